@@ -0,0 +1,109 @@
+#include <benchmark/benchmark.h>
+
+#include <CommandList.hpp>
+#include <JobSystem.hpp>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <thread>
+#include <vector>
+
+/**
+ * Powers of two up to the number of cores, and the core count itself.
+ */
+static void threadCounts(benchmark::internal::Benchmark * b) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    b->ArgName("threads");
+    for (unsigned t = 1; t < cores; t *= 2) {
+        b->Arg(t);
+    }
+    b->Arg(cores);
+}
+
+struct Sink {
+    float sum = 0;
+};
+
+static const std::size_t ObjectCount = 100000;
+
+/**
+ * Per object work and a draw command of the size of 18_render_thread.
+ */
+static void recordObjects(CommandList<Sink> & list,
+                          std::vector<glm::vec4> & objects,
+                          std::size_t begin,
+                          std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+        glm::vec4 & object = objects[i];
+        object.x = std::sin(object.x + object.y);
+        glm::mat4 model(object.x);
+        glm::vec4 color = object;
+        list.record([model, color](Sink & s) { s.sum += model[0][0] + color.w; },
+                    std::uint64_t(object.x * 1000.0f));
+    }
+}
+
+/**
+ * Recording cost as the threads grow, merged but not played.
+ */
+static void BM_CommandListRecord(benchmark::State & state) {
+    JobSystem jobs(state.range(0));
+    CommandRecorder<Sink> recorder;
+    std::vector<glm::vec4> objects(ObjectCount, glm::vec4(1.0f));
+    for (auto _ : state) {
+        recorder.parallelFor(
+            0, objects.size(), 0,
+            [&](CommandList<Sink> & list, std::size_t begin, std::size_t end) {
+                recordObjects(list, objects, begin, end);
+            },
+            &jobs);
+        benchmark::DoNotOptimize(recorder.merge());
+    }
+    state.SetItemsProcessed(state.iterations() * ObjectCount);
+}
+BENCHMARK(BM_CommandListRecord)
+    ->Apply(threadCounts)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/**
+ * Merging with a sort by key on the job system.
+ */
+static void BM_CommandListMergeSorted(benchmark::State & state) {
+    JobSystem jobs(state.range(0));
+    CommandRecorder<Sink> recorder;
+    std::vector<glm::vec4> objects(ObjectCount, glm::vec4(1.0f));
+    recorder.parallelFor(
+        0, objects.size(), 0,
+        [&](CommandList<Sink> & list, std::size_t begin, std::size_t end) {
+            recordObjects(list, objects, begin, end);
+        },
+        &jobs);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(recorder.merge(true));
+    }
+    state.SetItemsProcessed(state.iterations() * ObjectCount);
+}
+BENCHMARK(BM_CommandListMergeSorted)
+    ->Apply(threadCounts)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/**
+ * Playing the merged commands back on one thread.
+ */
+static void BM_CommandListPlay(benchmark::State & state) {
+    CommandRecorder<Sink> recorder;
+    std::vector<glm::vec4> objects(ObjectCount, glm::vec4(1.0f));
+    recorder.parallelFor(0, objects.size(), 0,
+                         [&](CommandList<Sink> & list, std::size_t begin, std::size_t end) {
+                             recordObjects(list, objects, begin, end);
+                         });
+    recorder.merge(true);
+    Sink sink;
+    for (auto _ : state) {
+        recorder.play(sink);
+    }
+    benchmark::DoNotOptimize(sink.sum);
+    state.SetItemsProcessed(state.iterations() * ObjectCount);
+}
+BENCHMARK(BM_CommandListPlay)->Unit(benchmark::kMillisecond);
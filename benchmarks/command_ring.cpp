@@ -0,0 +1,115 @@
+#include <benchmark/benchmark.h>
+
+#include <RenderThread.hpp>
+#include <atomic>
+#include <glm/glm.hpp>
+#include <thread>
+
+// the size of a draw command in 18_render_thread
+struct Draw {
+    Handle<Shader> shader;
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+struct Sink {
+    float sum = 0;
+};
+
+static const int CommandCount = 10000;
+
+/**
+ * Push and run commands on one thread, the cost of the ring alone.
+ */
+static void BM_CommandRingPushConsume(benchmark::State & state) {
+    CommandRing<Sink> ring(1 << 20);
+    Sink sink;
+    Draw draw {{1}, glm::mat4(1.0f), glm::vec4(1.0f)};
+    for (auto _ : state) {
+        for (int i = 0; i < CommandCount; i++) {
+            draw.color.x = float(i);
+            if (!ring.tryPush([draw](Sink & s) { s.sum += draw.model[0][0] + draw.color.x; }))
+                ring.consume(sink);
+        }
+        ring.consume(sink);
+    }
+    benchmark::DoNotOptimize(sink.sum);
+    state.SetItemsProcessed(state.iterations() * CommandCount);
+}
+BENCHMARK(BM_CommandRingPushConsume);
+
+/**
+ * Push commands with a block of data of range(0) bytes.
+ */
+static void BM_CommandRingPushData(benchmark::State & state) {
+    CommandRing<Sink> ring(1 << 20);
+    Sink sink;
+    std::vector<unsigned char> data(state.range(0), 1);
+    for (auto _ : state) {
+        for (int i = 0; i < CommandCount; i++) {
+            if (!ring.tryPush([](Sink & s, const void * d, std::size_t size) {
+                    s.sum += static_cast<const unsigned char *>(d)[size - 1];
+                },
+                              data.data(), data.size()))
+                ring.consume(sink);
+        }
+        ring.consume(sink);
+    }
+    benchmark::DoNotOptimize(sink.sum);
+    state.SetItemsProcessed(state.iterations() * CommandCount);
+    state.SetBytesProcessed(state.iterations() * CommandCount * data.size());
+}
+BENCHMARK(BM_CommandRingPushData)->ArgName("bytes")->RangeMultiplier(8)->Range(16, 4096);
+
+/**
+ * A producer and a consumer thread on a ring of range(0) bytes.
+ */
+static void BM_CommandRingThreaded(benchmark::State & state) {
+    CommandRing<Sink> ring(state.range(0));
+    Sink sink;
+    std::atomic<bool> done(false);
+    std::thread consumer([&] {
+        while (!done.load(std::memory_order_acquire) || !ring.empty()) {
+            if (ring.consume(sink) == 0)
+                std::this_thread::yield();
+        }
+    });
+    Draw draw {{1}, glm::mat4(1.0f), glm::vec4(1.0f)};
+    for (auto _ : state) {
+        for (int i = 0; i < CommandCount; i++) {
+            while (!ring.tryPush([draw](Sink & s) { s.sum += draw.color.x; }))
+                std::this_thread::yield();
+        }
+        while (!ring.empty())
+            std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    state.SetItemsProcessed(state.iterations() * CommandCount);
+}
+BENCHMARK(BM_CommandRingThreaded)
+    ->ArgName("capacity")
+    ->RangeMultiplier(16)
+    ->Range(4 << 10, 1 << 20)
+    ->UseRealTime();
+
+/**
+ * Frames of CommandCount commands on a RenderThread without a context,
+ * threaded if range(0) is 1.
+ */
+static void BM_RenderThreadFrame(benchmark::State & state) {
+    RenderThread render([] {}, [] {}, [] {}, state.range(0) != 0);
+    Draw draw {{1}, glm::mat4(1.0f), glm::vec4(1.0f)};
+    float sum = 0;
+    float * out = &sum;
+    for (auto _ : state) {
+        for (int i = 0; i < CommandCount; i++) {
+            render.submit([draw, out](RenderResources &) { *out += draw.color.x; });
+        }
+        render.endFrame();
+    }
+    render.finish();
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * CommandCount);
+}
+BENCHMARK(BM_RenderThreadFrame)->ArgName("threaded")->Arg(0)->Arg(1)->UseRealTime();
@@ -0,0 +1,135 @@
+#include <benchmark/benchmark.h>
+
+#include <Culling.hpp>
+#include <JobSystem.hpp>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <vector>
+
+static const std::size_t ObjectCount = 1000000;
+
+/**
+ * 1M objects spread over a 200 unit cube around a camera at the origin
+ * looking down -z, roughly 1 / 8 of them are visible.
+ */
+struct Scene {
+    Frustum frustum;
+    SphereBounds spheres;
+    BoxBounds boxes;
+    std::vector<std::uint32_t> visible;
+
+    Scene() : visible(ObjectCount) {
+        glm::mat4 projection =
+            glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0), {0, 0, -1}, {0, 1, 0});
+        frustum = Frustum::fromMatrix(projection * view);
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> size(0.1f, 2.0f);
+        for (std::size_t i = 0; i < ObjectCount; i++) {
+            glm::vec3 center(position(rng), position(rng), position(rng));
+            float r = size(rng);
+            spheres.add(center, r);
+            boxes.add(center - glm::vec3(r), center + glm::vec3(r));
+        }
+    }
+
+    static Scene & get() {
+        static Scene scene;
+        return scene;
+    }
+};
+
+static void BM_CullSpheresReference(benchmark::State & state) {
+    auto & scene = Scene::get();
+    for (auto _ : state) {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < scene.spheres.size(); i++) {
+            if (scene.frustum.intersects(scene.spheres.getCenter(i),
+                                         scene.spheres.getRadius(i)))
+                scene.visible[n++] = i;
+        }
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetItemsProcessed(state.iterations() * ObjectCount);
+}
+BENCHMARK(BM_CullSpheresReference)->Unit(benchmark::kMillisecond);
+
+static void BM_CullSpheres(benchmark::State & state) {
+    auto & scene = Scene::get();
+    std::size_t n = 0;
+    for (auto _ : state) {
+        n = FrustumCuller::cull(scene.frustum, scene.spheres,
+                                scene.visible.data(), state.range(0));
+        benchmark::DoNotOptimize(n);
+    }
+    state.counters["visible"] = n;
+    state.SetItemsProcessed(state.iterations() * ObjectCount);
+}
+BENCHMARK(BM_CullSpheres)
+    ->ArgName("threads")
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(0)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_CullSpheresJobs(benchmark::State & state) {
+    auto & scene = Scene::get();
+    JobSystem jobs(state.range(0));
+    std::size_t n = 0;
+    for (auto _ : state) {
+        n = FrustumCuller::cull(scene.frustum, scene.spheres,
+                                scene.visible.data(), jobs);
+        benchmark::DoNotOptimize(n);
+    }
+    state.counters["visible"] = n;
+    state.SetItemsProcessed(state.iterations() * ObjectCount);
+}
+BENCHMARK(BM_CullSpheresJobs)
+    ->ArgName("threads")
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(0)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_CullBoxesReference(benchmark::State & state) {
+    auto & scene = Scene::get();
+    for (auto _ : state) {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < scene.boxes.size(); i++) {
+            if (scene.frustum.intersects(scene.boxes.getMin(i),
+                                         scene.boxes.getMax(i)))
+                scene.visible[n++] = i;
+        }
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetItemsProcessed(state.iterations() * ObjectCount);
+}
+BENCHMARK(BM_CullBoxesReference)->Unit(benchmark::kMillisecond);
+
+static void BM_CullBoxes(benchmark::State & state) {
+    auto & scene = Scene::get();
+    std::size_t n = 0;
+    for (auto _ : state) {
+        n = FrustumCuller::cull(scene.frustum, scene.boxes,
+                                scene.visible.data(), state.range(0));
+        benchmark::DoNotOptimize(n);
+    }
+    state.counters["visible"] = n;
+    state.SetItemsProcessed(state.iterations() * ObjectCount);
+}
+BENCHMARK(BM_CullBoxes)
+    ->ArgName("threads")
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(0)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
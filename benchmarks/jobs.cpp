@@ -0,0 +1,135 @@
+#include <benchmark/benchmark.h>
+
+#include <JobSystem.hpp>
+#include <TransformStore.hpp>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <random>
+#include <thread>
+#include <vector>
+
+/**
+ * Powers of two up to the number of cores, and the core count itself.
+ */
+static void threadCounts(benchmark::internal::Benchmark * b) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    b->ArgName("threads");
+    for (unsigned t = 1; t < cores; t *= 2) {
+        b->Arg(t);
+    }
+    b->Arg(cores);
+}
+
+static const std::size_t ElementCount = 1 << 22;
+
+static void work(std::vector<float> & data, std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+        data[i] = std::sqrt(data[i] * 1.0001f + 1.0f) * std::sin(data[i]);
+    }
+}
+
+static void BM_ParallelFor(benchmark::State & state) {
+    JobSystem jobs(state.range(0));
+    std::vector<float> data(ElementCount, 1.0f);
+    for (auto _ : state) {
+        jobs.parallelFor(0, data.size(), 0, [&](std::size_t begin, std::size_t end) {
+            work(data, begin, end);
+        });
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * ElementCount);
+}
+BENCHMARK(BM_ParallelFor)
+    ->Apply(threadCounts)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_ParallelForGrain(benchmark::State & state) {
+    JobSystem jobs;
+    std::vector<float> data(ElementCount, 1.0f);
+    for (auto _ : state) {
+        jobs.parallelFor(0, data.size(), state.range(0),
+                         [&](std::size_t begin, std::size_t end) {
+                             work(data, begin, end);
+                         });
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * ElementCount);
+}
+BENCHMARK(BM_ParallelForGrain)
+    ->ArgName("grain")
+    ->RangeMultiplier(8)
+    ->Range(64, 1 << 18)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/**
+ * Overhead of submitting and running empty jobs.
+ */
+static void BM_JobSpawn(benchmark::State & state) {
+    const int count = 10000;
+    JobSystem jobs(state.range(0));
+    for (auto _ : state) {
+        JobSystem::Counter counter;
+        for (int i = 0; i < count; i++) {
+            jobs.run([] {}, &counter);
+        }
+        jobs.wait(counter);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_JobSpawn)->Apply(threadCounts)->UseRealTime();
+
+/**
+ * Jobs that spawn jobs, the load starts on one deque and has to be stolen.
+ */
+static void BM_JobNested(benchmark::State & state) {
+    const int count = 100;
+    JobSystem jobs(state.range(0));
+    std::vector<float> data(count * count * 256, 1.0f);
+    for (auto _ : state) {
+        JobSystem::Counter counter;
+        for (int i = 0; i < count; i++) {
+            jobs.run(
+                [&, i] {
+                    for (int j = 0; j < count; j++) {
+                        std::size_t begin = (i * count + j) * 256;
+                        jobs.run([&, begin] { work(data, begin, begin + 256); },
+                                 &counter);
+                    }
+                },
+                &counter);
+        }
+        jobs.wait(counter);
+    }
+    state.SetItemsProcessed(state.iterations() * count * count);
+}
+BENCHMARK(BM_JobNested)
+    ->Apply(threadCounts)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_ComposeJobs(benchmark::State & state) {
+    const std::size_t count = 1000000;
+    JobSystem jobs(state.range(0));
+    TransformStore transforms;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    for (std::size_t i = 0; i < count; i++) {
+        transforms.add({value(rng), value(rng), value(rng)},
+                       glm::normalize(glm::quat(value(rng), value(rng),
+                                                value(rng), value(rng))),
+                       glm::vec3(value(rng) + 2.0f));
+    }
+    std::vector<PackedAffine> out(count);
+    for (auto _ : state) {
+        transforms.markAllDirty();
+        transforms.compose(out.data(), jobs);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_ComposeJobs)
+    ->Apply(threadCounts)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+
+#include <JobSystem.hpp>
+#include <Lod.hpp>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <thread>
+#include <vector>
+
+/**
+ * A bumpy sphere with 128 * 256 * 2 = 65536 triangles.
+ */
+struct Mesh {
+    std::vector<glm::vec3> positions;
+    std::vector<std::uint32_t> indices;
+
+    Mesh() {
+        const int rings = 128, segments = 256;
+        const float pi = 3.14159265f;
+        for (int r = 0; r <= rings; r++) {
+            for (int s = 0; s <= segments; s++) {
+                float theta = pi * r / rings;
+                float phi = 2.0f * pi * s / segments;
+                float radius = 1.0f + 0.08f * std::sin(7.0f * phi) * std::sin(6.0f * theta);
+                positions.emplace_back(radius * std::sin(theta) * std::cos(phi),
+                                       radius * std::cos(theta),
+                                       radius * std::sin(theta) * std::sin(phi));
+            }
+        }
+        for (int r = 0; r < rings; r++) {
+            for (int s = 0; s < segments; s++) {
+                std::uint32_t a = r * (segments + 1) + s;
+                std::uint32_t b = a + segments + 1;
+                indices.insert(indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+            }
+        }
+    }
+
+    static Mesh & get() {
+        static Mesh mesh;
+        return mesh;
+    }
+};
+
+static void BM_Simplify(benchmark::State & state) {
+    auto & mesh = Mesh::get();
+    std::size_t target = mesh.indices.size() / state.range(0) / 3 * 3;
+    for (auto _ : state) {
+        auto result = MeshSimplifier::simplify(mesh.positions, mesh.indices, target);
+        benchmark::DoNotOptimize(result.data());
+    }
+    state.SetItemsProcessed(state.iterations() * mesh.indices.size() / 3);
+}
+BENCHMARK(BM_Simplify)
+    ->ArgName("ratio")
+    ->Arg(2)
+    ->Arg(8)
+    ->Arg(64)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_BuildLods(benchmark::State & state) {
+    auto & mesh = Mesh::get();
+    for (auto _ : state) {
+        auto lods = MeshSimplifier::buildLods(mesh.positions, mesh.indices, 6, 0.35f);
+        benchmark::DoNotOptimize(lods.indices.data());
+    }
+}
+BENCHMARK(BM_BuildLods)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_BuildLodsJobs(benchmark::State & state) {
+    auto & mesh = Mesh::get();
+    JobSystem jobs(state.range(0));
+    for (auto _ : state) {
+        auto lods = MeshSimplifier::buildLods(mesh.positions, mesh.indices, jobs, 6, 0.35f);
+        benchmark::DoNotOptimize(lods.indices.data());
+    }
+}
+BENCHMARK(BM_BuildLodsJobs)
+    ->ArgName("threads")
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(0)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
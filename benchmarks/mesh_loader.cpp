@@ -0,0 +1,145 @@
+#include <benchmark/benchmark.h>
+
+#include <JobSystem.hpp>
+#include <MeshLoader.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int GridSize = 512;
+
+/**
+ * A GridSize * GridSize quad grid as OBJ text with positions, texture
+ * coordinates and normals, about 40 MB.
+ */
+static const std::string & objText() {
+    static const std::string text = [] {
+        std::ostringstream s;
+        s.precision(6);
+        for (int y = 0; y <= GridSize; y++) {
+            for (int x = 0; x <= GridSize; x++) {
+                s << "v " << x * 0.01f << ' ' << std::sin(x * 0.1f) * 0.2f << ' ' << y * 0.01f << '\n';
+                s << "vt " << float(x) / GridSize << ' ' << float(y) / GridSize << '\n';
+                s << "vn " << 0.0f << ' ' << 0.98f << ' ' << 0.199f << '\n';
+            }
+        }
+        for (int y = 0; y < GridSize; y++) {
+            for (int x = 0; x < GridSize; x++) {
+                int a = y * (GridSize + 1) + x + 1, b = a + GridSize + 1;
+                s << "f " << a << '/' << a << '/' << a << ' ' << a + 1 << '/' << a + 1 << '/' << a + 1
+                  << ' ' << b + 1 << '/' << b + 1 << '/' << b + 1 << ' ' << b << '/' << b << '/' << b
+                  << '\n';
+            }
+        }
+        return s.str();
+    }();
+    return text;
+}
+
+static void appendU32(std::string & bytes, std::uint32_t value) {
+    bytes.append(reinterpret_cast<const char *>(&value), 4);
+}
+
+/**
+ * The same grid as a .glb with interleaved float attributes and 32 bit
+ * indices.
+ */
+static const std::string & glbBytes() {
+    static const std::string bytes = [] {
+        MeshData mesh = MeshLoader::loadObj(objText());
+        std::string binary(reinterpret_cast<const char *>(mesh.vertices.data()),
+                           mesh.vertices.size() * sizeof(MeshVertex));
+        binary.append(reinterpret_cast<const char *>(mesh.indices.data()),
+                      mesh.indices.size() * sizeof(std::uint32_t));
+
+        std::size_t vertexBytes = mesh.vertices.size() * sizeof(MeshVertex);
+        std::string n = std::to_string(mesh.vertices.size());
+        std::string json = R"({"asset":{"version":"2.0"},"scene":0,"scenes":[{"nodes":[0]}],)"
+                           R"("nodes":[{"mesh":0}],"meshes":[{"primitives":[{"attributes":)"
+                           R"({"POSITION":0,"NORMAL":1,"TEXCOORD_0":2},"indices":3}]}],)"
+                           R"("accessors":[)"
+                           R"({"bufferView":0,"componentType":5126,"count":)" + n + R"(,"type":"VEC3"},)"
+                           R"({"bufferView":0,"byteOffset":12,"componentType":5126,"count":)" + n + R"(,"type":"VEC3"},)"
+                           R"({"bufferView":0,"byteOffset":24,"componentType":5126,"count":)" + n + R"(,"type":"VEC2"},)"
+                           R"({"bufferView":1,"componentType":5125,"count":)" + std::to_string(mesh.indices.size())
+                           + R"(,"type":"SCALAR"}],"bufferViews":[)"
+                           R"({"buffer":0,"byteLength":)" + std::to_string(vertexBytes) + R"(,"byteStride":32},)"
+                           R"({"buffer":0,"byteOffset":)" + std::to_string(vertexBytes)
+                           + R"(,"byteLength":)" + std::to_string(binary.size() - vertexBytes) + R"(}],)"
+                           R"("buffers":[{"byteLength":)" + std::to_string(binary.size()) + "}]}";
+        while (json.size() % 4)
+            json += ' ';
+
+        std::string glb;
+        appendU32(glb, 0x46546C67);
+        appendU32(glb, 2);
+        appendU32(glb, 12 + 8 + json.size() + 8 + binary.size());
+        appendU32(glb, json.size());
+        appendU32(glb, 0x4E4F534A);
+        glb += json;
+        appendU32(glb, binary.size());
+        appendU32(glb, 0x004E4942);
+        glb += binary;
+        return glb;
+    }();
+    return bytes;
+}
+
+static void threadCounts(benchmark::internal::Benchmark * b) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    b->ArgName("threads");
+    b->Arg(0);
+    for (unsigned t = 1; t < cores; t *= 2) {
+        b->Arg(t);
+    }
+    b->Arg(cores);
+}
+
+// threads 0 loads without a job system
+static void BM_LoadObj(benchmark::State & state) {
+    const std::string & text = objText();
+    std::unique_ptr<JobSystem> jobs;
+    if (state.range(0) > 0)
+        jobs = std::make_unique<JobSystem>(state.range(0));
+    for (auto _ : state) {
+        MeshData mesh = MeshLoader::loadObj(text, jobs.get());
+        benchmark::DoNotOptimize(mesh.vertices.data());
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_LoadObj)->Apply(threadCounts)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_LoadGlb(benchmark::State & state) {
+    const std::string & bytes = glbBytes();
+    std::unique_ptr<JobSystem> jobs;
+    if (state.range(0) > 0)
+        jobs = std::make_unique<JobSystem>(state.range(0));
+    for (auto _ : state) {
+        MeshData mesh = MeshLoader::loadGlb(bytes, "", jobs.get());
+        benchmark::DoNotOptimize(mesh.vertices.data());
+    }
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_LoadGlb)->Apply(threadCounts)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_Weld(benchmark::State & state) {
+    MeshData source = MeshLoader::loadObj(objText());
+    // one vertex per corner, as an unindexed file would give
+    MeshData corners;
+    for (auto index : source.indices) {
+        corners.indices.push_back(corners.vertices.size());
+        corners.vertices.push_back(source.vertices[index]);
+    }
+    for (auto _ : state) {
+        MeshData mesh = corners;
+        MeshLoader::weld(mesh);
+        benchmark::DoNotOptimize(mesh.vertices.data());
+    }
+    state.SetItemsProcessed(state.iterations() * corners.vertices.size());
+}
+BENCHMARK(BM_Weld)->Unit(benchmark::kMillisecond);
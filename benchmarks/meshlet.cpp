@@ -0,0 +1,70 @@
+#include <benchmark/benchmark.h>
+
+#include <Culling.hpp>
+#include <Meshlet.hpp>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+
+/**
+ * A bumpy sphere with 256 * 512 * 2 = 262144 triangles.
+ */
+struct Mesh {
+    std::vector<glm::vec3> positions;
+    std::vector<std::uint32_t> indices;
+
+    Mesh() {
+        const int rings = 256, segments = 512;
+        const float pi = 3.14159265f;
+        for (int r = 0; r <= rings; r++) {
+            for (int s = 0; s <= segments; s++) {
+                float theta = pi * r / rings;
+                float phi = 2.0f * pi * s / segments;
+                float radius = 1.0f + 0.08f * std::sin(7.0f * phi) * std::sin(6.0f * theta);
+                positions.emplace_back(radius * std::sin(theta) * std::cos(phi),
+                                       radius * std::cos(theta),
+                                       radius * std::sin(theta) * std::sin(phi));
+            }
+        }
+        for (int r = 0; r < rings; r++) {
+            for (int s = 0; s < segments; s++) {
+                std::uint32_t a = r * (segments + 1) + s;
+                std::uint32_t b = a + segments + 1;
+                indices.insert(indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+            }
+        }
+    }
+
+    static Mesh & get() {
+        static Mesh mesh;
+        return mesh;
+    }
+};
+
+static void BM_BuildMeshlets(benchmark::State & state) {
+    auto & mesh = Mesh::get();
+    for (auto _ : state) {
+        MeshletMesh meshlets = MeshletBuilder::build(mesh.positions, mesh.indices);
+        benchmark::DoNotOptimize(meshlets.indices.data());
+    }
+    state.SetItemsProcessed(state.iterations() * mesh.indices.size() / 3);
+}
+BENCHMARK(BM_BuildMeshlets)->Unit(benchmark::kMillisecond);
+
+// range 0 culls against the frustum only, 1 against the normal cones too
+static void BM_CullMeshlets(benchmark::State & state) {
+    auto & mesh = Mesh::get();
+    static const MeshletMesh meshlets = MeshletBuilder::build(mesh.positions, mesh.indices);
+    MeshletCuller culler(meshlets.meshlets);
+    glm::vec3 eye(0, 0.5f, 1.8f);
+    Frustum frustum = Frustum::fromMatrix(glm::perspective(1.0f, 1.5f, 0.01f, 50.0f)
+                                          * glm::lookAt(eye, glm::vec3(0), glm::vec3(0, 1, 0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(culler.cull(frustum, eye, state.range(0)));
+    }
+    state.SetItemsProcessed(state.iterations() * culler.size());
+    state.counters["visible_triangles"] = culler.getVisibleTriangles();
+}
+BENCHMARK(BM_CullMeshlets)->ArgName("cones")->Arg(0)->Arg(1);
@@ -0,0 +1,52 @@
+#include <benchmark/benchmark.h>
+
+#include <Profiler.hpp>
+#include <cstdint>
+#include <vector>
+
+/**
+ * The cost of one zone on the recording thread, the rings are drained now
+ * and then outside the timed region so nothing is counted as lost.
+ */
+static void BM_Zone(benchmark::State & state) {
+    std::vector<TraceEvent> events;
+    std::size_t recorded = 0;
+    for (auto _ : state) {
+        Profiler::Zone zone("zone");
+        if (++recorded == Profiler::Capacity / 2) {
+            state.PauseTiming();
+            Profiler::get().collect(events);
+            events.clear();
+            recorded = 0;
+            state.ResumeTiming();
+        }
+    }
+}
+BENCHMARK(BM_Zone)->ThreadRange(1, 8);
+
+static void BM_Timestamp(benchmark::State & state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Profiler::now());
+    }
+}
+BENCHMARK(BM_Timestamp);
+
+/**
+ * Draining a full ring and converting its timestamps.
+ */
+static void BM_Collect(benchmark::State & state) {
+    std::vector<TraceEvent> events;
+    events.reserve(Profiler::Capacity);
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (std::size_t i = 0; i < Profiler::Capacity; i++) {
+            Profiler::Zone zone("zone");
+        }
+        events.clear();
+        state.ResumeTiming();
+        Profiler::get().collect(events);
+        benchmark::DoNotOptimize(events.data());
+    }
+    state.SetItemsProcessed(state.iterations() * Profiler::Capacity);
+}
+BENCHMARK(BM_Collect)->Unit(benchmark::kMicrosecond);
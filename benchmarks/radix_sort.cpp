@@ -0,0 +1,105 @@
+#include <benchmark/benchmark.h>
+
+#include <JobSystem.hpp>
+#include <RadixSort.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+static const std::size_t KeyCount = 1 << 20;
+
+/**
+ * Keys shaped like RenderQueue keys: a few layers, 8 shaders, 64 textures
+ * and a 24 bit depth, the rest of the bits are zero.
+ */
+static std::vector<std::uint64_t> makeKeys(bool renderKeys) {
+    std::mt19937_64 random(42);
+    std::vector<std::uint64_t> keys(KeyCount);
+    for (auto & key : keys) {
+        key = random();
+        if (renderKeys)
+            key = (key & 0x3) << 60 | (key >> 8 & 0x7) << 47 | (key >> 16 & 0x3F) << 35
+                  | (key >> 32 & 0xFFFFFF) << 11;
+    }
+    return keys;
+}
+
+static std::vector<std::uint32_t> makeValues() {
+    std::vector<std::uint32_t> values(KeyCount);
+    for (std::size_t i = 0; i < values.size(); i++) {
+        values[i] = i;
+    }
+    return values;
+}
+
+static void threadCounts(benchmark::internal::Benchmark * b) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    b->ArgNames({"render_keys", "threads"});
+    for (int renderKeys = 0; renderKeys < 2; renderKeys++) {
+        for (unsigned t = 1; t < cores; t *= 2) {
+            b->Args({renderKeys, t});
+        }
+        b->Args({renderKeys, cores});
+    }
+}
+
+static void BM_StdSort(benchmark::State & state) {
+    const auto keys = makeKeys(state.range(0));
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> pairs(KeyCount);
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < KeyCount; i++) {
+            pairs[i] = {keys[i], std::uint32_t(i)};
+        }
+        std::sort(pairs.begin(), pairs.end());
+        benchmark::DoNotOptimize(pairs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * KeyCount);
+}
+BENCHMARK(BM_StdSort)
+    ->ArgName("render_keys")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_RadixSort(benchmark::State & state) {
+    const auto keys = makeKeys(state.range(0));
+    const auto values = makeValues();
+    std::vector<std::uint64_t> sortedKeys;
+    std::vector<std::uint32_t> sortedValues;
+    RadixSort sorter;
+    for (auto _ : state) {
+        sortedKeys = keys;
+        sortedValues = values;
+        sorter.sort(sortedKeys, sortedValues);
+        benchmark::DoNotOptimize(sortedKeys.data());
+    }
+    state.SetItemsProcessed(state.iterations() * KeyCount);
+}
+BENCHMARK(BM_RadixSort)
+    ->ArgName("render_keys")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_RadixSortJobs(benchmark::State & state) {
+    const auto keys = makeKeys(state.range(0));
+    const auto values = makeValues();
+    std::vector<std::uint64_t> sortedKeys;
+    std::vector<std::uint32_t> sortedValues;
+    RadixSort sorter;
+    JobSystem jobs(state.range(1));
+    for (auto _ : state) {
+        sortedKeys = keys;
+        sortedValues = values;
+        sorter.sort(sortedKeys, sortedValues, &jobs);
+        benchmark::DoNotOptimize(sortedKeys.data());
+    }
+    state.SetItemsProcessed(state.iterations() * KeyCount);
+}
+BENCHMARK(BM_RadixSortJobs)
+    ->Apply(threadCounts)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
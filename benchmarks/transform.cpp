@@ -0,0 +1,50 @@
+#include <benchmark/benchmark.h>
+
+#include <Transform.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+static const std::size_t TransformCount = 1 << 12;
+
+static std::vector<Transform> makeTransforms() {
+    std::vector<Transform> transforms;
+    for (std::size_t i = 0; i < TransformCount; i++) {
+        transforms.emplace_back(glm::vec3(i, i * 0.5f, -float(i)),
+                                glm::quat(glm::vec3(i * 0.01f, i * 0.02f, 0)),
+                                glm::vec3(1 + i % 3));
+    }
+    return transforms;
+}
+
+/**
+ * Compose the matrix of a transform that changed since the last call.
+ */
+static void BM_ToMatrixChanged(benchmark::State & state) {
+    std::vector<Transform> transforms = makeTransforms();
+    for (auto _ : state) {
+        for (auto & t : transforms) {
+            t.move(glm::vec3(0.001f));
+            benchmark::DoNotOptimize(t.toMatrix());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * TransformCount);
+}
+BENCHMARK(BM_ToMatrixChanged);
+
+/**
+ * Return the cached matrix of an unchanged transform.
+ */
+static void BM_ToMatrixCached(benchmark::State & state) {
+    std::vector<Transform> transforms = makeTransforms();
+    for (auto & t : transforms) {
+        t.toMatrix();
+    }
+    for (auto _ : state) {
+        for (auto & t : transforms) {
+            benchmark::DoNotOptimize(t.toMatrix());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * TransformCount);
+}
+BENCHMARK(BM_ToMatrixCached);
@@ -0,0 +1,230 @@
+#include <benchmark/benchmark.h>
+
+#include <GL/glew.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <Buffer.hpp>
+#include <Context.hpp>
+#include <Shader.hpp>
+#include <Texture.hpp>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/**
+ * GL benchmarks of the wrapper hot paths on a headless EGL context, made for
+ * Mesa llvmpipe (LIBGL_ALWAYS_SOFTWARE=1) so results are comparable across
+ * machines. Every iteration that queues GPU work ends with glFinish() so the
+ * time includes the work the driver defers.
+ */
+
+static const char * vertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+uniform mat4 model;
+uniform vec4 color;
+out vec4 Color;
+void main() {
+    gl_Position = model * vec4(aPos, 0.0, 1.0);
+    Color = color;
+})";
+
+static const char * fragmentShaderSource = R"(
+#version 330 core
+in vec4 Color;
+out vec4 FragColor;
+void main() {
+    FragColor = Color;
+})";
+
+static void BM_BufferSubData(benchmark::State & state) {
+    const std::size_t size = state.range(0);
+    std::vector<unsigned char> data(size, 7);
+    Buffer buffer(GL_ARRAY_BUFFER);
+    buffer.bufferData(size, nullptr, GL_DYNAMIC_DRAW);
+    for (auto _ : state) {
+        buffer.bufferSubData(0, size, data.data());
+        glFinish();
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_BufferSubData)->ArgName("bytes")->RangeMultiplier(16)->Range(64, 4 << 20);
+
+/**
+ * Replace the whole store with bufferData, which lets the driver orphan it
+ * instead of waiting for draws that still read it.
+ */
+static void BM_BufferDataOrphan(benchmark::State & state) {
+    const std::size_t size = state.range(0);
+    std::vector<unsigned char> data(size, 7);
+    Buffer buffer(GL_ARRAY_BUFFER);
+    for (auto _ : state) {
+        buffer.bufferData(size, data.data(), GL_DYNAMIC_DRAW);
+        glFinish();
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_BufferDataOrphan)->ArgName("bytes")->RangeMultiplier(16)->Range(64, 4 << 20);
+
+/**
+ * Upload a size x size image with 1, 3 or 4 components, without mipmaps.
+ */
+static void BM_TextureUpload(benchmark::State & state) {
+    const unsigned components = state.range(0);
+    const glm::uvec2 size(state.range(1));
+    std::vector<unsigned char> pixels(size.x * size.y * components, 128);
+    Texture texture(pixels.data(), size, components, Texture::Linear, Texture::Linear,
+                    Texture::Repeat, false);
+    for (auto _ : state) {
+        texture.loadFrom(pixels.data(), size, components);
+        glFinish();
+    }
+    state.SetBytesProcessed(state.iterations() * pixels.size());
+}
+BENCHMARK(BM_TextureUpload)
+    ->ArgNames({"components", "size"})
+    ->ArgsProduct({{1, 3, 4}, {256, 1024}})
+    ->Unit(benchmark::kMicrosecond);
+
+/**
+ * Set a uniform of the bound program: 0 a float, 1 a vec4, 2 a mat4, 3 a
+ * mat4 looked up by name every time.
+ *
+ * No glFinish(): setting a uniform only updates program state on the CPU,
+ * nothing is queued for the GPU, so waiting would time glFinish() itself.
+ */
+static void BM_Uniform(benchmark::State & state) {
+    Shader shader(vertexShaderSource, fragmentShaderSource);
+    shader.bind();
+    Shader::Uniform model = shader.uniform("model");
+    Shader::Uniform color = shader.uniform("color");
+    glm::mat4 matrix(1);
+    float f = 0;
+    for (auto _ : state) {
+        f += 0.001f;
+        switch (state.range(0)) {
+            case 0:
+                color.setValue(f);
+                break;
+            case 1:
+                color.setVec4(glm::vec4(f, 0, 0, 1));
+                break;
+            case 2:
+                matrix[3][0] = f;
+                model.setMat4(matrix);
+                break;
+            default:
+                matrix[3][0] = f;
+                shader.uniform("model").setMat4(matrix);
+                break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Uniform)->ArgName("kind")->DenseRange(0, 3);
+
+/**
+ * The quads drawn by the draw benchmarks, small so the time is spent on
+ * submission rather than on rasterization.
+ */
+struct Quads {
+    Shader shader;
+    BufferArray array;
+    Shader::Uniform model;
+    Shader::Uniform color;
+
+    Quads()
+        : shader(vertexShaderSource, fragmentShaderSource),
+          array(std::vector<std::vector<Attribute>> {
+              {{0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0}}}),
+          model(shader.uniform("model")),
+          color(shader.uniform("color")) {
+        const float vertices[] = {-0.01f, -0.01f, 0.01f, -0.01f, 0.01f, 0.01f, -0.01f, 0.01f};
+        const unsigned int indices[] = {0, 1, 2, 0, 2, 3};
+        array.bind();
+        array.bufferData(0, sizeof(vertices), vertices);
+        array.bufferElements(sizeof(indices), indices);
+        array.unbind();
+
+        // llvmpipe compiles the shaders on the first draw
+        shader.bind();
+        array.drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        glFinish();
+    }
+};
+
+/**
+ * A batch of separate draws, each with its own model matrix.
+ */
+static void BM_DrawElements(benchmark::State & state) {
+    const int batch = state.range(0);
+    Quads quads;
+    quads.shader.bind();
+    quads.color.setVec4(glm::vec4(1));
+    glm::mat4 matrix(1);
+    for (auto _ : state) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (int i = 0; i < batch; i++) {
+            matrix[3][0] = (i % 64) / 32.0f - 1;
+            matrix[3][1] = (i / 64 % 64) / 32.0f - 1;
+            quads.model.setMat4(matrix);
+            quads.array.drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        }
+        glFinish();
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_DrawElements)
+    ->ArgName("batch")
+    ->RangeMultiplier(8)
+    ->Range(1, 4096)
+    ->Unit(benchmark::kMicrosecond);
+
+/**
+ * The same number of quads drawn with one instanced draw.
+ */
+static void BM_DrawElementsInstanced(benchmark::State & state) {
+    const int batch = state.range(0);
+    Quads quads;
+    quads.shader.bind();
+    quads.color.setVec4(glm::vec4(1));
+    quads.model.setMat4(glm::mat4(1));
+    for (auto _ : state) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        quads.array.drawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, batch);
+        glFinish();
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_DrawElementsInstanced)
+    ->ArgName("batch")
+    ->RangeMultiplier(8)
+    ->Range(1, 4096)
+    ->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char ** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    Context::Settings settings;
+    settings.size = {256, 256};
+    settings.vsync = false;
+    std::unique_ptr<HeadlessContext> context;
+    try {
+        context = std::make_unique<HeadlessContext>(settings);
+    }
+    catch (Context::ContextException & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    FrameBuffer::getDefault().bind();
+
+    benchmark::AddCustomContext("renderer",
+                                reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -4,15 +4,17 @@ using namespace std;
 #include <GL/glew.h>
 
 #include <SFML/Graphics.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
 
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 3, 0);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Hello Window",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -23,9 +25,12 @@ int main() {
         return 1;
     }
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
                     if (event.key.code == sf::Keyboard::Escape)
@@ -43,14 +48,18 @@ int main() {
                 default:
                     break;
             }
-        }
+        },
+        [&]() {
+            harness.beginFrame();
 
-        glClear(GL_COLOR_BUFFER_BIT);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        window.display();
-    }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
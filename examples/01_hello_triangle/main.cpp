@@ -4,6 +4,10 @@ using namespace std;
 #include <GL/glew.h>
 
 #include <SFML/Graphics.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
 #include <debug.hpp>
 
 static const char * vertexShaderSource = R"(
@@ -60,14 +64,12 @@ static GLuint loadShader() {
     return program;
 }
 
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 3, 0);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Hello Triangle",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -78,6 +80,10 @@ int main() {
         return 1;
     }
 
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
     initDebug();
 
     GLuint program = loadShader();
@@ -117,9 +123,8 @@ int main() {
     // uncomment this call to draw in wireframe polygons.
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
                     if (event.key.code == sf::Keyboard::Escape)
@@ -137,16 +142,20 @@ int main() {
                 default:
                     break;
             }
-        }
+        },
+        [&]() {
+            harness.beginFrame();
 
-        glClear(GL_COLOR_BUFFER_BIT);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        glUseProgram(program);
-        glBindVertexArray(vao);
-        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+            glUseProgram(program);
+            glBindVertexArray(vao);
+            glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
 
-        window.display();
-    }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     glDeleteVertexArrays(1, &vao);
     glDeleteBuffers(1, &vbo);
@@ -155,5 +164,5 @@ int main() {
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
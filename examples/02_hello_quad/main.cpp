@@ -5,6 +5,10 @@ using namespace std;
 #include <GL/glew.h>
 
 #include <SFML/Graphics.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
 #include <debug.hpp>
 #include <glm/glm.hpp>
 using namespace glm;
@@ -87,14 +91,12 @@ void draw_quad(const vec2 & pos, const vec2 & size) {
     draw_array(vertices, GL_TRIANGLES);
 }
 
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 3, 0);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Hello Quad",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -105,6 +107,10 @@ int main() {
         return 1;
     }
 
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
     initDebug();
 
     GLuint program = loadShader();
@@ -120,9 +126,8 @@ int main() {
     // uncomment this call to draw in wireframe polygons.
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
                     if (event.key.code == sf::Keyboard::Escape)
@@ -140,19 +145,23 @@ int main() {
                 default:
                     break;
             }
-        }
+        },
+        [&]() {
+            harness.beginFrame();
 
-        glClear(GL_COLOR_BUFFER_BIT);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        glUseProgram(program);
-        draw_quad({-0.5, -0.5}, {1, 1});
+            glUseProgram(program);
+            draw_quad({-0.5, -0.5}, {1, 1});
 
-        window.display();
-    }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     glDeleteProgram(program);
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
@@ -4,6 +4,10 @@ using namespace std;
 #include <GL/glew.h>
 
 #include <SFML/Graphics.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
 #include <Shader.hpp>
 #include <debug.hpp>
 
@@ -25,14 +29,12 @@ void main() {
     FragColor = vec4(color, 1.0);
 })";
 
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 3, 0);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Shader",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -43,6 +45,10 @@ int main() {
         return 1;
     }
 
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
     initDebug();
 
     Shader shader(vertexShaderSource, fragmentShaderSource);
@@ -92,9 +98,8 @@ int main() {
     // uncomment this call to draw in wireframe polygons.
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
                     if (event.key.code == sf::Keyboard::Escape)
@@ -112,16 +117,20 @@ int main() {
                 default:
                     break;
             }
-        }
+        },
+        [&]() {
+            harness.beginFrame();
 
-        glClear(GL_COLOR_BUFFER_BIT);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        shader.bind();
-        glBindVertexArray(vao);
-        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+            shader.bind();
+            glBindVertexArray(vao);
+            glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
 
-        window.display();
-    }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     glDeleteVertexArrays(1, &vao);
     glDeleteBuffers(2, vbo);
@@ -129,5 +138,5 @@ int main() {
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
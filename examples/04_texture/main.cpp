@@ -6,6 +6,9 @@ using namespace std;
 #include <SFML/Graphics.hpp>
 #include <Shader.hpp>
 #define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
 #include <Texture.hpp>
 #include <debug.hpp>
 
@@ -28,14 +31,12 @@ void main() {
     FragColor = texture(gTexture, FragTex);
 })";
 
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 3, 0);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Texture",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -46,6 +47,10 @@ int main() {
         return 1;
     }
 
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
     initDebug();
 
     Shader shader(vertexShaderSource, fragmentShaderSource);
@@ -96,9 +101,8 @@ int main() {
     // uncomment this call to draw in wireframe polygons.
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
                     if (event.key.code == sf::Keyboard::Escape)
@@ -116,17 +120,21 @@ int main() {
                 default:
                     break;
             }
-        }
+        },
+        [&]() {
+            harness.beginFrame();
 
-        glClear(GL_COLOR_BUFFER_BIT);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        shader.bind();
-        texture.bind();
-        glBindVertexArray(vao);
-        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+            shader.bind();
+            texture.bind();
+            glBindVertexArray(vao);
+            glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
 
-        window.display();
-    }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     glDeleteVertexArrays(1, &vao);
     glDeleteBuffers(2, vbo);
@@ -134,5 +142,5 @@ int main() {
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
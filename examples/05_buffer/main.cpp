@@ -6,7 +6,10 @@ using namespace std;
 #include <SFML/Graphics.hpp>
 #include <Shader.hpp>
 #define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <Buffer.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
 #include <Texture.hpp>
 #include <debug.hpp>
 
@@ -29,14 +32,12 @@ void main() {
     FragColor = texture(gTexture, FragTex);
 })";
 
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 3, 0);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Buffer",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -47,6 +48,10 @@ int main() {
         return 1;
     }
 
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
     initDebug();
 
     Shader shader(vertexShaderSource, fragmentShaderSource);
@@ -81,9 +86,8 @@ int main() {
     // uncomment this call to draw in wireframe polygons.
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
                     if (event.key.code == sf::Keyboard::Escape)
@@ -101,19 +105,23 @@ int main() {
                 default:
                     break;
             }
-        }
+        },
+        [&]() {
+            harness.beginFrame();
 
-        glClear(GL_COLOR_BUFFER_BIT);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        shader.bind();
-        texture.bind();
-        // array.drawArrays(GL_TRIANGLES, 0, 3);
-        array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+            shader.bind();
+            texture.bind();
+            // array.drawArrays(GL_TRIANGLES, 0, 3);
+            array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
 
-        window.display();
-    }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
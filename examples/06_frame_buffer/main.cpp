@@ -6,7 +6,10 @@ using namespace std;
 #include <SFML/Graphics.hpp>
 #include <Shader.hpp>
 #define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <Buffer.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
 #include <Texture.hpp>
 #include <debug.hpp>
 #include <glm/glm.hpp>
@@ -41,14 +44,12 @@ void main() {
     FragTex = aTex;
 })";
 
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 3, 0);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Frame Buffer",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -59,6 +60,10 @@ int main() {
         return 1;
     }
 
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
     initDebug();
 
     Shader shader(vertexShaderSource, fragmentShaderSource);
@@ -134,9 +139,8 @@ int main() {
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
                     if (event.key.code == sf::Keyboard::Escape)
@@ -154,29 +158,33 @@ int main() {
                 default:
                     break;
             }
-        }
+        },
+        [&]() {
+            harness.beginFrame();
 
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-        glClear(GL_COLOR_BUFFER_BIT);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        shader.bind();
-        texture.bind();
-        array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+            shader.bind();
+            texture.bind();
+            array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        screenShader.bind();
-        fboTexture.bind();
-        quad.draw();
+            screenShader.bind();
+            fboTexture.bind();
+            quad.draw();
 
-        window.display();
-    }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     glDeleteFramebuffers(1, &fbo);
     glDeleteRenderbuffers(1, &rbo);
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
@@ -6,8 +6,14 @@ using namespace std;
 #include <SFML/Graphics.hpp>
 #include <Shader.hpp>
 #define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <Buffer.hpp>
 #include <FrameBuffer.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
+#include <GpuProfiler.hpp>
+#include <PostProcess.hpp>
+#include <Profiler.hpp>
 #include <Texture.hpp>
 #include <debug.hpp>
 #include <glm/glm.hpp>
@@ -32,41 +38,12 @@ void main() {
     FragColor = texture(gTexture, FragTex);
 })";
 
-static const char * screenVertexShaderSource = R"(
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTex;
-out vec2 FragPos;
-out vec2 FragTex;
-void main() {
-    gl_Position = vec4(aPos, 1.0);
-    FragPos = aPos.xy;
-    FragTex = aTex;
-})";
-
-static const char * screenFragmentShaderSource = R"(
-#version 330 core
-in vec2 FragPos;
-in vec2 FragTex;
-out vec4 FragColor;
-uniform sampler2D gTexture;
-uniform float t;
-void main() {
-    vec2 d = vec2(sin(t + FragPos.x * 3) * 0.1, sin(t + FragPos.y * 3) * 0.1);
-    vec2 texCoord = FragTex + vec2(d.x, 0.0);
-    vec4 c = texture(gTexture, texCoord);
-    float v = c.r * 0.2126 + c.g * 0.7152 + c.b * 0.0722;
-    FragColor = vec4(vec3(v), c.a);
-})";
-
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 4, 6, sf::ContextSettings::Debug);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Post Processing",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -77,11 +54,13 @@ int main() {
         return 1;
     }
 
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
     initDebug();
 
     Shader shader(vertexShaderSource, fragmentShaderSource);
-    Shader screenShader(screenVertexShaderSource, screenFragmentShaderSource);
-    Shader::Uniform sst = screenShader.uniform("t");
     Texture texture = Texture::fromPath("../../../examples/res/uv.png");
 
     const float vertices[] = {
@@ -110,7 +89,12 @@ int main() {
     array.bufferElements(sizeof(indices), indices);
     array.unbind();
 
-    Quad quad;
+    PostProcessStack postProcess({
+        PostEffect::distortion(),
+        PostEffect::grayscale(),
+        PostEffect::vignette(),
+    });
+    auto ppt = postProcess.param("t");
 
     // uncomment this call to draw in wireframe polygons.
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -141,15 +125,37 @@ int main() {
     }
     FrameBuffer::getDefault().bind();
 
+    GpuProfiler profiler;
+    cout << "P: print GPU times, T: start / stop a trace" << endl;
+    PROFILE_THREAD("main");
+
     sf::Clock clock;
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
                     if (event.key.code == sf::Keyboard::Escape)
                         window.close();
+                    if (event.key.code == sf::Keyboard::P)
+                        profiler.report(cout);
+                    if (event.key.code == sf::Keyboard::T) {
+                        // CPU zones are only recorded with OPENGL_DEMO_PROFILE,
+                        // without it the trace holds the GPU scopes alone
+                        profiler.setCapture(!profiler.isCapturing());
+                        vector<TraceEvent> events;
+                        Profiler::get().collect(events);
+                        if (profiler.isCapturing()) {
+                            events.clear();
+                        }
+                        else {
+                            events.insert(events.end(), profiler.getEvents().begin(),
+                                          profiler.getEvents().end());
+                            Profiler::get().saveChromeTrace("trace.json", events);
+                            profiler.clearEvents();
+                            cout << "wrote trace.json" << endl;
+                        }
+                    }
                     break;
                 case sf::Event::Resized: {
                     sf::FloatRect visibleArea(0, 0, event.size.width,
@@ -163,27 +169,38 @@ int main() {
                 default:
                     break;
             }
-        }
-
-        fbo.bind();
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        shader.bind();
-        texture.bind();
-        array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
-
-        FrameBuffer::getDefault().bind();
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        screenShader.bind();
-        sst.setValue(clock.getElapsedTime().asSeconds());
-        fboTexture.bind();
-        quad.draw();
+        },
+        [&]() {
+            harness.beginFrame();
+
+            profiler.beginFrame();
+            PROFILE_FRAME(profiler.getFrame());
+            {
+                PROFILE_SCOPE("scene");
+                GPU_SCOPE("scene");
+                fbo.bind();
+                glClear(GL_COLOR_BUFFER_BIT);
+
+                shader.bind();
+                texture.bind();
+                array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+            }
+            {
+                PROFILE_SCOPE("post_process");
+                GPU_SCOPE("post_process");
+                ppt.setValue(harness.getTime(clock.getElapsedTime().asSeconds()));
+                postProcess.apply(fboTexture,
+                                  FrameBuffer::getDefault(),
+                                  uvec2(window.getSize().x, window.getSize().y));
+            }
+            profiler.endFrame();
 
-        window.display();
-    }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
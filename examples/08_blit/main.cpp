@@ -6,8 +6,11 @@ using namespace std;
 #include <SFML/Graphics.hpp>
 #include <Shader.hpp>
 #define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <Buffer.hpp>
 #include <FrameBuffer.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
 #include <Texture.hpp>
 #include <debug.hpp>
 
@@ -30,14 +33,12 @@ void main() {
     FragColor = texture(gTexture, FragTex);
 })";
 
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 4, 6, sf::ContextSettings::Debug);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Blit",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -48,6 +49,10 @@ int main() {
         return 1;
     }
 
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
     initDebug();
 
     Shader shader(vertexShaderSource, fragmentShaderSource);
@@ -104,9 +109,8 @@ int main() {
     }
     FrameBuffer::getDefault().bind();
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
                     if (event.key.code == sf::Keyboard::Escape)
@@ -127,24 +131,28 @@ int main() {
                 default:
                     break;
             }
-        }
+        },
+        [&]() {
+            harness.beginFrame();
 
-        fbo.bind();
-        glClear(GL_COLOR_BUFFER_BIT);
+            fbo.bind();
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        shader.bind();
-        texture.bind();
-        array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+            shader.bind();
+            texture.bind();
+            array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
 
-        FrameBuffer::getDefault().bind();
-        glClear(GL_COLOR_BUFFER_BIT);
+            FrameBuffer::getDefault().bind();
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        FrameBuffer::getDefault().blit(fbo);
+            FrameBuffer::getDefault().blit(fbo);
 
-        window.display();
-    }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
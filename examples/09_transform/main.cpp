@@ -1,4 +1,7 @@
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <thread>
 using namespace std;
 
 #include <GL/glew.h>
@@ -6,7 +9,12 @@ using namespace std;
 #include <SFML/Graphics.hpp>
 #include <Shader.hpp>
 #define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <Buffer.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
+#include <Scene.hpp>
+#include <Simulation.hpp>
 #include <Texture.hpp>
 #include <Transform.hpp>
 #include <debug.hpp>
@@ -35,14 +43,12 @@ void main() {
     FragColor = texture(gTexture, FragTex);
 })";
 
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 3, 0);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Transform",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -53,6 +59,10 @@ int main() {
         return 1;
     }
 
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
     initDebug();
 
     Shader shader(vertexShaderSource, fragmentShaderSource);
@@ -84,19 +94,42 @@ int main() {
     array.bufferElements(sizeof(indices), indices);
     array.unbind();
 
-    Transform model;
+    // the moon orbits the planet and spins on its own
+    SceneGraph scene;
+    auto planet = scene.create();
+    auto moon = scene.create(
+        planet,
+        Transform({0.6, 0, 0}, glm::quat(glm::vec3(0)), glm::vec3(0.4)));
     auto mvp = shader.uniform("mvp");
 
+    // the rotation is stepped at 20 Hz on its own thread and interpolated
+    // for every frame, press S to make every step take 150 ms
+    std::atomic<bool> spikes(false);
+    Simulation simulation(
+        {scene.getLocal(planet), scene.getLocal(moon)},
+        20.0,
+        [&](std::vector<Transform> & transforms, float dt) {
+            transforms[0].rotateEuler({0, 0, 0.6f * dt});
+            transforms[1].rotateEuler({0, 0, -1.8f * dt});
+            if (spikes)
+                std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        });
+    simulation.start();
+    std::vector<Transform> locals;
+
+    cout << "S: toggle simulation spikes" << endl;
+
     // uncomment this call to draw in wireframe polygons.
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
                     if (event.key.code == sf::Keyboard::Escape)
                         window.close();
+                    else if (event.key.code == sf::Keyboard::S)
+                        spikes = !spikes;
                     break;
                 case sf::Event::Resized: {
                     sf::FloatRect visibleArea(0, 0, event.size.width,
@@ -110,23 +143,32 @@ int main() {
                 default:
                     break;
             }
-        }
+        },
+        [&]() {
+            harness.beginFrame();
 
-        model.rotateEuler({0, 0, 0.01});
+            simulation.interpolate(locals);
+            scene.setLocal(planet, locals[0]);
+            scene.setLocal(moon, locals[1]);
+            scene.update();
 
-        glClear(GL_COLOR_BUFFER_BIT);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        shader.bind();
-        mvp.setMat4(model.toMatrix());
+            shader.bind();
+            texture.bind();
 
-        texture.bind();
-        // array.drawArrays(GL_TRIANGLES, 0, 3);
-        array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+            for (auto & model : scene.getWorldMatrices()) {
+                mvp.setMat4(model);
+                // array.drawArrays(GL_TRIANGLES, 0, 3);
+                array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+            }
 
-        window.display();
-    }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
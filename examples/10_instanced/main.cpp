@@ -1,4 +1,6 @@
+#include <cstring>
 #include <iostream>
+#include <string>
 using namespace std;
 
 #include <GL/glew.h>
@@ -6,22 +8,37 @@ using namespace std;
 #include <SFML/Graphics.hpp>
 #include <Shader.hpp>
 #define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <Buffer.hpp>
+#include <Culling.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
+#include <InstanceBuffer.hpp>
+#include <InstancePacking.hpp>
+#include <JobSystem.hpp>
 #include <Texture.hpp>
+#include <TransformStore.hpp>
 #include <debug.hpp>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 using namespace glm;
 
-static const char * vertexShaderSource = R"(
+static const char * vertexShaderVersion = R"(
 #version 330 core
+)";
+
+static const char * vertexShaderSource = R"(
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTex;
-layout (location = 2) in vec2 aOffset;
+layout (location = 2) in vec4 aModel0;
+layout (location = 3) in vec4 aModel1;
+layout (location = 4) in vec4 aModel2;
 out vec3 FragPos;
 out vec2 FragTex;
+uniform mat4 viewProjection;
 void main() {
-    vec4 pos = vec4(aPos + vec3(aOffset, 0.0), 1.0);
-    pos /= 10.0;
+    mat4 model = decodeAffine(aModel0, aModel1, aModel2);
+    vec4 pos = viewProjection * model * vec4(aPos, 1.0);
     gl_Position = pos;
     FragPos = pos.xyz;
     FragTex = aTex;
@@ -37,14 +54,12 @@ void main() {
     FragColor = texture(gTexture, FragTex);
 })";
 
-int main() {
+int main(int argc, char ** argv) {
     const sf::ContextSettings settings(24, 1, 8, 3, 0);
     sf::RenderWindow window(sf::VideoMode(800, 600),
                             "Instanced",
                             sf::Style::Default,
                             settings);
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(60);
     window.setActive();
     window.setKeyRepeatEnabled(false);
 
@@ -55,10 +70,24 @@ int main() {
         return 1;
     }
 
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
     initDebug();
 
-    Shader shader(vertexShaderSource, fragmentShaderSource);
-    Texture texture = Texture::fromPath("../../../examples/res/uv.png");
+    // 3x4 affine instance matrices, 48 bytes per instance instead of 64
+    std::string vertexSource = std::string(vertexShaderVersion)
+                               + instanceDecodeSource + vertexShaderSource;
+    Shader shader(vertexSource.c_str(), fragmentShaderSource);
+
+    JobSystem jobs;
+
+    // decode on a worker while the buffers are set up, upload on this thread
+    Texture::Image image;
+    JobSystem::Counter decoded;
+    jobs.run([&] { image = Texture::decode("../../../examples/res/uv.png"); },
+             &decoded);
 
     const float vertices[] = {
         -0.05f, -0.05f, 0.0f, // Bottom Left
@@ -76,40 +105,72 @@ int main() {
         0, 1, 2, // First Triangle
     };
 
-    vec2 translations[100];
-    int index = 0;
+    TransformStore transforms;
+    SphereBounds bounds;
     float offset = 0.1f;
     for (int y = -10; y < 10; y += 2) {
         for (int x = -10; x < 10; x += 2) {
-            vec2 translation;
+            vec3 translation;
             translation.x = (float)x / 10.0f + offset;
             translation.y = (float)y / 10.0f + offset;
-            translations[index++] = translation;
+            transforms.add(translation);
+            // bounding sphere of the triangle around its origin
+            bounds.add(translation, 0.071f);
         }
     }
 
+    vector<PackedAffine> instances(transforms.size());
+    vector<uint32_t> visible(transforms.size());
+    std::size_t visibleCount = 0;
+
     Attribute a0 {0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0};
     Attribute a1 {1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0};
-    Attribute a2 {2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0, 1};
 
-    BufferArray array(vector<vector<Attribute>> {{a0}, {a1}, {a2}});
+    BufferArray array(vector<vector<Attribute>> {{a0}, {a1}});
     array.bind();
     array.bufferData(0, sizeof(vertices), vertices);
     array.bufferData(1, sizeof(texCoords), texCoords);
-    array.bufferData(2, sizeof(translations), translations);
     array.bufferElements(sizeof(indices), indices);
     array.unbind();
 
+    // the visible instances, only the slots that changed are uploaded
+    InstanceBuffer<PackedAffine> visibleInstances(0, GL_STREAM_DRAW);
+    visibleInstances.attach(array, instanceAttributes(InstanceLayout::Affine, 2));
+
+    jobs.wait(decoded);
+    Texture texture = Texture::fromImage(image);
+
+    auto viewProjection = shader.uniform("viewProjection");
+    vec2 camera(0);
+
+    cout << "Arrow keys: move the camera" << endl;
+
     // uncomment this call to draw in wireframe polygons.
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
+    loop.run(
+        [&](const sf::Event & event) {
             switch (event.type) {
                 case sf::Event::KeyPressed:
-                    if (event.key.code == sf::Keyboard::Escape)
-                        window.close();
+                    switch (event.key.code) {
+                        case sf::Keyboard::Escape:
+                            window.close();
+                            break;
+                        case sf::Keyboard::Left:
+                            camera.x -= 0.2f;
+                            break;
+                        case sf::Keyboard::Right:
+                            camera.x += 0.2f;
+                            break;
+                        case sf::Keyboard::Down:
+                            camera.y -= 0.2f;
+                            break;
+                        case sf::Keyboard::Up:
+                            camera.y += 0.2f;
+                            break;
+                        default:
+                            break;
+                    }
                     break;
                 case sf::Event::Resized: {
                     sf::FloatRect visibleArea(0, 0, event.size.width,
@@ -123,20 +184,49 @@ int main() {
                 default:
                     break;
             }
-        }
+        },
+        [&]() {
+            harness.beginFrame();
 
-        glClear(GL_COLOR_BUFFER_BIT);
+            // only the bottom rows spin, the blocks of the others stay clean
+            for (std::size_t i = 0; i < transforms.size() / 4; i++) {
+                transforms.rotateEuler(i, {0, 0, 0.01f * (i % 7 + 1)});
+            }
+            transforms.compose(instances.data(), jobs);
+
+            // only the instances inside the view are written to the buffer
+            mat4 vp = translate(mat4(1), vec3(-camera, 0));
+            Frustum frustum = Frustum::fromMatrix(vp);
+            std::size_t count =
+                FrustumCuller::cull(frustum, bounds, visible.data(), jobs);
+            if (count != visibleCount) {
+                visibleCount = count;
+                window.setTitle("Instanced (" + to_string(count) + " visible)");
+            }
 
-        shader.bind();
+            visibleInstances.resize(count);
+            for (std::size_t i = 0; i < count; i++) {
+                const PackedAffine & instance = instances[visible[i]];
+                if (memcmp(&visibleInstances.get(i), &instance, sizeof(instance)) != 0)
+                    visibleInstances.set(i, instance);
+            }
+            visibleInstances.upload();
 
-        texture.bind();
-        // array.drawArraysInstanced(GL_TRIANGLES, 0, 3, 100);
-        array.drawElementsInstanced(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0, 100);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        window.display();
-    }
+            shader.bind();
+            viewProjection.setMat4(vp);
+
+            texture.bind();
+            // array.drawArraysInstanced(GL_TRIANGLES, 0, 3, 100);
+            array.drawElementsInstanced(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0, count);
+
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
 
     window.close();
 
-    return 0;
+    return harness.finish();
 }
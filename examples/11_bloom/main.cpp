@@ -0,0 +1,263 @@
+#include <iomanip>
+#include <iostream>
+using namespace std;
+
+#include <GL/glew.h>
+
+#include <SFML/Graphics.hpp>
+#include <Shader.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <Bloom.hpp>
+#include <Buffer.hpp>
+#include <FrameBuffer.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
+#include <PostProcess.hpp>
+#include <Texture.hpp>
+#include <debug.hpp>
+#include <glm/glm.hpp>
+using namespace glm;
+
+static const char * vertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTex;
+out vec2 FragTex;
+void main() {
+    gl_Position = vec4(aPos, 1.0);
+    FragTex = aTex;
+})";
+
+static const char * fragmentShaderSource = R"(
+#version 330 core
+in vec2 FragTex;
+out vec4 FragColor;
+uniform sampler2D gTexture;
+uniform float intensity;
+void main() {
+    FragColor = texture(gTexture, FragTex) * intensity;
+})";
+
+/**
+ * Time the fragment and compute blur and the bloom chain at several
+ * resolutions with GL_TIME_ELAPSED queries and print the average time of
+ * one call in milliseconds.
+ */
+static void runBenchmark(int radius) {
+    const uvec2 sizes[] = {
+        {1280, 720},
+        {1920, 1080},
+        {2560, 1440},
+        {3840, 2160},
+    };
+    const int iterations = 20;
+
+    GLuint query;
+    glGenQueries(1, &query);
+
+    auto time = [&](auto && f) {
+        f();
+        glFinish();
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (int i = 0; i < iterations; i++) {
+            f();
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        return ns / 1e6 / iterations;
+    };
+
+    cout << "radius " << radius << ", ms per call" << endl;
+    cout << setw(12) << "resolution" << setw(12) << "fragment" << setw(12)
+         << "compute" << setw(12) << "bloom" << endl;
+    cout << fixed << setprecision(3);
+
+    for (auto & size : sizes) {
+        RenderTarget input(size);
+        input.fbo.bind();
+        glClearColor(0.5f, 0.25f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+        GaussianBlur blur(radius);
+        Bloom bloom(size);
+
+        double fragment =
+            time([&] { blur.apply(input.texture, GaussianBlur::Fragment); });
+        double compute =
+            time([&] { blur.apply(input.texture, GaussianBlur::Compute); });
+        double chain = time([&] { bloom.apply(input.texture); });
+
+        cout << setw(12) << (to_string(size.x) + "x" + to_string(size.y))
+             << setw(12) << fragment << setw(12) << compute << setw(12)
+             << chain << endl;
+    }
+
+    cout.unsetf(ios::fixed);
+    glDeleteQueries(1, &query);
+    FrameBuffer::getDefault().bind();
+}
+
+int main(int argc, char ** argv) {
+    const sf::ContextSettings settings(24, 1, 8, 4, 3, sf::ContextSettings::Debug);
+    sf::RenderWindow window(sf::VideoMode(800, 600),
+                            "Bloom",
+                            sf::Style::Default,
+                            settings);
+    window.setActive();
+    window.setKeyRepeatEnabled(false);
+
+    // glewExperimental = true;
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        cerr << "glewInit failed: " << glewGetErrorString(err);
+        return 1;
+    }
+
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
+    initDebug();
+
+    Shader shader(vertexShaderSource, fragmentShaderSource);
+    auto intensity = shader.uniform("intensity");
+    Texture texture = Texture::fromPath("../../../examples/res/uv.png");
+
+    const float vertices[] = {
+        -0.5f, -0.5f, 0.0f, // Bottom Left
+        0.5f,  -0.5f, 0.0f, // Bottom Right
+        0.0f,  0.5f,  0.0f // Top Center
+    };
+
+    const float texCoords[] = {
+        -0.5f, -0.5f, // Bottom Left
+        0.5f,  -0.5f, // Bottom Right
+        0.0f,  0.5f, // Top Center
+    };
+
+    const unsigned int indices[] = {
+        0, 1, 2, // First Triangle
+    };
+
+    Attribute a0 {0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0};
+    Attribute a1 {1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0};
+
+    BufferArray array(vector<vector<Attribute>> {{a0}, {a1}});
+    array.bind();
+    array.bufferData(0, sizeof(vertices), vertices);
+    array.bufferData(1, sizeof(texCoords), texCoords);
+    array.bufferElements(sizeof(indices), indices);
+    array.unbind();
+
+    uvec2 size(window.getSize().x, window.getSize().y);
+
+    // hdr scene target, values above 1.0 will bloom
+    RenderTarget scene(size);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "FBO is not complete!" << endl;
+        return 1;
+    }
+
+    Bloom bloom(size);
+    GaussianBlur blur(8);
+
+    PostProcessStack bloomPresent({Bloom::composite(), PostEffect::tonemap()});
+    bloomPresent.param("bloomTexture").setValue(1);
+    PostProcessStack blurPresent({PostEffect::tonemap()});
+
+    enum { ShowBloom, ShowFragmentBlur, ShowComputeBlur } mode = ShowBloom;
+
+    if (argc > 1 && string(argv[1]) == "--benchmark") {
+        runBenchmark(blur.getRadius());
+        return 0;
+    }
+
+    cout << "1: bloom, 2: fragment blur, 3: compute blur" << endl;
+    cout << "Up / Down: blur radius, B: run benchmark" << endl;
+
+    loop.run(
+        [&](const sf::Event & event) {
+            switch (event.type) {
+                case sf::Event::KeyPressed:
+                    switch (event.key.code) {
+                        case sf::Keyboard::Escape:
+                            window.close();
+                            break;
+                        case sf::Keyboard::Num1:
+                            mode = ShowBloom;
+                            break;
+                        case sf::Keyboard::Num2:
+                            mode = ShowFragmentBlur;
+                            break;
+                        case sf::Keyboard::Num3:
+                            mode = ShowComputeBlur;
+                            break;
+                        case sf::Keyboard::Up:
+                            blur.setRadius(blur.getRadius() + 1);
+                            cout << "radius " << blur.getRadius() << endl;
+                            break;
+                        case sf::Keyboard::Down:
+                            blur.setRadius(blur.getRadius() - 1);
+                            cout << "radius " << blur.getRadius() << endl;
+                            break;
+                        case sf::Keyboard::B:
+                            runBenchmark(blur.getRadius());
+                            break;
+                        default:
+                            break;
+                    }
+                    break;
+                case sf::Event::Resized: {
+                    sf::FloatRect visibleArea(0, 0, event.size.width,
+                                              event.size.height);
+                    window.setView(sf::View(visibleArea));
+                    size = uvec2(event.size.width, event.size.height);
+                    scene.resize(size);
+                    bloom.resize(size);
+                } break;
+                case sf::Event::Closed:
+                    window.close();
+                    break;
+                default:
+                    break;
+            }
+        },
+        [&]() {
+            harness.beginFrame();
+
+            scene.fbo.bind();
+            glViewport(0, 0, size.x, size.y);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            shader.bind();
+            intensity.setValue(4.0f);
+            texture.bind();
+            array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+
+            if (mode == ShowBloom) {
+                bloom.apply(scene.texture);
+                bloom.getTexture().bind(1);
+                bloomPresent.apply(scene.texture, FrameBuffer::getDefault(), size);
+            }
+            else {
+                blur.apply(scene.texture,
+                           mode == ShowFragmentBlur ? GaussianBlur::Fragment
+                                                    : GaussianBlur::Compute);
+                blurPresent.apply(blur.getTexture(),
+                                  FrameBuffer::getDefault(),
+                                  size);
+            }
+
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
+
+    window.close();
+
+    return harness.finish();
+}
@@ -0,0 +1,151 @@
+#include <cstdlib>
+#include <iostream>
+using namespace std;
+
+#include <GL/glew.h>
+
+#include <Context.hpp>
+#include <Shader.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <Batch.hpp>
+#include <Buffer.hpp>
+#include <FrameHarness.hpp>
+#include <Texture.hpp>
+#include <Transform.hpp>
+#include <debug.hpp>
+
+static const char * vertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTex;
+uniform mat4 mvp;
+out vec2 FragTex;
+void main() {
+    gl_Position = mvp * vec4(aPos, 1.0);
+    FragTex = aTex;
+})";
+
+static const char * fragmentShaderSource = R"(
+#version 330 core
+in vec2 FragTex;
+out vec4 FragColor;
+uniform sampler2D gTexture;
+void main() {
+    FragColor = texture(gTexture, FragTex);
+})";
+
+/**
+ * Render a fixed number of frames offscreen and write them as images.
+ *
+ * Usage: 12_batch [frames] [pattern] [--window]
+ *
+ * Runs on a headless EGL context unless --window is given or the project
+ * was built without EGL. Pass "-" as the pattern to skip writing images and
+ * only measure rendering and readback. The FrameHarness options may follow,
+ * with --frames the harness frame count replaces frames.
+ */
+int main(int argc, char ** argv) {
+    FrameHarness harness(argc, argv);
+    size_t frames = argc > 1 && !FrameHarness::isOption(argv[1])
+                        ? strtoul(argv[1], nullptr, 10)
+                        : 300;
+    if (harness.isActive())
+        frames = harness.getFrameCount();
+    string pattern = argc > 2 && !FrameHarness::isOption(argv[2]) ? argv[2] : "frame_%05d.png";
+    if (pattern == "-")
+        pattern.clear();
+    bool headless = true;
+#ifndef OPENGL_DEMO_EGL
+    headless = false;
+#endif
+    if (argc > 3 && string(argv[3]) == "--window")
+        headless = false;
+
+    Context::Settings settings;
+    settings.size = {1280, 720};
+    settings.debug = true;
+    settings.majorVersion = 4;
+    settings.minorVersion = 3;
+    settings.vsync = false;
+    settings.framerateLimit = 0;
+
+    unique_ptr<Context> context;
+    try {
+        context = Context::create("Batch", settings, headless);
+    }
+    catch (const Context::ContextException & e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    initDebug();
+    cout << "Renderer: " << glGetString(GL_RENDERER) << endl;
+
+    Shader shader(vertexShaderSource, fragmentShaderSource);
+    Texture texture = Texture::fromPath("../../../examples/res/uv.png");
+
+    const float vertices[] = {
+        -0.5f, -0.5f, 0.0f, // Bottom Left
+        0.5f,  -0.5f, 0.0f, // Bottom Right
+        0.0f,  0.5f,  0.0f // Top Center
+    };
+
+    const float texCoords[] = {
+        -0.5f, -0.5f, // Bottom Left
+        0.5f,  -0.5f, // Bottom Right
+        0.0f,  0.5f, // Top Center
+    };
+
+    const unsigned int indices[] = {
+        0, 1, 2, // First Triangle
+    };
+
+    Attribute a0 {0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0};
+    Attribute a1 {1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0};
+
+    BufferArray array(vector<vector<Attribute>> {{a0}, {a1}});
+    array.bind();
+    array.bufferData(0, sizeof(vertices), vertices);
+    array.bufferData(1, sizeof(texCoords), texCoords);
+    array.bufferElements(sizeof(indices), indices);
+    array.unbind();
+
+    Transform model;
+    auto mvp = shader.uniform("mvp");
+
+    BatchRenderer batch(context->getSize());
+    harness.attach(context->getSize(), batch.getTarget().fbo.getBufferId());
+
+    auto stats = batch.run(frames, pattern, [&](size_t frame) {
+        harness.beginFrame();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        model.setRotation(glm::quat(glm::vec3(0, 0, frame * 0.01f)));
+
+        shader.bind();
+        mvp.setMat4(model.toMatrix());
+
+        texture.bind();
+        array.drawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+        harness.endFrame();
+
+        // show progress when running in a window
+        if (!headless) {
+            FrameBuffer::getDefault().blit(batch.getTarget().fbo);
+            context->display();
+        }
+    });
+
+    // no rates without frames to divide
+    if (stats.frames == 0) {
+        cout << "0 frames rendered" << endl;
+        return harness.finish();
+    }
+    cout << stats.frames << " frames, render " << stats.renderSeconds
+         << " s (" << stats.frames / stats.renderSeconds << " fps), total "
+         << stats.totalSeconds << " s (" << stats.frames / stats.totalSeconds
+         << " fps)" << endl;
+
+    return harness.finish();
+}
@@ -0,0 +1,295 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+using namespace std;
+
+#include <GL/glew.h>
+
+#include <SFML/Graphics.hpp>
+#include <Shader.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <Buffer.hpp>
+#include <FrameBuffer.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
+#include <GpuCulling.hpp>
+#include <InstancePacking.hpp>
+#include <Texture.hpp>
+#include <debug.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+static const char * bladeVertexVersion = R"(
+#version 430 core
+)";
+
+static const char * bladeVertexSource = R"(
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aModel0;
+layout (location = 2) in vec4 aModel1;
+layout (location = 3) in vec4 aModel2;
+uniform mat4 viewProjection;
+out float Height;
+void main() {
+    mat4 model = decodeAffine(aModel0, aModel1, aModel2);
+    gl_Position = viewProjection * model * vec4(aPos, 1.0);
+    Height = aPos.y;
+})";
+
+static const char * bladeFragmentSource = R"(
+#version 430 core
+in float Height;
+out vec4 FragColor;
+void main() {
+    FragColor = vec4(mix(vec3(0.05, 0.25, 0.05), vec3(0.5, 0.9, 0.3), Height), 1.0);
+})";
+
+static const char * wallVertexSource = R"(
+#version 430 core
+layout (location = 0) in vec3 aPos;
+uniform mat4 mvp;
+out vec3 FragPos;
+void main() {
+    gl_Position = mvp * vec4(aPos, 1.0);
+    FragPos = aPos;
+})";
+
+static const char * wallFragmentSource = R"(
+#version 430 core
+in vec3 FragPos;
+out vec4 FragColor;
+void main() {
+    FragColor = vec4(vec3(0.4 + 0.1 * FragPos.y), 1.0);
+})";
+
+int main(int argc, char ** argv) {
+    const sf::ContextSettings settings(24, 1, 8, 4, 3, sf::ContextSettings::Debug);
+    sf::RenderWindow window(sf::VideoMode(800, 600),
+                            "GPU Culling",
+                            sf::Style::Default,
+                            settings);
+    window.setActive();
+    window.setKeyRepeatEnabled(false);
+
+    // glewExperimental = true;
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        cerr << "glewInit failed: " << glewGetErrorString(err);
+        return 1;
+    }
+
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
+    initDebug();
+
+    size_t count = argc > 1 && !FrameHarness::isOption(argv[1])
+                       ? strtoul(argv[1], nullptr, 10)
+                       : 1000000;
+
+    string bladeSource =
+        string(bladeVertexVersion) + instanceDecodeSource + bladeVertexSource;
+    Shader bladeShader(bladeSource.c_str(), bladeFragmentSource);
+    auto bladeViewProjection = bladeShader.uniform("viewProjection");
+
+    Shader wallShader(wallVertexSource, wallFragmentSource);
+    auto wallMvp = wallShader.uniform("mvp");
+
+    // a single blade of grass, one unit tall
+    const float bladeVertices[] = {
+        -0.05f, 0.0f, 0.0f, //
+        0.05f,  0.0f, 0.0f, //
+        0.0f,   1.0f, 0.0f, //
+    };
+    const unsigned int bladeIndices[] = {0, 1, 2};
+
+    // unit cube from (-0.5, 0, -0.5) to (0.5, 1, 0.5)
+    const float cubeVertices[] = {
+        -0.5f, 0.0f, -0.5f, 0.5f, 0.0f, -0.5f, 0.5f, 1.0f, -0.5f, -0.5f, 1.0f, -0.5f,
+        -0.5f, 0.0f, 0.5f,  0.5f, 0.0f, 0.5f,  0.5f, 1.0f, 0.5f,  -0.5f, 1.0f, 0.5f,
+    };
+    const unsigned int cubeIndices[] = {
+        0, 2, 1, 0, 3, 2, // back
+        4, 5, 6, 4, 6, 7, // front
+        0, 4, 7, 0, 7, 3, // left
+        1, 2, 6, 1, 6, 5, // right
+        3, 7, 6, 3, 6, 2, // top
+        0, 1, 5, 0, 5, 4, // bottom
+    };
+
+    Attribute position {0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0};
+
+    BufferArray cube(vector<vector<Attribute>> {{position}});
+    cube.bind();
+    cube.bufferData(0, sizeof(cubeVertices), cubeVertices);
+    cube.bufferElements(sizeof(cubeIndices), cubeIndices);
+    cube.unbind();
+
+    GpuCuller culler(count, InstanceLayout::Affine);
+    culler.setMesh(3);
+
+    // the visible instances written by the culler are the instance stream
+    BufferArray blade(vector<vector<Attribute>> {{position}});
+    blade.bind();
+    blade.bufferData(0, sizeof(bladeVertices), bladeVertices);
+    blade.bufferElements(sizeof(bladeIndices), bladeIndices);
+    culler.getVisibleBuffer().bind();
+    for (auto & attribute : instanceAttributes(InstanceLayout::Affine, 1)) {
+        attribute.enable();
+    }
+    blade.unbind();
+
+    {
+        mt19937 rng(1);
+        uniform_real_distribution<float> position(-200.0f, 200.0f);
+        uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        uniform_real_distribution<float> height(0.5f, 1.5f);
+
+        vector<vec4> spheres(count);
+        vector<PackedAffine> instances(count);
+        for (size_t i = 0; i < count; i++) {
+            vec3 p(position(rng), 0.0f, position(rng));
+            float h = height(rng);
+            mat4 model = translate(mat4(1), p);
+            model = rotate(model, angle(rng), vec3(0, 1, 0));
+            model = scale(model, vec3(h));
+            instances[i] = packAffine(model);
+            spheres[i] = vec4(p + vec3(0, 0.5f * h, 0), 0.55f * h);
+        }
+        culler.setInstances(0, count, spheres.data(), instances.data());
+    }
+
+    // a ring of walls around the origin hides most of the far side
+    vector<mat4> walls;
+    for (int i = 0; i < 8; i++) {
+        float a = i * 6.2831853f / 8;
+        mat4 model = translate(mat4(1), vec3(cos(a), 0, sin(a)) * 30.0f);
+        model = rotate(model, -a, vec3(0, 1, 0));
+        walls.push_back(scale(model, vec3(2, 12, 22)));
+    }
+
+    uvec2 size(window.getSize().x, window.getSize().y);
+    RenderTarget scene(size, Texture::RGBA8, Texture::RGBA, GL_UNSIGNED_BYTE);
+    Texture depth(size,
+                  Texture::Depth32F,
+                  Texture::Depth,
+                  GL_FLOAT,
+                  0,
+                  Texture::Nearest,
+                  Texture::Nearest,
+                  Texture::Clamp,
+                  false);
+    scene.fbo.bind();
+    scene.fbo.attach(&depth, GL_DEPTH_ATTACHMENT);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "FBO is not complete!" << endl;
+        return 1;
+    }
+
+    FrameBuffer::getDefault().resize(size.x, size.y);
+
+    HiZPyramid hiZ(size);
+    bool useHiZ = true;
+
+    cout << count << " instances" << endl;
+    cout << "H: toggle occlusion culling, C: print visible count" << endl;
+
+    sf::Clock clock;
+    bool printCount = false;
+    loop.run(
+        [&](const sf::Event & event) {
+            switch (event.type) {
+                case sf::Event::KeyPressed:
+                    switch (event.key.code) {
+                        case sf::Keyboard::Escape:
+                            window.close();
+                            break;
+                        case sf::Keyboard::H:
+                            useHiZ = !useHiZ;
+                            cout << "occlusion culling "
+                                 << (useHiZ ? "on" : "off") << endl;
+                            break;
+                        case sf::Keyboard::C:
+                            printCount = true;
+                            break;
+                        default:
+                            break;
+                    }
+                    break;
+                case sf::Event::Resized: {
+                    sf::FloatRect visibleArea(0, 0, event.size.width,
+                                              event.size.height);
+                    window.setView(sf::View(visibleArea));
+                    size = uvec2(event.size.width, event.size.height);
+                    scene.resize(size);
+                    hiZ.resize(size);
+                    FrameBuffer::getDefault().resize(size.x, size.y);
+                } break;
+                case sf::Event::Closed:
+                    window.close();
+                    break;
+                default:
+                    break;
+            }
+        },
+        [&]() {
+            harness.beginFrame();
+
+            float t = harness.getTime(clock.getElapsedTime().asSeconds()) * 0.1f;
+            vec3 eye(cos(t) * 60.0f, 3.0f, sin(t) * 60.0f);
+            mat4 projection = perspective(radians(60.0f),
+                                          (float)size.x / size.y,
+                                          0.1f,
+                                          500.0f);
+            mat4 viewProjection =
+                projection * lookAt(eye, vec3(0, 2, 0), vec3(0, 1, 0));
+
+            scene.fbo.bind();
+            glViewport(0, 0, size.x, size.y);
+            glEnable(GL_DEPTH_TEST);
+            glClearColor(0.5f, 0.7f, 0.9f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // occluders first, their depth feeds the hi-z pyramid
+            wallShader.bind();
+            for (auto & wall : walls) {
+                wallMvp.setMat4(viewProjection * wall);
+                cube.drawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+            }
+
+            if (useHiZ)
+                hiZ.build(depth);
+            culler.cull(viewProjection, useHiZ ? &hiZ : nullptr);
+
+            bladeShader.bind();
+            bladeViewProjection.setMat4(viewProjection);
+            blade.drawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                       culler.getCommandBuffer());
+
+            if (printCount) {
+                printCount = false;
+                // debug readback, not needed for drawing
+                DrawElementsIndirectCommand command;
+                culler.getCommandBuffer().bind();
+                glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command),
+                                   &command);
+                cout << command.instanceCount << " / " << culler.size()
+                     << " visible" << endl;
+            }
+
+            glDisable(GL_DEPTH_TEST);
+            FrameBuffer::getDefault().blit(scene.fbo);
+
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
+
+    window.close();
+
+    return harness.finish();
+}
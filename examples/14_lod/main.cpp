@@ -0,0 +1,227 @@
+#include <cmath>
+#include <iostream>
+#include <string>
+using namespace std;
+
+#include <GL/glew.h>
+
+#include <SFML/Graphics.hpp>
+#include <Shader.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <Buffer.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
+#include <JobSystem.hpp>
+#include <Lod.hpp>
+#include <debug.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+static const char * vertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+uniform mat4 model;
+uniform mat4 viewProjection;
+out vec3 FragPos;
+void main() {
+    vec4 pos = model * vec4(aPos, 1.0);
+    gl_Position = viewProjection * pos;
+    FragPos = pos.xyz;
+})";
+
+static const char * fragmentShaderSource = R"(
+#version 330 core
+in vec3 FragPos;
+out vec4 FragColor;
+uniform vec3 color;
+void main() {
+    // flat shading from the screen space derivatives, no normals needed
+    vec3 normal = normalize(cross(dFdx(FragPos), dFdy(FragPos)));
+    float light = max(dot(normal, normalize(vec3(0.4, 1.0, 0.6))), 0.0);
+    FragColor = vec4(color * (0.2 + 0.8 * light), 1.0);
+})";
+
+/**
+ * A bumpy sphere of radius about 1 with rings * segments * 2 triangles.
+ */
+static void makeSphere(int rings,
+                       int segments,
+                       vector<vec3> & positions,
+                       vector<uint32_t> & indices) {
+    const float pi = 3.14159265f;
+    for (int r = 0; r <= rings; r++) {
+        for (int s = 0; s <= segments; s++) {
+            float theta = pi * r / rings;
+            float phi = 2.0f * pi * s / segments;
+            float radius = 1.0f + 0.08f * sin(7.0f * phi) * sin(6.0f * theta);
+            positions.emplace_back(radius * sin(theta) * cos(phi),
+                                   radius * cos(theta),
+                                   radius * sin(theta) * sin(phi));
+        }
+    }
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            uint32_t a = r * (segments + 1) + s;
+            uint32_t b = a + segments + 1;
+            indices.insert(indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+        }
+    }
+}
+
+int main(int argc, char ** argv) {
+    const sf::ContextSettings settings(24, 1, 8, 3, 3);
+    sf::RenderWindow window(sf::VideoMode(800, 600),
+                            "LOD",
+                            sf::Style::Default,
+                            settings);
+    window.setActive();
+    window.setKeyRepeatEnabled(false);
+
+    // glewExperimental = true;
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        cerr << "glewInit failed: " << glewGetErrorString(err);
+        return 1;
+    }
+
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
+    initDebug();
+
+    Shader shader(vertexShaderSource, fragmentShaderSource);
+    auto modelUniform = shader.uniform("model");
+    auto viewProjectionUniform = shader.uniform("viewProjection");
+    auto colorUniform = shader.uniform("color");
+
+    vector<vec3> positions;
+    vector<uint32_t> indices;
+    makeSphere(128, 256, positions, indices);
+
+    JobSystem jobs;
+    sf::Clock buildClock;
+    MeshLods lods = MeshSimplifier::buildLods(positions, indices, jobs, 6, 0.35f);
+    cout << "built " << lods.levels.size() << " levels in "
+         << buildClock.getElapsedTime().asMilliseconds() << " ms" << endl;
+    for (auto & level : lods.levels) {
+        cout << "  " << level.indexCount / 3 << " triangles, error "
+             << level.error << endl;
+    }
+
+    Attribute a0 {0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0};
+
+    // every level lives in the same element buffer
+    BufferArray array(vector<vector<Attribute>> {{a0}});
+    array.bind();
+    array.bufferData(0, positions.size() * sizeof(vec3), positions.data());
+    array.bufferElements(lods.indices.size() * sizeof(uint32_t),
+                         lods.indices.data());
+    array.unbind();
+
+    // a field of spheres stretching away from the camera
+    const int rows = 40, columns = 10;
+    vector<vec3> centers;
+    vector<uint32_t> levels;
+    for (int z = 0; z < rows; z++) {
+        for (int x = 0; x < columns; x++) {
+            centers.emplace_back((x - columns / 2) * 3.0f, 0.0f, -z * 3.0f);
+            levels.push_back(0);
+        }
+    }
+
+    const vec3 colors[] = {
+        {0.9f, 0.9f, 0.9f},
+        {0.3f, 0.8f, 0.3f},
+        {0.3f, 0.5f, 0.9f},
+        {0.9f, 0.8f, 0.2f},
+        {0.9f, 0.4f, 0.2f},
+        {0.8f, 0.2f, 0.8f},
+    };
+
+    LodSelector selector(1.0f, 0.25f);
+    vec3 eye(0, 2, 6);
+    uvec2 size(window.getSize().x, window.getSize().y);
+    bool showLevels = false;
+    size_t drawnTriangles = 0;
+
+    cout << "Up/Down: move the camera, L: color by level" << endl;
+
+    glEnable(GL_DEPTH_TEST);
+
+    loop.run(
+        [&](const sf::Event & event) {
+            switch (event.type) {
+                case sf::Event::KeyPressed:
+                    switch (event.key.code) {
+                        case sf::Keyboard::Escape:
+                            window.close();
+                            break;
+                        case sf::Keyboard::L:
+                            showLevels = !showLevels;
+                            break;
+                        default:
+                            break;
+                    }
+                    break;
+                case sf::Event::Resized: {
+                    sf::FloatRect visibleArea(0, 0, event.size.width,
+                                              event.size.height);
+                    window.setView(sf::View(visibleArea));
+                    glViewport(0, 0, event.size.width, event.size.height);
+                    size = uvec2(event.size.width, event.size.height);
+                } break;
+                case sf::Event::Closed:
+                    window.close();
+                    break;
+                default:
+                    break;
+            }
+        },
+        [&]() {
+            harness.beginFrame();
+
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))
+                eye.z -= 0.2f;
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
+                eye.z += 0.2f;
+
+            const float fovY = radians(60.0f);
+            mat4 projection =
+                perspective(fovY, (float)size.x / size.y, 0.1f, 500.0f);
+            mat4 viewProjection =
+                projection * lookAt(eye, eye + vec3(0, -0.2f, -1), vec3(0, 1, 0));
+            selector.setView(eye, fovY, size.y);
+
+            glClearColor(0.1f, 0.1f, 0.12f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            shader.bind();
+            viewProjectionUniform.setMat4(viewProjection);
+
+            size_t triangles = 0;
+            for (size_t i = 0; i < centers.size(); i++) {
+                levels[i] = selector.select(lods, centers[i], 1.1f, 1.0f, levels[i]);
+                const LodLevel & level = lods.levels[levels[i]];
+                modelUniform.setMat4(translate(mat4(1), centers[i]));
+                colorUniform.setVec3(showLevels ? colors[levels[i] % 6] : colors[0]);
+                array.drawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+                                   level.offset());
+                triangles += level.indexCount / 3;
+            }
+
+            if (triangles != drawnTriangles) {
+                drawnTriangles = triangles;
+                window.setTitle("LOD (" + to_string(triangles) + " triangles)");
+            }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
+
+    window.close();
+
+    return harness.finish();
+}
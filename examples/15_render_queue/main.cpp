@@ -0,0 +1,299 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+using namespace std;
+
+#include <GL/glew.h>
+
+#include <SFML/Graphics.hpp>
+#include <Shader.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <Buffer.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
+#include <JobSystem.hpp>
+#include <RenderQueue.hpp>
+#include <RenderStats.hpp>
+#include <Texture.hpp>
+#include <debug.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+static const char * vertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+uniform mat4 model;
+uniform mat4 viewProjection;
+out vec2 TexCoord;
+out vec3 FragPos;
+void main() {
+    vec4 pos = model * vec4(aPos, 1.0);
+    gl_Position = viewProjection * pos;
+    TexCoord = aTexCoord;
+    FragPos = pos.xyz;
+})";
+
+static const char * litFragmentSource = R"(
+#version 330 core
+in vec2 TexCoord;
+in vec3 FragPos;
+out vec4 FragColor;
+uniform sampler2D tex;
+void main() {
+    vec3 normal = normalize(cross(dFdx(FragPos), dFdy(FragPos)));
+    float light = max(dot(normal, normalize(vec3(0.4, 1.0, 0.6))), 0.0);
+    FragColor = vec4(texture(tex, TexCoord).rgb * (0.3 + 0.7 * light), 1.0);
+})";
+
+static const char * stripedFragmentSource = R"(
+#version 330 core
+in vec2 TexCoord;
+in vec3 FragPos;
+out vec4 FragColor;
+uniform sampler2D tex;
+void main() {
+    float stripe = step(0.5, fract(FragPos.y * 4.0));
+    FragColor = vec4(texture(tex, TexCoord).rgb * (0.5 + 0.5 * stripe), 1.0);
+})";
+
+static const char * glassFragmentSource = R"(
+#version 330 core
+in vec2 TexCoord;
+out vec4 FragColor;
+uniform sampler2D tex;
+void main() {
+    FragColor = vec4(texture(tex, TexCoord).rgb, 0.35);
+})";
+
+/**
+ * A 64x64 checkerboard of color and a darker shade of it.
+ */
+static Texture makeChecker(vec3 color) {
+    const unsigned size = 64;
+    vector<unsigned char> pixels;
+    for (unsigned y = 0; y < size; y++) {
+        for (unsigned x = 0; x < size; x++) {
+            float shade = ((x / 8 + y / 8) % 2) ? 1.0f : 0.6f;
+            for (int c = 0; c < 3; c++) {
+                pixels.push_back((unsigned char)(255 * color[c] * shade));
+            }
+        }
+    }
+    return Texture(pixels.data(), uvec2(size), 3);
+}
+
+int main(int argc, char ** argv) {
+    const sf::ContextSettings settings(24, 1, 8, 3, 3);
+    sf::RenderWindow window(sf::VideoMode(800, 600),
+                            "Render Queue",
+                            sf::Style::Default,
+                            settings);
+    window.setActive();
+    window.setKeyRepeatEnabled(false);
+
+    // glewExperimental = true;
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        cerr << "glewInit failed: " << glewGetErrorString(err);
+        return 1;
+    }
+
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
+    initDebug();
+
+    Shader lit(vertexShaderSource, litFragmentSource);
+    Shader striped(vertexShaderSource, stripedFragmentSource);
+    Shader glass(vertexShaderSource, glassFragmentSource);
+    const Shader * shaders[] = {&lit, &striped, &glass};
+
+    vector<Texture> textures;
+    for (vec3 color : {vec3(0.9f, 0.3f, 0.2f),
+                       vec3(0.3f, 0.8f, 0.3f),
+                       vec3(0.3f, 0.5f, 0.9f),
+                       vec3(0.9f, 0.8f, 0.2f),
+                       vec3(0.8f, 0.3f, 0.8f),
+                       vec3(0.9f, 0.9f, 0.9f)}) {
+        textures.push_back(makeChecker(color));
+    }
+
+    RenderQueue queue;
+    vector<uint16_t> shaderIds, textureIds;
+    for (auto shader : shaders) {
+        shaderIds.push_back(queue.addShader(*shader));
+    }
+    for (auto & texture : textures) {
+        textureIds.push_back(queue.addTexture(texture));
+    }
+
+    // clang-format off
+    const float cube[] = {
+        // positions        // texture coords
+        -0.5f, -0.5f, -0.5f, 0.0f, 0.0f,   0.5f, -0.5f, -0.5f, 1.0f, 0.0f,
+         0.5f,  0.5f, -0.5f, 1.0f, 1.0f,  -0.5f,  0.5f, -0.5f, 0.0f, 1.0f,
+        -0.5f, -0.5f,  0.5f, 0.0f, 0.0f,   0.5f, -0.5f,  0.5f, 1.0f, 0.0f,
+         0.5f,  0.5f,  0.5f, 1.0f, 1.0f,  -0.5f,  0.5f,  0.5f, 0.0f, 1.0f,
+    };
+    const unsigned int cubeIndices[] = {
+        0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 4, 7, 0, 7, 3,
+        1, 2, 6, 1, 6, 5,  0, 1, 5, 0, 5, 4,  3, 7, 6, 3, 6, 2,
+    };
+    const float pyramid[] = {
+        -0.5f, -0.5f, -0.5f, 0.0f, 0.0f,   0.5f, -0.5f, -0.5f, 1.0f, 0.0f,
+         0.5f, -0.5f,  0.5f, 1.0f, 1.0f,  -0.5f, -0.5f,  0.5f, 0.0f, 1.0f,
+         0.0f,  0.5f,  0.0f, 0.5f, 0.5f,
+    };
+    const unsigned int pyramidIndices[] = {
+        0, 1, 2, 0, 2, 3,  0, 4, 1, 1, 4, 2,  2, 4, 3, 3, 4, 0,
+    };
+    // clang-format on
+
+    Attribute a0 {0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0};
+    Attribute a1 {1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
+                  (void *)(3 * sizeof(float))};
+
+    BufferArray cubeArray(vector<vector<Attribute>> {{a0, a1}});
+    cubeArray.bind();
+    cubeArray.bufferData(0, sizeof(cube), cube);
+    cubeArray.bufferElements(sizeof(cubeIndices), cubeIndices);
+    cubeArray.unbind();
+
+    BufferArray pyramidArray(vector<vector<Attribute>> {{a0, a1}});
+    pyramidArray.bind();
+    pyramidArray.bufferData(0, sizeof(pyramid), pyramid);
+    pyramidArray.bufferElements(sizeof(pyramidIndices), pyramidIndices);
+    pyramidArray.unbind();
+
+    // objects with random materials, pushed in an order that has nothing to
+    // do with their state
+    const int side = 40;
+    mt19937 random(7);
+    vector<DrawPacket> objects;
+    for (int z = 0; z < side; z++) {
+        for (int x = 0; x < side; x++) {
+            DrawPacket packet;
+            bool isCube = random() % 2;
+            packet.array = isCube ? &cubeArray : &pyramidArray;
+            packet.count = isCube ? 36 : 18;
+            packet.translucent = random() % 8 == 0;
+            packet.shader = packet.translucent ? shaderIds[2]
+                                               : shaderIds[random() % 2];
+            packet.texture = textureIds[random() % textureIds.size()];
+            packet.model = translate(mat4(1),
+                                     vec3((x - side / 2) * 1.5f, 0, (z - side / 2) * 1.5f));
+            objects.push_back(packet);
+        }
+    }
+
+    JobSystem jobs;
+    uvec2 size(window.getSize().x, window.getSize().y);
+    bool sorted = true;
+    sf::Clock clock, titleClock;
+
+    // sorted, the scene needs a handful of program and texture binds
+    FrameStats budget;
+    budget.drawCalls = 2000;
+    budget.programBinds = 16;
+    budget.textureBinds = 64;
+    RenderStats & renderStats = RenderStats::get();
+    renderStats.setBudget(budget);
+
+    cout << "S: toggle sorting, J: print the render stats as JSON, P: change the pacing" << endl;
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    loop.run(
+        [&](const sf::Event & event) {
+            switch (event.type) {
+                case sf::Event::KeyPressed:
+                    switch (event.key.code) {
+                        case sf::Keyboard::Escape:
+                            window.close();
+                            break;
+                        case sf::Keyboard::S:
+                            sorted = !sorted;
+                            break;
+                        case sf::Keyboard::J:
+                            renderStats.writeJson(cout);
+                            break;
+                        case sf::Keyboard::P:
+                            loop.setPacing(FrameLoop::Pacing((loop.getPacing() + 1) % 3));
+                            break;
+                        default:
+                            break;
+                    }
+                    break;
+                case sf::Event::Resized: {
+                    sf::FloatRect visibleArea(0, 0, event.size.width,
+                                              event.size.height);
+                    window.setView(sf::View(visibleArea));
+                    glViewport(0, 0, event.size.width, event.size.height);
+                    size = uvec2(event.size.width, event.size.height);
+                } break;
+                case sf::Event::Closed:
+                    window.close();
+                    break;
+                default:
+                    break;
+            }
+        },
+        [&]() {
+            harness.beginFrame();
+
+            float time = harness.getTime(clock.getElapsedTime().asSeconds());
+            vec3 eye(cos(time * 0.2f) * 40.0f, 15.0f, sin(time * 0.2f) * 40.0f);
+            mat4 view = lookAt(eye, vec3(0), vec3(0, 1, 0));
+            mat4 viewProjection =
+                perspective(radians(60.0f), (float)size.x / size.y, 0.1f, 200.0f)
+                * view;
+
+            for (auto shader : shaders) {
+                shader->bind();
+                shader->uniform("viewProjection").setMat4(viewProjection);
+            }
+
+            glClearColor(0.1f, 0.1f, 0.12f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            queue.clear();
+            queue.setView(view, 0.1f, 200.0f);
+            for (auto & object : objects) {
+                queue.push(object);
+            }
+            if (sorted)
+                queue.sort(&jobs);
+            RenderQueue::Stats stats = queue.submit();
+            bool withinBudget = renderStats.endFrame();
+
+            if (titleClock.getElapsedTime().asSeconds() > 0.5f) {
+                titleClock.restart();
+                string title = string("Render Queue (") + (sorted ? "sorted" : "unsorted") + ", "
+                               + RenderStats::summary(renderStats.getLast()) + ", "
+                               + to_string(stats.arrayChanges) + " array changes, "
+                               + FrameLoop::name(loop.getPacing()) + " "
+                               + to_string(int(loop.getGpuLatency().average + 0.5f))
+                               + " ms latency)";
+                if (!withinBudget) {
+                    title += " over budget:";
+                    for (auto name : renderStats.getExceeded()) {
+                        title += string(" ") + name;
+                    }
+                }
+                window.setTitle(title);
+            }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
+
+    window.close();
+
+    return harness.finish();
+}
@@ -0,0 +1,164 @@
+#include <cmath>
+#include <iostream>
+#include <string>
+using namespace std;
+
+#include <GL/glew.h>
+
+#include <SFML/Graphics.hpp>
+#include <Shader.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <Buffer.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
+#include <JobSystem.hpp>
+#include <MeshLoader.hpp>
+#include <Texture.hpp>
+#include <debug.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+static const char * vertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+uniform mat4 model;
+uniform mat4 viewProjection;
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+void main() {
+    vec4 pos = model * vec4(aPos, 1.0);
+    gl_Position = viewProjection * pos;
+    FragPos = pos.xyz;
+    Normal = mat3(model) * aNormal;
+    TexCoord = aTexCoord;
+})";
+
+static const char * fragmentShaderSource = R"(
+#version 330 core
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoord;
+out vec4 FragColor;
+uniform sampler2D tex;
+void main() {
+    // meshes without normals are shaded flat
+    vec3 normal = dot(Normal, Normal) > 0.0
+        ? normalize(Normal)
+        : normalize(cross(dFdx(FragPos), dFdy(FragPos)));
+    float light = max(dot(normal, normalize(vec3(0.4, 1.0, 0.6))), 0.0);
+    FragColor = vec4(texture(tex, TexCoord).rgb * (0.25 + 0.75 * light), 1.0);
+})";
+
+int main(int argc, char ** argv) {
+    string path = argc > 1 && !FrameHarness::isOption(argv[1])
+                      ? argv[1]
+                      : "../../../examples/res/torus.obj";
+
+    const sf::ContextSettings settings(24, 1, 8, 3, 3);
+    sf::RenderWindow window(sf::VideoMode(800, 600),
+                            "Mesh Loader",
+                            sf::Style::Default,
+                            settings);
+    window.setActive();
+
+    // glewExperimental = true;
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        cerr << "glewInit failed: " << glewGetErrorString(err);
+        return 1;
+    }
+
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
+    initDebug();
+
+    JobSystem jobs;
+    MeshData mesh;
+    sf::Clock loadClock;
+    try {
+        mesh = MeshLoader::fromPath(path, &jobs);
+    }
+    catch (const MeshLoader::MeshLoadException & e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    cout << path << ": " << mesh.vertices.size() << " vertices, "
+         << mesh.indices.size() / 3 << " triangles in "
+         << loadClock.getElapsedTime().asMilliseconds() << " ms" << endl;
+
+    // fit the mesh into a unit sphere around the origin
+    vec3 low(INFINITY), high(-INFINITY);
+    for (auto & vertex : mesh.vertices) {
+        low = min(low, vertex.position);
+        high = max(high, vertex.position);
+    }
+    vec3 center = (low + high) * 0.5f;
+    float radius = std::max(length(high - low) * 0.5f, 1e-6f);
+    mat4 fit = scale(mat4(1), vec3(1.0f / radius)) * translate(mat4(1), -center);
+
+    Shader shader(vertexShaderSource, fragmentShaderSource);
+    auto modelUniform = shader.uniform("model");
+    auto viewProjectionUniform = shader.uniform("viewProjection");
+
+    Texture texture = Texture::fromPath("../../../examples/res/uv.png");
+    BufferArray array = mesh.toBufferArray();
+
+    glEnable(GL_DEPTH_TEST);
+    sf::Clock clock;
+
+    loop.run(
+        [&](const sf::Event & event) {
+            switch (event.type) {
+                case sf::Event::KeyPressed:
+                    if (event.key.code == sf::Keyboard::Escape)
+                        window.close();
+                    break;
+                case sf::Event::Resized: {
+                    sf::FloatRect visibleArea(0, 0, event.size.width,
+                                              event.size.height);
+                    window.setView(sf::View(visibleArea));
+                    glViewport(0, 0, event.size.width, event.size.height);
+                } break;
+                case sf::Event::Closed:
+                    window.close();
+                    break;
+                default:
+                    break;
+            }
+        },
+        [&]() {
+            harness.beginFrame();
+
+            float time = harness.getTime(clock.getElapsedTime().asSeconds());
+            mat4 model = rotate(mat4(1), time * 0.5f, vec3(0, 1, 0))
+                         * rotate(mat4(1), 0.4f, vec3(1, 0, 0)) * fit;
+            auto size = window.getSize();
+            mat4 viewProjection =
+                perspective(radians(45.0f), (float)size.x / size.y, 0.1f, 10.0f)
+                * lookAt(vec3(0, 0, 3), vec3(0), vec3(0, 1, 0));
+
+            glClearColor(0.1f, 0.1f, 0.12f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            shader.bind();
+            modelUniform.setMat4(model);
+            viewProjectionUniform.setMat4(viewProjection);
+            texture.bind();
+            array.drawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
+
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
+
+    window.close();
+
+    return harness.finish();
+}
@@ -0,0 +1,202 @@
+#include <cmath>
+#include <iostream>
+#include <string>
+using namespace std;
+
+#include <GL/glew.h>
+
+#include <SFML/Graphics.hpp>
+#include <Shader.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <Buffer.hpp>
+#include <Culling.hpp>
+#include <FrameHarness.hpp>
+#include <FrameLoop.hpp>
+#include <Meshlet.hpp>
+#include <debug.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+static const char * vertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+uniform mat4 viewProjection;
+out vec3 FragPos;
+void main() {
+    gl_Position = viewProjection * vec4(aPos, 1.0);
+    FragPos = aPos;
+})";
+
+static const char * fragmentShaderSource = R"(
+#version 330 core
+in vec3 FragPos;
+out vec4 FragColor;
+uniform vec3 color;
+void main() {
+    vec3 normal = normalize(cross(dFdx(FragPos), dFdy(FragPos)));
+    float light = max(dot(normal, normalize(vec3(0.4, 1.0, 0.6))), 0.0);
+    FragColor = vec4(color * (0.2 + 0.8 * light), 1.0);
+})";
+
+/**
+ * A bumpy sphere of radius about 1 with rings * segments * 2 triangles.
+ */
+static void makeSphere(int rings,
+                       int segments,
+                       vector<vec3> & positions,
+                       vector<uint32_t> & indices) {
+    const float pi = 3.14159265f;
+    for (int r = 0; r <= rings; r++) {
+        for (int s = 0; s <= segments; s++) {
+            float theta = pi * r / rings;
+            float phi = 2.0f * pi * s / segments;
+            float radius = 1.0f + 0.08f * sin(7.0f * phi) * sin(6.0f * theta);
+            positions.emplace_back(radius * sin(theta) * cos(phi),
+                                   radius * cos(theta),
+                                   radius * sin(theta) * sin(phi));
+        }
+    }
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            uint32_t a = r * (segments + 1) + s;
+            uint32_t b = a + segments + 1;
+            indices.insert(indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+        }
+    }
+}
+
+int main(int argc, char ** argv) {
+    const sf::ContextSettings settings(24, 1, 8, 3, 3);
+    sf::RenderWindow window(sf::VideoMode(800, 600),
+                            "Meshlets",
+                            sf::Style::Default,
+                            settings);
+    window.setActive();
+    window.setKeyRepeatEnabled(false);
+
+    // glewExperimental = true;
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        cerr << "glewInit failed: " << glewGetErrorString(err);
+        return 1;
+    }
+
+    FrameLoop loop(window);
+    FrameHarness harness(argc, argv);
+    harness.attach(window);
+
+    initDebug();
+
+    Shader shader(vertexShaderSource, fragmentShaderSource);
+    auto viewProjectionUniform = shader.uniform("viewProjection");
+    auto colorUniform = shader.uniform("color");
+
+    vector<vec3> positions;
+    vector<uint32_t> indices;
+    makeSphere(512, 1024, positions, indices);
+
+    sf::Clock buildClock;
+    MeshletMesh mesh = MeshletBuilder::build(positions, indices);
+    cout << indices.size() / 3 << " triangles in " << mesh.meshlets.size()
+         << " meshlets, built in " << buildClock.getElapsedTime().asMilliseconds()
+         << " ms" << endl;
+
+    Attribute a0 {0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0};
+
+    BufferArray array(vector<vector<Attribute>> {{a0}});
+    array.bind();
+    array.bufferData(0, positions.size() * sizeof(vec3), positions.data());
+    array.bufferElements(mesh.indices.size() * sizeof(uint32_t), mesh.indices.data());
+    array.unbind();
+
+    MeshletCuller culler(mesh.meshlets);
+    bool cones = true, frozen = false;
+    float distance = 2.5f;
+    vec3 cullEye;
+    Frustum cullFrustum;
+    uvec2 size(window.getSize().x, window.getSize().y);
+    size_t shownTriangles = 0;
+    sf::Clock clock;
+
+    cout << "Up/Down: zoom, C: toggle cone culling, F: freeze culling" << endl;
+
+    glEnable(GL_DEPTH_TEST);
+
+    loop.run(
+        [&](const sf::Event & event) {
+            switch (event.type) {
+                case sf::Event::KeyPressed:
+                    switch (event.key.code) {
+                        case sf::Keyboard::Escape:
+                            window.close();
+                            break;
+                        case sf::Keyboard::C:
+                            cones = !cones;
+                            break;
+                        case sf::Keyboard::F:
+                            frozen = !frozen;
+                            break;
+                        default:
+                            break;
+                    }
+                    break;
+                case sf::Event::Resized: {
+                    sf::FloatRect visibleArea(0, 0, event.size.width,
+                                              event.size.height);
+                    window.setView(sf::View(visibleArea));
+                    glViewport(0, 0, event.size.width, event.size.height);
+                    size = uvec2(event.size.width, event.size.height);
+                } break;
+                case sf::Event::Closed:
+                    window.close();
+                    break;
+                default:
+                    break;
+            }
+        },
+        [&]() {
+            harness.beginFrame();
+
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))
+                distance = std::max(1.2f, distance * 0.98f);
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
+                distance = std::min(10.0f, distance * 1.02f);
+
+            float time = harness.getTime(clock.getElapsedTime().asSeconds());
+            vec3 eye(cos(time * 0.3f) * distance, 0.5f, sin(time * 0.3f) * distance);
+            mat4 viewProjection =
+                perspective(radians(60.0f), (float)size.x / size.y, 0.01f, 50.0f)
+                * lookAt(eye, vec3(0), vec3(0, 1, 0));
+
+            // the model matrix is the identity, so world space is mesh space
+            if (!frozen) {
+                cullEye = eye;
+                cullFrustum = Frustum::fromMatrix(viewProjection);
+            }
+            culler.cull(cullFrustum, cullEye, cones);
+
+            glClearColor(0.1f, 0.1f, 0.12f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            shader.bind();
+            viewProjectionUniform.setMat4(viewProjection);
+            colorUniform.setVec3(vec3(0.8f, 0.7f, 0.5f));
+            culler.draw(array);
+
+            if (culler.getVisibleTriangles() != shownTriangles) {
+                shownTriangles = culler.getVisibleTriangles();
+                window.setTitle("Meshlets (" + to_string(culler.getVisibleCount()) + " of "
+                                + to_string(culler.size()) + " meshlets, "
+                                + to_string(shownTriangles) + " triangles)");
+            }
+            harness.endFrame();
+            if (harness.isDone())
+                window.close();
+        });
+
+    window.close();
+
+    return harness.finish();
+}
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <GL/glew.h>
+
+#include <SFML/Graphics.hpp>
+#include <Shader.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <Buffer.hpp>
+#include <CommandList.hpp>
+#include <FrameHarness.hpp>
+#include <JobSystem.hpp>
+#include <RenderThread.hpp>
+#include <debug.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+static const char * vertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+uniform mat4 projection;
+uniform mat4 model;
+void main() {
+    gl_Position = projection * model * vec4(aPos, 0.0, 1.0);
+})";
+
+static const char * fragmentShaderSource = R"(
+#version 330 core
+out vec4 FragColor;
+uniform vec4 color;
+void main() {
+    FragColor = color;
+})";
+
+struct Asteroid {
+    glm::vec2 position;
+    glm::vec2 velocity;
+    float angle;
+    float spin;
+    float size;
+    glm::vec4 color;
+};
+
+/**
+ * Many asteroids with their own logic and their own draw call.
+ *
+ * Usage: 18_render_thread [count] [--single] [--ahead frames]
+ *
+ * The main thread polls events and the job system moves the asteroids and
+ * records a command per asteroid into CommandLists. A RenderThread, which
+ * owns the context, plays the merged lists a frame behind, or up to the
+ * frames of --ahead. --single runs the commands on the main thread to
+ * compare, J records on the main thread only and S toggles sorting. The title shows the frame rate, the time spent
+ * recording and waiting for the render thread.
+ */
+int main(int argc, char ** argv) {
+    FrameHarness harness(argc, argv);
+    size_t count = argc > 1 && !FrameHarness::isOption(argv[1])
+                       ? strtoul(argv[1], nullptr, 10)
+                       : 20000;
+    bool threaded = true;
+    unsigned ahead = 1;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--single")
+            threaded = false;
+        else if (string(argv[i]) == "--ahead" && i + 1 < argc)
+            ahead = max(unsigned(strtoul(argv[++i], nullptr, 10)), 1u);
+    }
+
+    const sf::ContextSettings settings(24, 1, 8, 3, 3);
+    sf::RenderWindow window(sf::VideoMode(800, 600),
+                            "Render Thread",
+                            sf::Style::Default,
+                            settings);
+    window.setActive();
+    window.setKeyRepeatEnabled(false);
+    window.setVerticalSyncEnabled(true);
+
+    // glewExperimental = true;
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        cerr << "glewInit failed: " << glewGetErrorString(err);
+        return 1;
+    }
+
+    harness.attach(window);
+
+    initDebug();
+
+    // the context moves to the render thread, which presents, so the loop
+    // is written out instead of running FrameLoop
+    if (threaded)
+        window.setActive(false);
+    RenderThread render([&] { window.setActive(true); },
+                        [&] { window.display(); },
+                        [&] { window.setActive(false); },
+                        threaded);
+    render.setFramesAhead(ahead);
+
+    auto shader = render.create<Shader>(vertexShaderSource, fragmentShaderSource);
+    auto quad = render.allocate<BufferArray>();
+    const float vertices[] = {
+        -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, // First Triangle
+        -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, // Second Triangle
+    };
+    Attribute a0 {0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0};
+    render.submit(
+        [quad, a0](RenderResources & r, const void * data, size_t size) {
+            BufferArray & array = r.emplace(quad, vector<vector<Attribute>> {{a0}});
+            array.bind();
+            array.bufferData(0, size, data);
+            array.unbind();
+        },
+        vertices, sizeof(vertices));
+
+    // a fixed seed so the harness sees the same field every run
+    srand(1);
+    auto random = [](float min, float max) {
+        return min + (max - min) * (rand() / float(RAND_MAX));
+    };
+    vector<Asteroid> asteroids(count);
+    for (auto & asteroid : asteroids) {
+        asteroid.position = {random(-1, 1), random(-1, 1)};
+        asteroid.velocity = {random(-0.2f, 0.2f), random(-0.2f, 0.2f)};
+        asteroid.angle = random(0, 6.28f);
+        asteroid.spin = random(-2, 2);
+        asteroid.size = random(0.004f, 0.02f);
+        asteroid.color = {random(0.4f, 1), random(0.4f, 1), random(0.4f, 1), 1};
+    }
+
+    // the render thread may still play the lists of the frames ahead while
+    // the next one is recorded
+    JobSystem jobs;
+    vector<CommandRecorder<RenderResources>> recorders(ahead + 1);
+    bool parallel = true;
+    bool sorted = true;
+
+    cout << "J: toggle recording on the job system" << endl;
+    cout << "S: toggle sorting the draws by size" << endl;
+
+    sf::Clock clock, titleClock;
+    float last = 0;
+    uint64_t frame = 0;
+    double recordTime = 0, waitTime = 0;
+    unsigned titleFrames = 0;
+    glm::vec2 size(window.getSize().x, window.getSize().y);
+
+    // the window is only closed once the render thread let go of it
+    bool running = true;
+    while (running) {
+        sf::Event event;
+        while (window.pollEvent(event)) {
+            switch (event.type) {
+                case sf::Event::KeyPressed:
+                    if (event.key.code == sf::Keyboard::Escape)
+                        running = false;
+                    else if (event.key.code == sf::Keyboard::J)
+                        parallel = !parallel;
+                    else if (event.key.code == sf::Keyboard::S)
+                        sorted = !sorted;
+                    break;
+                case sf::Event::Resized: {
+                    size = glm::vec2(event.size.width, event.size.height);
+                    render.submit([size](RenderResources &) {
+                        glViewport(0, 0, GLsizei(size.x), GLsizei(size.y));
+                    });
+                } break;
+                case sf::Event::Closed:
+                    running = false;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (!running)
+            break;
+
+        sf::Clock recordClock;
+
+        // the harness frame counter belongs to the render thread, so the
+        // fixed step comes from the frames recorded here
+        float time = harness.isActive() ? frame / 60.0f : clock.getElapsedTime().asSeconds();
+        float dt = min(time - last, 0.25f);
+        last = time;
+
+        FrameHarness * h = &harness;
+        render.submit([h](RenderResources &) {
+            h->beginFrame();
+            glClearColor(0.02f, 0.02f, 0.05f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+        });
+
+        float aspect = size.x / size.y;
+        glm::mat4 projection = glm::ortho(-aspect, aspect, -1.0f, 1.0f, -1.0f, 1.0f);
+        render.submit([shader, projection](RenderResources & r) {
+            r.get(shader).bind();
+            r.uniform(shader, "projection").setMat4(projection);
+        });
+
+        // the asteroids are moved and their draws recorded in chunks on
+        // the workers, the render thread plays the merged lists back
+        CommandRecorder<RenderResources> * recorder = &recorders[frame % recorders.size()];
+        recorder->parallelFor(
+            0, asteroids.size(), 0,
+            [&](CommandList<RenderResources> & list, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    Asteroid & asteroid = asteroids[i];
+                    asteroid.position += asteroid.velocity * dt;
+                    asteroid.angle += asteroid.spin * dt;
+                    for (int axis = 0; axis < 2; axis++) {
+                        float bound = axis == 0 ? aspect : 1.0f;
+                        if (asteroid.position[axis] < -bound)
+                            asteroid.position[axis] += 2 * bound;
+                        else if (asteroid.position[axis] > bound)
+                            asteroid.position[axis] -= 2 * bound;
+                    }
+                    float pulse = 1.0f + 0.2f * sin(time * 3.0f + asteroid.angle);
+
+                    glm::mat4 model =
+                        glm::translate(glm::mat4(1.0f), glm::vec3(asteroid.position, 0));
+                    model = glm::rotate(model, asteroid.angle, glm::vec3(0, 0, 1));
+                    model = glm::scale(model, glm::vec3(asteroid.size * pulse));
+                    glm::vec4 color = asteroid.color;
+                    // sorted, the large asteroids are drawn over the small
+                    uint64_t key = uint64_t(asteroid.size * 1e6f);
+                    list.record(
+                        [shader, quad, model, color](RenderResources & r) {
+                            r.uniform(shader, "model").setMat4(model);
+                            r.uniform(shader, "color").setVec4(color);
+                            r.get(quad).drawArrays(GL_TRIANGLES, 0, 6);
+                        },
+                        key);
+                }
+            },
+            parallel ? &jobs : nullptr);
+        recorder->merge(sorted);
+        render.submit([recorder](RenderResources & r) { recorder->play(r); });
+
+        render.submit([h](RenderResources &) { h->endFrame(); });
+        recordTime += recordClock.getElapsedTime().asSeconds() * 1000.0;
+        render.endFrame();
+        waitTime += render.getWaitTime();
+        frame++;
+        titleFrames++;
+
+        if (harness.isActive() && frame >= harness.getFrameCount())
+            running = false;
+
+        if (titleClock.getElapsedTime().asSeconds() > 0.5f) {
+            float seconds = titleClock.restart().asSeconds();
+            ostringstream title;
+            title.precision(2);
+            title << fixed << "Render Thread (" << (threaded ? "threaded" : "single") << ", "
+                  << (parallel ? "jobs" : "serial") << (sorted ? ", sorted" : "") << ") "
+                  << count << " asteroids, " << titleFrames / seconds << " fps, record "
+                  << recordTime / titleFrames << " ms, wait " << waitTime / titleFrames
+                  << " ms";
+            window.setTitle(title.str());
+            recordTime = waitTime = 0;
+            titleFrames = 0;
+        }
+    }
+
+    // run what is left, then take the context back for the harness
+    render.stop();
+    window.setActive(true);
+    int result = harness.finish();
+    window.close();
+
+    return result;
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+// REMEMBER TO DEFINE STB_IMAGE_WRITE_IMPLEMENTATION in main.cpp
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "FrameBuffer.hpp"
+
+/**
+ * Render a fixed number of frames into an offscreen target as fast as
+ * possible and write them to an image sequence.
+ *
+ * Frames are read back asynchronously through a ring of pixel pack buffers
+ * guarded by fences, so the GPU is never waited on for the frame that was
+ * just submitted. Mapped pixels are copied into pooled images and handed to
+ * worker threads that encode and write the files. The queue to the workers
+ * is bounded, rendering blocks when encoding falls too far behind.
+ */
+class BatchRenderer {
+public:
+    struct Stats {
+        std::size_t frames;
+        double renderSeconds;
+        double totalSeconds;
+    };
+
+private:
+    struct Image {
+        std::size_t frame;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct Readback {
+        Buffer buffer;
+        GLsync fence;
+        std::size_t frame;
+
+        Readback() : buffer(GL_PIXEL_PACK_BUFFER), fence(0), frame(0) {}
+    };
+
+    glm::uvec2 size;
+    RenderTarget target;
+    RenderBuffer depth;
+    std::vector<Readback> readbacks;
+
+    std::vector<std::thread> workers;
+    std::deque<std::unique_ptr<Image>> queue;
+    std::vector<std::unique_ptr<Image>> pool;
+    std::size_t maxQueued;
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::size_t pending;
+    bool stopping;
+    std::string pattern;
+    std::string error;
+
+public:
+    /**
+     * @param size the frame size in pixels
+     * @param threads the number of encoder threads, 0 for one per core
+     * @param readbackDepth the number of frames in flight before a
+     *                      readback is mapped
+     */
+    BatchRenderer(const glm::uvec2 & size,
+                  std::size_t threads = 0,
+                  std::size_t readbackDepth = 3)
+        : size(size),
+          target(size, Texture::RGBA8, Texture::RGBA, GL_UNSIGNED_BYTE),
+          depth(size.x, size.y, GL_DEPTH24_STENCIL8),
+          readbacks(std::max<std::size_t>(readbackDepth, 1)),
+          pending(0),
+          stopping(false) {
+        target.fbo.bind();
+        target.fbo.attach(&depth, GL_DEPTH_STENCIL_ATTACHMENT);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            throw std::runtime_error("Batch target is not complete");
+
+        for (auto & r : readbacks) {
+            r.buffer.bufferData(imageSize(), nullptr, GL_STREAM_READ);
+        }
+        readbacks.front().buffer.unbind();
+
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        maxQueued = threads * 2;
+        for (std::size_t i = 0; i < threads; i++) {
+            workers.emplace_back(&BatchRenderer::encodeLoop, this);
+        }
+    }
+
+    BatchRenderer(const BatchRenderer &) = delete;
+    BatchRenderer & operator=(const BatchRenderer &) = delete;
+
+    ~BatchRenderer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queueChanged.notify_all();
+        for (auto & t : workers) {
+            t.join();
+        }
+        for (auto & r : readbacks) {
+            if (r.fence)
+                glDeleteSync(r.fence);
+        }
+    }
+
+    /**
+     * The frame buffer frames are rendered to, it is bound before each call
+     * to render.
+     */
+    const RenderTarget & getTarget() const {
+        return target;
+    }
+
+    /**
+     * Render frames and write each one to a file.
+     *
+     * The output pattern is passed to snprintf with the frame number, the
+     * extension selects the encoder (.png, .bmp or .tga). Pass an empty
+     * pattern to only measure rendering and readback.
+     *
+     * @param frames the number of frames to render
+     * @param pattern the output file pattern like "out/frame_%05d.png"
+     * @param render called with the frame number to draw each frame
+     *
+     * @return timing of the batch
+     *
+     * @throws std::runtime_error if writing an image failed
+     */
+    Stats run(std::size_t frames,
+              const std::string & pattern,
+              const std::function<void(std::size_t)> & render) {
+        this->pattern = pattern;
+        error.clear();
+        stbi_flip_vertically_on_write(1);
+
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t frame = 0; frame < frames; frame++) {
+            auto & r = readbacks[frame % readbacks.size()];
+            if (r.fence)
+                collect(r);
+
+            target.fbo.bind();
+            glViewport(0, 0, size.x, size.y);
+            render(frame);
+
+            r.buffer.bind();
+            glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+            r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            r.frame = frame;
+        }
+        for (std::size_t i = 0; i < readbacks.size(); i++) {
+            auto & r = readbacks[(frames + i) % readbacks.size()];
+            if (r.fence)
+                collect(r);
+        }
+        readbacks.front().buffer.unbind();
+        auto rendered = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        queueChanged.wait(lock, [&] { return pending == 0; });
+        auto end = std::chrono::steady_clock::now();
+
+        if (!error.empty())
+            throw std::runtime_error(error);
+
+        return {frames,
+                std::chrono::duration<double>(rendered - start).count(),
+                std::chrono::duration<double>(end - start).count()};
+    }
+
+private:
+    GLsizeiptr imageSize() const {
+        return static_cast<GLsizeiptr>(size.x) * size.y * 4;
+    }
+
+    /**
+     * Wait for a readback, copy its pixels into a pooled image and queue it
+     * for encoding.
+     */
+    void collect(Readback & r) {
+        glClientWaitSync(r.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(r.fence);
+        r.fence = 0;
+
+        std::unique_ptr<Image> image;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queueChanged.wait(lock, [&] { return queue.size() < maxQueued; });
+            if (!pool.empty()) {
+                image = std::move(pool.back());
+                pool.pop_back();
+            }
+            pending++;
+        }
+        if (!image)
+            image = std::make_unique<Image>();
+        image->frame = r.frame;
+        image->pixels.resize(imageSize());
+
+        r.buffer.bind();
+        auto * data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, imageSize(),
+                                       GL_MAP_READ_BIT);
+        if (data) {
+            std::memcpy(image->pixels.data(), data, imageSize());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(image));
+        }
+        queueChanged.notify_all();
+    }
+
+    void encodeLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            queueChanged.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+
+            auto image = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            queueChanged.notify_all();
+
+            bool ok = write(*image);
+
+            lock.lock();
+            if (!ok && error.empty())
+                error = "Failed to write frame " + std::to_string(image->frame);
+            pool.push_back(std::move(image));
+            pending--;
+            queueChanged.notify_all();
+        }
+    }
+
+    bool write(const Image & image) const {
+        if (pattern.empty())
+            return true;
+
+        std::vector<char> path(pattern.size() + 32);
+        std::snprintf(path.data(), path.size(), pattern.c_str(),
+                      static_cast<int>(image.frame));
+
+        std::string file(path.data());
+        auto ext = file.substr(file.find_last_of('.') + 1);
+        int w = size.x, h = size.y;
+        if (ext == "bmp")
+            return stbi_write_bmp(file.c_str(), w, h, 4, image.pixels.data());
+        if (ext == "tga")
+            return stbi_write_tga(file.c_str(), w, h, 4, image.pixels.data());
+        return stbi_write_png(file.c_str(), w, h, 4, image.pixels.data(), w * 4);
+    }
+};
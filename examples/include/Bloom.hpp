@@ -0,0 +1,442 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FrameBuffer.hpp"
+#include "PostProcess.hpp"
+#include "Shader.hpp"
+#include "Texture.hpp"
+
+/**
+ * Separable gaussian blur with a kernel radius that can change at runtime.
+ *
+ * Two implementations are provided. The fragment path renders a horizontal
+ * and a vertical pass through frame buffers, reading every tap from the
+ * texture. The compute path loads one row (or column) segment plus the
+ * kernel apron into shared memory per work group so each texel is fetched
+ * once per pass, then writes the result with image stores. The compute path
+ * requires OpenGL 4.3, its shader is only compiled when first used.
+ */
+class GaussianBlur {
+public:
+    enum Mode {
+        Fragment,
+        Compute,
+    };
+
+    static constexpr int MaxRadius = 32;
+    static constexpr int TileSize = 256;
+
+private:
+    struct Program {
+        Shader shader;
+        Shader::Uniform direction;
+        Shader::Uniform radius;
+        Shader::Uniform weights;
+        int uploadedRadius;
+
+        Program(Shader && shader, const char * direction)
+            : shader(std::move(shader)),
+              direction(this->shader.uniform(direction)),
+              radius(this->shader.uniform("radius")),
+              weights(this->shader.uniform("weights")),
+              uploadedRadius(-1) {}
+
+        void bind(int radius, const float * weights) {
+            shader.bind();
+            if (uploadedRadius != radius) {
+                this->radius.setValue(radius);
+                this->weights.setArray(weights, MaxRadius + 1);
+                uploadedRadius = radius;
+            }
+        }
+    };
+
+    std::unique_ptr<RenderTarget> temp;
+    std::unique_ptr<RenderTarget> result;
+    Program fragment;
+    std::unique_ptr<Program> compute;
+    FullscreenTriangle triangle;
+    int radius;
+    float weights[MaxRadius + 1];
+
+public:
+    /**
+     * @param radius the kernel radius in pixels, at most MaxRadius
+     */
+    GaussianBlur(int radius = 8)
+        : fragment(Shader(FullscreenTriangle::vertexShaderSource,
+                          fragmentSource().c_str()),
+                   "direction"),
+          radius(0) {
+        setRadius(radius);
+    }
+
+    int getRadius() const {
+        return radius;
+    }
+
+    /**
+     * Set the kernel radius, sigma is radius / 3 so the kernel covers three
+     * standard deviations. The weights are uploaded on the next apply().
+     *
+     * @param radius the kernel radius in pixels, clamped to [0, MaxRadius]
+     */
+    void setRadius(int radius) {
+        this->radius = std::clamp(radius, 0, MaxRadius);
+        float sigma = std::max(this->radius / 3.0f, 0.5f);
+        float sum = 0;
+        for (int i = 0; i <= MaxRadius; i++) {
+            weights[i] = i <= this->radius
+                             ? std::exp(-0.5f * i * i / (sigma * sigma))
+                             : 0.0f;
+            sum += i == 0 ? weights[i] : 2 * weights[i];
+        }
+        for (auto & w : weights) {
+            w /= sum;
+        }
+    }
+
+    /**
+     * The blurred image from the last call to apply().
+     */
+    const Texture & getTexture() const {
+        return result->texture;
+    }
+
+    /**
+     * Blur input into getTexture(). The viewport and the texture bound to
+     * unit 0 are changed.
+     *
+     * @param input the texture to blur
+     * @param mode use the fragment or compute shader implementation
+     */
+    void apply(const Texture & input, Mode mode = Compute) {
+        auto & size = input.getSize();
+        updateTargets(size);
+
+        if (mode == Fragment)
+            applyFragment(input, size);
+        else
+            applyCompute(input, size);
+    }
+
+private:
+    void updateTargets(const glm::uvec2 & size) {
+        for (auto * target : {&temp, &result}) {
+            if (!*target)
+                *target = std::make_unique<RenderTarget>(size);
+            else if ((*target)->getSize() != size)
+                (*target)->resize(size);
+        }
+    }
+
+    void applyFragment(const Texture & input, const glm::uvec2 & size) {
+        glViewport(0, 0, size.x, size.y);
+        fragment.bind(radius, weights);
+
+        temp->fbo.bind();
+        fragment.direction.setVec2(glm::vec2(1.0f / size.x, 0));
+        input.bind();
+        triangle.draw();
+
+        result->fbo.bind();
+        fragment.direction.setVec2(glm::vec2(0, 1.0f / size.y));
+        temp->texture.bind();
+        triangle.draw();
+    }
+
+    void applyCompute(const Texture & input, const glm::uvec2 & size) {
+        if (!compute)
+            compute = std::make_unique<Program>(
+                Shader(computeSource().c_str()), "vertical");
+
+        compute->bind(radius, weights);
+
+        compute->direction.setValue(false);
+        input.bind();
+        temp->texture.bindImage(0, GL_WRITE_ONLY);
+        compute->shader.dispatch((size.x + TileSize - 1) / TileSize, size.y);
+        Shader::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        compute->direction.setValue(true);
+        temp->texture.bind();
+        result->texture.bindImage(0, GL_WRITE_ONLY);
+        compute->shader.dispatch((size.y + TileSize - 1) / TileSize, size.x);
+        Shader::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+    }
+
+    static std::string fragmentSource() {
+        return R"(
+#version 330 core
+in vec2 FragTex;
+out vec4 FragColor;
+uniform sampler2D gTexture;
+uniform vec2 direction;
+uniform int radius;
+uniform float weights[)"
+               + std::to_string(MaxRadius + 1) + R"(];
+void main() {
+    vec4 c = texture(gTexture, FragTex) * weights[0];
+    for (int i = 1; i <= radius; i++) {
+        vec2 o = direction * float(i);
+        c += (texture(gTexture, FragTex + o) + texture(gTexture, FragTex - o))
+             * weights[i];
+    }
+    FragColor = c;
+})";
+    }
+
+    static std::string computeSource() {
+        return "#version 430 core\n"
+               "#define TILE "
+               + std::to_string(TileSize) + "\n#define MAX_RADIUS "
+               + std::to_string(MaxRadius) + R"(
+layout (local_size_x = TILE) in;
+layout (rgba16f, binding = 0) uniform writeonly image2D outImage;
+uniform sampler2D gTexture;
+uniform bool vertical;
+uniform int radius;
+uniform float weights[MAX_RADIUS + 1];
+shared vec4 tile[TILE + 2 * MAX_RADIUS];
+
+ivec2 toCoord(int along, int across) {
+    return vertical ? ivec2(across, along) : ivec2(along, across);
+}
+
+void main() {
+    ivec2 size = textureSize(gTexture, 0);
+    int extent = vertical ? size.y : size.x;
+    int start = int(gl_WorkGroupID.x) * TILE;
+    int across = int(gl_WorkGroupID.y);
+    int lid = int(gl_LocalInvocationID.x);
+
+    for (int i = lid; i < TILE + 2 * radius; i += TILE) {
+        int p = clamp(start + i - radius, 0, extent - 1);
+        tile[i] = texelFetch(gTexture, toCoord(p, across), 0);
+    }
+    barrier();
+
+    int p = start + lid;
+    if (p >= extent)
+        return;
+
+    int t = lid + radius;
+    vec4 c = tile[t] * weights[0];
+    for (int i = 1; i <= radius; i++)
+        c += (tile[t - i] + tile[t + i]) * weights[i];
+    imageStore(outImage, toCoord(p, across), c);
+})";
+    }
+};
+
+/**
+ * Physically based bloom over a chain of progressively smaller targets.
+ *
+ * Each downsample step uses the 13 tap filter from Call of Duty: Advanced
+ * Warfare, the first step also applies the brightness threshold and a Karis
+ * average to suppress fireflies. The chain is then walked back up with a
+ * 3x3 tent filter, additively blending each level into the next larger one.
+ * Targets use R11G11B10F to keep the bandwidth of every step low.
+ */
+class Bloom {
+    struct Program {
+        Shader shader;
+        Shader::Uniform texelSize;
+
+        Program(Shader && shader)
+            : shader(std::move(shader)),
+              texelSize(this->shader.uniform("texelSize")) {}
+    };
+
+    std::vector<std::unique_ptr<RenderTarget>> mips;
+    std::size_t mipCount;
+    Program downsample;
+    Shader::Uniform firstPass;
+    Shader::Uniform threshold;
+    Program upsample;
+    Shader::Uniform filterRadius;
+    FullscreenTriangle triangle;
+
+public:
+    /**
+     * @param size the size of the input image in pixels
+     * @param mipCount the number of downsample steps, the chain stops
+     *                 earlier if a level would be smaller than one pixel.
+     *                 The first level is always made, at least 1x1.
+     */
+    Bloom(const glm::uvec2 & size, std::size_t mipCount = 6)
+        : mipCount(mipCount),
+          downsample(Shader(FullscreenTriangle::vertexShaderSource,
+                            downsampleSource)),
+          firstPass(downsample.shader.uniform("firstPass")),
+          threshold(downsample.shader.uniform("threshold")),
+          upsample(Shader(FullscreenTriangle::vertexShaderSource,
+                          upsampleSource)),
+          filterRadius(upsample.shader.uniform("filterRadius")) {
+        resize(size);
+        setThreshold(1.0f);
+        setFilterRadius(0.005f);
+    }
+
+    void resize(const glm::uvec2 & size) {
+        mips.clear();
+        glm::uvec2 mipSize = size;
+        for (std::size_t i = 0; i < std::max<std::size_t>(mipCount, 1); i++) {
+            mipSize /= 2u;
+            if (i == 0)
+                mipSize = glm::uvec2(std::max(mipSize.x, 1u), std::max(mipSize.y, 1u));
+            else if (mipSize.x == 0 || mipSize.y == 0)
+                break;
+            mips.push_back(std::make_unique<RenderTarget>(
+                mipSize, Texture::R11G11B10F, Texture::RGB, GL_FLOAT));
+        }
+    }
+
+    /**
+     * @param threshold the brightness where pixels start to bloom
+     */
+    void setThreshold(float threshold) {
+        downsample.shader.bind();
+        this->threshold.setValue(threshold);
+    }
+
+    /**
+     * @param radius the upsample filter radius in texture coordinates
+     */
+    void setFilterRadius(float radius) {
+        upsample.shader.bind();
+        filterRadius.setValue(radius);
+    }
+
+    /**
+     * The bloom image at half the input resolution, resize() always
+     * makes this level.
+     */
+    const Texture & getTexture() const {
+        return mips.front()->texture;
+    }
+
+    /**
+     * Build the bloom image from input. The viewport and the texture bound
+     * to unit 0 are changed.
+     *
+     * @param input the hdr image
+     */
+    void apply(const Texture & input) {
+        downsample.shader.bind();
+        const Texture * source = &input;
+        for (std::size_t i = 0; i < mips.size(); i++) {
+            auto & mip = *mips[i];
+            firstPass.setValue(i == 0);
+            draw(downsample, *source, mip);
+            source = &mip.texture;
+        }
+
+        upsample.shader.bind();
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glBlendEquation(GL_FUNC_ADD);
+        for (std::size_t i = mips.size() - 1; i > 0; i--) {
+            draw(upsample, mips[i]->texture, *mips[i - 1]);
+        }
+        glDisable(GL_BLEND);
+    }
+
+    /**
+     * A PostProcessStack effect that adds the bloom image to the scene.
+     * Bind getTexture() to a texture unit and set the `bloomTexture`
+     * parameter to that unit.
+     */
+    static PostEffect composite() {
+        return {PostEffect::Color,
+                "uniform sampler2D bloomTexture;\n"
+                "uniform float bloomStrength = 0.04;",
+                "vec3 bloom = texture(bloomTexture, uv).rgb;\n"
+                "return vec4(mix(color.rgb, bloom, bloomStrength), color.a);"};
+    }
+
+private:
+    void draw(const Program & program,
+              const Texture & source,
+              const RenderTarget & target) {
+        auto & size = target.getSize();
+        glViewport(0, 0, size.x, size.y);
+        target.fbo.bind();
+        program.texelSize.setVec2(glm::vec2(1.0f / source.getSize().x,
+                                            1.0f / source.getSize().y));
+        source.bind();
+        triangle.draw();
+    }
+
+    static constexpr const char * downsampleSource = R"(
+#version 330 core
+in vec2 FragTex;
+out vec4 FragColor;
+uniform sampler2D gTexture;
+uniform vec2 texelSize;
+uniform bool firstPass;
+uniform float threshold;
+
+float karisWeight(vec3 c) {
+    float luma = dot(c, vec3(0.2126, 0.7152, 0.0722));
+    return 1.0 / (1.0 + luma);
+}
+
+vec3 group(vec3 a, vec3 b, vec3 c, vec3 d) {
+    vec3 s = (a + b + c + d) * 0.25;
+    return firstPass ? s * karisWeight(s) : s;
+}
+
+vec3 tap(float x, float y) {
+    return texture(gTexture, FragTex + vec2(x, y) * texelSize).rgb;
+}
+
+void main() {
+    vec3 a = tap(-2, 2), b = tap(0, 2), c = tap(2, 2);
+    vec3 d = tap(-2, 0), e = tap(0, 0), f = tap(2, 0);
+    vec3 g = tap(-2, -2), h = tap(0, -2), i = tap(2, -2);
+    vec3 j = tap(-1, 1), k = tap(1, 1);
+    vec3 l = tap(-1, -1), m = tap(1, -1);
+
+    vec3 color = group(j, k, l, m) * 0.5
+                 + group(a, b, d, e) * 0.125
+                 + group(b, c, e, f) * 0.125
+                 + group(d, e, g, h) * 0.125
+                 + group(e, f, h, i) * 0.125;
+
+    if (firstPass) {
+        float bright = max(color.r, max(color.g, color.b));
+        color *= max(bright - threshold, 0.0) / max(bright, 0.0001);
+    }
+    FragColor = vec4(max(color, 0.0001), 1.0);
+})";
+
+    static constexpr const char * upsampleSource = R"(
+#version 330 core
+in vec2 FragTex;
+out vec4 FragColor;
+uniform sampler2D gTexture;
+uniform vec2 texelSize;
+uniform float filterRadius;
+
+vec3 tap(float x, float y) {
+    return texture(gTexture, FragTex + vec2(x, y) * filterRadius).rgb;
+}
+
+void main() {
+    vec3 color = tap(0, 0) * 4.0;
+    color += (tap(0, 1) + tap(-1, 0) + tap(1, 0) + tap(0, -1)) * 2.0;
+    color += tap(-1, 1) + tap(1, 1) + tap(-1, -1) + tap(1, -1);
+    FragColor = vec4(color / 16.0, 1.0);
+})";
+};
@@ -10,6 +10,10 @@
 #include <stdexcept>
 #include <vector>
 
+#include "Capture.hpp"
+#include "Profiler.hpp"
+#include "RenderStats.hpp"
+
 struct Attribute {
     GLuint index;
     GLint size;
@@ -20,16 +24,31 @@ struct Attribute {
     GLuint divisor = 0;
 
     void enable() const {
+        CAPTURE(Capture::VertexAttrib {index, size, type, normalized, stride, divisor,
+                                       reinterpret_cast<std::uintptr_t>(pointer)});
         glVertexAttribPointer(index, size, type, normalized, stride, pointer);
         glVertexAttribDivisor(index, divisor);
         glEnableVertexAttribArray(index);
     }
 
     void disable() const {
+        CAPTURE(Capture::DisableVertexAttrib {index});
         glDisableVertexAttribArray(index);
     }
 };
 
+/**
+ * The layout of one command in a GL_DRAW_INDIRECT_BUFFER for
+ * glDrawElementsIndirect.
+ */
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
 class Buffer {
     GLenum target;
     GLuint buffer;
@@ -37,6 +56,7 @@ class Buffer {
 public:
     Buffer(GLenum target = GL_ARRAY_BUFFER) : target(target) {
         glGenBuffers(1, &buffer);
+        CAPTURE(Capture::Create {Capture::BufferObject, buffer});
     }
 
     Buffer(Buffer && other) : target(other.target), buffer(other.buffer) {
@@ -54,8 +74,10 @@ public:
     Buffer & operator=(const Buffer &) = delete;
 
     ~Buffer() {
-        if (buffer != 0)
+        if (buffer != 0) {
+            CAPTURE(Capture::Delete {Capture::BufferObject, buffer});
             glDeleteBuffers(1, &buffer);
+        }
     }
 
     GLenum getTarget() const {
@@ -67,20 +89,56 @@ public:
     }
 
     void bind() const {
+        RenderStats::current().bufferBinds++;
+        CAPTURE(Capture::BindBuffer {target, buffer});
         glBindBuffer(target, buffer);
     }
 
     void unbind() const {
+        CAPTURE(Capture::BindBuffer {target, 0});
         glBindBuffer(target, 0);
     }
 
+    /**
+     * Bind the buffer to an indexed binding point of its target, for
+     * example a GL_SHADER_STORAGE_BUFFER binding.
+     *
+     * @param index the binding point index
+     */
+    void bindBase(GLuint index) const {
+        CAPTURE(Capture::BindBufferBase {target, index, buffer});
+        glBindBufferBase(target, index, buffer);
+    }
+
+    /**
+     * Bind the buffer to an indexed binding point of another target, for
+     * example to read a vertex buffer as a shader storage buffer.
+     *
+     * @param target an indexed target like GL_SHADER_STORAGE_BUFFER
+     * @param index the binding point index
+     */
+    void bindBase(GLenum target, GLuint index) const {
+        CAPTURE(Capture::BindBufferBase {target, index, buffer});
+        glBindBufferBase(target, index, buffer);
+    }
+
     void bufferData(GLsizeiptr size, const void * data, GLenum usage = GL_STATIC_DRAW) {
+        PROFILE_SCOPE("Buffer::bufferData");
+        if (data) {
+            RenderStats::current().bufferUploads++;
+            RenderStats::current().bufferBytes += size;
+        }
         bind();
+        CAPTURE(Capture::BufferData {target, usage, size}, data, size);
         glBufferData(target, size, data, usage);
     }
 
     void bufferSubData(GLintptr offset, GLsizeiptr size, const void * data) {
+        PROFILE_SCOPE("Buffer::bufferSubData");
+        RenderStats::current().bufferUploads++;
+        RenderStats::current().bufferBytes += size;
         bind();
+        CAPTURE(Capture::BufferSubData {target, 0, offset}, data, size);
         glBufferSubData(target, offset, size, data);
     }
 };
@@ -126,6 +184,7 @@ class BufferArray {
 public:
     BufferArray() : elementBuffer(nullptr) {
         glGenVertexArrays(1, &array);
+        CAPTURE(Capture::Create {Capture::VertexArrayObject, array});
     }
 
     BufferArray(const std::vector<std::vector<Attribute>> & attributes)
@@ -159,8 +218,10 @@ public:
     BufferArray & operator=(const BufferArray &) = delete;
 
     ~BufferArray() {
-        if (array)
+        if (array) {
+            CAPTURE(Capture::Delete {Capture::VertexArrayObject, array});
             glDeleteVertexArrays(1, &array);
+        }
     }
 
     GLuint getArrayId() const {
@@ -171,7 +232,7 @@ public:
         return buffers.size();
     }
 
-    void addBuffer(const vector<Attribute> & attributes) {
+    void addBuffer(const std::vector<Attribute> & attributes) {
         Buffer buffer(GL_ARRAY_BUFFER);
         buffers.emplace_back(attributes, std::move(buffer));
     }
@@ -185,10 +246,13 @@ public:
     }
 
     void bind() const {
+        RenderStats::current().arrayBinds++;
+        CAPTURE(Capture::BindVertexArray {array});
         glBindVertexArray(array);
     }
 
     void unbind() const {
+        CAPTURE(Capture::BindVertexArray {0});
         glBindVertexArray(0);
     }
 
@@ -215,7 +279,10 @@ public:
     }
 
     void drawArrays(GLenum mode, GLint first, GLsizei count) const {
+        PROFILE_SCOPE("BufferArray::drawArrays");
+        RenderStats::countDraw(mode, count);
         bind();
+        CAPTURE(Capture::DrawArrays {mode, first, count, 0});
         glDrawArrays(mode, first, count);
     }
 
@@ -223,7 +290,10 @@ public:
                              GLint first,
                              GLsizei count,
                              GLsizei primcount) const {
+        PROFILE_SCOPE("BufferArray::drawArraysInstanced");
+        RenderStats::countDraw(mode, count, primcount);
         bind();
+        CAPTURE(Capture::DrawArrays {mode, first, count, primcount});
         glDrawArraysInstanced(mode, first, count, primcount);
     }
 
@@ -231,7 +301,11 @@ public:
                       GLsizei count,
                       GLenum type,
                       const void * indices) const {
+        PROFILE_SCOPE("BufferArray::drawElements");
+        RenderStats::countDraw(mode, count);
         bind();
+        CAPTURE(Capture::DrawElements {mode, count, type, 0,
+                                       reinterpret_cast<std::uintptr_t>(indices)});
         glDrawElements(mode, count, type, indices);
     }
 
@@ -240,9 +314,36 @@ public:
                                GLenum type,
                                const void * indices,
                                GLsizei primcount) const {
+        PROFILE_SCOPE("BufferArray::drawElementsInstanced");
+        RenderStats::countDraw(mode, count, primcount);
         bind();
+        CAPTURE(Capture::DrawElements {mode, count, type, primcount,
+                                       reinterpret_cast<std::uintptr_t>(indices)});
         glDrawElementsInstanced(mode, count, type, indices, primcount);
     }
+
+    /**
+     * Draw with the parameters read from a DrawElementsIndirectCommand in
+     * a buffer, which may have been written by a compute shader.
+     *
+     * @param mode the primitive mode
+     * @param type the index type
+     * @param commands the buffer holding the command
+     * @param offset the byte offset of the command in commands
+     */
+    void drawElementsIndirect(GLenum mode,
+                              GLenum type,
+                              const Buffer & commands,
+                              GLintptr offset = 0) const {
+        PROFILE_SCOPE("BufferArray::drawElementsIndirect");
+        // the counts are on the GPU, only the call is counted
+        RenderStats::current().drawCalls++;
+        bind();
+        CAPTURE(Capture::BindBuffer {GL_DRAW_INDIRECT_BUFFER, commands.getBufferId()});
+        CAPTURE(Capture::DrawElementsIndirect {mode, type, std::uint64_t(offset)});
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.getBufferId());
+        glDrawElementsIndirect(mode, type, reinterpret_cast<const void *>(offset));
+    }
 };
 
 class Quad {
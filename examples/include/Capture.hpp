@@ -0,0 +1,716 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Records the GL calls of the wrapper classes into a binary stream that
+ * Replay can execute again, see tools/replay.cpp.
+ *
+ * Buffer, BufferArray, Texture, Shader, FrameBuffer and RenderBuffer record
+ * every GL call they make with its payload (buffer contents, pixels, shader
+ * sources) through CAPTURE(), and so do the helpers built on them
+ * (RenderQueue, MeshletCuller, PostProcessStack, Bloom, the GPU culling and
+ * TransformStore). Object names are recorded as the application saw them
+ * and mapped to new objects on replay.
+ *
+ * Raw GL calls, in the application or in a helper, are not recorded.
+ * Fixed function state is the exception, whoever sets it: before every
+ * draw and blit the viewport, clear values and depth, blend, cull and
+ * scissor state are read back and recorded when they changed. glClear is
+ * not recorded, Replay clears the default frame buffer at the start of
+ * every frame with the recorded clear values. Reads like glReadPixels,
+ * queries and fences are left out on purpose.
+ *
+ * Set OPENGL_DEMO_CAPTURE to a path to record from the first wrapper call
+ * on, or call start(). Replay needs every object a frame uses, so a capture
+ * must start before the first object is created. FrameHarness::endFrame()
+ * marks the end of each frame and writes the frame out, applications
+ * without a harness call endFrame() themselves.
+ *
+ * The stream is a Header followed by commands: an Op byte, the command
+ * struct and, for commands with HasData, a 64 bit size and that many bytes.
+ * It is written in host byte order. Commands are copied as bytes, so they
+ * have no padding, gaps are filled with reserved fields.
+ */
+class Capture {
+public:
+    static constexpr std::uint32_t Version = 1;
+    // the buffer is written out when it grows past this
+    static constexpr std::size_t FlushSize = 1 << 20;
+
+    class CaptureException : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    struct Header {
+        char magic[8] = {'G', 'L', 'C', 'A', 'P', 'T', 'U', 'R'};
+        std::uint32_t version = Version;
+        std::uint32_t reserved = 0;
+    };
+
+    enum class Op : std::uint8_t {
+        EndFrame,
+        Create,
+        Delete,
+        BindBuffer,
+        BindBufferBase,
+        BufferData,
+        BufferSubData,
+        BindVertexArray,
+        VertexAttrib,
+        DisableVertexAttrib,
+        DrawArrays,
+        DrawElements,
+        DrawElementsIndirect,
+        BindTexture,
+        BindImage,
+        TexImage,
+        TexImageMultisample,
+        TexParameter,
+        GenerateMipmap,
+        CreateProgram,
+        UseProgram,
+        UniformLocation,
+        Uniform,
+        Dispatch,
+        BindFramebuffer,
+        FramebufferTexture,
+        FramebufferRenderbuffer,
+        BlitFramebuffer,
+        BindRenderbuffer,
+        RenderbufferStorage,
+        State,
+        MultiDrawElements,
+        MemoryBarrier,
+        Count,
+    };
+
+    /**
+     * The kinds of GL objects, each has its own names.
+     */
+    enum Object : std::uint32_t {
+        BufferObject,
+        VertexArrayObject,
+        TextureObject,
+        ProgramObject,
+        FramebufferObject,
+        RenderbufferObject,
+        ObjectCount,
+    };
+
+    struct EndFrame {
+        static constexpr Op op = Op::EndFrame;
+        static constexpr bool HasData = false;
+        std::uint64_t frame;
+    };
+
+    struct Create {
+        static constexpr Op op = Op::Create;
+        static constexpr bool HasData = false;
+        std::uint32_t object;
+        std::uint32_t id;
+    };
+
+    struct Delete {
+        static constexpr Op op = Op::Delete;
+        static constexpr bool HasData = false;
+        std::uint32_t object;
+        std::uint32_t id;
+    };
+
+    struct BindBuffer {
+        static constexpr Op op = Op::BindBuffer;
+        static constexpr bool HasData = false;
+        std::uint32_t target;
+        std::uint32_t buffer;
+    };
+
+    struct BindBufferBase {
+        static constexpr Op op = Op::BindBufferBase;
+        static constexpr bool HasData = false;
+        std::uint32_t target;
+        std::uint32_t index;
+        std::uint32_t buffer;
+    };
+
+    // data is the contents, no data for an uninitialized store
+    struct BufferData {
+        static constexpr Op op = Op::BufferData;
+        static constexpr bool HasData = true;
+        std::uint32_t target;
+        std::uint32_t usage;
+        std::int64_t size;
+    };
+
+    struct BufferSubData {
+        static constexpr Op op = Op::BufferSubData;
+        static constexpr bool HasData = true;
+        std::uint32_t target;
+        std::uint32_t reserved;
+        std::int64_t offset;
+    };
+
+    struct BindVertexArray {
+        static constexpr Op op = Op::BindVertexArray;
+        static constexpr bool HasData = false;
+        std::uint32_t array;
+    };
+
+    struct VertexAttrib {
+        static constexpr Op op = Op::VertexAttrib;
+        static constexpr bool HasData = false;
+        std::uint32_t index;
+        std::int32_t size;
+        std::uint32_t type;
+        std::uint32_t normalized;
+        std::int32_t stride;
+        std::uint32_t divisor;
+        std::uint64_t offset;
+    };
+
+    struct DisableVertexAttrib {
+        static constexpr Op op = Op::DisableVertexAttrib;
+        static constexpr bool HasData = false;
+        std::uint32_t index;
+    };
+
+    // instances is 0 for the draws that are not instanced
+    struct DrawArrays {
+        static constexpr Op op = Op::DrawArrays;
+        static constexpr bool HasData = false;
+        std::uint32_t mode;
+        std::int32_t first;
+        std::int32_t count;
+        std::int32_t instances;
+    };
+
+    struct DrawElements {
+        static constexpr Op op = Op::DrawElements;
+        static constexpr bool HasData = false;
+        std::uint32_t mode;
+        std::int32_t count;
+        std::uint32_t type;
+        std::int32_t instances;
+        std::uint64_t offset;
+    };
+
+    // the command buffer is bound with a BindBuffer before
+    struct DrawElementsIndirect {
+        static constexpr Op op = Op::DrawElementsIndirect;
+        static constexpr bool HasData = false;
+        std::uint32_t mode;
+        std::uint32_t type;
+        std::uint64_t offset;
+    };
+
+    // unit is -1 to bind to the active texture unit
+    struct BindTexture {
+        static constexpr Op op = Op::BindTexture;
+        static constexpr bool HasData = false;
+        std::uint32_t target;
+        std::uint32_t texture;
+        std::int32_t unit;
+    };
+
+    struct BindImage {
+        static constexpr Op op = Op::BindImage;
+        static constexpr bool HasData = false;
+        std::uint32_t unit;
+        std::uint32_t texture;
+        std::int32_t level;
+        std::uint32_t access;
+        std::uint32_t format;
+    };
+
+    // data is the pixels as GL read them with the unpack alignment
+    struct TexImage {
+        static constexpr Op op = Op::TexImage;
+        static constexpr bool HasData = true;
+        std::uint32_t target;
+        std::int32_t internal;
+        std::int32_t width;
+        std::int32_t height;
+        std::uint32_t format;
+        std::uint32_t type;
+        std::int32_t alignment;
+    };
+
+    struct TexImageMultisample {
+        static constexpr Op op = Op::TexImageMultisample;
+        static constexpr bool HasData = false;
+        std::uint32_t target;
+        std::int32_t samples;
+        std::uint32_t internal;
+        std::int32_t width;
+        std::int32_t height;
+    };
+
+    struct TexParameter {
+        static constexpr Op op = Op::TexParameter;
+        static constexpr bool HasData = false;
+        std::uint32_t target;
+        std::uint32_t name;
+        std::int32_t value;
+    };
+
+    struct GenerateMipmap {
+        static constexpr Op op = Op::GenerateMipmap;
+        static constexpr bool HasData = false;
+        std::uint32_t target;
+    };
+
+    // data is the sources of the stages, each ending in a 0 byte
+    struct CreateProgram {
+        static constexpr Op op = Op::CreateProgram;
+        static constexpr bool HasData = true;
+        std::uint32_t program;
+        std::uint32_t stages;
+    };
+
+    struct UseProgram {
+        static constexpr Op op = Op::UseProgram;
+        static constexpr bool HasData = false;
+        std::uint32_t program;
+    };
+
+    // data is the uniform name, locations differ between drivers
+    struct UniformLocation {
+        static constexpr Op op = Op::UniformLocation;
+        static constexpr bool HasData = true;
+        std::uint32_t program;
+        std::int32_t location;
+    };
+
+    // type is the GL type of one element like GL_FLOAT_VEC4, data the values
+    struct Uniform {
+        static constexpr Op op = Op::Uniform;
+        static constexpr bool HasData = true;
+        std::int32_t location;
+        std::uint32_t type;
+        std::int32_t count;
+    };
+
+    struct Dispatch {
+        static constexpr Op op = Op::Dispatch;
+        static constexpr bool HasData = false;
+        std::uint32_t x;
+        std::uint32_t y;
+        std::uint32_t z;
+    };
+
+    // framebuffer 0 is the default frame buffer of the replay
+    struct BindFramebuffer {
+        static constexpr Op op = Op::BindFramebuffer;
+        static constexpr bool HasData = false;
+        std::uint32_t target;
+        std::uint32_t framebuffer;
+    };
+
+    struct FramebufferTexture {
+        static constexpr Op op = Op::FramebufferTexture;
+        static constexpr bool HasData = false;
+        std::uint32_t attachment;
+        std::uint32_t target;
+        std::uint32_t texture;
+    };
+
+    struct FramebufferRenderbuffer {
+        static constexpr Op op = Op::FramebufferRenderbuffer;
+        static constexpr bool HasData = false;
+        std::uint32_t attachment;
+        std::uint32_t renderbuffer;
+    };
+
+    struct BlitFramebuffer {
+        static constexpr Op op = Op::BlitFramebuffer;
+        static constexpr bool HasData = false;
+        std::int32_t sourceWidth;
+        std::int32_t sourceHeight;
+        std::int32_t width;
+        std::int32_t height;
+        std::uint32_t mask;
+        std::uint32_t filter;
+    };
+
+    struct BindRenderbuffer {
+        static constexpr Op op = Op::BindRenderbuffer;
+        static constexpr bool HasData = false;
+        std::uint32_t renderbuffer;
+    };
+
+    struct RenderbufferStorage {
+        static constexpr Op op = Op::RenderbufferStorage;
+        static constexpr bool HasData = false;
+        std::uint32_t internal;
+        std::int32_t width;
+        std::int32_t height;
+    };
+
+    // the fixed function state draws depend on, enabled is a set of flags
+    struct State {
+        static constexpr Op op = Op::State;
+        static constexpr bool HasData = false;
+        enum Flag : std::uint32_t {
+            DepthTest = 1,
+            Blend = 2,
+            CullFace = 4,
+            ScissorTest = 8,
+        };
+        std::int32_t viewport[4];
+        std::int32_t scissor[4];
+        float clearColor[4];
+        float clearDepth;
+        std::uint32_t enabled;
+        std::uint32_t depthFunc;
+        std::uint32_t depthMask;
+        std::uint32_t blendFunc[4];
+        std::uint32_t cullFace;
+
+        /**
+         * Read the state of the current context.
+         */
+        static State current() {
+            State s {};
+            glGetIntegerv(GL_VIEWPORT, s.viewport);
+            glGetIntegerv(GL_SCISSOR_BOX, s.scissor);
+            glGetFloatv(GL_COLOR_CLEAR_VALUE, s.clearColor);
+            glGetFloatv(GL_DEPTH_CLEAR_VALUE, &s.clearDepth);
+            if (glIsEnabled(GL_DEPTH_TEST))
+                s.enabled |= DepthTest;
+            if (glIsEnabled(GL_BLEND))
+                s.enabled |= Blend;
+            if (glIsEnabled(GL_CULL_FACE))
+                s.enabled |= CullFace;
+            if (glIsEnabled(GL_SCISSOR_TEST))
+                s.enabled |= ScissorTest;
+            static const GLenum blendNames[] = {GL_BLEND_SRC_RGB, GL_BLEND_DST_RGB,
+                                                GL_BLEND_SRC_ALPHA, GL_BLEND_DST_ALPHA};
+            GLint value = 0;
+            glGetIntegerv(GL_DEPTH_FUNC, &value);
+            s.depthFunc = value;
+            GLboolean mask = GL_TRUE;
+            glGetBooleanv(GL_DEPTH_WRITEMASK, &mask);
+            s.depthMask = mask;
+            for (int i = 0; i < 4; i++) {
+                glGetIntegerv(blendNames[i], &value);
+                s.blendFunc[i] = value;
+            }
+            glGetIntegerv(GL_CULL_FACE_MODE, &value);
+            s.cullFace = value;
+            return s;
+        }
+    };
+
+    // data is drawCount 32 bit counts followed by drawCount 64 bit offsets
+    struct MultiDrawElements {
+        static constexpr Op op = Op::MultiDrawElements;
+        static constexpr bool HasData = true;
+        std::uint32_t mode;
+        std::uint32_t type;
+        std::int32_t drawCount;
+    };
+
+    struct MemoryBarrier {
+        static constexpr Op op = Op::MemoryBarrier;
+        static constexpr bool HasData = false;
+        std::uint32_t barriers;
+    };
+
+private:
+    std::ofstream file;
+    std::vector<char> buffer;
+    bool recording;
+    std::uint64_t frame;
+    std::uint64_t bytes;
+    // the last State recorded, valid once hasState
+    State state;
+    bool hasState;
+
+    Capture() : recording(false), frame(0), bytes(0), state(), hasState(false) {
+        if (const char * path = std::getenv("OPENGL_DEMO_CAPTURE"))
+            start(path);
+    }
+
+public:
+    Capture(const Capture &) = delete;
+    Capture & operator=(const Capture &) = delete;
+
+    ~Capture() {
+        stop();
+    }
+
+    static Capture & get() {
+        static Capture capture;
+        return capture;
+    }
+
+    static bool isRecording() {
+        return get().recording;
+    }
+
+    /**
+     * Start recording into the file at path, replacing it.
+     *
+     * @throws CaptureException if the file can not be opened
+     */
+    void start(const std::string & path) {
+        stop();
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            throw CaptureException("Could not open " + path);
+        Header header;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        buffer.reserve(FlushSize);
+        recording = true;
+        frame = 0;
+        bytes = sizeof(header);
+        hasState = false;
+    }
+
+    /**
+     * Write out what is left and close the file.
+     */
+    void stop() {
+        if (!recording)
+            return;
+        flush();
+        file.close();
+        recording = false;
+    }
+
+    /**
+     * Mark the end of a frame and write the frame out, so a crash keeps
+     * every finished frame.
+     */
+    void endFrame() {
+        if (!recording)
+            return;
+        record(EndFrame {frame++});
+        flush();
+    }
+
+    std::uint64_t getFrameCount() const {
+        return frame;
+    }
+
+    /**
+     * The number of bytes recorded so far.
+     */
+    std::uint64_t getSize() const {
+        return bytes + buffer.size();
+    }
+
+    /**
+     * Append a command without data.
+     */
+    template <typename Command>
+    void record(const Command & command) {
+        static_assert(!Command::HasData, "command needs data");
+        append(command);
+    }
+
+    /**
+     * Append a command with size bytes of data, data may be nullptr.
+     */
+    template <typename Command>
+    void record(const Command & command, const void * data, std::uint64_t size) {
+        static_assert(Command::HasData, "command has no data");
+        append(command);
+        if (!data)
+            size = 0;
+        put(&size, sizeof(size));
+        put(data, size);
+    }
+
+    template <typename Command>
+    void record(const Command & command, const std::string & data) {
+        record(command, data.data(), data.size());
+    }
+
+    /**
+     * The number of bytes GL reads for an image of width x height pixels in
+     * format and type from client memory, with the current unpack
+     * alignment.
+     */
+    static std::uint64_t imageSize(GLsizei width, GLsizei height, GLenum format, GLenum type) {
+        GLint alignment = 4;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        return imageSize(width, height, format, type, alignment);
+    }
+
+    /**
+     * The same with rows aligned to alignment bytes, 1, 2, 4 or 8.
+     */
+    static std::uint64_t imageSize(GLsizei width,
+                                   GLsizei height,
+                                   GLenum format,
+                                   GLenum type,
+                                   GLint alignment) {
+        if (width <= 0 || height <= 0)
+            return 0;
+        std::uint64_t components;
+        switch (format) {
+            case GL_RG:
+                components = 2;
+                break;
+            case GL_RGB:
+            case GL_BGR:
+                components = 3;
+                break;
+            case GL_RGBA:
+            case GL_BGRA:
+                components = 4;
+                break;
+            default:
+                components = 1;
+                break;
+        }
+        std::uint64_t componentSize;
+        switch (type) {
+            case GL_UNSIGNED_BYTE:
+            case GL_BYTE:
+                componentSize = 1;
+                break;
+            case GL_UNSIGNED_SHORT:
+            case GL_SHORT:
+            case GL_HALF_FLOAT:
+                componentSize = 2;
+                break;
+            default:
+                componentSize = 4;
+                break;
+        }
+        std::uint64_t row = width * components * componentSize;
+        std::uint64_t stride = (row + alignment - 1) / alignment * alignment;
+        return stride * (height - 1) + row;
+    }
+
+    /**
+     * Whether the result of op depends on the fixed function state.
+     */
+    static constexpr bool usesState(Op op) {
+        return op == Op::DrawArrays || op == Op::DrawElements || op == Op::DrawElementsIndirect
+               || op == Op::MultiDrawElements || op == Op::BlitFramebuffer;
+    }
+
+    /**
+     * The data of a MultiDrawElements command.
+     */
+    static std::string multiDrawData(const GLsizei * counts,
+                                     const void * const * offsets,
+                                     std::size_t drawCount) {
+        std::string data(drawCount * (sizeof(std::int32_t) + sizeof(std::uint64_t)), '\0');
+        char * out = &data[0];
+        for (std::size_t i = 0; i < drawCount; i++) {
+            std::int32_t count = counts[i];
+            std::memcpy(out + i * sizeof(count), &count, sizeof(count));
+        }
+        out += drawCount * sizeof(std::int32_t);
+        for (std::size_t i = 0; i < drawCount; i++) {
+            std::uint64_t offset = reinterpret_cast<std::uintptr_t>(offsets[i]);
+            std::memcpy(out + i * sizeof(offset), &offset, sizeof(offset));
+        }
+        return data;
+    }
+
+    static const char * name(Op op) {
+        static const char * names[] = {
+            "EndFrame",
+            "Create",
+            "Delete",
+            "BindBuffer",
+            "BindBufferBase",
+            "BufferData",
+            "BufferSubData",
+            "BindVertexArray",
+            "VertexAttrib",
+            "DisableVertexAttrib",
+            "DrawArrays",
+            "DrawElements",
+            "DrawElementsIndirect",
+            "BindTexture",
+            "BindImage",
+            "TexImage",
+            "TexImageMultisample",
+            "TexParameter",
+            "GenerateMipmap",
+            "CreateProgram",
+            "UseProgram",
+            "UniformLocation",
+            "Uniform",
+            "Dispatch",
+            "BindFramebuffer",
+            "FramebufferTexture",
+            "FramebufferRenderbuffer",
+            "BlitFramebuffer",
+            "BindRenderbuffer",
+            "RenderbufferStorage",
+            "State",
+            "MultiDrawElements",
+            "MemoryBarrier",
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == std::size_t(Op::Count),
+                      "a name for every op");
+        return op < Op::Count ? names[std::size_t(op)] : "Unknown";
+    }
+
+private:
+    /**
+     * Record the State if it changed since the last one.
+     */
+    void recordState() {
+        State current = State::current();
+        if (hasState && std::memcmp(&current, &state, sizeof(state)) == 0)
+            return;
+        state = current;
+        hasState = true;
+        append(state);
+    }
+
+    template <typename Command>
+    void append(const Command & command) {
+        static_assert(std::is_trivially_copyable<Command>::value, "commands are copied as bytes");
+        if (usesState(Command::op))
+            recordState();
+        Op op = Command::op;
+        put(&op, sizeof(op));
+        put(&command, sizeof(command));
+    }
+
+    void put(const void * data, std::size_t size) {
+        const char * bytes = static_cast<const char *>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+        if (buffer.size() >= FlushSize)
+            flush();
+    }
+
+    void flush() {
+        file.write(buffer.data(), buffer.size());
+        file.flush();
+        bytes += buffer.size();
+        buffer.clear();
+    }
+};
+
+/**
+ * Record a command while a capture is running, for example
+ * CAPTURE(Capture::BindBuffer {target, buffer}). The arguments are only
+ * evaluated when recording.
+ */
+#define CAPTURE(...)                                                           \
+    do {                                                                       \
+        if (Capture::isRecording())                                            \
+            Capture::get().record(__VA_ARGS__);                                \
+    } while (0)
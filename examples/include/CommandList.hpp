@@ -0,0 +1,370 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "RadixSort.hpp"
+
+/**
+ * Hands out memory by bumping an offset into blocks. reset() rewinds to the
+ * first block and keeps every block, so after the first frames recording
+ * allocates nothing. Only one thread may use an allocator at a time.
+ */
+class LinearAllocator {
+public:
+    static constexpr std::size_t DefaultBlockSize = 256 << 10;
+
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> memory;
+        std::size_t size;
+    };
+
+    std::vector<Block> blocks;
+    std::size_t blockSize;
+    std::size_t current;
+    std::size_t offset;
+    std::size_t used;
+
+public:
+    explicit LinearAllocator(std::size_t blockSize = DefaultBlockSize)
+        : blockSize(blockSize), current(0), offset(0), used(0) {}
+
+    LinearAllocator(LinearAllocator &&) = default;
+    LinearAllocator & operator=(LinearAllocator &&) = default;
+
+    /**
+     * @param align a power of two of at most alignof(std::max_align_t)
+     */
+    void * allocate(std::size_t size, std::size_t align) {
+        while (current < blocks.size()) {
+            std::size_t start = (offset + align - 1) & ~(align - 1);
+            if (start + size <= blocks[current].size) {
+                offset = start + size;
+                used += size;
+                return blocks[current].memory.get() + start;
+            }
+            current++;
+            offset = 0;
+        }
+        // new [] is aligned to max_align_t, a block fits at least size
+        std::size_t bytes = std::max(blockSize, size);
+        blocks.push_back({std::make_unique<unsigned char[]>(bytes), bytes});
+        offset = size;
+        used += size;
+        return blocks.back().memory.get();
+    }
+
+    /**
+     * Free everything at once, previous allocations must not be used again.
+     */
+    void reset() {
+        current = 0;
+        offset = 0;
+        used = 0;
+    }
+
+    /**
+     * The bytes allocated since the last reset().
+     */
+    std::size_t getUsed() const {
+        return used;
+    }
+
+    std::size_t getCapacity() const {
+        std::size_t capacity = 0;
+        for (auto & block : blocks) {
+            capacity += block.size;
+        }
+        return capacity;
+    }
+};
+
+template<typename Context>
+class CommandRecorder;
+
+/**
+ * Commands recorded without a GL context, to be played back later on the
+ * thread that has one.
+ *
+ * A command is a trivially copyable callable taking Context &, like the
+ * commands of RenderThread, with an optional block of data and a 64 bit
+ * sort key. Commands live in the LinearAllocator the list was started with
+ * and are chained in recording order, recording never touches a shared
+ * structure.
+ */
+template<typename Context>
+class alignas(64) CommandList {
+    static constexpr std::size_t Align = 16;
+
+    using Execute = void (*)(Context &, const void * command, const void * data, std::size_t size);
+
+    struct alignas(Align) Packet {
+        Execute execute;
+        Packet * next;
+        std::uint64_t key;
+        std::uint32_t commandSize;
+        std::uint32_t dataSize;
+
+        void run(Context & context) const {
+            const unsigned char * command = reinterpret_cast<const unsigned char *>(this + 1);
+            execute(context, command, command + commandSize, dataSize);
+        }
+    };
+
+    LinearAllocator * allocator;
+    Packet * first;
+    Packet * last;
+    std::size_t count;
+
+    friend class CommandRecorder<Context>;
+
+    static constexpr std::size_t align(std::size_t size) {
+        return (size + Align - 1) & ~(Align - 1);
+    }
+
+    template<typename F>
+    static void call(Context & context, const void * command, const void *, std::size_t) {
+        (*static_cast<const F *>(command))(context);
+    }
+
+    template<typename F>
+    static void callWithData(Context & context,
+                             const void * command,
+                             const void * data,
+                             std::size_t size) {
+        (*static_cast<const F *>(command))(context, data, size);
+    }
+
+    template<typename F>
+    void record(Execute execute,
+                const F & command,
+                const void * data,
+                std::size_t size,
+                std::uint64_t key) {
+        static_assert(std::is_trivially_copyable<F>::value,
+                      "commands are copied as bytes, capture only plain values and handles");
+        static_assert(alignof(F) <= Align, "command alignment");
+
+        const std::size_t commandSize = align(sizeof(F));
+        void * memory = allocator->allocate(sizeof(Packet) + commandSize + size, Align);
+        Packet * packet = new (memory) Packet {execute, nullptr, key, std::uint32_t(commandSize),
+                                               std::uint32_t(size)};
+        unsigned char * bytes = reinterpret_cast<unsigned char *>(packet + 1);
+        std::memcpy(bytes, &command, sizeof(F));
+        if (size > 0)
+            std::memcpy(bytes + commandSize, data, size);
+
+        if (last)
+            last->next = packet;
+        else
+            first = packet;
+        last = packet;
+        count++;
+    }
+
+public:
+    explicit CommandList(LinearAllocator * allocator = nullptr)
+        : allocator(allocator), first(nullptr), last(nullptr), count(0) {}
+
+    /**
+     * Drop the commands and record into allocator from now on.
+     */
+    void begin(LinearAllocator & allocator) {
+        this->allocator = &allocator;
+        first = last = nullptr;
+        count = 0;
+    }
+
+    /**
+     * Record command, called with Context & on playback.
+     *
+     * @param key the order of the command when the lists are sorted
+     */
+    template<typename F>
+    void record(const F & command, std::uint64_t key = 0) {
+        record(&call<F>, command, nullptr, 0, key);
+    }
+
+    /**
+     * Record command with a copy of size bytes of data, called with
+     * Context &, the copy and size on playback.
+     */
+    template<typename F>
+    void record(const F & command, const void * data, std::size_t size, std::uint64_t key = 0) {
+        record(&callWithData<F>, command, data, size, key);
+    }
+
+    std::size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    /**
+     * Run the commands in the order they were recorded.
+     */
+    void play(Context & context) const {
+        for (const Packet * packet = first; packet; packet = packet->next) {
+            packet->run(context);
+        }
+    }
+};
+
+/**
+ * Records CommandLists on the threads of a JobSystem and merges them into
+ * one stream for a single thread to play back.
+ *
+ * Every thread records into a LinearAllocator of its own. Lists are
+ * numbered, and merge() puts them together by number whatever thread
+ * recorded them, so the result is the same on any number of threads. With
+ * sort the merged commands are ordered by key with a stable RadixSort,
+ * equal keys keep the merged order.
+ *
+ * A frame goes reset(), recording, merge() and play(). The commands stay
+ * valid until the next reset(), give each frame in flight a recorder of its
+ * own when a RenderThread plays them back.
+ */
+template<typename Context>
+class CommandRecorder {
+    using Packet = typename CommandList<Context>::Packet;
+
+    struct alignas(64) ThreadAllocator {
+        LinearAllocator allocator;
+    };
+
+    JobSystem * jobs;
+    std::vector<ThreadAllocator> allocators;
+    std::vector<CommandList<Context>> lists;
+
+    std::vector<const Packet *> packets;
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint32_t> order;
+    RadixSort sorter;
+
+public:
+    CommandRecorder() : jobs(nullptr), allocators(1) {}
+
+    CommandRecorder(const CommandRecorder &) = delete;
+    CommandRecorder & operator=(const CommandRecorder &) = delete;
+
+    /**
+     * Drop every command and make room for count lists.
+     *
+     * @param jobs the job system the lists are recorded and sorted on,
+     *             nullptr for the calling thread only
+     */
+    void reset(std::size_t count = 0, JobSystem * jobs = nullptr) {
+        this->jobs = jobs;
+        if (jobs && allocators.size() < jobs->getThreadCount() + 1u)
+            allocators.resize(jobs->getThreadCount() + 1);
+        for (auto & thread : allocators) {
+            thread.allocator.reset();
+        }
+        lists.assign(count, CommandList<Context>());
+        packets.clear();
+        keys.clear();
+        order.clear();
+    }
+
+    std::size_t getListCount() const {
+        return lists.size();
+    }
+
+    /**
+     * Start list number index on the calling thread, which records it.
+     * Lists must be started after reset() and on one thread each, a thread
+     * of the job system given to reset() or the one that called it.
+     */
+    CommandList<Context> & begin(std::size_t index) {
+        unsigned thread = jobs ? jobs->getThreadIndex() : 0;
+        lists[index].begin(allocators[thread].allocator);
+        return lists[index];
+    }
+
+    /**
+     * Record [first, last) in chunks of grain indices, function(list,
+     * begin, end) records chunk number (begin - first) / grain into list.
+     * Starts with reset().
+     *
+     * @param grain the chunk size, 0 for about 8 chunks per thread
+     * @param jobs the job system to record on, nullptr to record on this
+     *             thread
+     */
+    template<typename F>
+    void parallelFor(std::size_t first,
+                     std::size_t last,
+                     std::size_t grain,
+                     F && function,
+                     JobSystem * jobs = nullptr) {
+        PROFILE_SCOPE("CommandRecorder::parallelFor");
+        std::size_t count = last > first ? last - first : 0;
+        unsigned threads = jobs ? jobs->getThreadCount() : 1;
+        if (grain == 0)
+            grain = std::max<std::size_t>(1, count / (threads * 8));
+        reset((count + grain - 1) / grain, jobs);
+        auto chunk = [&](std::size_t begin, std::size_t end) {
+            function(this->begin((begin - first) / grain), begin, end);
+        };
+        if (!jobs) {
+            for (std::size_t begin = first; begin < last; begin += grain) {
+                chunk(begin, std::min(last, begin + grain));
+            }
+            return;
+        }
+        jobs->parallelFor(first, last, grain, chunk);
+    }
+
+    /**
+     * Chain the lists by number, then order the commands by key if sort.
+     *
+     * @return the number of commands
+     */
+    std::size_t merge(bool sort = false) {
+        PROFILE_SCOPE("CommandRecorder::merge");
+        packets.clear();
+        keys.clear();
+        order.clear();
+        for (auto & list : lists) {
+            for (const Packet * packet = list.first; packet; packet = packet->next) {
+                keys.push_back(packet->key);
+                order.push_back(packets.size());
+                packets.push_back(packet);
+            }
+        }
+        if (sort)
+            sorter.sort(keys, order, jobs);
+        return packets.size();
+    }
+
+    /**
+     * Run the merged commands, on the thread with the context.
+     */
+    void play(Context & context) const {
+        PROFILE_SCOPE("CommandRecorder::play");
+        for (auto i : order) {
+            packets[i]->run(context);
+        }
+    }
+
+    /**
+     * The bytes of commands recorded since reset() on every thread.
+     */
+    std::size_t getUsed() const {
+        std::size_t used = 0;
+        for (auto & thread : allocators) {
+            used += thread.allocator.getUsed();
+        }
+        return used;
+    }
+};
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#ifdef OPENGL_DEMO_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <SFML/Graphics.hpp>
+#include <glm/glm.hpp>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "FrameBuffer.hpp"
+
+/**
+ * An OpenGL context and the surface it presents to.
+ *
+ * WindowContext wraps an sf::RenderWindow. HeadlessContext (only available
+ * when built with OPENGL_DEMO_EGL) creates a surfaceless EGL context that
+ * runs without a display server, for example on Mesa llvmpipe. Both make
+ * the context current and initialize GLEW in the constructor, so code that
+ * only uses the Context interface can run on either backend.
+ */
+class Context {
+public:
+    struct Settings {
+        glm::uvec2 size = {800, 600};
+        unsigned int majorVersion = 3;
+        unsigned int minorVersion = 3;
+        bool debug = false;
+        bool vsync = true;
+        unsigned int framerateLimit = 60;
+    };
+
+    virtual ~Context() {}
+
+    virtual glm::uvec2 getSize() const = 0;
+
+    virtual bool isOpen() const = 0;
+
+    virtual void close() = 0;
+
+    /**
+     * Pop the next window event, headless contexts never have events.
+     *
+     * @return true if event was set
+     */
+    virtual bool pollEvent(sf::Event & event) = 0;
+
+    /**
+     * Present the back buffer.
+     */
+    virtual void display() = 0;
+
+    class ContextException : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * Create a headless context if headless is true and EGL support was
+     * compiled in, a window otherwise.
+     *
+     * @throws ContextException if headless is requested but not available
+     */
+    static std::unique_ptr<Context> create(const std::string & title,
+                                           const Settings & settings,
+                                           bool headless);
+};
+
+class WindowContext : public Context {
+    sf::RenderWindow window;
+
+public:
+    WindowContext(const std::string & title, const Settings & settings)
+        : window(sf::VideoMode(settings.size.x, settings.size.y),
+                 title,
+                 sf::Style::Default,
+                 sf::ContextSettings(24,
+                                     1,
+                                     8,
+                                     settings.majorVersion,
+                                     settings.minorVersion,
+                                     settings.debug
+                                         ? sf::ContextSettings::Debug
+                                         : sf::ContextSettings::Default)) {
+        // the SFML limiter sleeps on top of the vsync wait, only use one
+        window.setVerticalSyncEnabled(settings.vsync);
+        window.setFramerateLimit(settings.vsync ? 0 : settings.framerateLimit);
+        window.setActive();
+        window.setKeyRepeatEnabled(false);
+
+        GLenum err = glewInit();
+        if (err != GLEW_OK)
+            throw ContextException(
+                std::string("glewInit failed: ")
+                + reinterpret_cast<const char *>(glewGetErrorString(err)));
+
+        FrameBuffer::setDefault(0, window.getSize().x, window.getSize().y);
+    }
+
+    sf::RenderWindow & getWindow() {
+        return window;
+    }
+
+    glm::uvec2 getSize() const override {
+        return {window.getSize().x, window.getSize().y};
+    }
+
+    bool isOpen() const override {
+        return window.isOpen();
+    }
+
+    void close() override {
+        window.close();
+    }
+
+    bool pollEvent(sf::Event & event) override {
+        if (!window.pollEvent(event))
+            return false;
+        if (event.type == sf::Event::Resized)
+            FrameBuffer::setDefault(0, event.size.width, event.size.height);
+        return true;
+    }
+
+    void display() override {
+        window.display();
+    }
+};
+
+#ifdef OPENGL_DEMO_EGL
+
+/**
+ * A surfaceless EGL context rendering into an offscreen back buffer.
+ *
+ * FrameBuffer::getDefault() is redirected to the back buffer so examples
+ * render to it like they would to a window. Requires the
+ * EGL_MESA_platform_surfaceless and EGL_KHR_surfaceless_context extensions,
+ * set LIBGL_ALWAYS_SOFTWARE=1 to force llvmpipe on machines with a GPU.
+ *
+ * GLEW is initialized with glewContextInit() since glewInit() also
+ * requires a GLX display. Function pointers are resolved through libglvnd
+ * which dispatches to the current EGL context.
+ */
+class HeadlessContext : public Context {
+    EGLDisplay eglDisplay;
+    EGLContext eglContext;
+    glm::uvec2 size;
+    bool open;
+    std::unique_ptr<RenderTarget> backBuffer;
+    std::unique_ptr<RenderBuffer> depthBuffer;
+
+public:
+    HeadlessContext(const Settings & settings)
+        : eglDisplay(EGL_NO_DISPLAY),
+          eglContext(EGL_NO_CONTEXT),
+          size(settings.size),
+          open(true) {
+        auto getPlatformDisplay =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (!getPlatformDisplay)
+            throw ContextException("eglGetPlatformDisplayEXT not supported");
+
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                        EGL_DEFAULT_DISPLAY,
+                                        nullptr);
+        if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, 0, 0))
+            throw ContextException("Failed to initialize EGL display");
+
+        if (!eglBindAPI(EGL_OPENGL_API))
+            throw ContextException("EGL does not support OpenGL");
+
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, //
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, //
+            EGL_NONE,
+        };
+        EGLConfig config;
+        EGLint count = 0;
+        if (!eglChooseConfig(eglDisplay, configAttribs, &config, 1, &count)
+            || count == 0)
+            throw ContextException("No EGL config found");
+
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION,
+            static_cast<EGLint>(settings.majorVersion),
+            EGL_CONTEXT_MINOR_VERSION,
+            static_cast<EGLint>(settings.minorVersion),
+            EGL_CONTEXT_OPENGL_PROFILE_MASK,
+            EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_CONTEXT_OPENGL_DEBUG,
+            settings.debug ? EGL_TRUE : EGL_FALSE,
+            EGL_NONE,
+        };
+        eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT,
+                                      contextAttribs);
+        if (eglContext == EGL_NO_CONTEXT)
+            throw ContextException("Failed to create EGL context");
+
+        if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                            eglContext))
+            throw ContextException("Failed to make EGL context current");
+
+        glewExperimental = true;
+        GLenum err = glewContextInit();
+        if (err != GLEW_OK)
+            throw ContextException(
+                std::string("glewContextInit failed: ")
+                + reinterpret_cast<const char *>(glewGetErrorString(err)));
+
+        backBuffer = std::make_unique<RenderTarget>(
+            size, Texture::RGBA8, Texture::RGBA, GL_UNSIGNED_BYTE);
+        depthBuffer = std::make_unique<RenderBuffer>(size.x, size.y,
+                                                     GL_DEPTH24_STENCIL8);
+        backBuffer->fbo.attach(depthBuffer.get(), GL_DEPTH_STENCIL_ATTACHMENT);
+        FrameBuffer::setDefault(backBuffer->fbo.getBufferId(), size.x, size.y);
+        glViewport(0, 0, size.x, size.y);
+    }
+
+    HeadlessContext(const HeadlessContext &) = delete;
+    HeadlessContext & operator=(const HeadlessContext &) = delete;
+
+    ~HeadlessContext() {
+        FrameBuffer::setDefault(0, 0, 0);
+        depthBuffer.reset();
+        backBuffer.reset();
+        if (eglContext != EGL_NO_CONTEXT) {
+            eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                           EGL_NO_CONTEXT);
+            eglDestroyContext(eglDisplay, eglContext);
+        }
+        if (eglDisplay != EGL_NO_DISPLAY)
+            eglTerminate(eglDisplay);
+    }
+
+    /**
+     * The texture behind FrameBuffer::getDefault().
+     */
+    const Texture & getBackBuffer() const {
+        return backBuffer->texture;
+    }
+
+    glm::uvec2 getSize() const override {
+        return size;
+    }
+
+    bool isOpen() const override {
+        return open;
+    }
+
+    void close() override {
+        open = false;
+    }
+
+    bool pollEvent(sf::Event &) override {
+        return false;
+    }
+
+    void display() override {
+        glFlush();
+    }
+};
+
+#endif
+
+inline std::unique_ptr<Context> Context::create(const std::string & title,
+                                                const Settings & settings,
+                                                bool headless) {
+    if (headless) {
+#ifdef OPENGL_DEMO_EGL
+        return std::make_unique<HeadlessContext>(settings);
+#else
+        throw ContextException("Built without headless (EGL) support");
+#endif
+    }
+    return std::make_unique<WindowContext>(title, settings);
+}
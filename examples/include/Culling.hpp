@@ -0,0 +1,552 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "simd.hpp"
+
+/**
+ * Six planes with normals pointing inside, a point p is inside when
+ * dot(plane.xyz, p) + plane.w >= 0 for every plane.
+ */
+struct Frustum {
+    glm::vec4 planes[6];
+
+    /**
+     * Extract the planes of a view projection matrix (Gribb / Hartmann).
+     */
+    static Frustum fromMatrix(const glm::mat4 & viewProjection) {
+        const glm::mat4 & m = viewProjection;
+        glm::vec4 row[4];
+        for (int r = 0; r < 4; r++) {
+            row[r] = {m[0][r], m[1][r], m[2][r], m[3][r]};
+        }
+
+        Frustum frustum {{
+            row[3] + row[0], // left
+            row[3] - row[0], // right
+            row[3] + row[1], // bottom
+            row[3] - row[1], // top
+            row[3] + row[2], // near
+            row[3] - row[2], // far
+        }};
+        for (auto & plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    bool intersects(const glm::vec3 & center, float radius) const {
+        for (auto & plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    bool intersects(const glm::vec3 & min, const glm::vec3 & max) const {
+        glm::vec3 center = (min + max) * 0.5f;
+        glm::vec3 extents = (max - min) * 0.5f;
+        for (auto & plane : planes) {
+            glm::vec3 normal(plane);
+            float d = glm::dot(normal, center) + plane.w;
+            if (d < -glm::dot(glm::abs(normal), extents))
+                return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * Bounding spheres in SoA form, padded to a multiple of 8 entries.
+ */
+class SphereBounds {
+    std::vector<float> x, y, z, radius;
+    std::size_t count;
+
+    friend class FrustumCuller;
+
+public:
+    SphereBounds() : count(0) {}
+
+    std::size_t size() const {
+        return count;
+    }
+
+    void clear() {
+        count = 0;
+        for (auto * a : {&x, &y, &z, &radius}) {
+            a->clear();
+        }
+    }
+
+    std::size_t add(const glm::vec3 & center, float r) {
+        std::size_t i = count++;
+        if (i == x.size()) {
+            for (auto * a : {&x, &y, &z, &radius}) {
+                a->resize(i + 8, 0.0f);
+            }
+        }
+        set(i, center, r);
+        return i;
+    }
+
+    void set(std::size_t i, const glm::vec3 & center, float r) {
+        x[i] = center.x;
+        y[i] = center.y;
+        z[i] = center.z;
+        radius[i] = r;
+    }
+
+    glm::vec3 getCenter(std::size_t i) const {
+        return {x[i], y[i], z[i]};
+    }
+
+    float getRadius(std::size_t i) const {
+        return radius[i];
+    }
+};
+
+/**
+ * Axis aligned bounding boxes in SoA form as center and half extents,
+ * padded to a multiple of 8 entries.
+ */
+class BoxBounds {
+    std::vector<float> cx, cy, cz, ex, ey, ez;
+    std::size_t count;
+
+    friend class FrustumCuller;
+
+public:
+    BoxBounds() : count(0) {}
+
+    std::size_t size() const {
+        return count;
+    }
+
+    void clear() {
+        count = 0;
+        for (auto * a : {&cx, &cy, &cz, &ex, &ey, &ez}) {
+            a->clear();
+        }
+    }
+
+    std::size_t add(const glm::vec3 & min, const glm::vec3 & max) {
+        std::size_t i = count++;
+        if (i == cx.size()) {
+            for (auto * a : {&cx, &cy, &cz, &ex, &ey, &ez}) {
+                a->resize(i + 8, 0.0f);
+            }
+        }
+        set(i, min, max);
+        return i;
+    }
+
+    void set(std::size_t i, const glm::vec3 & min, const glm::vec3 & max) {
+        glm::vec3 center = (min + max) * 0.5f;
+        glm::vec3 extents = (max - min) * 0.5f;
+        cx[i] = center.x;
+        cy[i] = center.y;
+        cz[i] = center.z;
+        ex[i] = extents.x;
+        ey[i] = extents.y;
+        ez[i] = extents.z;
+    }
+
+    glm::vec3 getMin(std::size_t i) const {
+        return glm::vec3(cx[i], cy[i], cz[i]) - glm::vec3(ex[i], ey[i], ez[i]);
+    }
+
+    glm::vec3 getMax(std::size_t i) const {
+        return glm::vec3(cx[i], cy[i], cz[i]) + glm::vec3(ex[i], ey[i], ez[i]);
+    }
+};
+
+/**
+ * Test bounding volumes against a frustum SIMD_WIDTH at a time and write
+ * the indices of the visible ones to a compact list.
+ *
+ * Large sets are split into chunks culled on separate threads or on the
+ * workers of a JobSystem. Each chunk compacts into its own range of the
+ * output which is then packed together, so the result is always in
+ * ascending order.
+ */
+class FrustumCuller {
+public:
+    /**
+     * Chunks smaller than this are not worth a thread.
+     */
+    static constexpr std::size_t MinChunk = 16384;
+
+    /**
+     * Cull spheres against frustum.
+     *
+     * @param visible an array of at least bounds.size() indices
+     * @param threads the number of threads, 0 for one per core
+     *
+     * @return the number of indices written to visible
+     */
+    static std::size_t cull(const Frustum & frustum,
+                            const SphereBounds & bounds,
+                            std::uint32_t * visible,
+                            unsigned threads = 0) {
+        return cullParallel(frustum, bounds, visible, threads);
+    }
+
+    /**
+     * Cull boxes against frustum.
+     *
+     * @param visible an array of at least bounds.size() indices
+     * @param threads the number of threads, 0 for one per core
+     *
+     * @return the number of indices written to visible
+     */
+    static std::size_t cull(const Frustum & frustum,
+                            const BoxBounds & bounds,
+                            std::uint32_t * visible,
+                            unsigned threads = 0) {
+        return cullParallel(frustum, bounds, visible, threads);
+    }
+
+    /**
+     * Cull spheres against frustum, spreading chunks of MinChunk spheres
+     * over the threads of jobs.
+     *
+     * @param visible an array of at least bounds.size() indices
+     *
+     * @return the number of indices written to visible
+     */
+    static std::size_t cull(const Frustum & frustum,
+                            const SphereBounds & bounds,
+                            std::uint32_t * visible,
+                            JobSystem & jobs) {
+        return cullJobs(frustum, bounds, visible, jobs);
+    }
+
+    /**
+     * Cull boxes against frustum, spreading chunks of MinChunk boxes over
+     * the threads of jobs.
+     *
+     * @param visible an array of at least bounds.size() indices
+     *
+     * @return the number of indices written to visible
+     */
+    static std::size_t cull(const Frustum & frustum,
+                            const BoxBounds & bounds,
+                            std::uint32_t * visible,
+                            JobSystem & jobs) {
+        return cullJobs(frustum, bounds, visible, jobs);
+    }
+
+    /**
+     * Copy the entries of src selected by indices to dst, for example to
+     * fill an instance buffer with only the visible instances.
+     */
+    template<typename T>
+    static void gather(const T * src,
+                       const std::uint32_t * indices,
+                       std::size_t count,
+                       T * dst) {
+        for (std::size_t i = 0; i < count; i++) {
+            dst[i] = src[indices[i]];
+        }
+    }
+
+private:
+#if SIMD_WIDTH == 8
+    using Lanes = __m256;
+#elif SIMD_WIDTH == 4
+    using Lanes = __m128;
+#else
+    using Lanes = float;
+#endif
+
+    /**
+     * Plane components broadcast to every lane.
+     */
+    struct PlaneLanes {
+        Lanes n[6][3];
+        Lanes absN[6][3];
+        Lanes w[6];
+    };
+
+    static PlaneLanes broadcast(const Frustum & frustum) {
+        PlaneLanes lanes;
+        for (int p = 0; p < 6; p++) {
+            for (int c = 0; c < 3; c++) {
+                float v = frustum.planes[p][c];
+                lanes.n[p][c] = splat(v);
+                lanes.absN[p][c] = splat(std::abs(v));
+            }
+            lanes.w[p] = splat(frustum.planes[p].w);
+        }
+        return lanes;
+    }
+
+    template<typename Bounds>
+    static std::size_t cullParallel(const Frustum & frustum,
+                                    const Bounds & bounds,
+                                    std::uint32_t * visible,
+                                    unsigned threads) {
+        const PlaneLanes planes = broadcast(frustum);
+        const std::size_t count = bounds.size();
+
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min<std::size_t>(threads,
+                                        std::max<std::size_t>(1, count / MinChunk));
+        if (threads <= 1)
+            return cullRange(planes, bounds, 0, count, visible);
+
+        // chunks are a multiple of 8 so no block straddles two chunks
+        std::size_t chunk = ((count + threads - 1) / threads + 7) / 8 * 8;
+        std::vector<std::size_t> found(threads, 0);
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                std::size_t begin = t * chunk;
+                std::size_t end = std::min(count, begin + chunk);
+                if (begin < end)
+                    found[t] = cullRange(planes, bounds, begin, end,
+                                         visible + begin);
+            });
+        }
+        found[0] = cullRange(planes, bounds, 0, std::min(count, chunk), visible);
+        for (auto & worker : workers) {
+            worker.join();
+        }
+        return pack(visible, found, chunk);
+    }
+
+    template<typename Bounds>
+    static std::size_t cullJobs(const Frustum & frustum,
+                                const Bounds & bounds,
+                                std::uint32_t * visible,
+                                JobSystem & jobs) {
+        const PlaneLanes planes = broadcast(frustum);
+        const std::size_t count = bounds.size();
+        const std::size_t chunks = (count + MinChunk - 1) / MinChunk;
+
+        std::vector<std::size_t> found(chunks, 0);
+        jobs.parallelFor(0, chunks, 1, [&](std::size_t first, std::size_t last) {
+            for (std::size_t c = first; c < last; c++) {
+                std::size_t begin = c * MinChunk;
+                std::size_t end = std::min(count, begin + MinChunk);
+                found[c] = cullRange(planes, bounds, begin, end, visible + begin);
+            }
+        });
+        return pack(visible, found, MinChunk);
+    }
+
+    /**
+     * Move the results of chunk c, found[c] indices at visible + c * chunk,
+     * together at the front of visible.
+     */
+    static std::size_t pack(std::uint32_t * visible,
+                            const std::vector<std::size_t> & found,
+                            std::size_t chunk) {
+        std::size_t n = found.empty() ? 0 : found[0];
+        for (std::size_t c = 1; c < found.size(); c++) {
+            if (found[c])
+                std::memmove(visible + n, visible + c * chunk,
+                             found[c] * sizeof(std::uint32_t));
+            n += found[c];
+        }
+        return n;
+    }
+
+    /**
+     * Cull [begin, end) into out, begin must be a multiple of 8. Full blocks
+     * store a whole register of indices so out must have room for
+     * end - begin entries.
+     */
+    template<typename Bounds>
+    static std::size_t cullRange(const PlaneLanes & planes,
+                                 const Bounds & bounds,
+                                 std::size_t begin,
+                                 std::size_t end,
+                                 std::uint32_t * out) {
+        std::size_t n = 0;
+        for (std::size_t i = begin; i < end; i += SIMD_WIDTH) {
+            unsigned mask = visibleMask(planes, bounds, i);
+#if SIMD_WIDTH == 8
+            if (end - i >= 8) {
+                // left pack the indices of the set lanes with one permute
+                __m256i lanes = _mm256_load_si256(
+                    reinterpret_cast<const __m256i *>(compactTable().lanes[mask]));
+                __m256i indices =
+                    _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(i)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + n), indices);
+                n += popcount(mask);
+                continue;
+            }
+#endif
+            if (end - i < SIMD_WIDTH)
+                mask &= (1u << (end - i)) - 1;
+            while (mask) {
+                out[n++] = static_cast<std::uint32_t>(i + lowestBit(mask));
+                mask &= mask - 1;
+            }
+        }
+        return n;
+    }
+
+#if SIMD_WIDTH == 8
+
+    static Lanes splat(float v) {
+        return _mm256_set1_ps(v);
+    }
+
+    static unsigned visibleMask(const PlaneLanes & p,
+                                const SphereBounds & b,
+                                std::size_t i) {
+        __m256 x = _mm256_loadu_ps(&b.x[i]);
+        __m256 y = _mm256_loadu_ps(&b.y[i]);
+        __m256 z = _mm256_loadu_ps(&b.z[i]);
+        __m256 r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&b.radius[i]));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int k = 0; k < 6; k++) {
+            __m256 d = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(p.n[k][0], x), _mm256_mul_ps(p.n[k][1], y)),
+                _mm256_add_ps(_mm256_mul_ps(p.n[k][2], z), p.w[k]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, r, _CMP_GE_OQ));
+        }
+        return _mm256_movemask_ps(inside);
+    }
+
+    static unsigned visibleMask(const PlaneLanes & p,
+                                const BoxBounds & b,
+                                std::size_t i) {
+        __m256 x = _mm256_loadu_ps(&b.cx[i]);
+        __m256 y = _mm256_loadu_ps(&b.cy[i]);
+        __m256 z = _mm256_loadu_ps(&b.cz[i]);
+        __m256 ex = _mm256_loadu_ps(&b.ex[i]);
+        __m256 ey = _mm256_loadu_ps(&b.ey[i]);
+        __m256 ez = _mm256_loadu_ps(&b.ez[i]);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int k = 0; k < 6; k++) {
+            __m256 d = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(p.n[k][0], x), _mm256_mul_ps(p.n[k][1], y)),
+                _mm256_add_ps(_mm256_mul_ps(p.n[k][2], z), p.w[k]));
+            // projected radius of the box onto the plane normal
+            __m256 r = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(p.absN[k][0], ex),
+                              _mm256_mul_ps(p.absN[k][1], ey)),
+                _mm256_mul_ps(p.absN[k][2], ez));
+            inside = _mm256_and_ps(
+                inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        return _mm256_movemask_ps(inside);
+    }
+
+    /**
+     * For every 8 bit lane mask, the numbers of the set lanes packed to the
+     * front.
+     */
+    struct CompactTable {
+        alignas(32) std::uint32_t lanes[256][8];
+
+        CompactTable() {
+            for (unsigned mask = 0; mask < 256; mask++) {
+                unsigned n = 0;
+                for (unsigned lane = 0; lane < 8; lane++) {
+                    if (mask & (1u << lane))
+                        lanes[mask][n++] = lane;
+                }
+                while (n < 8) {
+                    lanes[mask][n++] = 0;
+                }
+            }
+        }
+    };
+
+    static const CompactTable & compactTable() {
+        static const CompactTable table;
+        return table;
+    }
+
+#elif SIMD_WIDTH == 4
+
+    static Lanes splat(float v) {
+        return _mm_set1_ps(v);
+    }
+
+    static unsigned visibleMask(const PlaneLanes & p,
+                                const SphereBounds & b,
+                                std::size_t i) {
+        __m128 x = _mm_loadu_ps(&b.x[i]);
+        __m128 y = _mm_loadu_ps(&b.y[i]);
+        __m128 z = _mm_loadu_ps(&b.z[i]);
+        __m128 r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&b.radius[i]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int k = 0; k < 6; k++) {
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(p.n[k][0], x), _mm_mul_ps(p.n[k][1], y)),
+                _mm_add_ps(_mm_mul_ps(p.n[k][2], z), p.w[k]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, r));
+        }
+        return _mm_movemask_ps(inside);
+    }
+
+    static unsigned visibleMask(const PlaneLanes & p,
+                                const BoxBounds & b,
+                                std::size_t i) {
+        __m128 x = _mm_loadu_ps(&b.cx[i]);
+        __m128 y = _mm_loadu_ps(&b.cy[i]);
+        __m128 z = _mm_loadu_ps(&b.cz[i]);
+        __m128 ex = _mm_loadu_ps(&b.ex[i]);
+        __m128 ey = _mm_loadu_ps(&b.ey[i]);
+        __m128 ez = _mm_loadu_ps(&b.ez[i]);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int k = 0; k < 6; k++) {
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(p.n[k][0], x), _mm_mul_ps(p.n[k][1], y)),
+                _mm_add_ps(_mm_mul_ps(p.n[k][2], z), p.w[k]));
+            __m128 r = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(p.absN[k][0], ex), _mm_mul_ps(p.absN[k][1], ey)),
+                _mm_mul_ps(p.absN[k][2], ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+        }
+        return _mm_movemask_ps(inside);
+    }
+
+#else
+
+    static Lanes splat(float v) {
+        return v;
+    }
+
+    static unsigned visibleMask(const PlaneLanes & p,
+                                const SphereBounds & b,
+                                std::size_t i) {
+        for (int k = 0; k < 6; k++) {
+            float d = p.n[k][0] * b.x[i] + p.n[k][1] * b.y[i]
+                      + p.n[k][2] * b.z[i] + p.w[k];
+            if (d < -b.radius[i])
+                return 0;
+        }
+        return 1;
+    }
+
+    static unsigned visibleMask(const PlaneLanes & p,
+                                const BoxBounds & b,
+                                std::size_t i) {
+        for (int k = 0; k < 6; k++) {
+            float d = p.n[k][0] * b.cx[i] + p.n[k][1] * b.cy[i]
+                      + p.n[k][2] * b.cz[i] + p.w[k];
+            float r = p.absN[k][0] * b.ex[i] + p.absN[k][1] * b.ey[i]
+                      + p.absN[k][2] * b.ez[i];
+            if (d + r < 0)
+                return 0;
+        }
+        return 1;
+    }
+
+#endif
+};
@@ -10,6 +10,8 @@
 #include <stdexcept>
 #include <vector>
 
+#include "Capture.hpp"
+#include "RenderStats.hpp"
 #include "Texture.hpp"
 
 class RenderBuffer {
@@ -21,6 +23,7 @@ public:
     RenderBuffer(int width, int height, GLenum internal)
         : internal(internal), width(width), height(height) {
         glGenRenderbuffers(1, &buffer);
+        CAPTURE(Capture::Create {Capture::RenderbufferObject, buffer});
         resize(width, height);
     }
 
@@ -45,8 +48,10 @@ public:
     RenderBuffer & operator=(const RenderBuffer &) = delete;
 
     ~RenderBuffer() {
-        if (buffer)
+        if (buffer) {
+            CAPTURE(Capture::Delete {Capture::RenderbufferObject, buffer});
             glDeleteRenderbuffers(1, &buffer);
+        }
     }
 
     GLuint getBufferId() const {
@@ -65,14 +70,17 @@ public:
         this->width = width;
         this->height = height;
         bind();
+        CAPTURE(Capture::RenderbufferStorage {internal, width, height});
         glRenderbufferStorage(GL_RENDERBUFFER, internal, width, height);
     }
 
     void bind() const {
+        CAPTURE(Capture::BindRenderbuffer {buffer});
         glBindRenderbuffer(GL_RENDERBUFFER, buffer);
     }
 
     void unbind() const {
+        CAPTURE(Capture::BindRenderbuffer {0});
         glBindRenderbuffer(GL_RENDERBUFFER, 0);
     }
 };
@@ -109,11 +117,12 @@ class FrameBuffer {
     std::vector<Attachment> attachments;
     int width, height;
 
-    FrameBuffer(GLuint buffer) : buffer(buffer) {}
+    FrameBuffer(GLuint buffer) : buffer(buffer), width(0), height(0) {}
 
 public:
     FrameBuffer(int width, int height) : width(width), height(height) {
         glGenFramebuffers(1, &buffer);
+        CAPTURE(Capture::Create {Capture::FramebufferObject, buffer});
         bind();
     }
 
@@ -138,8 +147,10 @@ public:
     FrameBuffer & operator=(const FrameBuffer &) = delete;
 
     ~FrameBuffer() {
-        if (buffer)
+        if (buffer) {
+            CAPTURE(Capture::Delete {Capture::FramebufferObject, buffer});
             glDeleteFramebuffers(1, &buffer);
+        }
     }
 
     GLuint getBufferId() const {
@@ -151,6 +162,8 @@ public:
             throw std::runtime_error("Attachment size does not match");
 
         attachments.emplace_back(texture, attachment);
+        CAPTURE(Capture::FramebufferTexture {attachment, texture->getTarget(),
+                                             texture->getTextureId()});
         glFramebufferTexture2D(GL_FRAMEBUFFER,
                                attachment,
                                texture->getTarget(),
@@ -164,6 +177,7 @@ public:
             throw std::runtime_error("Attachment size does not match");
 
         attachments.emplace_back(buffer, attachment);
+        CAPTURE(Capture::FramebufferRenderbuffer {attachment, buffer->getBufferId()});
         glFramebufferRenderbuffer(GL_FRAMEBUFFER,
                                   attachment,
                                   GL_RENDERBUFFER,
@@ -191,11 +205,14 @@ public:
     }
 
     void bind(GLenum target = GL_FRAMEBUFFER) const {
+        RenderStats::current().framebufferBinds++;
+        // the default is recorded as 0 even when a context redirects it
+        CAPTURE(Capture::BindFramebuffer {target, this == &getDefault() ? 0 : buffer});
         glBindFramebuffer(target, buffer);
     }
 
     void unbind() const {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        getDefault().bind();
     }
 
     void blit(const FrameBuffer & source,
@@ -203,6 +220,8 @@ public:
               GLenum filter = GL_NEAREST) const {
         source.bind(GL_READ_FRAMEBUFFER);
         bind(GL_DRAW_FRAMEBUFFER);
+        RenderStats::current().blits++;
+        CAPTURE(Capture::BlitFramebuffer {source.width, source.height, width, height, mask, filter});
         glBlitFramebuffer(0, 0, source.width, source.height, //
                           0, 0, width, height, //
                           mask, filter);
@@ -212,4 +231,67 @@ public:
         static FrameBuffer buffer(0);
         return buffer;
     }
+
+    /**
+     * Redirect getDefault() to another frame buffer object. Contexts
+     * without a window system frame buffer use this to provide their own
+     * back buffer. Call setDefault(0, 0, 0) before the object is deleted.
+     *
+     * @param buffer the frame buffer object id
+     * @param width the width in pixels
+     * @param height the height in pixels
+     */
+    static void setDefault(GLuint buffer, int width, int height) {
+        auto & fbo = getDefault();
+        fbo.buffer = buffer;
+        fbo.width = width;
+        fbo.height = height;
+    }
+};
+
+/**
+ * A frame buffer with a single color texture attachment.
+ *
+ * The frame buffer keeps a pointer to the texture so a RenderTarget can not
+ * be moved, keep it in a std::unique_ptr if it needs to be stored.
+ */
+struct RenderTarget {
+    Texture texture;
+    FrameBuffer fbo;
+
+    /**
+     * Create a texture without mipmaps and attach it as color attachment 0.
+     *
+     * @param size the size in pixels
+     * @param internal the internal format of the texture
+     * @param format the format of pixel data
+     * @param type the data type of pixel data
+     */
+    RenderTarget(const glm::uvec2 & size,
+                 Texture::Format internal = Texture::RGBA16F,
+                 Texture::Format format = Texture::RGBA,
+                 GLenum type = GL_FLOAT)
+        : texture(size,
+                  internal,
+                  format,
+                  type,
+                  0,
+                  Texture::Linear,
+                  Texture::Linear,
+                  Texture::Clamp,
+                  false),
+          fbo(size.x, size.y) {
+        fbo.attach(&texture, GL_COLOR_ATTACHMENT0);
+    }
+
+    RenderTarget(const RenderTarget &) = delete;
+    RenderTarget & operator=(const RenderTarget &) = delete;
+
+    const glm::uvec2 & getSize() const {
+        return texture.getSize();
+    }
+
+    void resize(const glm::uvec2 & size) {
+        fbo.resize(size.x, size.y);
+    }
 };
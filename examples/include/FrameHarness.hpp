@@ -0,0 +1,490 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+// REMEMBER TO DEFINE STB_IMAGE_IMPLEMENTATION and
+// STB_IMAGE_WRITE_IMPLEMENTATION in main.cpp
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include <SFML/Window.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "Capture.hpp"
+
+/**
+ * Runs an example for a fixed number of frames and checks it for frame time
+ * and image regressions.
+ *
+ * Without --frames the harness is inactive and every call does nothing, so
+ * examples stay interactive. With it the example renders that many frames
+ * with vsync off and a fixed time step, then finish():
+ *
+ * - writes the CPU and GPU frame time percentiles and the peak memory as
+ *   JSON (--report)
+ * - writes the final frame as PNG (--output) and compares it to --golden,
+ *   a pixel differs when a channel is off by more than --tolerance, at most
+ *   --max-diff of the pixels may differ
+ * - fails when p50 or p95 of the CPU or GPU time, or the peak memory, is
+ *   more than --threshold above --baseline, a report of an earlier run on
+ *   the same machine
+ *
+ * --record writes the golden image and the baseline from the run instead of
+ * comparing. A missing baseline is written the same way, a missing golden
+ * image skips the comparison and finish() returns Skipped. Failing to write
+ * an image or a report fails the run. The first Warmup frames are left out of the
+ * statistics.
+ *
+ * The loop of an example becomes:
+ *
+ *     harness.beginFrame();      // after handling events
+ *     ...render...
+ *     harness.endFrame();        // before display()
+ *     window.display();
+ *     if (harness.isDone())
+ *         window.close();
+ *
+ * and main() ends with return harness.finish().
+ */
+class FrameHarness {
+public:
+    // the exit code of a run without a golden image, CTest's SKIP_RETURN_CODE
+    static constexpr int Skipped = 77;
+
+    struct Percentiles {
+        double p50 = 0;
+        double p95 = 0;
+        double p99 = 0;
+    };
+
+    struct Report {
+        std::size_t frames = 0;
+        // milliseconds
+        Percentiles cpu;
+        Percentiles gpu;
+        // bytes
+        std::uint64_t peakMemory = 0;
+        // the fraction of pixels that differ from the golden image
+        double imageDifference = 0;
+    };
+
+private:
+    std::string name;
+    std::size_t frames;
+    std::size_t warmup;
+    std::string output;
+    std::string golden;
+    std::string baseline;
+    std::string reportPath;
+    int tolerance;
+    double maxDifference;
+    double threshold;
+    bool record;
+    bool skipped;
+
+    std::size_t frame;
+    glm::uvec2 size;
+    GLuint framebuffer;
+    GLuint queries[2];
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    std::vector<unsigned char> image;
+
+public:
+    /**
+     * Parse the harness options from the command line, other arguments are
+     * left to the example.
+     */
+    FrameHarness(int argc, char ** argv)
+        : frames(0),
+          warmup(10),
+          tolerance(8),
+          maxDifference(0.001),
+          threshold(0.25),
+          record(false),
+          skipped(false),
+          frame(0),
+          size(0),
+          framebuffer(0),
+          queries {0, 0} {
+        name = argc > 0 ? argv[0] : "example";
+        name = name.substr(name.find_last_of("/\\") + 1);
+        output = name + ".png";
+        reportPath = name + ".json";
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            std::string value = i + 1 < argc ? argv[i + 1] : "";
+            if (arg == "--record") {
+                record = true;
+                continue;
+            }
+            if (arg.compare(0, 2, "--") != 0 || i + 1 >= argc)
+                continue;
+            if (arg == "--frames")
+                frames = std::strtoul(value.c_str(), nullptr, 10);
+            else if (arg == "--warmup")
+                warmup = std::strtoul(value.c_str(), nullptr, 10);
+            else if (arg == "--output")
+                output = value;
+            else if (arg == "--golden")
+                golden = value;
+            else if (arg == "--baseline")
+                baseline = value;
+            else if (arg == "--report")
+                reportPath = value;
+            else if (arg == "--tolerance")
+                tolerance = std::atoi(value.c_str());
+            else if (arg == "--max-diff")
+                maxDifference = std::atof(value.c_str());
+            else if (arg == "--threshold")
+                threshold = std::atof(value.c_str());
+            else
+                continue;
+            i++;
+        }
+        warmup = std::min(warmup, frames / 2);
+    }
+
+    FrameHarness(const FrameHarness &) = delete;
+    FrameHarness & operator=(const FrameHarness &) = delete;
+
+    ~FrameHarness() {
+        if (queries[0])
+            glDeleteQueries(2, queries);
+    }
+
+    /**
+     * Whether arg is an option rather than a positional argument, for
+     * examples that take positional arguments.
+     */
+    static bool isOption(const char * arg) {
+        return arg[0] == '-' && arg[1] == '-';
+    }
+
+    bool isActive() const {
+        return frames > 0;
+    }
+
+    std::size_t getFrameCount() const {
+        return frames;
+    }
+
+    bool isDone() const {
+        return isActive() && frame >= frames;
+    }
+
+    /**
+     * Read the final frame from the back buffer of window and turn off
+     * vsync and the frame limit.
+     */
+    void attach(sf::Window & window) {
+        if (!isActive())
+            return;
+        window.setVerticalSyncEnabled(false);
+        window.setFramerateLimit(0);
+        attach(glm::uvec2(window.getSize().x, window.getSize().y), 0);
+    }
+
+    /**
+     * Read the final frame from the first color attachment of framebuffer,
+     * or from the back buffer if it is 0.
+     */
+    void attach(const glm::uvec2 & size, GLuint framebuffer) {
+        this->size = size;
+        this->framebuffer = framebuffer;
+    }
+
+    /**
+     * The time to animate with: seconds when inactive, a fixed 60 Hz step
+     * per frame otherwise so the final frame is always the same.
+     */
+    float getTime(float seconds) const {
+        return isActive() ? frame / 60.0f : seconds;
+    }
+
+    void beginFrame() {
+        if (!isActive())
+            return;
+        if (!queries[0])
+            glGenQueries(2, queries);
+        frameStart = std::chrono::steady_clock::now();
+        glQueryCounter(queries[0], GL_TIMESTAMP);
+    }
+
+    /**
+     * Wait for the frame to finish and time it, the last frame is read
+     * back. Also ends the frame of a running Capture. Call before the back
+     * buffer is presented.
+     */
+    void endFrame() {
+        Capture::get().endFrame();
+        if (!isActive() || isDone())
+            return;
+        glQueryCounter(queries[1], GL_TIMESTAMP);
+        glFinish();
+        auto end = std::chrono::steady_clock::now();
+        GLuint64 begin = 0, finish = 0;
+        glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &finish);
+
+        if (frame >= warmup) {
+            cpuTimes.push_back(std::chrono::duration<double, std::milli>(end - frameStart).count());
+            gpuTimes.push_back((finish - begin) / 1e6);
+        }
+        frame++;
+        if (isDone())
+            readImage();
+    }
+
+    /**
+     * Write the report and the final frame and compare them to the golden
+     * image and the baseline.
+     *
+     * @return the exit code, 0 if inactive or nothing regressed, Skipped
+     *         if nothing regressed but there was no golden image
+     */
+    int finish() {
+        if (!isActive())
+            return 0;
+
+        Report report;
+        report.frames = frame;
+        report.cpu = percentiles(cpuTimes);
+        report.gpu = percentiles(gpuTimes);
+        report.peakMemory = peakMemory();
+
+        bool passed = frame == frames;
+        if (!passed)
+            std::cerr << name << ": stopped after " << frame << " of " << frames << " frames"
+                      << std::endl;
+
+        if (!image.empty()) {
+            flipRows(image);
+            // the rows are flipped already, the flag is global and examples
+            // such as 12_batch turn it on for their own images
+            stbi_flip_vertically_on_write(0);
+            if (!stbi_write_png(output.c_str(), size.x, size.y, 4, image.data(), size.x * 4)) {
+                std::cerr << name << ": could not write " << output << std::endl;
+                passed = false;
+            }
+            if (!golden.empty())
+                passed &= compareImage(report);
+        }
+
+        if (!writeReport(reportPath, report)) {
+            std::cerr << name << ": could not write " << reportPath << std::endl;
+            passed = false;
+        }
+        if (!baseline.empty())
+            passed &= compareBaseline(report);
+
+        std::cout << std::fixed << std::setprecision(3) << name << ": " << report.frames
+                  << " frames, cpu p50 " << report.cpu.p50 << " p95 " << report.cpu.p95
+                  << " p99 " << report.cpu.p99 << " ms, gpu p50 " << report.gpu.p50 << " p95 "
+                  << report.gpu.p95 << " p99 " << report.gpu.p99 << " ms, peak memory "
+                  << report.peakMemory / (1024 * 1024) << " MiB, "
+                  << (!passed ? "FAILED" : skipped ? "skipped" : "passed") << std::endl;
+        if (!passed)
+            return 1;
+        return skipped ? Skipped : 0;
+    }
+
+    static Percentiles percentiles(std::vector<double> times) {
+        Percentiles p;
+        if (times.empty())
+            return p;
+        std::sort(times.begin(), times.end());
+        auto at = [&](double q) {
+            std::size_t i = std::size_t(std::ceil(q * times.size())) - 1;
+            return times[std::min(i, times.size() - 1)];
+        };
+        p.p50 = at(0.50);
+        p.p95 = at(0.95);
+        p.p99 = at(0.99);
+        return p;
+    }
+
+    /**
+     * The peak resident memory of the process in bytes, 0 where unknown.
+     */
+    static std::uint64_t peakMemory() {
+#if defined(__unix__) || defined(__APPLE__)
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+        return usage.ru_maxrss;
+#else
+        return std::uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#else
+        return 0;
+#endif
+    }
+
+private:
+    void readImage() {
+        if (size.x == 0 || size.y == 0)
+            return;
+        GLint previous = 0;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glReadBuffer(framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        image.resize(std::size_t(size.x) * size.y * 4);
+        glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+    }
+
+    /**
+     * GL rows start at the bottom, images at the top.
+     */
+    void flipRows(std::vector<unsigned char> & pixels) const {
+        std::size_t row = std::size_t(size.x) * 4;
+        for (std::size_t y = 0; y < size.y / 2; y++) {
+            std::swap_ranges(pixels.begin() + y * row, pixels.begin() + (y + 1) * row,
+                             pixels.begin() + (size.y - 1 - y) * row);
+        }
+    }
+
+    /**
+     * Compare the final frame with the golden image, or write it with
+     * --record. Without a golden image the comparison is skipped.
+     */
+    bool compareImage(Report & report) {
+        if (record) {
+            if (!stbi_write_png(golden.c_str(), size.x, size.y, 4, image.data(), size.x * 4)) {
+                std::cerr << name << ": could not record " << golden << std::endl;
+                return false;
+            }
+            std::cout << name << ": recorded " << golden << std::endl;
+            return true;
+        }
+        int w = 0, h = 0, n = 0;
+        unsigned char * reference = stbi_load(golden.c_str(), &w, &h, &n, 4);
+        if (!reference) {
+            std::cerr << name << ": no golden image " << golden << ", record it with --record"
+                      << std::endl;
+            skipped = true;
+            return true;
+        }
+
+        bool sameSize = unsigned(w) == size.x && unsigned(h) == size.y;
+        std::size_t different = 0;
+        if (sameSize) {
+            for (std::size_t i = 0; i < image.size(); i += 4) {
+                for (std::size_t c = 0; c < 3; c++) {
+                    if (std::abs(int(image[i + c]) - int(reference[i + c])) > tolerance) {
+                        different++;
+                        break;
+                    }
+                }
+            }
+        }
+        stbi_image_free(reference);
+
+        if (!sameSize) {
+            std::cerr << name << ": " << golden << " is " << w << "x" << h << ", the frame is "
+                      << size.x << "x" << size.y << std::endl;
+            report.imageDifference = 1;
+            return false;
+        }
+        report.imageDifference = double(different) / (std::size_t(size.x) * size.y);
+        if (report.imageDifference <= maxDifference)
+            return true;
+        std::cerr << name << ": " << different << " pixels differ from " << golden << std::endl;
+        return false;
+    }
+
+    /**
+     * @return false if the report could not be written
+     */
+    static bool writeReport(const std::string & path, const Report & report) {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        auto percentiles = [&](const Percentiles & p) {
+            out << "{\"p50\":" << p.p50 << ",\"p95\":" << p.p95 << ",\"p99\":" << p.p99 << "}";
+        };
+        out << std::setprecision(6) << "{\"frames\":" << report.frames << ",\"cpu\":";
+        percentiles(report.cpu);
+        out << ",\"gpu\":";
+        percentiles(report.gpu);
+        out << ",\"peakMemory\":" << report.peakMemory
+            << ",\"imageDifference\":" << report.imageDifference << "}\n";
+        out.flush();
+        return bool(out);
+    }
+
+    /**
+     * Compare the frame times and memory with the baseline, or write it
+     * with --record or when it is missing, baselines belong to a machine.
+     */
+    bool compareBaseline(const Report & report) {
+        if (record || !std::ifstream(baseline)) {
+            if (!writeReport(baseline, report)) {
+                std::cerr << name << ": could not record " << baseline << std::endl;
+                return false;
+            }
+            std::cout << name << ": recorded " << baseline << std::endl;
+            return true;
+        }
+        std::ifstream in(baseline);
+        std::stringstream text;
+        text << in.rdbuf();
+        std::string json = text.str();
+
+        bool passed = true;
+        // slack keeps sub-millisecond frames from failing on noise
+        auto check = [&](const char * what, const char * object, const char * key, double value,
+                         double slack) {
+            double base = 0;
+            if (!readNumber(json, object, key, base) || base <= 0)
+                return;
+            if (value > base * (1 + threshold) && value > base + slack) {
+                std::cerr << name << ": " << what << " regressed from " << base << " to " << value
+                          << std::endl;
+                passed = false;
+            }
+        };
+        check("cpu p50", "\"cpu\"", "\"p50\"", report.cpu.p50, 0.1);
+        check("cpu p95", "\"cpu\"", "\"p95\"", report.cpu.p95, 0.1);
+        check("gpu p50", "\"gpu\"", "\"p50\"", report.gpu.p50, 0.1);
+        check("gpu p95", "\"gpu\"", "\"p95\"", report.gpu.p95, 0.1);
+        check("peak memory", "", "\"peakMemory\"", double(report.peakMemory), 4 << 20);
+        return passed;
+    }
+
+    /**
+     * Find key after object in a report written by writeReport().
+     */
+    static bool readNumber(const std::string & json,
+                           const std::string & object,
+                           const std::string & key,
+                           double & value) {
+        std::size_t start = object.empty() ? 0 : json.find(object);
+        if (start == std::string::npos)
+            return false;
+        std::size_t at = json.find(key + ":", start);
+        if (at == std::string::npos)
+            return false;
+        value = std::atof(json.c_str() + at + key.size() + 1);
+        return true;
+    }
+};
@@ -0,0 +1,346 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <SFML/Window.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+ * The frame loop of the examples: poll events, update, render and present
+ * with a choice of pacing.
+ *
+ * VSync lets the swap interval pace frames and turns the SFML limiter off,
+ * the two together add a sleep on top of the vsync wait. Limit turns vsync
+ * off and sleeps until shortly before the next frame is due, then spins for
+ * the rest, which is far more precise than the millisecond sleep of
+ * sf::Window::setFramerateLimit(). Uncapped renders as fast as possible.
+ *
+ * Pacing happens before the events are polled so input is read as late as
+ * possible. A fence after every present keeps the CPU at most
+ * maxFramesInFlight frames ahead of the GPU, otherwise drivers queue several
+ * frames and each adds a frame of latency.
+ *
+ * Input latency is measured from polling the events to the return of
+ * display() and to the GPU finishing the frame. The GPU end of a frame is
+ * a GL_TIMESTAMP query lined up with steady_clock like in GpuProfiler,
+ * without timer queries it is when the fence is seen signaled.
+ */
+class FrameLoop {
+public:
+    enum Pacing {
+        VSync,
+        Limit,
+        Uncapped,
+    };
+
+    // the number of frames the rolling statistics cover
+    static constexpr unsigned Window = 120;
+
+    /**
+     * Rolling statistics in milliseconds over the last Window frames.
+     */
+    struct Timing {
+        double last = 0;
+        double average = 0;
+        double max = 0;
+    };
+
+    using EventHandler = std::function<void(const sf::Event &)>;
+    using Update = std::function<void(float)>;
+    using Render = std::function<void()>;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    class History {
+        std::vector<double> samples;
+        std::size_t next = 0;
+
+    public:
+        Timing timing;
+
+        void add(double ms) {
+            if (samples.size() < Window)
+                samples.push_back(ms);
+            else
+                samples[next] = ms;
+            next = (next + 1) % Window;
+
+            timing.last = ms;
+            timing.max = 0;
+            double sum = 0;
+            for (double sample : samples) {
+                sum += sample;
+                timing.max = std::max(timing.max, sample);
+            }
+            timing.average = sum / samples.size();
+        }
+    };
+
+    struct InFlight {
+        GLsync fence;
+        GLuint query;
+        clock::time_point input;
+    };
+
+    sf::Window & window;
+    Pacing pacing;
+    clock::duration period;
+    clock::duration spin;
+    unsigned maxFramesInFlight;
+    bool fences;
+    bool timestamps;
+    // steady_clock minus GL timestamp, in nanoseconds
+    std::int64_t clockOffset;
+    std::vector<GLuint> freeQueries;
+
+    clock::time_point deadline;
+    clock::time_point frameStart;
+    clock::time_point input;
+    std::deque<InFlight> inFlight;
+    std::uint64_t frames;
+
+    History frameTime;
+    History latency;
+    History gpuLatency;
+
+public:
+    /**
+     * @param window the window to poll and present
+     * @param pacing how frames are paced
+     * @param rate the frame rate of Limit in frames per second
+     * @param maxFramesInFlight how many frames the CPU may be ahead of the
+     *                          GPU, 0 to not wait
+     */
+    explicit FrameLoop(sf::Window & window,
+                       Pacing pacing = VSync,
+                       float rate = 60,
+                       unsigned maxFramesInFlight = 2)
+        : window(window),
+          pacing(pacing),
+          spin(std::chrono::microseconds(1500)),
+          maxFramesInFlight(maxFramesInFlight),
+          fences(GLEW_VERSION_3_2 || GLEW_ARB_sync),
+          timestamps(GLEW_VERSION_3_3 || GLEW_ARB_timer_query),
+          clockOffset(0),
+          deadline(clock::now()),
+          frameStart(clock::now()),
+          input(clock::now()),
+          frames(0) {
+        setRate(rate);
+        setPacing(pacing);
+        if (timestamps) {
+            GLint64 gpu = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpu);
+            clockOffset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              clock::now().time_since_epoch())
+                              .count()
+                          - gpu;
+        }
+    }
+
+    FrameLoop(const FrameLoop &) = delete;
+    FrameLoop & operator=(const FrameLoop &) = delete;
+
+    ~FrameLoop() {
+        for (auto & frame : inFlight) {
+            glDeleteSync(frame.fence);
+            if (frame.query)
+                freeQueries.push_back(frame.query);
+        }
+        if (!freeQueries.empty())
+            glDeleteQueries(freeQueries.size(), freeQueries.data());
+    }
+
+    void setPacing(Pacing pacing) {
+        this->pacing = pacing;
+        window.setVerticalSyncEnabled(pacing == VSync);
+        window.setFramerateLimit(0);
+        deadline = clock::now();
+    }
+
+    Pacing getPacing() const {
+        return pacing;
+    }
+
+    static const char * name(Pacing pacing) {
+        switch (pacing) {
+            case VSync:
+                return "vsync";
+            case Limit:
+                return "limit";
+            default:
+                return "uncapped";
+        }
+    }
+
+    /**
+     * Set the frame rate of Limit.
+     */
+    void setRate(float rate) {
+        period = std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>(1.0 / std::max(rate, 1.0f)));
+    }
+
+    /**
+     * Set how long before a frame is due Limit stops sleeping and spins,
+     * longer than the sleep granularity of the OS.
+     */
+    void setSpinTime(std::chrono::microseconds spin) {
+        this->spin = spin;
+    }
+
+    void setMaxFramesInFlight(unsigned frames) {
+        maxFramesInFlight = frames;
+    }
+
+    /**
+     * Run until the window is closed. onEvent sees every event, Closed also
+     * closes the window.
+     */
+    void run(const EventHandler & onEvent, const Render & render) {
+        run(onEvent, Update(), render);
+    }
+
+    /**
+     * Run until the window is closed, calling update with the seconds since
+     * the last frame before render.
+     */
+    void run(const EventHandler & onEvent, const Update & update, const Render & render) {
+        while (window.isOpen()) {
+            float dt = beginFrame();
+            sf::Event event;
+            while (window.pollEvent(event)) {
+                onEvent(event);
+                if (event.type == sf::Event::Closed)
+                    window.close();
+            }
+            if (!window.isOpen())
+                break;
+            if (update)
+                update(dt);
+            render();
+            endFrame();
+        }
+    }
+
+    /**
+     * Wait for the next frame to be due and for the GPU to catch up, then
+     * start the frame. Poll the events right after. Called by run().
+     *
+     * @return the seconds since the previous frame started
+     */
+    float beginFrame() {
+        if (pacing == Limit)
+            pace();
+        waitForGpu();
+
+        auto now = clock::now();
+        float dt = std::chrono::duration<float>(now - frameStart).count();
+        if (frames > 0)
+            frameTime.add(std::chrono::duration<double, std::milli>(now - frameStart).count());
+        frameStart = now;
+        input = now;
+        return std::min(dt, 0.25f);
+    }
+
+    /**
+     * Present the frame and fence it. Called by run().
+     */
+    void endFrame() {
+        if (window.isOpen())
+            window.display();
+        latency.add(std::chrono::duration<double, std::milli>(clock::now() - input).count());
+        if (fences) {
+            GLuint query = 0;
+            if (timestamps) {
+                if (freeQueries.empty()) {
+                    freeQueries.resize(1);
+                    glGenQueries(1, freeQueries.data());
+                }
+                query = freeQueries.back();
+                freeQueries.pop_back();
+                glQueryCounter(query, GL_TIMESTAMP);
+            }
+            inFlight.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), query, input});
+        }
+        frames++;
+    }
+
+    std::uint64_t getFrameCount() const {
+        return frames;
+    }
+
+    /**
+     * The time between the starts of frames.
+     */
+    const Timing & getFrameTime() const {
+        return frameTime.timing;
+    }
+
+    /**
+     * The time from polling the events to the return of display().
+     */
+    const Timing & getLatency() const {
+        return latency.timing;
+    }
+
+    /**
+     * The time from polling the events to the GPU finishing the frame.
+     */
+    const Timing & getGpuLatency() const {
+        return gpuLatency.timing;
+    }
+
+private:
+    /**
+     * Sleep until spin before the deadline and spin for the rest.
+     */
+    void pace() {
+        deadline += period;
+        auto now = clock::now();
+        // more than a frame behind, start over instead of catching up
+        if (now > deadline + period)
+            deadline = now;
+        if (deadline - now > spin)
+            std::this_thread::sleep_for(deadline - now - spin);
+        while (clock::now() < deadline)
+            std::this_thread::yield();
+    }
+
+    /**
+     * Retire the frames the GPU finished and wait for the oldest while too
+     * many are in flight.
+     */
+    void waitForGpu() {
+        while (!inFlight.empty()) {
+            bool wait = maxFramesInFlight > 0 && inFlight.size() >= maxFramesInFlight;
+            GLuint64 timeout = wait ? 1000000000 : 0;
+            GLenum result =
+                glClientWaitSync(inFlight.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+            if (result == GL_TIMEOUT_EXPIRED && !wait)
+                break;
+
+            InFlight & frame = inFlight.front();
+            auto done = clock::now();
+            if (frame.query) {
+                GLuint64 gpu = 0;
+                glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &gpu);
+                done = clock::time_point(std::chrono::duration_cast<clock::duration>(
+                    std::chrono::nanoseconds(std::int64_t(gpu) + clockOffset)));
+                freeQueries.push_back(frame.query);
+            }
+            gpuLatency.add(std::chrono::duration<double, std::milli>(done - frame.input).count());
+            glDeleteSync(frame.fence);
+            inFlight.pop_front();
+        }
+    }
+};
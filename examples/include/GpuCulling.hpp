@@ -0,0 +1,358 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <string>
+
+#include "Buffer.hpp"
+#include "Culling.hpp"
+#include "InstancePacking.hpp"
+#include "Shader.hpp"
+#include "Texture.hpp"
+
+/**
+ * A hierarchical depth buffer, every texel of level n holds the farthest
+ * depth of the 2x2 texels below it in level n - 1. Built with compute
+ * shaders, requires OpenGL 4.3.
+ */
+class HiZPyramid {
+    static constexpr GLuint GroupSize = 8;
+
+    static constexpr const char * copySource = R"(
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+layout (r32f, binding = 0) uniform writeonly image2D dst;
+uniform sampler2D depth;
+void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(p, imageSize(dst))))
+        return;
+    imageStore(dst, p, vec4(texelFetch(depth, p, 0).r));
+})";
+
+    static constexpr const char * reduceSource = R"(
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+layout (r32f, binding = 0) uniform readonly image2D src;
+layout (r32f, binding = 1) uniform writeonly image2D dst;
+void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(p, imageSize(dst))))
+        return;
+    ivec2 srcSize = imageSize(src);
+    ivec2 s = p * 2;
+    float d = max(max(imageLoad(src, s).r, imageLoad(src, s + ivec2(1, 0)).r),
+                  max(imageLoad(src, s + ivec2(0, 1)).r, imageLoad(src, s + ivec2(1, 1)).r));
+    // odd sizes, the last texel also covers the extra row / column
+    bool oddX = (srcSize.x & 1) != 0 && s.x + 3 == srcSize.x;
+    bool oddY = (srcSize.y & 1) != 0 && s.y + 3 == srcSize.y;
+    if (oddX) {
+        d = max(d, max(imageLoad(src, s + ivec2(2, 0)).r, imageLoad(src, s + ivec2(2, 1)).r));
+    }
+    if (oddY) {
+        d = max(d, max(imageLoad(src, s + ivec2(0, 2)).r, imageLoad(src, s + ivec2(1, 2)).r));
+    }
+    if (oddX && oddY) {
+        d = max(d, imageLoad(src, s + ivec2(2, 2)).r);
+    }
+    imageStore(dst, p, vec4(d));
+})";
+
+    Shader copy;
+    Shader reduce;
+    Texture pyramid;
+    int levels;
+
+public:
+    HiZPyramid(const glm::uvec2 & size)
+        : copy(copySource),
+          reduce(reduceSource),
+          pyramid(size,
+                  Texture::R32F,
+                  Texture::Gray,
+                  GL_FLOAT,
+                  0,
+                  Texture::Nearest,
+                  Texture::NearestMmNearest,
+                  Texture::Clamp,
+                  true),
+          levels(0) {
+        resize(size);
+    }
+
+    void resize(const glm::uvec2 & size) {
+        pyramid.resize(size);
+        // allocates the storage of every level
+        pyramid.generateMipmap();
+        levels = 1 + static_cast<int>(std::floor(std::log2(std::max(size.x, size.y))));
+    }
+
+    const Texture & getTexture() const {
+        return pyramid;
+    }
+
+    int getLevels() const {
+        return levels;
+    }
+
+    /**
+     * Rebuild the pyramid from a depth texture of the same size.
+     */
+    void build(const Texture & depth) {
+        glm::uvec2 size = pyramid.getSize();
+
+        depth.bind();
+        pyramid.bindImage(0, GL_WRITE_ONLY, 0);
+        copy.dispatch(groups(size.x), groups(size.y));
+
+        for (int level = 1; level < levels; level++) {
+            Shader::memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            size = glm::max(size / 2u, glm::uvec2(1));
+            pyramid.bindImage(0, GL_READ_ONLY, level - 1);
+            pyramid.bindImage(1, GL_WRITE_ONLY, level);
+            reduce.dispatch(groups(size.x), groups(size.y));
+        }
+        Shader::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+private:
+    static GLuint groups(GLuint size) {
+        return (size + GroupSize - 1) / GroupSize;
+    }
+};
+
+/**
+ * Cull instances on the GPU and draw the visible ones without a CPU round
+ * trip. Requires OpenGL 4.3.
+ *
+ * A compute shader tests one bounding sphere per instance against the
+ * frustum and optionally against a HiZPyramid of the occluders. Visible
+ * instances are appended to getVisibleBuffer() and counted into the
+ * instanceCount of a DrawElementsIndirectCommand with an atomic, draw the
+ * result with BufferArray::drawElementsIndirect(getCommandBuffer()).
+ */
+class GpuCuller {
+    static constexpr GLuint GroupSize = 64;
+
+    static constexpr const char * cullSource = R"(
+layout (local_size_x = 64) in;
+
+struct Command {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Bounds { vec4 bounds[]; };
+layout (std430, binding = 1) readonly buffer Instances { vec4 instances[]; };
+layout (std430, binding = 2) writeonly buffer Visible { vec4 visible[]; };
+layout (std430, binding = 3) buffer Commands { Command command; };
+
+uniform uint count;
+uniform vec4 planes[6];
+uniform mat4 viewProjection;
+uniform bool useHiZ;
+uniform sampler2D hiZ;
+uniform vec2 hiZSize;
+
+bool occluded(vec4 sphere) {
+    vec3 lo = vec3(1.0), hi = vec3(-1.0);
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = vec3((i & 1) != 0 ? 1.0 : -1.0,
+                           (i & 2) != 0 ? 1.0 : -1.0,
+                           (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(sphere.xyz + corner * sphere.w, 1.0);
+        // crosses the near plane, can not be tested
+        if (clip.w <= 0.0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        lo = i == 0 ? ndc : min(lo, ndc);
+        hi = i == 0 ? ndc : max(hi, ndc);
+    }
+    vec2 uvLo = clamp(lo.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uvHi = clamp(hi.xy * 0.5 + 0.5, 0.0, 1.0);
+
+    // the level where the rectangle covers at most 2x2 texels
+    vec2 extent = (uvHi - uvLo) * hiZSize;
+    float level = ceil(log2(max(max(extent.x, extent.y), 1.0)));
+
+    float farthest = max(max(textureLod(hiZ, uvLo, level).r,
+                             textureLod(hiZ, vec2(uvHi.x, uvLo.y), level).r),
+                         max(textureLod(hiZ, vec2(uvLo.x, uvHi.y), level).r,
+                             textureLod(hiZ, uvHi, level).r));
+    float nearest = lo.z * 0.5 + 0.5;
+    return nearest > farthest;
+}
+
+void main() {
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= count)
+        return;
+
+    vec4 sphere = bounds[id];
+    for (int i = 0; i < 6; i++) {
+        if (dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w)
+            return;
+    }
+    if (useHiZ && occluded(sphere))
+        return;
+
+    uint slot = atomicAdd(command.instanceCount, 1u);
+    for (uint i = 0u; i < INSTANCE_VEC4S; i++) {
+        visible[slot * INSTANCE_VEC4S + i] = instances[id * INSTANCE_VEC4S + i];
+    }
+})";
+
+    InstanceLayout layout;
+    std::size_t capacity;
+    std::size_t count;
+    Shader shader;
+    Shader::Uniform countUniform;
+    Shader::Uniform planes;
+    Shader::Uniform viewProjectionUniform;
+    Shader::Uniform useHiZ;
+    Shader::Uniform hiZSize;
+    Buffer bounds;
+    Buffer instances;
+    Buffer visible;
+    Buffer commands;
+    DrawElementsIndirectCommand command;
+
+public:
+    /**
+     * @param capacity the maximum number of instances
+     * @param layout the format of the instance data that is compacted
+     */
+    GpuCuller(std::size_t capacity, InstanceLayout layout = InstanceLayout::Affine)
+        : layout(layout),
+          capacity(capacity),
+          count(0),
+          shader(source(layout).c_str()),
+          countUniform(shader.uniform("count")),
+          planes(shader.uniform("planes")),
+          viewProjectionUniform(shader.uniform("viewProjection")),
+          useHiZ(shader.uniform("useHiZ")),
+          hiZSize(shader.uniform("hiZSize")),
+          bounds(GL_SHADER_STORAGE_BUFFER),
+          instances(GL_SHADER_STORAGE_BUFFER),
+          visible(GL_ARRAY_BUFFER),
+          commands(GL_DRAW_INDIRECT_BUFFER),
+          command {0, 0, 0, 0, 0} {
+        bounds.bufferData(capacity * sizeof(glm::vec4), nullptr, GL_STATIC_DRAW);
+        instances.bufferData(capacity * instanceStride(layout), nullptr,
+                             GL_STATIC_DRAW);
+        bounds.unbind();
+        visible.bufferData(capacity * instanceStride(layout), nullptr,
+                           GL_DYNAMIC_COPY);
+        visible.unbind();
+        commands.bufferData(sizeof(command), &command, GL_DYNAMIC_DRAW);
+        commands.unbind();
+    }
+
+    /**
+     * The compacted instance data, use as the divisor 1 attribute stream.
+     */
+    const Buffer & getVisibleBuffer() const {
+        return visible;
+    }
+
+    const Buffer & getCommandBuffer() const {
+        return commands;
+    }
+
+    std::size_t size() const {
+        return count;
+    }
+
+    /**
+     * Set the index range drawn for every visible instance.
+     */
+    void setMesh(GLuint indexCount, GLuint firstIndex = 0, GLint baseVertex = 0) {
+        command.count = indexCount;
+        command.firstIndex = firstIndex;
+        command.baseVertex = baseVertex;
+    }
+
+    /**
+     * Upload the bounding spheres (center, radius) and instance data of a
+     * range of instances.
+     *
+     * @param first the first instance to replace
+     * @param n the number of instances
+     * @param spheres n bounding spheres in world space
+     * @param data n instances in the layout given to the constructor
+     *
+     * @throws std::out_of_range if the range exceeds the capacity
+     */
+    void setInstances(std::size_t first,
+                      std::size_t n,
+                      const glm::vec4 * spheres,
+                      const void * data) {
+        if (first + n > capacity)
+            throw std::out_of_range("GpuCuller capacity exceeded");
+        bounds.bufferSubData(first * sizeof(glm::vec4), n * sizeof(glm::vec4),
+                             spheres);
+        instances.bufferSubData(first * instanceStride(layout),
+                                n * instanceStride(layout),
+                                data);
+        instances.unbind();
+        count = std::max(count, first + n);
+    }
+
+    /**
+     * Only the first n instances are culled.
+     */
+    void resize(std::size_t n) {
+        count = std::min(n, capacity);
+    }
+
+    /**
+     * Reset the command and run the culling pass. The results are ready for
+     * drawing, the barriers for indirect commands and vertex attributes are
+     * issued here.
+     *
+     * @param viewProjection the camera to cull against
+     * @param hiZ the depth pyramid of the occluders, nullptr to skip the
+     *            occlusion test
+     */
+    void cull(const glm::mat4 & viewProjection, const HiZPyramid * hiZ = nullptr) {
+        command.instanceCount = 0;
+        commands.bufferSubData(0, sizeof(command), &command);
+        commands.unbind();
+
+        Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+        shader.bind();
+        countUniform.setValue(static_cast<unsigned int>(count));
+        planes.setArray(frustum.planes, 6);
+        viewProjectionUniform.setMat4(viewProjection);
+        useHiZ.setValue(hiZ != nullptr);
+        if (hiZ) {
+            // the hiZ sampler uses the default texture unit 0
+            hiZ->getTexture().bind();
+            hiZSize.setVec2(glm::vec2(hiZ->getTexture().getSize()));
+        }
+
+        bounds.bindBase(0);
+        instances.bindBase(1);
+        visible.bindBase(GL_SHADER_STORAGE_BUFFER, 2);
+        commands.bindBase(GL_SHADER_STORAGE_BUFFER, 3);
+
+        shader.dispatch(static_cast<GLuint>((count + GroupSize - 1) / GroupSize));
+        Shader::memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+private:
+    static std::string source(InstanceLayout layout) {
+        return "#version 430 core\n#define INSTANCE_VEC4S "
+               + std::to_string(instanceStride(layout) / sizeof(glm::vec4))
+               + "u\n" + cullSource;
+    }
+};
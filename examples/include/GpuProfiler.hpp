@@ -0,0 +1,403 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Profiler.hpp"
+
+/**
+ * Times nested scopes on the GPU with GL_TIMESTAMP queries.
+ *
+ * Every scope writes a timestamp at its start and end, unlike
+ * GL_TIME_ELAPSED queries these can nest. Queries come from a pool and are
+ * only read once the GPU has passed them, at least Latency frames later, so
+ * the CPU never waits for a result. When the results fall more than
+ * MaxPendingFrames behind, frames are skipped instead.
+ *
+ * With KHR_debug every scope is also a glPushDebugGroup so it shows up in
+ * RenderDoc, apitrace and driver tools.
+ *
+ * The most recently created profiler is the one GPU_SCOPE() records into,
+ * scopes do nothing when there is none. Scope names must outlive the
+ * profiler, string literals are fine.
+ */
+class GpuProfiler {
+public:
+    static constexpr unsigned Latency = 3;
+    static constexpr unsigned MaxPendingFrames = 8;
+    // the number of frames the rolling statistics cover
+    static constexpr unsigned Window = 120;
+
+    class GpuProfilerException : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * Rolling statistics of a scope in milliseconds, over the last Window
+     * frames it ran in.
+     */
+    struct Stats {
+        const char * name;
+        unsigned depth;
+        double last;
+        double average;
+        double min;
+        double max;
+    };
+
+    /**
+     * A finished scope as recorded for a trace, on trace thread 0. Merge
+     * them with the events of Profiler::collect() for one timeline.
+     */
+    using Event = TraceEvent;
+
+    /**
+     * Times the enclosing C++ scope.
+     */
+    class Scope {
+        GpuProfiler * profiler;
+
+    public:
+        explicit Scope(const char * name) : profiler(current()) {
+            if (profiler)
+                profiler->push(name);
+        }
+
+        ~Scope() {
+            if (profiler)
+                profiler->pop();
+        }
+
+        Scope(const Scope &) = delete;
+        Scope & operator=(const Scope &) = delete;
+    };
+
+private:
+    struct Marker {
+        const char * name;
+        unsigned depth;
+        GLuint begin;
+        GLuint end;
+    };
+
+    struct Frame {
+        std::uint64_t number;
+        std::vector<Marker> markers;
+    };
+
+    struct History {
+        const char * name;
+        unsigned depth;
+        std::vector<double> samples;
+        std::size_t next = 0;
+    };
+
+    std::vector<GLuint> freeQueries;
+    std::vector<GLuint> allQueries;
+    std::deque<Frame> pending;
+    Frame frame;
+    std::vector<std::size_t> open;
+    bool recording;
+    bool markers;
+    std::uint64_t frameNumber;
+    std::uint64_t skipped;
+
+    std::vector<History> histories;
+    std::vector<Stats> stats;
+
+    bool capturing;
+    std::vector<Event> events;
+    // steady_clock minus GL timestamp, in nanoseconds
+    std::int64_t clockOffset;
+
+    static GpuProfiler *& currentPointer() {
+        static GpuProfiler * profiler = nullptr;
+        return profiler;
+    }
+
+public:
+    /**
+     * @param debugGroups also push debug groups when KHR_debug is there
+     */
+    explicit GpuProfiler(bool debugGroups = true)
+        : recording(false),
+          markers(debugGroups && (GLEW_KHR_debug || GLEW_VERSION_4_3)),
+          frameNumber(0),
+          skipped(0),
+          capturing(false),
+          clockOffset(0) {
+        // line the GPU clock up with steady_clock so traces can be merged
+        // with CPU traces
+        GLint64 gpu = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpu);
+        auto cpu = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+        clockOffset = cpu - gpu;
+        currentPointer() = this;
+    }
+
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler & operator=(const GpuProfiler &) = delete;
+
+    ~GpuProfiler() {
+        if (currentPointer() == this)
+            currentPointer() = nullptr;
+        if (!allQueries.empty())
+            glDeleteQueries(allQueries.size(), allQueries.data());
+    }
+
+    /**
+     * The profiler GPU_SCOPE() records into, nullptr if there is none.
+     */
+    static GpuProfiler * current() {
+        return currentPointer();
+    }
+
+    void makeCurrent() {
+        currentPointer() = this;
+    }
+
+    /**
+     * Collect the results that are ready and start recording a frame. Call
+     * once per frame before the first scope.
+     */
+    void beginFrame() {
+        collect();
+        frameNumber++;
+        frame.number = frameNumber;
+        frame.markers.clear();
+        open.clear();
+        recording = pending.size() < MaxPendingFrames;
+        if (!recording)
+            skipped++;
+        push("frame");
+    }
+
+    /**
+     * Stop recording the frame, its results are read in a later
+     * beginFrame().
+     */
+    void endFrame() {
+        pop();
+        if (recording)
+            pending.push_back(std::move(frame));
+        recording = false;
+    }
+
+    void push(const char * name) {
+        if (markers)
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+        if (!recording)
+            return;
+        Marker marker {name, unsigned(open.size()), query(), 0};
+        glQueryCounter(marker.begin, GL_TIMESTAMP);
+        open.push_back(frame.markers.size());
+        frame.markers.push_back(marker);
+    }
+
+    void pop() {
+        if (markers)
+            glPopDebugGroup();
+        if (!recording || open.empty())
+            return;
+        Marker & marker = frame.markers[open.back()];
+        open.pop_back();
+        marker.end = query();
+        glQueryCounter(marker.end, GL_TIMESTAMP);
+    }
+
+    /**
+     * The number of the frame being recorded, starting at 1.
+     */
+    std::uint64_t getFrame() const {
+        return frameNumber;
+    }
+
+    /**
+     * The number of frames that were not recorded because the GPU was too
+     * far behind.
+     */
+    std::uint64_t getSkippedFrames() const {
+        return skipped;
+    }
+
+    /**
+     * The statistics of every scope seen so far, in the order they first
+     * ran, the whole frame first.
+     */
+    const std::vector<Stats> & getStats() const {
+        return stats;
+    }
+
+    /**
+     * The statistics of the first scope called name, nullptr if it never
+     * ran.
+     */
+    const Stats * find(const char * name) const {
+        for (auto & s : stats) {
+            if (std::strcmp(s.name, name) == 0)
+                return &s;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Print the statistics as an indented table.
+     */
+    void report(std::ostream & out) const {
+        out << std::left << std::setw(28) << "scope" << std::right << std::setw(10)
+            << "last" << std::setw(10) << "avg" << std::setw(10) << "min"
+            << std::setw(10) << "max" << "  (ms)" << std::endl;
+        out << std::fixed << std::setprecision(3);
+        for (auto & s : stats) {
+            out << std::left << std::setw(28) << std::string(2 * s.depth, ' ') + s.name
+                << std::right << std::setw(10) << s.last << std::setw(10) << s.average
+                << std::setw(10) << s.min << std::setw(10) << s.max << std::endl;
+        }
+    }
+
+    /**
+     * Start or stop keeping every collected scope for a trace.
+     */
+    void setCapture(bool capture) {
+        capturing = capture;
+    }
+
+    bool isCapturing() const {
+        return capturing;
+    }
+
+    const std::vector<Event> & getEvents() const {
+        return events;
+    }
+
+    void clearEvents() {
+        events.clear();
+    }
+
+    /**
+     * Write the captured scopes as Chrome trace JSON, for chrome://tracing
+     * or Perfetto.
+     */
+    void writeChromeTrace(std::ostream & out) const {
+        out << "{\"traceEvents\":[\n";
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+               "\"args\":{\"name\":\"GPU\"}}";
+        out << std::fixed << std::setprecision(3);
+        for (auto & e : events) {
+            out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,"
+                << "\"tid\":0,\"ts\":" << e.begin / 1000.0 << ",\"dur\":" << (e.end - e.begin) / 1000.0
+                << ",\"args\":{\"frame\":" << e.frame << "}}";
+        }
+        out << "\n]}\n";
+    }
+
+    /**
+     * @throws GpuProfilerException if the file can not be written
+     */
+    void saveChromeTrace(const std::string & path) const {
+        std::ofstream file(path);
+        if (!file)
+            throw GpuProfilerException("Could not open " + path);
+        writeChromeTrace(file);
+    }
+
+private:
+    GLuint query() {
+        if (freeQueries.empty()) {
+            GLuint queries[32];
+            glGenQueries(32, queries);
+            freeQueries.insert(freeQueries.end(), queries, queries + 32);
+            allQueries.insert(allQueries.end(), queries, queries + 32);
+        }
+        GLuint q = freeQueries.back();
+        freeQueries.pop_back();
+        return q;
+    }
+
+    /**
+     * Read every pending frame whose last query is done, oldest first,
+     * without waiting.
+     */
+    void collect() {
+        while (!pending.empty()) {
+            Frame & f = pending.front();
+            if (frameNumber - f.number < Latency - 1 && pending.size() < MaxPendingFrames)
+                break;
+            // the frame scope ends last, when it is done the others are too
+            GLint available = 0;
+            glGetQueryObjectiv(f.markers.front().end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+
+            for (auto & marker : f.markers) {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(marker.begin, GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(marker.end, GL_QUERY_RESULT, &end);
+                freeQueries.push_back(marker.begin);
+                freeQueries.push_back(marker.end);
+                record(marker, f.number, begin, end);
+            }
+            pending.pop_front();
+        }
+    }
+
+    void record(const Marker & marker, std::uint64_t number, GLuint64 begin, GLuint64 end) {
+        double ms = (end - begin) / 1e6;
+        std::size_t i = 0;
+        while (i < histories.size()
+               && (histories[i].depth != marker.depth
+                   || std::strcmp(histories[i].name, marker.name) != 0))
+            i++;
+        if (i == histories.size()) {
+            histories.push_back({marker.name, marker.depth, {}, 0});
+            stats.push_back({marker.name, marker.depth, 0, 0, 0, 0});
+        }
+
+        History & h = histories[i];
+        if (h.samples.size() < Window)
+            h.samples.push_back(ms);
+        else
+            h.samples[h.next] = ms;
+        h.next = (h.next + 1) % Window;
+
+        Stats & s = stats[i];
+        s.last = ms;
+        s.min = s.max = ms;
+        double sum = 0;
+        for (double sample : h.samples) {
+            sum += sample;
+            s.min = std::min(s.min, sample);
+            s.max = std::max(s.max, sample);
+        }
+        s.average = sum / h.samples.size();
+
+        if (capturing)
+            events.push_back({marker.name, "gpu", 0, number,
+                              std::int64_t(begin) + clockOffset,
+                              std::int64_t(end) + clockOffset});
+    }
+};
+
+#define GPU_SCOPE_JOIN2(a, b) a##b
+#define GPU_SCOPE_JOIN(a, b) GPU_SCOPE_JOIN2(a, b)
+
+/**
+ * Time the rest of the enclosing C++ scope on the GPU as name.
+ */
+#define GPU_SCOPE(name) GpuProfiler::Scope GPU_SCOPE_JOIN(gpuScope, __LINE__)(name)
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Buffer.hpp"
+
+/**
+ * A CPU copy of per instance data and the GL buffer it is streamed to.
+ *
+ * Changes are tracked per block of BlockSize instances and upload() only
+ * sends the dirty blocks with glBufferSubData. The GL buffer doubles, from
+ * BlockSize instances on, until it fits when it runs out, so a slowly
+ * growing instance count does not reallocate every frame. It never shrinks.
+ *
+ * Removing an instance moves the last one into its slot, instance indices
+ * are not stable across remove().
+ */
+template<typename T>
+class InstanceBuffer {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Instance data is copied to GL as raw bytes");
+
+public:
+    static constexpr std::size_t BlockSize = 64;
+
+private:
+    Buffer buffer;
+    GLenum usage;
+    std::size_t capacity;
+    std::vector<T> instances;
+    std::vector<std::uint64_t> dirty;
+
+public:
+    /**
+     * @param capacity the number of instances to allocate in the GL buffer
+     * @param usage the usage hint for glBufferData
+     */
+    explicit InstanceBuffer(std::size_t capacity = 0, GLenum usage = GL_DYNAMIC_DRAW)
+        : buffer(GL_ARRAY_BUFFER), usage(usage), capacity(0) {
+        reserve(capacity);
+    }
+
+    InstanceBuffer(InstanceBuffer && other) = default;
+    InstanceBuffer & operator=(InstanceBuffer && other) = default;
+
+    /**
+     * Point attributes of array at this buffer, for example the
+     * instanceAttributes() of a packed layout. The buffer object stays the
+     * same when it grows, so this is only needed once.
+     */
+    void attach(const BufferArray & array, const std::vector<Attribute> & attributes) const {
+        array.bind();
+        buffer.bind();
+        for (auto & attribute : attributes) {
+            attribute.enable();
+        }
+        array.unbind();
+    }
+
+    const Buffer & getBuffer() const {
+        return buffer;
+    }
+
+    std::size_t size() const {
+        return instances.size();
+    }
+
+    bool empty() const {
+        return instances.empty();
+    }
+
+    /**
+     * The number of instances the GL buffer can hold without growing.
+     */
+    std::size_t getCapacity() const {
+        return capacity;
+    }
+
+    /**
+     * Allocate room for n instances in the GL buffer and the CPU copy.
+     */
+    void reserve(std::size_t n) {
+        instances.reserve(n);
+        if (n > capacity)
+            allocate(n);
+    }
+
+    /**
+     * Resize to n instances, new instances are value initialized and dirty.
+     */
+    void resize(std::size_t n) {
+        std::size_t old = instances.size();
+        instances.resize(n);
+        if (n > old)
+            markDirty(old, n - old);
+    }
+
+    void clear() {
+        instances.clear();
+    }
+
+    /**
+     * @return the index of the new instance
+     */
+    std::size_t add(const T & instance) {
+        instances.push_back(instance);
+        markDirty(instances.size() - 1, 1);
+        return instances.size() - 1;
+    }
+
+    /**
+     * Remove instance i in O(1) by moving the last instance into its slot.
+     *
+     * @return the old index of the instance now at i, size() if the last
+     *         instance was removed
+     *
+     * @throws std::out_of_range if i is not an instance
+     */
+    std::size_t remove(std::size_t i) {
+        if (i >= instances.size())
+            throw std::out_of_range("Instance index out of range");
+        std::size_t last = instances.size() - 1;
+        if (i != last) {
+            instances[i] = instances[last];
+            markDirty(i, 1);
+        }
+        instances.pop_back();
+        return i != last ? last : instances.size();
+    }
+
+    const T & get(std::size_t i) const {
+        return instances[i];
+    }
+
+    void set(std::size_t i, const T & instance) {
+        instances[i] = instance;
+        markDirty(i, 1);
+    }
+
+    /**
+     * Get instance i for modification, it is marked dirty. The reference
+     * is invalidated by add() and resize().
+     */
+    T & edit(std::size_t i) {
+        markDirty(i, 1);
+        return instances[i];
+    }
+
+    /**
+     * Get count instances from first for modification, they are marked
+     * dirty.
+     */
+    T * edit(std::size_t first, std::size_t count) {
+        markDirty(first, count);
+        return instances.data() + first;
+    }
+
+    const T * data() const {
+        return instances.data();
+    }
+
+    void markDirty(std::size_t first, std::size_t count) {
+        if (count == 0)
+            return;
+        std::size_t begin = first / BlockSize;
+        std::size_t end = (first + count - 1) / BlockSize + 1;
+        if (dirty.size() * 64 < end)
+            dirty.resize((end + 63) / 64, 0);
+        for (std::size_t b = begin; b < end; b++) {
+            dirty[b / 64] |= std::uint64_t(1) << (b % 64);
+        }
+    }
+
+    /**
+     * Send the dirty blocks to the GL buffer, growing it first if it is too
+     * small, and clear the dirty flags.
+     *
+     * @return the number of bytes sent
+     */
+    std::size_t upload() {
+        std::size_t sent = 0;
+        if (instances.size() > capacity) {
+            // the old contents are gone, send everything
+            std::size_t n = std::max(capacity * 2, BlockSize);
+            while (n < instances.size())
+                n *= 2;
+            allocate(n);
+            buffer.bufferSubData(0, instances.size() * sizeof(T), instances.data());
+            sent = instances.size() * sizeof(T);
+        }
+        else {
+            std::size_t blocks = (instances.size() + BlockSize - 1) / BlockSize;
+            std::size_t b = 0;
+            while (b < blocks && b / 64 < dirty.size()) {
+                if ((dirty[b / 64] >> (b % 64)) == 0) {
+                    // the rest of the word is clean
+                    b = (b / 64 + 1) * 64;
+                    continue;
+                }
+                if (!isBlockDirty(b)) {
+                    b++;
+                    continue;
+                }
+                std::size_t run = b;
+                while (run < blocks && isBlockDirty(run))
+                    run++;
+                std::size_t first = b * BlockSize;
+                std::size_t last = std::min(run * BlockSize, instances.size());
+                buffer.bufferSubData(first * sizeof(T),
+                                     (last - first) * sizeof(T),
+                                     instances.data() + first);
+                sent += (last - first) * sizeof(T);
+                b = run;
+            }
+        }
+        std::fill(dirty.begin(), dirty.end(), 0);
+        return sent;
+    }
+
+private:
+    bool isBlockDirty(std::size_t b) const {
+        return b / 64 < dirty.size() && (dirty[b / 64] >> (b % 64) & 1);
+    }
+
+    void allocate(std::size_t n) {
+        capacity = n;
+        buffer.bufferData(capacity * sizeof(T), nullptr, usage);
+    }
+};
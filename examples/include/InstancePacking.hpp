@@ -0,0 +1,140 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "simd.hpp"
+
+/**
+ * Per instance transform formats for divisor 1 attribute streams.
+ *
+ * Matrix is a full column major glm::mat4 (64 bytes). Affine drops the
+ * constant last row and stores the upper 3x4 part row major (48 bytes).
+ * Rigid stores a rotation quaternion, a translation and a uniform scale
+ * (32 bytes), non uniform scale is lost.
+ */
+enum class InstanceLayout {
+    Matrix,
+    Affine,
+    Rigid,
+};
+
+/**
+ * The rows of the upper 3x4 part of an affine matrix.
+ */
+struct PackedAffine {
+    glm::vec4 rows[3];
+};
+
+/**
+ * A rotation quaternion (x, y, z, w) and a translation with the uniform
+ * scale in w.
+ */
+struct PackedRigid {
+    glm::vec4 rotation;
+    glm::vec4 translationScale;
+};
+
+static_assert(sizeof(PackedAffine) == 48, "PackedAffine must be tightly packed");
+static_assert(sizeof(PackedRigid) == 32, "PackedRigid must be tightly packed");
+
+/**
+ * GLSL functions that decode the packed layouts. Paste after the #version
+ * line of a vertex shader.
+ */
+static constexpr const char * instanceDecodeSource = R"(
+mat4 decodeAffine(vec4 row0, vec4 row1, vec4 row2) {
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+vec3 rigidRotate(vec4 rotation, vec3 v) {
+    return v + 2.0 * cross(rotation.xyz, cross(rotation.xyz, v) + rotation.w * v);
+}
+vec3 rigidTransform(vec4 rotation, vec4 translationScale, vec3 p) {
+    return rigidRotate(rotation, p * translationScale.w) + translationScale.xyz;
+}
+)";
+
+inline GLsizei instanceStride(InstanceLayout layout) {
+    switch (layout) {
+        case InstanceLayout::Affine:
+            return sizeof(PackedAffine);
+        case InstanceLayout::Rigid:
+            return sizeof(PackedRigid);
+        default:
+            return sizeof(glm::mat4);
+    }
+}
+
+/**
+ * The vec4 attributes of one instance stream, starting at location. Matrix
+ * uses 4 locations, Affine 3 and Rigid 2.
+ *
+ * @param layout the instance format
+ * @param location the first attribute location
+ * @param divisor advance the attributes once per divisor instances
+ */
+inline std::vector<Attribute> instanceAttributes(InstanceLayout layout,
+                                                 GLuint location,
+                                                 GLuint divisor = 1) {
+    GLsizei stride = instanceStride(layout);
+    std::vector<Attribute> attributes;
+    for (GLsizei offset = 0; offset < stride; offset += sizeof(glm::vec4)) {
+        attributes.push_back({location++,
+                              4,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              stride,
+                              reinterpret_cast<const void *>(offset),
+                              divisor});
+    }
+    return attributes;
+}
+
+inline PackedRigid packRigid(const glm::vec3 & position,
+                             const glm::quat & rotation,
+                             float scale) {
+    return {{rotation.x, rotation.y, rotation.z, rotation.w},
+            {position, scale}};
+}
+
+/**
+ * Pack the upper 3x4 part of count matrices, transposed four columns at a
+ * time when SSE is available.
+ */
+inline void packAffine(const glm::mat4 * in, std::size_t count, PackedAffine * out) {
+    const float * src = &in[0][0][0];
+    float * dst = &out[0].rows[0][0];
+#if SIMD_WIDTH >= 4
+    for (std::size_t i = 0; i < count; i++, src += 16, dst += 12) {
+        __m128 c0 = _mm_loadu_ps(src);
+        __m128 c1 = _mm_loadu_ps(src + 4);
+        __m128 c2 = _mm_loadu_ps(src + 8);
+        __m128 c3 = _mm_loadu_ps(src + 12);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        _mm_storeu_ps(dst, c0);
+        _mm_storeu_ps(dst + 4, c1);
+        _mm_storeu_ps(dst + 8, c2);
+    }
+#else
+    for (std::size_t i = 0; i < count; i++, src += 16, dst += 12) {
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 4; c++) {
+                dst[r * 4 + c] = src[c * 4 + r];
+            }
+        }
+    }
+#endif
+}
+
+inline PackedAffine packAffine(const glm::mat4 & matrix) {
+    PackedAffine packed;
+    packAffine(&matrix, 1, &packed);
+    return packed;
+}
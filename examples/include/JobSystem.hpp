@@ -0,0 +1,444 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Profiler.hpp"
+
+/**
+ * A pool of worker threads that share work by stealing.
+ *
+ * Every worker owns a lock free deque (Chase-Lev). It pushes and pops jobs
+ * at the bottom, idle workers steal from the top of the others. The thread
+ * that creates the system is worker 0: it runs jobs while it waits on a
+ * Counter and is the only thread that drains the main queue, which is where
+ * jobs that need the GL context go. Threads outside the system submit
+ * through a locked queue.
+ *
+ * Jobs must not throw, an exception escaping a job terminates the program.
+ */
+class JobSystem {
+    struct Job;
+
+public:
+    /**
+     * Counts unfinished jobs. A job submitted with a counter increments it
+     * and decrements it when done, wait() returns once it is back to zero.
+     * Jobs can also be held back until a counter reaches zero, see run().
+     */
+    class Counter {
+        std::atomic<std::size_t> pending;
+        std::mutex mutex;
+        std::vector<Job *> continuations;
+
+        friend class JobSystem;
+
+    public:
+        Counter() : pending(0) {}
+
+        Counter(const Counter &) = delete;
+        Counter & operator=(const Counter &) = delete;
+
+        /**
+         * Only wait() guarantees that the last job is done with the
+         * counter, wait before destroying it.
+         */
+        bool done() const {
+            return pending.load(std::memory_order_acquire) == 0;
+        }
+    };
+
+private:
+    struct Job {
+        std::function<void()> function;
+        Counter * counter;
+    };
+
+    /**
+     * A fixed size Chase-Lev deque after Lê et al., "Correct and Efficient
+     * Work-Stealing for Weak Memory Models". push() and pop() are only
+     * called by the owner, steal() by any thread.
+     */
+    class Deque {
+    public:
+        static constexpr std::int64_t Capacity = 4096;
+
+    private:
+        std::atomic<std::int64_t> top;
+        std::atomic<std::int64_t> bottom;
+        std::atomic<Job *> jobs[Capacity];
+
+    public:
+        Deque() : top(0), bottom(0) {
+            for (auto & job : jobs) {
+                job.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @return false if the deque is full
+         */
+        bool push(Job * job) {
+            std::int64_t b = bottom.load(std::memory_order_relaxed);
+            std::int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= Capacity)
+                return false;
+            jobs[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        Job * pop() {
+            std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            Job * job = jobs[b & (Capacity - 1)].load(std::memory_order_relaxed);
+            if (t == b) {
+                // the last job, race the thieves for it
+                if (!top.compare_exchange_strong(t, t + 1,
+                                                 std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed))
+                    job = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        Job * steal() {
+            std::int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return nullptr;
+            Job * job = jobs[t & (Capacity - 1)].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t, t + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed))
+                return nullptr;
+            return job;
+        }
+    };
+
+    /**
+     * The system and worker index of the calling thread.
+     */
+    struct ThreadState {
+        const JobSystem * system = nullptr;
+        unsigned index = 0;
+    };
+
+    static constexpr unsigned NoWorker = ~0u;
+
+    std::vector<std::unique_ptr<Deque>> deques;
+    std::vector<std::thread> workers;
+
+    std::mutex injectedMutex;
+    std::deque<Job *> injected;
+
+    std::mutex mainMutex;
+    std::vector<std::function<void()>> mainJobs;
+
+    // jobs sitting in a queue, idle workers sleep while this is zero
+    std::atomic<std::size_t> queued;
+    std::atomic<unsigned> sleeping;
+    std::atomic<bool> stopping;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+public:
+    /**
+     * Start threads - 1 workers, the calling thread is the last one.
+     *
+     * @param threads the total number of threads, 0 for one per core
+     */
+    explicit JobSystem(unsigned threads = 0)
+        : queued(0), sleeping(0), stopping(false) {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < threads; i++) {
+            deques.emplace_back(new Deque());
+        }
+        threadState() = {this, 0};
+        for (unsigned i = 1; i < threads; i++) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem & operator=(const JobSystem &) = delete;
+
+    /**
+     * Stop the workers. Every counter must have been waited on, jobs still
+     * queued are dropped.
+     */
+    ~JobSystem() {
+        stopping = true;
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_all();
+        for (auto & worker : workers) {
+            worker.join();
+        }
+        if (threadState().system == this)
+            threadState() = {};
+    }
+
+    /**
+     * The number of threads that run jobs, including the main thread.
+     */
+    unsigned getThreadCount() const {
+        return deques.size();
+    }
+
+    /**
+     * The index of the calling thread for per thread storage, 0 for the
+     * thread that created the system and getThreadCount() for threads
+     * outside it.
+     */
+    unsigned getThreadIndex() const {
+        unsigned index = workerIndex();
+        return index == NoWorker ? getThreadCount() : index;
+    }
+
+    /**
+     * Queue a job on any worker.
+     *
+     * @param counter incremented now and decremented when the job is done
+     */
+    void run(std::function<void()> function, Counter * counter = nullptr) {
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        enqueue(new Job {std::move(function), counter});
+    }
+
+    /**
+     * Queue a job once every job counted by after is done.
+     *
+     * @param counter incremented now and decremented when the job is done
+     * @param after the counter the job depends on
+     */
+    void run(std::function<void()> function, Counter * counter, Counter & after) {
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        Job * job = new Job {std::move(function), counter};
+        {
+            std::lock_guard<std::mutex> lock(after.mutex);
+            if (after.pending.load(std::memory_order_acquire) > 0) {
+                after.continuations.push_back(job);
+                return;
+            }
+        }
+        enqueue(job);
+    }
+
+    /**
+     * Queue a job for the main thread, safe to call from any thread. Main
+     * jobs run in pumpMain() and while the main thread waits.
+     */
+    void runOnMain(std::function<void()> function) {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        mainJobs.push_back(std::move(function));
+    }
+
+    /**
+     * Run the queued main thread jobs. Only call from the main thread, once
+     * per frame for example.
+     *
+     * @return the number of jobs that ran
+     */
+    std::size_t pumpMain() {
+        std::vector<std::function<void()>> jobs;
+        {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            jobs.swap(mainJobs);
+        }
+        for (auto & job : jobs) {
+            job();
+        }
+        return jobs.size();
+    }
+
+    /**
+     * Run jobs on the calling thread until counter reaches zero.
+     */
+    void wait(Counter & counter) {
+        unsigned index = workerIndex();
+        unsigned idle = 0;
+        while (!counter.done()) {
+            if (runOne(index) || (index == 0 && pumpMain() > 0)) {
+                idle = 0;
+            }
+            else if (++idle > 64) {
+                std::this_thread::yield();
+            }
+        }
+        std::lock_guard<std::mutex> lock(counter.mutex);
+    }
+
+    /**
+     * Call function(begin, end) over [first, last) in chunks of grain
+     * indices on every thread and return when all chunks are done. Threads
+     * take the next chunk from a shared index, so uneven chunks balance
+     * themselves.
+     *
+     * @param grain the chunk size, 0 to pick one that gives each thread
+     *              about 8 chunks
+     */
+    template<typename F>
+    void parallelFor(std::size_t first, std::size_t last, std::size_t grain, F && function) {
+        if (first >= last)
+            return;
+        std::size_t count = last - first;
+        if (grain == 0)
+            grain = std::max<std::size_t>(1, count / (getThreadCount() * 8));
+        std::size_t chunks = (count + grain - 1) / grain;
+        if (chunks == 1) {
+            function(first, last);
+            return;
+        }
+
+        std::atomic<std::size_t> next(first);
+        auto loop = [&] {
+            for (;;) {
+                std::size_t begin = next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= last)
+                    break;
+                function(begin, std::min(last, begin + grain));
+            }
+        };
+
+        Counter counter;
+        std::size_t helpers = std::min<std::size_t>(chunks, getThreadCount()) - 1;
+        for (std::size_t i = 0; i < helpers; i++) {
+            run(loop, &counter);
+        }
+        loop();
+        wait(counter);
+    }
+
+private:
+    static ThreadState & threadState() {
+        static thread_local ThreadState state;
+        return state;
+    }
+
+    unsigned workerIndex() const {
+        const auto & state = threadState();
+        return state.system == this ? state.index : NoWorker;
+    }
+
+    void enqueue(Job * job) {
+        unsigned index = workerIndex();
+        queued.fetch_add(1);
+        if (index != NoWorker) {
+            if (!deques[index]->push(job)) {
+                // full, run it inline instead of growing the deque
+                queued.fetch_sub(1);
+                execute(job);
+                return;
+            }
+        }
+        else {
+            std::lock_guard<std::mutex> lock(injectedMutex);
+            injected.push_back(job);
+        }
+        if (sleeping.load() > 0) {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+            }
+            wake.notify_one();
+        }
+    }
+
+    Job * find(unsigned index) {
+        Job * job = nullptr;
+        if (index != NoWorker)
+            job = deques[index]->pop();
+        if (!job) {
+            std::lock_guard<std::mutex> lock(injectedMutex);
+            if (!injected.empty()) {
+                job = injected.front();
+                injected.pop_front();
+            }
+        }
+        // steal starting after our own deque so thieves spread out
+        unsigned n = deques.size();
+        unsigned start = index == NoWorker ? 0 : index + 1;
+        for (unsigned i = 0; !job && i < n; i++) {
+            unsigned victim = (start + i) % n;
+            if (victim != index)
+                job = deques[victim]->steal();
+        }
+        return job;
+    }
+
+    bool runOne(unsigned index) {
+        Job * job = find(index);
+        if (!job)
+            return false;
+        queued.fetch_sub(1);
+        execute(job);
+        return true;
+    }
+
+    void execute(Job * job) {
+        {
+            PROFILE_SCOPE("JobSystem::job");
+            job->function();
+        }
+        Counter * counter = job->counter;
+        delete job;
+        if (!counter)
+            return;
+
+        // decrement under the lock, wait() takes it once more before
+        // returning so the counter is not destroyed while we hold it
+        std::vector<Job *> ready;
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ready.swap(counter->continuations);
+        }
+        for (auto * next : ready) {
+            enqueue(next);
+        }
+    }
+
+    void workerLoop(unsigned index) {
+        threadState() = {this, index};
+        PROFILE_THREAD("worker " + std::to_string(index));
+        unsigned idle = 0;
+        while (!stopping.load(std::memory_order_relaxed)) {
+            if (runOne(index)) {
+                idle = 0;
+            }
+            else if (++idle < 64) {
+                std::this_thread::yield();
+            }
+            else {
+                sleeping.fetch_add(1);
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wake.wait(lock, [this] { return queued.load() > 0 || stopping.load(); });
+                sleeping.fetch_sub(1);
+                idle = 0;
+            }
+        }
+    }
+};
@@ -0,0 +1,481 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <glm/glm.hpp>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "JobSystem.hpp"
+
+/**
+ * A range of MeshLods::indices and how far it strays from the source mesh.
+ */
+struct LodLevel {
+    std::uint32_t firstIndex;
+    std::uint32_t indexCount;
+    // object space distance, 0 for the source mesh
+    float error;
+
+    /**
+     * The offset to pass to glDrawElements for 32 bit indices.
+     */
+    const void * offset() const {
+        return reinterpret_cast<const void *>(firstIndex * sizeof(std::uint32_t));
+    }
+};
+
+/**
+ * Triangle lists of every level of detail of one mesh, stored back to back
+ * in one index array, finest first. Every level indexes the same vertices,
+ * so switching level is only a different range of the element buffer.
+ */
+struct MeshLods {
+    std::vector<std::uint32_t> indices;
+    std::vector<LodLevel> levels;
+};
+
+/**
+ * Quadric error edge collapse after Garland and Heckbert, "Surface
+ * Simplification Using Quadric Error Metrics".
+ *
+ * A vertex is only ever collapsed onto one of its neighbours, never moved,
+ * so the result is a new index list over the original vertices. Vertices
+ * with identical positions are welded while simplifying so attribute seams
+ * do not tear, corners on a seam that moved take the attributes of the
+ * vertex they collapsed onto. Open borders are kept in place by extra
+ * planes along the border edges.
+ */
+class MeshSimplifier {
+public:
+    /**
+     * Collapse edges until at most targetIndexCount indices are left or no
+     * edge can be collapsed without flipping a triangle.
+     *
+     * @param positions the vertex positions
+     * @param indices a triangle list
+     * @param targetIndexCount the number of indices to reduce to
+     * @param error set to the largest distance error of a collapse
+     *
+     * @return the simplified triangle list
+     */
+    static std::vector<std::uint32_t> simplify(const std::vector<glm::vec3> & positions,
+                                               const std::vector<std::uint32_t> & indices,
+                                               std::size_t targetIndexCount,
+                                               float * error = nullptr) {
+        Collapser collapser(positions, indices);
+        return collapser.run(targetIndexCount, error);
+    }
+
+    /**
+     * Build levels of detail, each with ratio times the triangles of the one
+     * before. Stops early when a level can not be reduced any further.
+     *
+     * @param levels the maximum number of levels, including the source
+     */
+    static MeshLods buildLods(const std::vector<glm::vec3> & positions,
+                              const std::vector<std::uint32_t> & indices,
+                              unsigned levels = 4,
+                              float ratio = 0.5f) {
+        std::vector<std::vector<std::uint32_t>> lists(levels);
+        std::vector<float> errors(levels, 0.0f);
+        for (unsigned l = 1; l < levels; l++) {
+            simplifyLevel(positions, indices, ratio, l, lists[l], errors[l]);
+        }
+        return combine(indices, lists, errors);
+    }
+
+    /**
+     * Like buildLods() but the levels are simplified in parallel, each one
+     * straight from the source mesh.
+     */
+    static MeshLods buildLods(const std::vector<glm::vec3> & positions,
+                              const std::vector<std::uint32_t> & indices,
+                              JobSystem & jobs,
+                              unsigned levels = 4,
+                              float ratio = 0.5f) {
+        std::vector<std::vector<std::uint32_t>> lists(levels);
+        std::vector<float> errors(levels, 0.0f);
+        jobs.parallelFor(1, levels, 1, [&](std::size_t first, std::size_t last) {
+            for (std::size_t l = first; l < last; l++) {
+                simplifyLevel(positions, indices, ratio, l, lists[l], errors[l]);
+            }
+        });
+        return combine(indices, lists, errors);
+    }
+
+private:
+    static void simplifyLevel(const std::vector<glm::vec3> & positions,
+                              const std::vector<std::uint32_t> & indices,
+                              float ratio,
+                              std::size_t level,
+                              std::vector<std::uint32_t> & out,
+                              float & error) {
+        std::size_t target = std::size_t(indices.size() / 3 * std::pow(ratio, level)) * 3;
+        out = simplify(positions, indices, target, &error);
+    }
+
+    static MeshLods combine(const std::vector<std::uint32_t> & source,
+                            std::vector<std::vector<std::uint32_t>> & lists,
+                            std::vector<float> & errors) {
+        MeshLods lods;
+        lods.indices = source;
+        lods.levels.push_back({0, std::uint32_t(source.size()), 0.0f});
+        for (std::size_t l = 1; l < lists.size(); l++) {
+            const LodLevel previous = lods.levels.back();
+            // a level that barely shrank is not worth a switch
+            if (lists[l].empty() || lists[l].size() > previous.indexCount * 9 / 10)
+                break;
+            lods.levels.push_back({std::uint32_t(lods.indices.size()),
+                                   std::uint32_t(lists[l].size()),
+                                   std::max(errors[l], previous.error)});
+            lods.indices.insert(lods.indices.end(), lists[l].begin(), lists[l].end());
+        }
+        return lods;
+    }
+
+    /**
+     * A symmetric 4x4 matrix, the sum of squared distances to a set of
+     * planes.
+     */
+    struct Quadric {
+        double a[10] = {};
+
+        void addPlane(const glm::dvec3 & n, double d, double weight = 1.0) {
+            const double p[4] = {n.x, n.y, n.z, d};
+            int k = 0;
+            for (int i = 0; i < 4; i++) {
+                for (int j = i; j < 4; j++) {
+                    a[k++] += weight * p[i] * p[j];
+                }
+            }
+        }
+
+        Quadric & operator+=(const Quadric & other) {
+            for (int i = 0; i < 10; i++) {
+                a[i] += other.a[i];
+            }
+            return *this;
+        }
+
+        double evaluate(const glm::vec3 & v) const {
+            const double x = v.x, y = v.y, z = v.z;
+            return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+                   + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+                   + a[7] * z * z + 2 * a[8] * z + a[9];
+        }
+    };
+
+    struct Candidate {
+        double cost;
+        std::uint32_t from, to;
+        std::uint32_t fromVersion, toVersion;
+
+        bool operator>(const Candidate & other) const {
+            return cost > other.cost;
+        }
+    };
+
+    class Collapser {
+        const std::vector<glm::vec3> & positions;
+        const std::vector<std::uint32_t> & source;
+
+        // welded vertex of every vertex, the first one with its position
+        std::vector<std::uint32_t> weld;
+        // welded corners, 3 per triangle
+        std::vector<std::uint32_t> corners;
+        std::vector<bool> triangleAlive;
+        std::size_t liveTriangles;
+
+        std::vector<Quadric> quadrics;
+        std::vector<std::vector<std::uint32_t>> triangles;
+        std::vector<std::uint32_t> version;
+        std::vector<bool> vertexAlive;
+
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+        std::vector<std::uint32_t> neighbours;
+
+    public:
+        Collapser(const std::vector<glm::vec3> & positions,
+                  const std::vector<std::uint32_t> & indices)
+            : positions(positions),
+              source(indices),
+              weld(positions.size()),
+              corners(indices.size()),
+              triangleAlive(indices.size() / 3, true),
+              liveTriangles(indices.size() / 3),
+              quadrics(positions.size()),
+              triangles(positions.size()),
+              version(positions.size(), 0),
+              vertexAlive(positions.size(), true) {
+            weldPositions();
+            for (std::size_t i = 0; i < indices.size(); i++) {
+                corners[i] = weld[indices[i]];
+            }
+            for (std::size_t t = 0; t < liveTriangles; t++) {
+                for (int c = 0; c < 3; c++) {
+                    triangles[corners[t * 3 + c]].push_back(t);
+                }
+            }
+            buildQuadrics();
+        }
+
+        std::vector<std::uint32_t> run(std::size_t targetIndexCount, float * error) {
+            double maxCost = 0.0;
+            while (liveTriangles * 3 > targetIndexCount && !heap.empty()) {
+                Candidate c = heap.top();
+                heap.pop();
+                if (!vertexAlive[c.from] || !vertexAlive[c.to]
+                    || version[c.from] != c.fromVersion
+                    || version[c.to] != c.toVersion)
+                    continue;
+                if (flips(c.from, c.to))
+                    continue;
+                collapse(c.from, c.to);
+                maxCost = std::max(maxCost, c.cost);
+            }
+            if (error)
+                *error = float(std::sqrt(std::max(maxCost, 0.0)));
+
+            std::vector<std::uint32_t> result;
+            result.reserve(liveTriangles * 3);
+            for (std::size_t t = 0; t < triangleAlive.size(); t++) {
+                if (!triangleAlive[t])
+                    continue;
+                for (int c = 0; c < 3; c++) {
+                    std::uint32_t original = source[t * 3 + c];
+                    std::uint32_t welded = corners[t * 3 + c];
+                    // keep the corner's own attributes unless it moved
+                    result.push_back(weld[original] == welded ? original : welded);
+                }
+            }
+            return result;
+        }
+
+    private:
+        void weldPositions() {
+            struct Hash {
+                std::size_t operator()(const glm::vec3 & p) const {
+                    // adding zero turns -0 into 0, they compare equal
+                    glm::vec3 q = p + glm::vec3(0.0f);
+                    std::uint32_t h[3];
+                    std::memcpy(h, &q, sizeof(h));
+                    return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+                }
+            };
+            std::unordered_map<glm::vec3, std::uint32_t, Hash> first;
+            first.reserve(positions.size());
+            for (std::uint32_t i = 0; i < positions.size(); i++) {
+                weld[i] = first.emplace(positions[i], i).first->second;
+                if (weld[i] != i)
+                    vertexAlive[i] = false;
+            }
+        }
+
+        static std::uint64_t edgeKey(std::uint32_t a, std::uint32_t b) {
+            return std::uint64_t(std::min(a, b)) << 32 | std::max(a, b);
+        }
+
+        /**
+         * Sum the planes of the triangles around every vertex and queue
+         * every edge once.
+         */
+        void buildQuadrics() {
+            // sorted edges, a border edge appears in one triangle only
+            std::vector<std::uint64_t> edges;
+            edges.reserve(corners.size());
+            for (std::size_t i = 0; i < corners.size(); i += 3) {
+                for (int c = 0; c < 3; c++) {
+                    edges.push_back(edgeKey(corners[i + c], corners[i + (c + 1) % 3]));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            auto border = [&](std::uint64_t key) {
+                auto range = std::equal_range(edges.begin(), edges.end(), key);
+                return range.second - range.first == 1;
+            };
+
+            for (std::size_t t = 0; t < liveTriangles; t++) {
+                const std::uint32_t * v = &corners[t * 3];
+                glm::dvec3 p0(positions[v[0]]), p1(positions[v[1]]), p2(positions[v[2]]);
+                glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+                double length = glm::length(n);
+                if (length == 0.0)
+                    continue;
+                n /= length;
+                Quadric q;
+                q.addPlane(n, -glm::dot(n, p0));
+                for (int c = 0; c < 3; c++) {
+                    quadrics[v[c]] += q;
+                }
+
+                for (int c = 0; c < 3; c++) {
+                    std::uint32_t a = v[c], b = v[(c + 1) % 3];
+                    if (!border(edgeKey(a, b)))
+                        continue;
+                    // a plane through the border edge, perpendicular to the
+                    // triangle, heavily weighted to pin the border
+                    glm::dvec3 pa(positions[a]), pb(positions[b]);
+                    glm::dvec3 m = glm::cross(pb - pa, n);
+                    double ml = glm::length(m);
+                    if (ml == 0.0)
+                        continue;
+                    m /= ml;
+                    Quadric plane;
+                    plane.addPlane(m, -glm::dot(m, pa), 100.0);
+                    quadrics[a] += plane;
+                    quadrics[b] += plane;
+                }
+            }
+
+            edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+            for (auto key : edges) {
+                pushEdge(std::uint32_t(key >> 32), std::uint32_t(key));
+            }
+        }
+
+        void pushEdge(std::uint32_t a, std::uint32_t b) {
+            Quadric q = quadrics[a];
+            q += quadrics[b];
+            double toB = q.evaluate(positions[b]);
+            double toA = q.evaluate(positions[a]);
+            if (toB <= toA)
+                heap.push({toB, a, b, version[a], version[b]});
+            else
+                heap.push({toA, b, a, version[b], version[a]});
+        }
+
+        /**
+         * Would moving from onto to turn a remaining triangle over?
+         */
+        bool flips(std::uint32_t from, std::uint32_t to) const {
+            for (auto t : triangles[from]) {
+                if (!triangleAlive[t])
+                    continue;
+                const std::uint32_t * v = &corners[t * 3];
+                if (v[0] == to || v[1] == to || v[2] == to)
+                    continue;
+                glm::vec3 before[3], after[3];
+                for (int c = 0; c < 3; c++) {
+                    before[c] = positions[v[c]];
+                    after[c] = positions[v[c] == from ? to : v[c]];
+                }
+                glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(n0, n1) <= 0.0f)
+                    return true;
+            }
+            return false;
+        }
+
+        void collapse(std::uint32_t from, std::uint32_t to) {
+            for (auto t : triangles[from]) {
+                if (!triangleAlive[t])
+                    continue;
+                std::uint32_t * v = &corners[t * 3];
+                if (v[0] == to || v[1] == to || v[2] == to) {
+                    triangleAlive[t] = false;
+                    liveTriangles--;
+                    continue;
+                }
+                for (int c = 0; c < 3; c++) {
+                    if (v[c] == from)
+                        v[c] = to;
+                }
+                triangles[to].push_back(t);
+            }
+            triangles[from].clear();
+            vertexAlive[from] = false;
+            quadrics[to] += quadrics[from];
+            version[to]++;
+
+            // drop dead triangles and queue the edges around the new vertex
+            auto & around = triangles[to];
+            around.erase(std::remove_if(around.begin(), around.end(),
+                                        [&](std::uint32_t t) { return !triangleAlive[t]; }),
+                         around.end());
+            neighbours.clear();
+            for (auto t : around) {
+                for (int c = 0; c < 3; c++) {
+                    if (corners[t * 3 + c] != to)
+                        neighbours.push_back(corners[t * 3 + c]);
+                }
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+                             neighbours.end());
+            for (auto n : neighbours) {
+                pushEdge(to, n);
+            }
+        }
+    };
+};
+
+/**
+ * Picks a level of detail per object from how large its simplification
+ * error would appear on screen.
+ *
+ * The error of a level projected at the distance of the object's bounding
+ * sphere must stay below a pixel tolerance. To keep objects near a
+ * threshold from switching back and forth every frame, moving to a coarser
+ * level needs the error to be below tolerance * (1 - hysteresis), while the
+ * current level is only left for a finer one once it exceeds the full
+ * tolerance.
+ */
+class LodSelector {
+    glm::vec3 eye;
+    float pixelsPerUnit;
+    float tolerance;
+    float hysteresis;
+
+public:
+    /**
+     * @param tolerance the largest error on screen in pixels
+     * @param hysteresis the fraction of tolerance a coarser level must beat
+     */
+    explicit LodSelector(float tolerance = 1.0f, float hysteresis = 0.25f)
+        : eye(0), pixelsPerUnit(1), tolerance(tolerance), hysteresis(hysteresis) {}
+
+    /**
+     * @param eye the camera position
+     * @param fovY the vertical field of view in radians
+     * @param viewportHeight the height of the viewport in pixels
+     */
+    void setView(const glm::vec3 & eye, float fovY, float viewportHeight) {
+        this->eye = eye;
+        pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY / 2.0f));
+    }
+
+    /**
+     * @param lods the levels of the object's mesh
+     * @param center the world space center of the bounding sphere
+     * @param radius the world space radius of the bounding sphere
+     * @param scale the object's world scale, errors are in object space
+     * @param current the level used last frame
+     *
+     * @return the level to draw
+     */
+    std::uint32_t select(const MeshLods & lods,
+                         const glm::vec3 & center,
+                         float radius,
+                         float scale,
+                         std::uint32_t current) const {
+        float distance = std::max(glm::length(center - eye) - radius, 1e-3f);
+        float project = scale * pixelsPerUnit / distance;
+
+        std::uint32_t last = lods.levels.size() - 1;
+        current = std::min(current, last);
+        // finer while the current level shows too much error
+        while (current > 0 && lods.levels[current].error * project > tolerance)
+            current--;
+        // coarser only with some margin
+        float coarse = tolerance * (1.0f - hysteresis);
+        while (current < last && lods.levels[current + 1].error * project <= coarse)
+            current++;
+        return current;
+    }
+};
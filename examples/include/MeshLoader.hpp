@@ -0,0 +1,1172 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "JobSystem.hpp"
+
+/**
+ * One vertex of a loaded mesh, interleaved as it goes to GL.
+ */
+struct MeshVertex {
+    glm::vec3 position {0};
+    glm::vec3 normal {0};
+    glm::vec2 texCoord {0};
+};
+
+/**
+ * An indexed triangle list.
+ */
+struct MeshData {
+    std::vector<MeshVertex> vertices;
+    std::vector<std::uint32_t> indices;
+
+    /**
+     * The attributes of the interleaved vertices, position, normal and
+     * texture coordinates at location, location + 1 and location + 2.
+     */
+    static std::vector<Attribute> attributes(GLuint location = 0) {
+        const GLsizei stride = sizeof(MeshVertex);
+        return {
+            {location, 3, GL_FLOAT, GL_FALSE, stride,
+             reinterpret_cast<const void *>(offsetof(MeshVertex, position))},
+            {location + 1, 3, GL_FLOAT, GL_FALSE, stride,
+             reinterpret_cast<const void *>(offsetof(MeshVertex, normal))},
+            {location + 2, 2, GL_FLOAT, GL_FALSE, stride,
+             reinterpret_cast<const void *>(offsetof(MeshVertex, texCoord))},
+        };
+    }
+
+    /**
+     * Upload to a new BufferArray with one interleaved vertex buffer and an
+     * element buffer. Draw it with
+     * drawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0).
+     */
+    BufferArray toBufferArray(GLenum usage = GL_STATIC_DRAW) const {
+        BufferArray array(std::vector<std::vector<Attribute>> {attributes()});
+        array.bind();
+        array.bufferData(0, vertices.size() * sizeof(MeshVertex), vertices.data(), usage);
+        array.bufferElements(indices.size() * sizeof(std::uint32_t), indices.data(), usage);
+        array.unbind();
+        return array;
+    }
+};
+
+/**
+ * Loads triangle meshes from Wavefront OBJ and glTF 2.0 files.
+ *
+ * OBJ text is split into chunks at line breaks that are parsed in parallel
+ * on a JobSystem, numbers are read with std::from_chars. Faces are fanned
+ * into triangles and corners that use the same position, texture
+ * coordinate and normal are welded into one vertex. Groups, materials and
+ * smoothing groups are ignored.
+ *
+ * glTF files may be .gltf with external or data: URI buffers, or binary
+ * .glb. The triangles of every mesh in the default scene are transformed by
+ * their node and merged into one mesh, the primitives are decoded in
+ * parallel. Sparse accessors are not supported.
+ *
+ * Texture coordinates have their origin at the top left like glTF, which
+ * matches images uploaded without flipping, so OBJ coordinates are flipped.
+ * Vertices without normals or texture coordinates get zeros.
+ */
+class MeshLoader {
+public:
+    class MeshLoadException : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * OBJ text is not split into chunks smaller than this.
+     */
+    static constexpr std::size_t MinChunk = 1 << 18;
+
+    /**
+     * Load a .obj, .gltf or .glb file.
+     *
+     * @param jobs the job system to parse on, nullptr for this thread
+     *
+     * @throws MeshLoadException if the file can not be read or parsed
+     */
+    static MeshData fromPath(const std::string & path, JobSystem * jobs = nullptr) {
+        std::string contents = readFile(path);
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        if (hasExtension(path, ".obj"))
+            return loadObj(contents, jobs);
+        if (hasExtension(path, ".gltf"))
+            return loadGltf(contents, directory, jobs);
+        if (hasExtension(path, ".glb"))
+            return loadGlb(contents, directory, jobs);
+        throw MeshLoadException("Unknown mesh format: " + path);
+    }
+
+    /**
+     * Parse the contents of an OBJ file.
+     *
+     * @throws MeshLoadException on malformed lines or indices out of range
+     */
+    static MeshData loadObj(const std::string & text, JobSystem * jobs = nullptr) {
+        // split at line breaks, a few chunks per thread to balance them
+        std::size_t chunkCount = 1;
+        if (jobs)
+            chunkCount = std::max<std::size_t>(
+                1, std::min<std::size_t>(jobs->getThreadCount() * 4, text.size() / MinChunk));
+        std::vector<const char *> bounds {text.data()};
+        const char * end = text.data() + text.size();
+        for (std::size_t c = 1; c < chunkCount; c++) {
+            const char * p = std::max(text.data() + text.size() * c / chunkCount, bounds.back());
+            p = static_cast<const char *>(std::memchr(p, '\n', end - p));
+            if (!p)
+                break;
+            bounds.push_back(p + 1);
+        }
+        bounds.push_back(end);
+        chunkCount = bounds.size() - 1;
+
+        std::vector<ObjChunk> chunks(chunkCount);
+        forEach(jobs, chunkCount, [&](std::size_t c) {
+            parseObj(bounds[c], bounds[c + 1], chunks[c]);
+        });
+        rethrow(chunks);
+
+        // the chunks only know their own counts, relative indices and the
+        // merged arrays need the counts of the chunks before them
+        std::vector<ObjBase> bases(chunkCount + 1);
+        for (std::size_t c = 0; c < chunkCount; c++) {
+            bases[c + 1].count[0] = bases[c].count[0] + chunks[c].positions.size();
+            bases[c + 1].count[1] = bases[c].count[1] + chunks[c].texCoords.size();
+            bases[c + 1].count[2] = bases[c].count[2] + chunks[c].normals.size();
+            bases[c + 1].corners = bases[c].corners + chunks[c].corners.size();
+        }
+        const ObjBase & total = bases.back();
+
+        std::vector<glm::vec3> positions(total.count[0]);
+        std::vector<glm::vec2> texCoords(total.count[1]);
+        std::vector<glm::vec3> normals(total.count[2]);
+        std::vector<ObjKey> keys(total.corners);
+        forEach(jobs, chunkCount, [&](std::size_t c) {
+            ObjChunk & chunk = chunks[c];
+            const ObjBase & base = bases[c];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + base.count[0]);
+            std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + base.count[1]);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + base.count[2]);
+            try {
+                for (std::size_t i = 0; i < chunk.corners.size(); i++) {
+                    keys[base.corners + i] = resolve(chunk.corners[i], base, total);
+                }
+            }
+            catch (...) {
+                chunk.error = std::current_exception();
+            }
+        });
+        rethrow(chunks);
+
+        // weld corners with the same indices into one vertex
+        MeshData mesh;
+        mesh.indices.resize(keys.size());
+        std::vector<ObjKey> unique;
+        HashTable table(keys.size());
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            const ObjKey & key = keys[i];
+            std::uint32_t * slot = table.find(key.hash(), [&](std::uint32_t v) {
+                return unique[v] == key;
+            });
+            if (*slot == HashTable::Empty) {
+                *slot = unique.size();
+                unique.push_back(key);
+            }
+            mesh.indices[i] = *slot;
+        }
+
+        mesh.vertices.resize(unique.size());
+        forEach(jobs, unique.size(), [&](std::size_t i) {
+            const ObjKey & key = unique[i];
+            MeshVertex & v = mesh.vertices[i];
+            v.position = positions[key.index[0]];
+            if (key.index[1] >= 0)
+                v.texCoord = glm::vec2(texCoords[key.index[1]].x, 1.0f - texCoords[key.index[1]].y);
+            if (key.index[2] >= 0)
+                v.normal = normals[key.index[2]];
+        }, 4096);
+        return mesh;
+    }
+
+    /**
+     * Parse a .gltf file.
+     *
+     * @param directory where buffers with relative URIs are found
+     *
+     * @throws MeshLoadException on malformed JSON or unsupported data
+     */
+    static MeshData loadGltf(const std::string & json,
+                             const std::string & directory,
+                             JobSystem * jobs = nullptr) {
+        return loadGltf(json.data(), json.data() + json.size(), directory, nullptr, jobs);
+    }
+
+    /**
+     * Parse a binary .glb file.
+     *
+     * @param directory where buffers with relative URIs are found
+     *
+     * @throws MeshLoadException on malformed chunks, JSON or unsupported data
+     */
+    static MeshData loadGlb(const std::string & bytes,
+                            const std::string & directory,
+                            JobSystem * jobs = nullptr) {
+        const unsigned char * data = reinterpret_cast<const unsigned char *>(bytes.data());
+        if (bytes.size() < 20 || readU32(data) != 0x46546C67 || readU32(data + 4) != 2)
+            throw MeshLoadException("Not a glTF 2.0 binary");
+        std::size_t length = std::min<std::size_t>(readU32(data + 8), bytes.size());
+
+        const char * json = nullptr;
+        std::size_t jsonLength = 0;
+        std::string binary;
+        for (std::size_t offset = 12; offset + 8 <= length;) {
+            std::size_t chunkLength = readU32(data + offset);
+            std::uint32_t type = readU32(data + offset + 4);
+            if (offset + 8 + chunkLength > length)
+                throw MeshLoadException("glTF binary chunk out of range");
+            if (type == 0x4E4F534A) {
+                json = bytes.data() + offset + 8;
+                jsonLength = chunkLength;
+            }
+            else if (type == 0x004E4942 && binary.empty()) {
+                binary.assign(bytes.data() + offset + 8, chunkLength);
+            }
+            offset += 8 + chunkLength;
+        }
+        if (!json)
+            throw MeshLoadException("glTF binary without JSON");
+        return loadGltf(json, json + jsonLength, directory, &binary, jobs);
+    }
+
+    /**
+     * Merge bitwise identical vertices and remap the indices. The first of
+     * each set of duplicates is kept, in order.
+     */
+    static void weld(MeshData & mesh, JobSystem * jobs = nullptr) {
+        std::vector<std::uint64_t> hashes(mesh.vertices.size());
+        forEach(jobs, hashes.size(), [&](std::size_t i) {
+            hashes[i] = hashBytes(&mesh.vertices[i], sizeof(MeshVertex));
+        }, 4096);
+
+        std::vector<std::uint32_t> remap(mesh.vertices.size());
+        HashTable table(mesh.vertices.size());
+        std::uint32_t count = 0;
+        for (std::size_t i = 0; i < mesh.vertices.size(); i++) {
+            std::uint32_t * slot = table.find(hashes[i], [&](std::uint32_t v) {
+                return std::memcmp(&mesh.vertices[v], &mesh.vertices[i], sizeof(MeshVertex)) == 0;
+            });
+            if (*slot == HashTable::Empty) {
+                // kept vertices move down, never over one that is still to come
+                mesh.vertices[count] = mesh.vertices[i];
+                *slot = count++;
+            }
+            remap[i] = *slot;
+        }
+        mesh.vertices.resize(count);
+        for (auto & index : mesh.indices) {
+            index = remap[index];
+        }
+    }
+
+private:
+    struct ObjCorner {
+        std::int32_t index[3];
+        // bit k set when index[k] is relative to the start of the chunk
+        std::uint8_t relative;
+    };
+
+    struct ObjChunk {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texCoords;
+        std::vector<glm::vec3> normals;
+        std::vector<ObjCorner> corners;
+        std::exception_ptr error;
+    };
+
+    struct ObjBase {
+        std::size_t count[3] = {0, 0, 0};
+        std::size_t corners = 0;
+    };
+
+    /**
+     * The position, texture coordinate and normal index of a corner, -1
+     * when it has none.
+     */
+    struct ObjKey {
+        std::int32_t index[3];
+
+        bool operator==(const ObjKey & other) const {
+            return index[0] == other.index[0] && index[1] == other.index[1]
+                   && index[2] == other.index[2];
+        }
+
+        std::uint64_t hash() const {
+            return mix(std::uint64_t(std::uint32_t(index[0]))
+                       ^ std::uint64_t(std::uint32_t(index[1])) << 21
+                       ^ std::uint64_t(std::uint32_t(index[2])) << 42);
+        }
+    };
+
+    /**
+     * Open addressing from hashes to vertex indices, sized for a known
+     * number of entries.
+     */
+    class HashTable {
+        std::vector<std::uint32_t> slots;
+        std::size_t mask;
+
+    public:
+        static constexpr std::uint32_t Empty = ~0u;
+
+        explicit HashTable(std::size_t entries) {
+            std::size_t size = 16;
+            while (size < entries * 2)
+                size *= 2;
+            slots.assign(size, Empty);
+            mask = size - 1;
+        }
+
+        /**
+         * @return the slot holding an entry for which equal() is true, or
+         *         the empty slot to put it in
+         */
+        template<typename Equal>
+        std::uint32_t * find(std::uint64_t hash, Equal && equal) {
+            for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+                if (slots[i] == Empty || equal(slots[i]))
+                    return &slots[i];
+            }
+        }
+    };
+
+    /**
+     * A parsed JSON value, enough for glTF.
+     */
+    struct Json {
+        enum Type { Null, Bool, Number, String, Array, Object };
+
+        Type type = Null;
+        double number = 0;
+        std::string string;
+        std::vector<Json> items;
+        // the keys of an object, its values are in items
+        std::vector<std::string> keys;
+
+        const Json * find(const char * key) const {
+            if (type != Object)
+                return nullptr;
+            for (std::size_t i = 0; i < keys.size(); i++) {
+                if (keys[i] == key)
+                    return &items[i];
+            }
+            return nullptr;
+        }
+
+        double get(const char * key, double fallback) const {
+            const Json * value = find(key);
+            return value && value->type == Number ? value->number : fallback;
+        }
+
+        /**
+         * @throws MeshLoadException if key is missing or not an array
+         */
+        const std::vector<Json> & array(const char * key) const {
+            const Json * value = find(key);
+            if (!value || value->type != Array)
+                throw MeshLoadException(std::string("glTF without ") + key);
+            return value->items;
+        }
+    };
+
+    class JsonParser {
+        const char * p;
+        const char * end;
+
+    public:
+        JsonParser(const char * begin, const char * end) : p(begin), end(end) {}
+
+        Json parse() {
+            Json value = parseValue(0);
+            skipSpace();
+            if (p != end)
+                fail();
+            return value;
+        }
+
+    private:
+        [[noreturn]] static void fail() {
+            throw MeshLoadException("Malformed glTF JSON");
+        }
+
+        void skipSpace() {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+                p++;
+        }
+
+        void expect(char c) {
+            skipSpace();
+            if (p == end || *p != c)
+                fail();
+            p++;
+        }
+
+        /**
+         * @return true after a comma, false after close
+         */
+        bool next(char close) {
+            skipSpace();
+            if (p == end || (*p != ',' && *p != close))
+                fail();
+            return *p++ == ',';
+        }
+
+        bool consume(const char * word) {
+            std::size_t length = std::strlen(word);
+            if (std::size_t(end - p) < length || std::memcmp(p, word, length) != 0)
+                return false;
+            p += length;
+            return true;
+        }
+
+        Json parseValue(int depth) {
+            if (depth > 64)
+                fail();
+            skipSpace();
+            if (p == end)
+                fail();
+            Json value;
+            if (*p == '{') {
+                value.type = Json::Object;
+                p++;
+                skipSpace();
+                if (p < end && *p == '}') {
+                    p++;
+                    return value;
+                }
+                do {
+                    skipSpace();
+                    value.keys.push_back(parseString());
+                    expect(':');
+                    value.items.push_back(parseValue(depth + 1));
+                } while (next('}'));
+            }
+            else if (*p == '[') {
+                value.type = Json::Array;
+                p++;
+                skipSpace();
+                if (p < end && *p == ']') {
+                    p++;
+                    return value;
+                }
+                do {
+                    value.items.push_back(parseValue(depth + 1));
+                } while (next(']'));
+            }
+            else if (*p == '"') {
+                value.type = Json::String;
+                value.string = parseString();
+            }
+            else if (consume("true")) {
+                value.type = Json::Bool;
+                value.number = 1;
+            }
+            else if (consume("false")) {
+                value.type = Json::Bool;
+            }
+            else if (consume("null")) {
+            }
+            else {
+                value.type = Json::Number;
+                p = parseNumber(p, end, value.number);
+                if (!p)
+                    fail();
+            }
+            return value;
+        }
+
+        std::string parseString() {
+            if (p == end || *p != '"')
+                fail();
+            p++;
+            std::string string;
+            while (p < end && *p != '"') {
+                if (*p != '\\') {
+                    string += *p++;
+                    continue;
+                }
+                if (++p == end)
+                    fail();
+                char c = *p++;
+                switch (c) {
+                    case 'b':
+                        string += '\b';
+                        break;
+                    case 'f':
+                        string += '\f';
+                        break;
+                    case 'n':
+                        string += '\n';
+                        break;
+                    case 'r':
+                        string += '\r';
+                        break;
+                    case 't':
+                        string += '\t';
+                        break;
+                    case 'u': {
+                        unsigned code = parseHex4();
+                        if (code >= 0xD800 && code < 0xDC00) {
+                            // a high surrogate, combined with the low one
+                            // after it into one code point
+                            if (end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                                p += 2;
+                                unsigned low = parseHex4();
+                                if (low >= 0xDC00 && low < 0xE000) {
+                                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                                }
+                                else {
+                                    appendUtf8(string, 0xFFFD);
+                                    code = low;
+                                }
+                            }
+                        }
+                        // unpaired surrogates are not valid UTF-8
+                        if (code >= 0xD800 && code < 0xE000)
+                            code = 0xFFFD;
+                        appendUtf8(string, code);
+                    } break;
+                    default:
+                        string += c;
+                        break;
+                }
+            }
+            if (p == end)
+                fail();
+            p++;
+            return string;
+        }
+
+        unsigned parseHex4() {
+            unsigned code = 0;
+            if (end - p < 4 || std::from_chars(p, p + 4, code, 16).ptr != p + 4)
+                fail();
+            p += 4;
+            return code;
+        }
+
+        static void appendUtf8(std::string & string, unsigned code) {
+            if (code < 0x80) {
+                string += char(code);
+            }
+            else if (code < 0x800) {
+                string += char(0xC0 | code >> 6);
+                string += char(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000) {
+                string += char(0xE0 | code >> 12);
+                string += char(0x80 | (code >> 6 & 0x3F));
+                string += char(0x80 | (code & 0x3F));
+            }
+            else {
+                string += char(0xF0 | code >> 18);
+                string += char(0x80 | (code >> 12 & 0x3F));
+                string += char(0x80 | (code >> 6 & 0x3F));
+                string += char(0x80 | (code & 0x3F));
+            }
+        }
+    };
+
+    /**
+     * Where the elements of a glTF accessor are.
+     */
+    struct Accessor {
+        const unsigned char * data;
+        std::size_t count;
+        std::size_t stride;
+        int componentType;
+        int components;
+        bool normalized;
+
+        float get(std::size_t i, int component) const {
+            const unsigned char * p = data + i * stride;
+            switch (componentType) {
+                case 5120: {
+                    auto v = std::int8_t(p[component]);
+                    return normalized ? std::max(v / 127.0f, -1.0f) : v;
+                }
+                case 5121:
+                    return normalized ? p[component] / 255.0f : p[component];
+                case 5122: {
+                    std::int16_t v;
+                    std::memcpy(&v, p + 2 * component, 2);
+                    return normalized ? std::max(v / 32767.0f, -1.0f) : v;
+                }
+                case 5123: {
+                    std::uint16_t v;
+                    std::memcpy(&v, p + 2 * component, 2);
+                    return normalized ? v / 65535.0f : v;
+                }
+                case 5125:
+                    return readU32(p + 4 * component);
+                default: {
+                    float v;
+                    std::memcpy(&v, p + 4 * component, 4);
+                    return v;
+                }
+            }
+        }
+
+        std::uint32_t getIndex(std::size_t i) const {
+            const unsigned char * p = data + i * stride;
+            switch (componentType) {
+                case 5121:
+                    return p[0];
+                case 5123: {
+                    std::uint16_t v;
+                    std::memcpy(&v, p, 2);
+                    return v;
+                }
+                default:
+                    return readU32(p);
+            }
+        }
+    };
+
+    struct GltfInstance {
+        const Json * primitive;
+        glm::mat4 transform;
+    };
+
+    static MeshData loadGltf(const char * begin,
+                             const char * end,
+                             const std::string & directory,
+                             const std::string * binary,
+                             JobSystem * jobs) {
+        Json document = JsonParser(begin, end).parse();
+
+        std::vector<std::string> buffers;
+        const Json * bufferList = document.find("buffers");
+        for (std::size_t i = 0; bufferList && i < bufferList->items.size(); i++) {
+            const Json * uri = bufferList->items[i].find("uri");
+            if (!uri) {
+                if (!binary || i != 0)
+                    throw MeshLoadException("glTF buffer without data");
+                buffers.push_back(*binary);
+            }
+            else if (uri->string.compare(0, 5, "data:") == 0) {
+                buffers.push_back(decodeBase64(uri->string.substr(uri->string.find(',') + 1)));
+            }
+            else {
+                buffers.push_back(readFile(directory + uri->string));
+            }
+        }
+
+        // every mesh instance of the scene with its transform
+        std::vector<GltfInstance> instances;
+        const Json * meshes = document.find("meshes");
+        const Json * nodes = document.find("nodes");
+        const Json * scenes = document.find("scenes");
+        if (scenes && nodes && !scenes->items.empty()) {
+            std::size_t scene = std::size_t(document.get("scene", 0));
+            if (scene >= scenes->items.size())
+                throw MeshLoadException("glTF scene out of range");
+            for (auto & root : scenes->items[scene].array("nodes")) {
+                addNode(document, std::size_t(root.number), glm::mat4(1), instances, 0);
+            }
+        }
+        else if (meshes) {
+            for (auto & mesh : meshes->items) {
+                for (auto & primitive : mesh.array("primitives")) {
+                    instances.push_back({&primitive, glm::mat4(1)});
+                }
+            }
+        }
+
+        std::vector<MeshData> parts(instances.size());
+        std::vector<std::exception_ptr> errors(instances.size());
+        forEach(jobs, instances.size(), [&](std::size_t i) {
+            try {
+                parts[i] = loadPrimitive(document, buffers, instances[i]);
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+        for (auto & error : errors) {
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        MeshData mesh;
+        std::size_t vertexCount = 0, indexCount = 0;
+        for (auto & part : parts) {
+            vertexCount += part.vertices.size();
+            indexCount += part.indices.size();
+        }
+        mesh.vertices.reserve(vertexCount);
+        mesh.indices.reserve(indexCount);
+        for (auto & part : parts) {
+            std::uint32_t base = mesh.vertices.size();
+            mesh.vertices.insert(mesh.vertices.end(), part.vertices.begin(), part.vertices.end());
+            for (auto index : part.indices) {
+                mesh.indices.push_back(base + index);
+            }
+        }
+        weld(mesh, jobs);
+        return mesh;
+    }
+
+    static void addNode(const Json & document,
+                        std::size_t index,
+                        const glm::mat4 & parent,
+                        std::vector<GltfInstance> & instances,
+                        int depth) {
+        const auto & nodes = document.array("nodes");
+        if (index >= nodes.size() || depth > 64)
+            throw MeshLoadException("glTF node out of range");
+        const Json & node = nodes[index];
+
+        glm::mat4 local(1);
+        if (const Json * matrix = node.find("matrix")) {
+            for (int i = 0; i < 16 && i < int(matrix->items.size()); i++) {
+                local[i / 4][i % 4] = float(matrix->items[i].number);
+            }
+        }
+        else {
+            glm::vec3 translation(0), scale(1);
+            glm::quat rotation(1, 0, 0, 0);
+            if (const Json * t = node.find("translation"); t && t->items.size() == 3)
+                translation = glm::vec3(t->items[0].number, t->items[1].number, t->items[2].number);
+            if (const Json * r = node.find("rotation"); r && r->items.size() == 4)
+                rotation = glm::quat(float(r->items[3].number), float(r->items[0].number),
+                                     float(r->items[1].number), float(r->items[2].number));
+            if (const Json * s = node.find("scale"); s && s->items.size() == 3)
+                scale = glm::vec3(s->items[0].number, s->items[1].number, s->items[2].number);
+            local = glm::translate(glm::mat4(1), translation) * glm::mat4_cast(rotation)
+                    * glm::scale(glm::mat4(1), scale);
+        }
+        glm::mat4 transform = parent * local;
+
+        if (const Json * mesh = node.find("mesh")) {
+            const auto & meshes = document.array("meshes");
+            if (std::size_t(mesh->number) >= meshes.size())
+                throw MeshLoadException("glTF mesh out of range");
+            for (auto & primitive : meshes[std::size_t(mesh->number)].array("primitives")) {
+                instances.push_back({&primitive, transform});
+            }
+        }
+        if (const Json * children = node.find("children")) {
+            for (auto & child : children->items) {
+                addNode(document, std::size_t(child.number), transform, instances, depth + 1);
+            }
+        }
+    }
+
+    static Accessor getAccessor(const Json & document,
+                                const std::vector<std::string> & buffers,
+                                std::size_t index) {
+        const auto & accessors = document.array("accessors");
+        if (index >= accessors.size())
+            throw MeshLoadException("glTF accessor out of range");
+        const Json & accessor = accessors[index];
+        if (accessor.find("sparse"))
+            throw MeshLoadException("glTF sparse accessors are not supported");
+
+        Accessor result;
+        result.count = std::size_t(accessor.get("count", 0));
+        result.componentType = int(accessor.get("componentType", 5126));
+        const Json * normalized = accessor.find("normalized");
+        result.normalized = normalized && normalized->number != 0;
+        const Json * type = accessor.find("type");
+        std::string name = type ? type->string : "";
+        result.components = name == "SCALAR" ? 1 : name == "VEC2" ? 2 : name == "VEC3" ? 3 : name == "VEC4" ? 4 : 0;
+        if (result.components == 0)
+            throw MeshLoadException("glTF accessor type not supported: " + name);
+
+        std::size_t componentSize;
+        switch (result.componentType) {
+            case 5120:
+            case 5121:
+                componentSize = 1;
+                break;
+            case 5122:
+            case 5123:
+                componentSize = 2;
+                break;
+            case 5125:
+            case 5126:
+                componentSize = 4;
+                break;
+            default:
+                throw MeshLoadException("glTF component type not supported");
+        }
+        std::size_t elementSize = componentSize * result.components;
+
+        const Json * viewIndex = accessor.find("bufferView");
+        if (!viewIndex)
+            throw MeshLoadException("glTF accessor without buffer view");
+        const auto & views = document.array("bufferViews");
+        if (std::size_t(viewIndex->number) >= views.size())
+            throw MeshLoadException("glTF buffer view out of range");
+        const Json & view = views[std::size_t(viewIndex->number)];
+        std::size_t buffer = std::size_t(view.get("buffer", 0));
+        if (buffer >= buffers.size())
+            throw MeshLoadException("glTF buffer out of range");
+
+        std::size_t offset = std::size_t(view.get("byteOffset", 0))
+                             + std::size_t(accessor.get("byteOffset", 0));
+        std::size_t viewEnd = std::size_t(view.get("byteOffset", 0))
+                              + std::size_t(view.get("byteLength", 0));
+        result.stride = std::size_t(view.get("byteStride", 0));
+        if (result.stride == 0)
+            result.stride = elementSize;
+        if (result.count > 0
+            && (viewEnd > buffers[buffer].size()
+                || offset + (result.count - 1) * result.stride + elementSize > viewEnd))
+            throw MeshLoadException("glTF accessor out of range");
+        result.data = reinterpret_cast<const unsigned char *>(buffers[buffer].data()) + offset;
+        return result;
+    }
+
+    static MeshData loadPrimitive(const Json & document,
+                                  const std::vector<std::string> & buffers,
+                                  const GltfInstance & instance) {
+        const Json & primitive = *instance.primitive;
+        int mode = int(primitive.get("mode", 4));
+        MeshData mesh;
+        // points and lines have no triangles
+        if (mode != 4 && mode != 5 && mode != 6)
+            return mesh;
+
+        const Json * attributes = primitive.find("attributes");
+        const Json * position = attributes ? attributes->find("POSITION") : nullptr;
+        if (!position)
+            return mesh;
+
+        Accessor positions = getAccessor(document, buffers, std::size_t(position->number));
+        mesh.vertices.resize(positions.count);
+        for (std::size_t i = 0; i < positions.count; i++) {
+            glm::vec4 p(positions.get(i, 0), positions.get(i, 1), positions.get(i, 2), 1);
+            mesh.vertices[i].position = glm::vec3(instance.transform * p);
+        }
+        if (const Json * normal = attributes->find("NORMAL")) {
+            Accessor normals = getAccessor(document, buffers, std::size_t(normal->number));
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(instance.transform)));
+            for (std::size_t i = 0; i < std::min(normals.count, positions.count); i++) {
+                glm::vec3 n(normals.get(i, 0), normals.get(i, 1), normals.get(i, 2));
+                n = normalMatrix * n;
+                float length = glm::length(n);
+                mesh.vertices[i].normal = length > 0 ? n / length : n;
+            }
+        }
+        if (const Json * texCoord = attributes->find("TEXCOORD_0")) {
+            Accessor texCoords = getAccessor(document, buffers, std::size_t(texCoord->number));
+            for (std::size_t i = 0; i < std::min(texCoords.count, positions.count); i++) {
+                mesh.vertices[i].texCoord = glm::vec2(texCoords.get(i, 0), texCoords.get(i, 1));
+            }
+        }
+
+        std::vector<std::uint32_t> indices;
+        if (const Json * index = primitive.find("indices")) {
+            Accessor accessor = getAccessor(document, buffers, std::size_t(index->number));
+            indices.resize(accessor.count);
+            for (std::size_t i = 0; i < accessor.count; i++) {
+                indices[i] = accessor.getIndex(i);
+                if (indices[i] >= positions.count)
+                    throw MeshLoadException("glTF index out of range");
+            }
+        }
+        else {
+            indices.resize(positions.count);
+            for (std::size_t i = 0; i < indices.size(); i++) {
+                indices[i] = i;
+            }
+        }
+
+        if (mode == 4) {
+            indices.resize(indices.size() / 3 * 3);
+            mesh.indices = std::move(indices);
+        }
+        for (std::size_t i = 2; mode != 4 && i < indices.size(); i++) {
+            if (mode == 6)
+                mesh.indices.insert(mesh.indices.end(), {indices[0], indices[i - 1], indices[i]});
+            else if (i % 2 == 0)
+                mesh.indices.insert(mesh.indices.end(), {indices[i - 2], indices[i - 1], indices[i]});
+            else
+                mesh.indices.insert(mesh.indices.end(), {indices[i - 1], indices[i - 2], indices[i]});
+        }
+
+        // a mirroring transform turns the triangles inside out
+        if (glm::determinant(glm::mat3(instance.transform)) < 0) {
+            for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+            }
+        }
+        return mesh;
+    }
+
+    static void parseObj(const char * p, const char * end, ObjChunk & chunk) {
+        try {
+            while (p < end) {
+                const char * lineEnd = static_cast<const char *>(std::memchr(p, '\n', end - p));
+                if (!lineEnd)
+                    lineEnd = end;
+                p = skipSpace(p, lineEnd);
+                if (lineEnd - p >= 2) {
+                    if (p[0] == 'v' && isSpace(p[1])) {
+                        glm::vec3 v(0);
+                        parseFloats(p + 2, lineEnd, &v.x, 3, 3);
+                        chunk.positions.push_back(v);
+                    }
+                    else if (p[0] == 'v' && p[1] == 't' && lineEnd - p > 2 && isSpace(p[2])) {
+                        glm::vec2 t(0);
+                        parseFloats(p + 3, lineEnd, &t.x, 1, 2);
+                        chunk.texCoords.push_back(t);
+                    }
+                    else if (p[0] == 'v' && p[1] == 'n' && lineEnd - p > 2 && isSpace(p[2])) {
+                        glm::vec3 n(0);
+                        parseFloats(p + 3, lineEnd, &n.x, 3, 3);
+                        chunk.normals.push_back(n);
+                    }
+                    else if (p[0] == 'f' && isSpace(p[1])) {
+                        parseFace(p + 2, lineEnd, chunk);
+                    }
+                }
+                // the last line may have no newline
+                p = lineEnd < end ? lineEnd + 1 : end;
+            }
+        }
+        catch (...) {
+            chunk.error = std::current_exception();
+        }
+    }
+
+    static void parseFace(const char * p, const char * end, ObjChunk & chunk) {
+        ObjCorner first, previous;
+        int count = 0;
+        for (p = skipSpace(p, end); p < end; p = skipSpace(p, end)) {
+            ObjCorner corner {{-1, -1, -1}, 0};
+            for (int k = 0; k < 3; k++) {
+                if (k > 0) {
+                    if (p == end || *p != '/')
+                        break;
+                    p++;
+                    // p//n has no texture coordinate
+                    if (k == 1 && p < end && *p == '/')
+                        continue;
+                }
+                int value = 0;
+                auto result = std::from_chars(p, end, value);
+                if (result.ec != std::errc() || value == 0)
+                    throw MeshLoadException("Malformed OBJ face");
+                p = result.ptr;
+                std::size_t local = k == 0   ? chunk.positions.size()
+                                    : k == 1 ? chunk.texCoords.size()
+                                             : chunk.normals.size();
+                if (value > 0) {
+                    corner.index[k] = value - 1;
+                }
+                else {
+                    corner.index[k] = std::int32_t(local) + value;
+                    corner.relative |= 1 << k;
+                }
+            }
+            if (p < end && !isSpace(*p))
+                throw MeshLoadException("Malformed OBJ face");
+
+            if (count == 0)
+                first = corner;
+            else if (count >= 2)
+                chunk.corners.insert(chunk.corners.end(), {first, previous, corner});
+            previous = corner;
+            count++;
+        }
+        if (count < 3)
+            throw MeshLoadException("OBJ face with less than 3 vertices");
+    }
+
+    static ObjKey resolve(const ObjCorner & corner, const ObjBase & base, const ObjBase & total) {
+        ObjKey key;
+        for (int k = 0; k < 3; k++) {
+            std::int64_t index = corner.index[k];
+            if (corner.relative & (1 << k))
+                index += base.count[k];
+            else if (index < 0 && k > 0) {
+                key.index[k] = -1;
+                continue;
+            }
+            if (index < 0 || std::size_t(index) >= total.count[k])
+                throw MeshLoadException("OBJ index out of range");
+            key.index[k] = std::int32_t(index);
+        }
+        return key;
+    }
+
+    static void rethrow(const std::vector<ObjChunk> & chunks) {
+        for (auto & chunk : chunks) {
+            if (chunk.error)
+                std::rethrow_exception(chunk.error);
+        }
+    }
+
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static const char * skipSpace(const char * p, const char * end) {
+        while (p < end && isSpace(*p))
+            p++;
+        return p;
+    }
+
+    /**
+     * Read between required and count floats separated by spaces, the
+     * rest of the line is ignored.
+     */
+    static void parseFloats(const char * p, const char * end, float * out, int required, int count) {
+        for (int i = 0; i < count; i++) {
+            p = skipSpace(p, end);
+            double value;
+            const char * next = p < end ? parseNumber(p, end, value) : nullptr;
+            if (!next) {
+                if (i < required)
+                    throw MeshLoadException("Malformed OBJ vertex");
+                return;
+            }
+            out[i] = float(value);
+            p = next;
+        }
+    }
+
+    /**
+     * @return the end of the number, nullptr if there is none
+     */
+    static const char * parseNumber(const char * p, const char * end, double & value) {
+        if (p < end && *p == '+')
+            p++;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        auto result = std::from_chars(p, end, value);
+        return result.ec == std::errc() ? result.ptr : nullptr;
+#else
+        // strtod stops at the line break or the closing quote, the text is
+        // always followed by one of them or a null
+        char * next;
+        value = std::strtod(p, &next);
+        return next != p && next <= end ? next : nullptr;
+#endif
+    }
+
+    template<typename Function>
+    static void forEach(JobSystem * jobs, std::size_t count, Function && function, std::size_t grain = 1) {
+        if (!jobs || count <= grain) {
+            for (std::size_t i = 0; i < count; i++) {
+                function(i);
+            }
+            return;
+        }
+        jobs->parallelFor(0, count, grain, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; i++) {
+                function(i);
+            }
+        });
+    }
+
+    static std::uint64_t mix(std::uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    static std::uint64_t hashBytes(const void * data, std::size_t size) {
+        std::uint64_t hash = 0;
+        const unsigned char * bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i + 8 <= size; i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            hash = mix(hash ^ word);
+        }
+        return hash;
+    }
+
+    static std::uint32_t readU32(const unsigned char * p) {
+        return std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 | std::uint32_t(p[2]) << 16
+               | std::uint32_t(p[3]) << 24;
+    }
+
+    static std::string decodeBase64(const std::string & text) {
+        std::string bytes;
+        bytes.reserve(text.size() * 3 / 4);
+        unsigned bits = 0;
+        int count = 0;
+        for (char c : text) {
+            int value;
+            if (c >= 'A' && c <= 'Z')
+                value = c - 'A';
+            else if (c >= 'a' && c <= 'z')
+                value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9')
+                value = c - '0' + 52;
+            else if (c == '+')
+                value = 62;
+            else if (c == '/')
+                value = 63;
+            else
+                continue;
+            bits = bits << 6 | value;
+            count += 6;
+            if (count >= 8) {
+                count -= 8;
+                bytes += char(bits >> count & 0xFF);
+            }
+        }
+        return bytes;
+    }
+
+    static bool hasExtension(const std::string & path, const char * extension) {
+        std::size_t length = std::strlen(extension);
+        if (path.size() < length)
+            return false;
+        for (std::size_t i = 0; i < length; i++) {
+            char c = path[path.size() - length + i];
+            if (std::tolower(static_cast<unsigned char>(c)) != extension[i])
+                return false;
+        }
+        return true;
+    }
+
+    static std::string readFile(const std::string & path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            throw MeshLoadException("Could not open " + path);
+        std::string contents(std::size_t(file.tellg()), '\0');
+        file.seekg(0);
+        if (!file.read(&contents[0], contents.size()))
+            throw MeshLoadException("Could not read " + path);
+        return contents;
+    }
+};
@@ -0,0 +1,494 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "Culling.hpp"
+#include "RenderStats.hpp"
+#include "simd.hpp"
+
+/**
+ * A small cluster of triangles with the bounds to cull it.
+ */
+struct Meshlet {
+    std::uint32_t firstIndex;
+    std::uint32_t indexCount;
+    // the number of distinct vertices the triangles use
+    std::uint32_t vertexCount;
+
+    glm::vec3 center;
+    float radius;
+
+    // every triangle normal is within the cone around coneAxis, the cluster
+    // is backfacing from eye when
+    // dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius
+    // coneCutoff is 1 when the normals are too spread out to ever cull
+    glm::vec3 coneAxis;
+    float coneCutoff;
+
+    /**
+     * The offset to pass to glDrawElements for 32 bit indices.
+     */
+    const void * offset() const {
+        return reinterpret_cast<const void *>(firstIndex * sizeof(std::uint32_t));
+    }
+};
+
+/**
+ * The triangles of a mesh regrouped into meshlets, stored back to back in
+ * one index array over the original vertices.
+ */
+struct MeshletMesh {
+    std::vector<std::uint32_t> indices;
+    std::vector<Meshlet> meshlets;
+};
+
+/**
+ * Splits indexed triangle meshes into meshlets offline.
+ *
+ * A meshlet grows from a seed triangle by adding the neighbouring triangle
+ * that brings the fewest new vertices, preferring triangles that face the
+ * same way as the meshlet so its normal cone stays narrow. When no
+ * neighbour fits any more the meshlet is closed and the next one is seeded
+ * from a triangle next to it, or from the first unassigned triangle when
+ * the surface around it is used up.
+ */
+class MeshletBuilder {
+public:
+    static constexpr std::size_t MaxVertices = 64;
+    static constexpr std::size_t MaxTriangles = 124;
+
+    /**
+     * @param positions the vertex positions
+     * @param indices a triangle list
+     * @param maxVertices the vertex limit per meshlet, at most MaxVertices
+     * @param maxTriangles the triangle limit per meshlet
+     */
+    static MeshletMesh build(const std::vector<glm::vec3> & positions,
+                             const std::vector<std::uint32_t> & indices,
+                             std::size_t maxVertices = MaxVertices,
+                             std::size_t maxTriangles = MaxTriangles) {
+        maxVertices = std::min(std::max<std::size_t>(maxVertices, 3), MaxVertices);
+        maxTriangles = std::max<std::size_t>(maxTriangles, 1);
+        const std::size_t triangleCount = indices.size() / 3;
+
+        std::vector<glm::vec3> normals(triangleCount);
+        for (std::size_t t = 0; t < triangleCount; t++) {
+            const glm::vec3 & a = positions[indices[3 * t]];
+            glm::vec3 n = glm::cross(positions[indices[3 * t + 1]] - a,
+                                     positions[indices[3 * t + 2]] - a);
+            float length = glm::length(n);
+            normals[t] = length > 0 ? n / length : glm::vec3(0);
+        }
+
+        // the live triangles around every vertex, assigned triangles are
+        // swapped out of the lists
+        std::vector<std::uint32_t> first(positions.size() + 1, 0);
+        for (std::size_t i = 0; i < triangleCount * 3; i++) {
+            first[indices[i] + 1]++;
+        }
+        for (std::size_t v = 0; v < positions.size(); v++) {
+            first[v + 1] += first[v];
+        }
+        std::vector<std::uint32_t> live(positions.size(), 0);
+        std::vector<std::uint32_t> adjacent(triangleCount * 3);
+        for (std::size_t i = 0; i < triangleCount * 3; i++) {
+            std::uint32_t v = indices[i];
+            adjacent[first[v] + live[v]++] = i / 3;
+        }
+
+        MeshletMesh mesh;
+        mesh.indices.reserve(triangleCount * 3);
+        std::vector<bool> assigned(triangleCount, false);
+        // the slot of each vertex in the open meshlet, 0xFF when not in it
+        std::vector<std::uint8_t> slot(positions.size(), 0xFF);
+        std::vector<std::uint32_t> vertices;
+        std::vector<std::uint32_t> triangles;
+        glm::vec3 normalSum(0);
+        std::size_t seed = 0;
+
+        auto close = [&] {
+            if (triangles.empty())
+                return;
+            Meshlet meshlet;
+            meshlet.firstIndex = mesh.indices.size();
+            meshlet.indexCount = triangles.size() * 3;
+            meshlet.vertexCount = vertices.size();
+            for (auto t : triangles) {
+                mesh.indices.insert(mesh.indices.end(), &indices[3 * t], &indices[3 * t] + 3);
+            }
+            computeBounds(positions, vertices, normals, triangles, meshlet);
+            mesh.meshlets.push_back(meshlet);
+            for (auto v : vertices) {
+                slot[v] = 0xFF;
+            }
+            vertices.clear();
+            triangles.clear();
+            normalSum = glm::vec3(0);
+        };
+
+        for (std::size_t added = 0; added < triangleCount; added++) {
+            std::size_t best = pickNeighbour(indices, normals, adjacent, first, live,
+                                             assigned, slot, vertices, normalSum,
+                                             maxVertices);
+            if (best == NoTriangle || triangles.size() == maxTriangles) {
+                // seed the next meshlet next to this one to keep them compact
+                best = pickNeighbour(indices, normals, adjacent, first, live, assigned,
+                                     slot, vertices, normalSum, NoTriangle);
+                close();
+                if (best == NoTriangle) {
+                    while (assigned[seed])
+                        seed++;
+                    best = seed;
+                }
+            }
+
+            assigned[best] = true;
+            triangles.push_back(best);
+            normalSum += normals[best];
+            for (int k = 0; k < 3; k++) {
+                std::uint32_t v = indices[3 * best + k];
+                if (slot[v] == 0xFF) {
+                    slot[v] = vertices.size();
+                    vertices.push_back(v);
+                }
+                // swap the triangle out of the live list of v
+                std::uint32_t * list = &adjacent[first[v]];
+                for (std::uint32_t i = 0; i < live[v]; i++) {
+                    if (list[i] == best) {
+                        list[i] = list[--live[v]];
+                        break;
+                    }
+                }
+            }
+        }
+        close();
+        return mesh;
+    }
+
+private:
+    static constexpr std::size_t NoTriangle = ~std::size_t(0);
+
+    /**
+     * The live triangle next to the open meshlet that adds the fewest
+     * vertices and deviates least from its average normal, without going
+     * over maxVertices.
+     */
+    static std::size_t pickNeighbour(const std::vector<std::uint32_t> & indices,
+                                     const std::vector<glm::vec3> & normals,
+                                     const std::vector<std::uint32_t> & adjacent,
+                                     const std::vector<std::uint32_t> & first,
+                                     const std::vector<std::uint32_t> & live,
+                                     const std::vector<bool> & assigned,
+                                     const std::vector<std::uint8_t> & slot,
+                                     const std::vector<std::uint32_t> & vertices,
+                                     const glm::vec3 & normalSum,
+                                     std::size_t maxVertices) {
+        float length = glm::length(normalSum);
+        glm::vec3 axis = length > 0 ? normalSum / length : glm::vec3(0);
+
+        std::size_t best = NoTriangle;
+        float bestScore = INFINITY;
+        for (auto v : vertices) {
+            for (std::uint32_t i = 0; i < live[v]; i++) {
+                std::uint32_t t = adjacent[first[v] + i];
+                if (assigned[t])
+                    continue;
+                unsigned extra = 0;
+                for (int k = 0; k < 3; k++) {
+                    extra += slot[indices[3 * t + k]] == 0xFF;
+                }
+                if (vertices.size() + extra > maxVertices)
+                    continue;
+                // new vertices always weigh more than the normal
+                float score = extra + (1.0f - glm::dot(normals[t], axis)) * 0.5f;
+                if (score < bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+        return best;
+    }
+
+    static void computeBounds(const std::vector<glm::vec3> & positions,
+                              const std::vector<std::uint32_t> & vertices,
+                              const std::vector<glm::vec3> & normals,
+                              const std::vector<std::uint32_t> & triangles,
+                              Meshlet & meshlet) {
+        glm::vec3 low(INFINITY), high(-INFINITY);
+        for (auto v : vertices) {
+            low = glm::min(low, positions[v]);
+            high = glm::max(high, positions[v]);
+        }
+        meshlet.center = (low + high) * 0.5f;
+        meshlet.radius = 0;
+        for (auto v : vertices) {
+            meshlet.radius = std::max(meshlet.radius, glm::length(positions[v] - meshlet.center));
+        }
+
+        glm::vec3 sum(0);
+        for (auto t : triangles) {
+            sum += normals[t];
+        }
+        float length = glm::length(sum);
+        meshlet.coneAxis = length > 0 ? sum / length : glm::vec3(0, 0, 1);
+        float minDot = 1;
+        for (auto t : triangles) {
+            // degenerate triangles are never seen
+            if (normals[t] != glm::vec3(0))
+                minDot = std::min(minDot, glm::dot(normals[t], meshlet.coneAxis));
+        }
+        // the view direction has to be within 90 degrees minus the cone
+        // angle of the axis, sin of the cone angle is cos of that
+        meshlet.coneCutoff = minDot > 0 ? std::sqrt(1 - minDot * minDot) : 1.0f;
+    }
+};
+
+/**
+ * Culls the meshlets of one mesh against the frustum and by their normal
+ * cones, and draws the visible ones with one glMultiDrawElements call.
+ * Visible meshlets that are next to each other in the index array are drawn
+ * as one range.
+ *
+ * Bounds are kept in SoA form so the test runs SIMD_WIDTH meshlets at a
+ * time. The frustum and eye are in the space of the mesh, build the frustum
+ * from viewProjection * model and transform the eye by the inverse model
+ * matrix.
+ */
+class MeshletCuller {
+    std::vector<float> x, y, z, radius;
+    std::vector<float> axisX, axisY, axisZ, cutoff;
+    std::vector<std::uint32_t> firstIndex, indexCount;
+    std::size_t count;
+
+    std::vector<std::uint32_t> visible;
+    std::size_t visibleCount;
+    std::size_t visibleIndices;
+    std::vector<GLsizei> counts;
+    std::vector<const void *> offsets;
+
+public:
+    explicit MeshletCuller(const std::vector<Meshlet> & meshlets)
+        : count(meshlets.size()), visibleCount(0), visibleIndices(0) {
+        std::size_t padded = (count + 7) / 8 * 8;
+        for (auto * a : {&x, &y, &z, &radius, &axisX, &axisY, &axisZ, &cutoff}) {
+            a->assign(padded, 0.0f);
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            const Meshlet & m = meshlets[i];
+            x[i] = m.center.x;
+            y[i] = m.center.y;
+            z[i] = m.center.z;
+            radius[i] = m.radius;
+            axisX[i] = m.coneAxis.x;
+            axisY[i] = m.coneAxis.y;
+            axisZ[i] = m.coneAxis.z;
+            cutoff[i] = m.coneCutoff;
+            firstIndex.push_back(m.firstIndex);
+            indexCount.push_back(m.indexCount);
+        }
+        visible.resize(padded);
+    }
+
+    std::size_t size() const {
+        return count;
+    }
+
+    /**
+     * @param frustum the frustum in mesh space
+     * @param eye the camera position in mesh space
+     * @param cones cull backfacing meshlets too
+     *
+     * @return the number of visible meshlets
+     */
+    std::size_t cull(const Frustum & frustum, const glm::vec3 & eye, bool cones = true) {
+        Lanes planes[6][4];
+        for (int p = 0; p < 6; p++) {
+            for (int c = 0; c < 4; c++) {
+                planes[p][c] = splat(frustum.planes[p][c]);
+            }
+        }
+        Lanes eyeLanes[3] = {splat(eye.x), splat(eye.y), splat(eye.z)};
+
+        visibleCount = 0;
+        visibleIndices = 0;
+        for (std::size_t i = 0; i < count; i += SIMD_WIDTH) {
+            unsigned mask = visibleMask(planes, eyeLanes, cones, i);
+            if (count - i < SIMD_WIDTH)
+                mask &= (1u << (count - i)) - 1;
+            while (mask) {
+                std::uint32_t m = i + lowestBit(mask);
+                visible[visibleCount++] = m;
+                visibleIndices += indexCount[m];
+                mask &= mask - 1;
+            }
+        }
+        return visibleCount;
+    }
+
+    /**
+     * The meshlets found by the last cull().
+     */
+    const std::uint32_t * getVisible() const {
+        return visible.data();
+    }
+
+    std::size_t getVisibleCount() const {
+        return visibleCount;
+    }
+
+    std::size_t getVisibleTriangles() const {
+        return visibleIndices / 3;
+    }
+
+    /**
+     * Draw the meshlets found by the last cull() from the element buffer of
+     * array, which holds MeshletMesh::indices.
+     */
+    void draw(const BufferArray & array) {
+        counts.clear();
+        offsets.clear();
+        std::uint32_t end = ~0u;
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < visibleCount; i++) {
+            std::uint32_t m = visible[i];
+            total += indexCount[m];
+            if (firstIndex[m] == end) {
+                counts.back() += indexCount[m];
+            }
+            else {
+                counts.push_back(indexCount[m]);
+                offsets.push_back(
+                    reinterpret_cast<const void *>(firstIndex[m] * sizeof(std::uint32_t)));
+            }
+            end = firstIndex[m] + indexCount[m];
+        }
+        if (counts.empty())
+            return;
+        array.bind();
+        RenderStats::countDraw(GL_TRIANGLES, total);
+        CAPTURE(Capture::MultiDrawElements {GL_TRIANGLES, GL_UNSIGNED_INT,
+                                            std::int32_t(counts.size())},
+                Capture::multiDrawData(counts.data(), offsets.data(), counts.size()));
+        glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(),
+                            counts.size());
+        array.unbind();
+    }
+
+private:
+#if SIMD_WIDTH == 8
+    using Lanes = __m256;
+
+    static Lanes splat(float v) {
+        return _mm256_set1_ps(v);
+    }
+
+    unsigned visibleMask(const Lanes planes[6][4],
+                         const Lanes eye[3],
+                         bool cones,
+                         std::size_t i) const {
+        __m256 cx = _mm256_loadu_ps(&x[i]);
+        __m256 cy = _mm256_loadu_ps(&y[i]);
+        __m256 cz = _mm256_loadu_ps(&z[i]);
+        __m256 r = _mm256_loadu_ps(&radius[i]);
+        __m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), r);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int k = 0; k < 6; k++) {
+            __m256 d = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(planes[k][0], cx), _mm256_mul_ps(planes[k][1], cy)),
+                _mm256_add_ps(_mm256_mul_ps(planes[k][2], cz), planes[k][3]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+        }
+        if (cones) {
+            __m256 dx = _mm256_sub_ps(cx, eye[0]);
+            __m256 dy = _mm256_sub_ps(cy, eye[1]);
+            __m256 dz = _mm256_sub_ps(cz, eye[2]);
+            __m256 along = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(dx, _mm256_loadu_ps(&axisX[i])),
+                              _mm256_mul_ps(dy, _mm256_loadu_ps(&axisY[i]))),
+                _mm256_mul_ps(dz, _mm256_loadu_ps(&axisZ[i])));
+            __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                _mm256_mul_ps(dz, dz)));
+            __m256 limit = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&cutoff[i]), distance), r);
+            inside = _mm256_andnot_ps(_mm256_cmp_ps(along, limit, _CMP_GE_OQ), inside);
+        }
+        return _mm256_movemask_ps(inside);
+    }
+
+#elif SIMD_WIDTH == 4
+    using Lanes = __m128;
+
+    static Lanes splat(float v) {
+        return _mm_set1_ps(v);
+    }
+
+    unsigned visibleMask(const Lanes planes[6][4],
+                         const Lanes eye[3],
+                         bool cones,
+                         std::size_t i) const {
+        __m128 cx = _mm_loadu_ps(&x[i]);
+        __m128 cy = _mm_loadu_ps(&y[i]);
+        __m128 cz = _mm_loadu_ps(&z[i]);
+        __m128 r = _mm_loadu_ps(&radius[i]);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int k = 0; k < 6; k++) {
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planes[k][0], cx), _mm_mul_ps(planes[k][1], cy)),
+                _mm_add_ps(_mm_mul_ps(planes[k][2], cz), planes[k][3]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+        }
+        if (cones) {
+            __m128 dx = _mm_sub_ps(cx, eye[0]);
+            __m128 dy = _mm_sub_ps(cy, eye[1]);
+            __m128 dz = _mm_sub_ps(cz, eye[2]);
+            __m128 along = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&axisX[i])),
+                           _mm_mul_ps(dy, _mm_loadu_ps(&axisY[i]))),
+                _mm_mul_ps(dz, _mm_loadu_ps(&axisZ[i])));
+            __m128 distance = _mm_sqrt_ps(_mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+            __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&cutoff[i]), distance), r);
+            inside = _mm_andnot_ps(_mm_cmpge_ps(along, limit), inside);
+        }
+        return _mm_movemask_ps(inside);
+    }
+
+#else
+    using Lanes = float;
+
+    static Lanes splat(float v) {
+        return v;
+    }
+
+    unsigned visibleMask(const Lanes planes[6][4],
+                         const Lanes eye[3],
+                         bool cones,
+                         std::size_t i) const {
+        for (int k = 0; k < 6; k++) {
+            float d = planes[k][0] * x[i] + planes[k][1] * y[i] + planes[k][2] * z[i]
+                      + planes[k][3];
+            if (d < -radius[i])
+                return 0;
+        }
+        if (cones) {
+            glm::vec3 d(x[i] - eye[0], y[i] - eye[1], z[i] - eye[2]);
+            float along = d.x * axisX[i] + d.y * axisY[i] + d.z * axisZ[i];
+            if (along >= cutoff[i] * glm::length(d) + radius[i])
+                return 0;
+        }
+        return 1;
+    }
+
+#endif
+};
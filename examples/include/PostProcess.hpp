@@ -0,0 +1,354 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "FrameBuffer.hpp"
+#include "Shader.hpp"
+#include "Texture.hpp"
+
+/**
+ * Draw a single triangle that covers the whole viewport.
+ *
+ * The vertex positions are generated from gl_VertexID so no vertex buffers
+ * are needed, only an empty vertex array which is required by the core
+ * profile. Compared to Quad this avoids the diagonal seam where fragments
+ * are shaded twice.
+ */
+class FullscreenTriangle {
+    BufferArray array;
+
+public:
+    static constexpr const char * vertexShaderSource = R"(
+#version 330 core
+out vec2 FragPos;
+out vec2 FragTex;
+void main() {
+    FragTex = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    FragPos = FragTex * 2.0 - 1.0;
+    gl_Position = vec4(FragPos, 0.0, 1.0);
+})";
+
+    void draw() const {
+        array.drawArrays(GL_TRIANGLES, 0, 3);
+    }
+};
+
+/**
+ * A single post processing effect described as a GLSL snippet.
+ *
+ * The body is pasted into a generated function whose signature depends on
+ * the kind of effect. Snippets can read the `FragPos` (clip space) and
+ * `FragTex` inputs and the `texelSize` uniform of the input texture.
+ */
+struct PostEffect {
+    enum Kind {
+        /// Remap the coordinate before sampling, `vec2 f(vec2 uv)`
+        Coord,
+        /// Modify the sampled color per pixel, `vec4 f(vec4 color, vec2 uv)`
+        Color,
+        /// Read neighbouring pixels, `vec4 f(sampler2D tex, vec2 uv)`
+        Sample,
+    };
+
+    Kind kind;
+    /// Uniform declarations, one per line, may include default values
+    std::string uniforms;
+    /// Function body, must return the result
+    std::string body;
+
+    static PostEffect distortion() {
+        return {Coord,
+                "uniform float t;",
+                "vec2 d = vec2(sin(t + FragPos.x * 3) * 0.1,\n"
+                "              sin(t + FragPos.y * 3) * 0.1);\n"
+                "return uv + vec2(d.x, 0.0);"};
+    }
+
+    static PostEffect grayscale() {
+        return {Color,
+                "",
+                "float v = dot(color.rgb, vec3(0.2126, 0.7152, 0.0722));\n"
+                "return vec4(vec3(v), color.a);"};
+    }
+
+    /// ACES filmic curve fit by Krzysztof Narkowicz
+    static PostEffect tonemap() {
+        return {Color,
+                "uniform float exposure = 1.0;",
+                "vec3 x = color.rgb * exposure;\n"
+                "x = (x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14);\n"
+                "return vec4(clamp(x, 0.0, 1.0), color.a);"};
+    }
+
+    static PostEffect vignette() {
+        return {Color,
+                "uniform float vignetteRadius = 0.75;\n"
+                "uniform float vignetteSoftness = 0.45;",
+                "float d = length(FragPos) * 0.7071;\n"
+                "float v = smoothstep(vignetteRadius,\n"
+                "                     vignetteRadius - vignetteSoftness, d);\n"
+                "return vec4(color.rgb * v, color.a);"};
+    }
+
+    static PostEffect colorGrade() {
+        return {Color,
+                "uniform mat3 gradeMatrix = mat3(1.0);\n"
+                "uniform vec3 gradeOffset = vec3(0.0);\n"
+                "uniform float saturation = 1.0;",
+                "vec3 c = gradeMatrix * color.rgb + gradeOffset;\n"
+                "float l = dot(c, vec3(0.2126, 0.7152, 0.0722));\n"
+                "return vec4(mix(vec3(l), c, saturation), color.a);"};
+    }
+
+    /// 3x3 tent filter, the simplest effect that forces a new pass
+    static PostEffect blur() {
+        return {Sample,
+                "",
+                "vec4 c = vec4(0.0);\n"
+                "for (int y = -1; y <= 1; y++)\n"
+                "    for (int x = -1; x <= 1; x++)\n"
+                "        c += texture(tex, uv + vec2(x, y) * texelSize)\n"
+                "             * float((2 - abs(x)) * (2 - abs(y)));\n"
+                "return c / 16.0;"};
+    }
+};
+
+/**
+ * Apply a list of post processing effects to a texture.
+ *
+ * Consecutive effects are fused into one generated shader so the image is
+ * only read and written once. A new pass is only started when an effect has
+ * to sample the previous result at other coordinates, that is a Coord or
+ * Sample effect following an effect that already sampled the input.
+ * Intermediate targets are only allocated when more than one pass is used.
+ */
+class PostProcessStack {
+public:
+    /**
+     * A uniform shared by every pass that declares it.
+     */
+    class Param {
+        std::vector<std::pair<GLuint, Shader::Uniform>> uniforms;
+
+        friend class PostProcessStack;
+
+        template <class F>
+        void set(F && f) const {
+            for (auto & u : uniforms) {
+                // recorded like Shader::bind(), replayed uniforms go to the
+                // program that was bound last
+                RenderStats::current().programBinds++;
+                CAPTURE(Capture::UseProgram {u.first});
+                glUseProgram(u.first);
+                f(u.second);
+            }
+        }
+
+    public:
+        void setValue(int value) const {
+            set([&](const Shader::Uniform & u) { u.setValue(value); });
+        }
+
+        void setValue(float value) const {
+            set([&](const Shader::Uniform & u) { u.setValue(value); });
+        }
+
+        void setVec2(const glm::vec2 & value) const {
+            set([&](const Shader::Uniform & u) { u.setVec2(value); });
+        }
+
+        void setVec3(const glm::vec3 & value) const {
+            set([&](const Shader::Uniform & u) { u.setVec3(value); });
+        }
+
+        void setVec4(const glm::vec4 & value) const {
+            set([&](const Shader::Uniform & u) { u.setVec4(value); });
+        }
+
+        void setMat3(const glm::mat3 & value) const {
+            set([&](const Shader::Uniform & u) { u.setMat3(value); });
+        }
+    };
+
+private:
+    struct Pass {
+        Shader shader;
+        Shader::Uniform texelSize;
+
+        Pass(Shader && shader)
+            : shader(std::move(shader)),
+              texelSize(this->shader.uniform("texelSize")) {}
+    };
+
+    std::vector<Pass> passes;
+    std::unique_ptr<RenderTarget> targets[2];
+    Texture::Format format;
+    GLenum type;
+    FullscreenTriangle triangle;
+
+public:
+    /**
+     * Generate the shaders for a list of effects.
+     *
+     * @param effects the effects in the order they are applied
+     * @param format the format of intermediate targets
+     * @param type the data type of intermediate targets
+     *
+     * @throws Shader::CompileException if a snippet does not compile
+     */
+    PostProcessStack(const std::vector<PostEffect> & effects,
+                     Texture::Format format = Texture::RGB,
+                     GLenum type = GL_UNSIGNED_BYTE)
+        : format(format), type(type) {
+        std::vector<const PostEffect *> pass;
+        bool sampled = false;
+        for (auto & effect : effects) {
+            if (effect.kind != PostEffect::Color && sampled) {
+                addPass(pass);
+                pass.clear();
+                sampled = false;
+            }
+            pass.push_back(&effect);
+            if (effect.kind != PostEffect::Coord)
+                sampled = true;
+        }
+        if (!pass.empty() || passes.empty())
+            addPass(pass);
+    }
+
+    PostProcessStack(PostProcessStack && other) = default;
+    PostProcessStack & operator=(PostProcessStack && other) = default;
+
+    PostProcessStack(const PostProcessStack &) = delete;
+    PostProcessStack & operator=(const PostProcessStack &) = delete;
+
+    std::size_t getPassCount() const {
+        return passes.size();
+    }
+
+    Param param(const char * name) const {
+        Param param;
+        for (auto & pass : passes) {
+            auto u = pass.shader.uniform(name);
+            if (static_cast<GLint>(u.getLocation()) != -1)
+                param.uniforms.emplace_back(pass.shader.getProgram(), u);
+        }
+        return param;
+    }
+
+    /**
+     * Run every pass, reading from input and writing the final pass to
+     * output.
+     *
+     * @param input the texture to process, bound to texture unit 0
+     * @param output the frame buffer receiving the result
+     * @param size the size of the output viewport in pixels
+     */
+    void apply(const Texture & input,
+               const FrameBuffer & output,
+               const glm::uvec2 & size) {
+        if (passes.size() > 1)
+            updateTargets(size);
+
+        glViewport(0, 0, size.x, size.y);
+        const Texture * source = &input;
+        for (std::size_t i = 0; i < passes.size(); i++) {
+            if (i + 1 < passes.size())
+                targets[i % 2]->fbo.bind();
+            else
+                output.bind();
+
+            auto & pass = passes[i];
+            pass.shader.bind();
+            pass.texelSize.setVec2(glm::vec2(1.0f / source->getSize().x,
+                                             1.0f / source->getSize().y));
+            source->bind();
+            triangle.draw();
+
+            if (i + 1 < passes.size())
+                source = &targets[i % 2]->texture;
+        }
+    }
+
+private:
+    void updateTargets(const glm::uvec2 & size) {
+        for (auto & target : targets) {
+            if (!target)
+                target = std::make_unique<RenderTarget>(size, format, format,
+                                                        type);
+            else if (target->getSize() != size)
+                target->resize(size);
+        }
+    }
+
+    void addPass(const std::vector<const PostEffect *> & effects) {
+        std::vector<std::string> declared;
+        std::ostringstream decl;
+        std::ostringstream body;
+
+        body << "void main() {\n"
+             << "    vec2 uv = FragTex;\n";
+        bool sampled = false;
+        for (std::size_t i = 0; i < effects.size(); i++) {
+            auto & effect = *effects[i];
+
+            std::istringstream lines(effect.uniforms);
+            std::string line;
+            while (std::getline(lines, line)) {
+                if (line.empty()
+                    || std::find(declared.begin(), declared.end(), line)
+                           != declared.end())
+                    continue;
+                declared.push_back(line);
+                decl << line << "\n";
+            }
+
+            std::string fn = "fx" + std::to_string(i);
+            switch (effect.kind) {
+                case PostEffect::Coord:
+                    decl << "vec2 " << fn << "(vec2 uv) {\n";
+                    body << "    uv = " << fn << "(uv);\n";
+                    break;
+                case PostEffect::Color:
+                    decl << "vec4 " << fn << "(vec4 color, vec2 uv) {\n";
+                    if (!sampled)
+                        body << "    vec4 color = texture(gTexture, uv);\n";
+                    body << "    color = " << fn << "(color, uv);\n";
+                    sampled = true;
+                    break;
+                case PostEffect::Sample:
+                    decl << "vec4 " << fn << "(sampler2D tex, vec2 uv) {\n";
+                    body << "    vec4 color = " << fn << "(gTexture, uv);\n";
+                    sampled = true;
+                    break;
+            }
+            decl << effect.body << "\n}\n";
+        }
+        if (!sampled)
+            body << "    vec4 color = texture(gTexture, uv);\n";
+        body << "    FragColor = color;\n"
+             << "}\n";
+
+        std::string source = "#version 330 core\n"
+                             "in vec2 FragPos;\n"
+                             "in vec2 FragTex;\n"
+                             "out vec4 FragColor;\n"
+                             "uniform sampler2D gTexture;\n"
+                             "uniform vec2 texelSize;\n"
+                             + decl.str() + body.str();
+
+        passes.emplace_back(Shader(FullscreenTriangle::vertexShaderSource,
+                                   source.c_str()));
+    }
+};
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PROFILER_RDTSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+/**
+ * One finished zone, times are nanoseconds on the std::chrono::steady_clock
+ * timeline so CPU and GPU events line up.
+ */
+struct TraceEvent {
+    const char * name;
+    const char * category;
+    // the trace thread the event is drawn on
+    std::uint32_t thread;
+    // the frame that was current when the zone began
+    std::uint64_t frame;
+    std::int64_t begin;
+    std::int64_t end;
+};
+
+/**
+ * In-process CPU profiler for scoped zones.
+ *
+ * Every thread writes its zones into its own ring of Capacity records,
+ * a single producer ring that needs no lock and no atomic read-modify-write,
+ * so a zone costs two timestamps and three plain stores. collect() drains
+ * the rings from any thread; when a thread records more than Capacity zones
+ * between two collects the oldest ones are lost and counted.
+ *
+ * Timestamps come from rdtsc on x86 (assuming an invariant TSC, which every
+ * CPU of the last decade has) and from steady_clock elsewhere. They are
+ * converted to steady_clock nanoseconds when collected.
+ *
+ * The PROFILE_* macros compile to nothing unless OPENGL_DEMO_PROFILE is
+ * defined, see the CMake option of the same name.
+ */
+class Profiler {
+public:
+    static constexpr std::size_t Capacity = 1 << 16;
+
+    class ProfilerException : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * Records the enclosing C++ scope as name on this thread.
+     */
+    class Zone {
+        const char * name;
+        std::uint64_t begin;
+
+    public:
+        explicit Zone(const char * name) : name(name), begin(now()) {}
+
+        ~Zone() {
+            ring().push(name, begin, now());
+        }
+
+        Zone(const Zone &) = delete;
+        Zone & operator=(const Zone &) = delete;
+    };
+
+private:
+    /**
+     * The fields are relaxed atomics so the collector may read a slot while
+     * it is being overwritten, such slots are thrown away afterwards.
+     */
+    struct Record {
+        std::atomic<const char *> name;
+        std::atomic<std::uint64_t> begin;
+        std::atomic<std::uint64_t> end;
+        std::atomic<std::uint64_t> frame;
+    };
+
+    struct ThreadRing {
+        std::unique_ptr<Record[]> records;
+        // the number of records ever written, only the owner writes it
+        std::atomic<std::uint64_t> head;
+        // the number of records collected, only collect() touches it
+        std::uint64_t tail;
+        std::uint32_t id;
+        std::string name;
+
+        ThreadRing(std::uint32_t id) : records(new Record[Capacity]), head(0), tail(0), id(id) {}
+
+        void push(const char * name, std::uint64_t begin, std::uint64_t end) {
+            // pairs with the acquire fence in collect(): a collector that
+            // reads a field written below also sees the head before it
+            std::atomic_thread_fence(std::memory_order_release);
+            std::uint64_t h = head.load(std::memory_order_relaxed);
+            Record & r = records[h & (Capacity - 1)];
+            r.name.store(name, std::memory_order_relaxed);
+            r.begin.store(begin, std::memory_order_relaxed);
+            r.end.store(end, std::memory_order_relaxed);
+            r.frame.store(get().frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            head.store(h + 1, std::memory_order_release);
+        }
+    };
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    std::atomic<std::uint64_t> frame;
+    std::uint64_t lost;
+
+    // a pair of readings of both clocks to convert ticks with
+    std::uint64_t startTicks;
+    std::int64_t startNanoseconds;
+
+    Profiler() : frame(0), lost(0), startTicks(now()), startNanoseconds(steadyNow()) {}
+
+    static ThreadRing & ring() {
+        thread_local ThreadRing * ring = get().addThread();
+        return *ring;
+    }
+
+    ThreadRing * addThread() {
+        std::lock_guard<std::mutex> lock(mutex);
+        rings.push_back(std::make_unique<ThreadRing>(rings.size() + 1));
+        return rings.back().get();
+    }
+
+    static std::int64_t steadyNow() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+public:
+    Profiler(const Profiler &) = delete;
+    Profiler & operator=(const Profiler &) = delete;
+
+    static Profiler & get() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    /**
+     * The raw timestamp zones record.
+     */
+    static std::uint64_t now() {
+#if defined(PROFILER_RDTSC)
+        return __rdtsc();
+#else
+        return steadyNow();
+#endif
+    }
+
+    /**
+     * Set the frame number zones are tagged with, use the number of the
+     * GpuProfiler to line both up.
+     */
+    void setFrame(std::uint64_t number) {
+        frame.store(number, std::memory_order_relaxed);
+    }
+
+    std::uint64_t getFrame() const {
+        return frame.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Name the calling thread in traces.
+     */
+    void setThreadName(const std::string & name) {
+        ThreadRing & r = ring();
+        std::lock_guard<std::mutex> lock(mutex);
+        r.name = name;
+    }
+
+    /**
+     * The number of zones overwritten before they were collected.
+     */
+    std::uint64_t getLostCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return lost;
+    }
+
+    /**
+     * Move the zones recorded since the last collect() of every thread to
+     * out, in the order each thread finished them.
+     */
+    void collect(std::vector<TraceEvent> & out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const double scale = nanosecondsPerTick();
+        for (auto & r : rings) {
+            std::uint64_t head = r->head.load(std::memory_order_acquire);
+            std::uint64_t first = std::max(r->tail, head > Capacity ? head - Capacity : 0);
+            std::size_t start = out.size();
+            for (std::uint64_t i = first; i < head; i++) {
+                const Record & record = r->records[i & (Capacity - 1)];
+                out.push_back({record.name.load(std::memory_order_relaxed),
+                               "cpu",
+                               r->id,
+                               record.frame.load(std::memory_order_relaxed),
+                               toNanoseconds(record.begin.load(std::memory_order_relaxed), scale),
+                               toNanoseconds(record.end.load(std::memory_order_relaxed), scale)});
+            }
+            // drop the slots the thread overwrote while they were copied,
+            // including the one of record after it may be writing now. The
+            // fence orders the relaxed field reads before the head re-read
+            // and pairs with the release fence in push().
+            std::atomic_thread_fence(std::memory_order_acquire);
+            std::uint64_t after = r->head.load(std::memory_order_relaxed);
+            std::uint64_t valid = after + 1 > Capacity ? after + 1 - Capacity : 0;
+            if (valid > first) {
+                std::size_t torn = std::min<std::uint64_t>(valid - first, head - first);
+                out.erase(out.begin() + start, out.begin() + start + torn);
+                first += torn;
+            }
+            lost += first - r->tail;
+            r->tail = head;
+        }
+    }
+
+    /**
+     * Write events as Chrome trace JSON, for chrome://tracing or Perfetto.
+     * Thread names are taken from setThreadName(), events of the
+     * GpuProfiler go on a thread named GPU.
+     */
+    void writeChromeTrace(std::ostream & out, const std::vector<TraceEvent> & events) {
+        out << "{\"traceEvents\":[\n";
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+               "\"args\":{\"name\":\"GPU\"}}";
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto & r : rings) {
+                std::string name = r->name.empty() ? "thread " + std::to_string(r->id) : r->name;
+                out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << r->id
+                    << ",\"args\":{\"name\":\"" << name << "\"}}";
+            }
+        }
+        out << std::fixed << std::setprecision(3);
+        for (auto & e : events) {
+            out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                << ",\"ts\":" << e.begin / 1000.0 << ",\"dur\":" << (e.end - e.begin) / 1000.0
+                << ",\"args\":{\"frame\":" << e.frame << "}}";
+        }
+        out << "\n]}\n";
+    }
+
+    /**
+     * @throws ProfilerException if the file can not be written
+     */
+    void saveChromeTrace(const std::string & path, const std::vector<TraceEvent> & events) {
+        std::ofstream file(path);
+        if (!file)
+            throw ProfilerException("Could not open " + path);
+        writeChromeTrace(file, events);
+    }
+
+private:
+    /**
+     * Measured between construction and now, waits a millisecond if that
+     * is too short to be accurate.
+     */
+    double nanosecondsPerTick() const {
+#if defined(PROFILER_RDTSC)
+        std::int64_t elapsed = steadyNow() - startNanoseconds;
+        while (elapsed < 1000000) {
+            std::this_thread::yield();
+            elapsed = steadyNow() - startNanoseconds;
+        }
+        return double(elapsed) / double(now() - startTicks);
+#else
+        return 1.0;
+#endif
+    }
+
+    std::int64_t toNanoseconds(std::uint64_t ticks, double scale) const {
+        return startNanoseconds + std::int64_t(double(std::int64_t(ticks - startTicks)) * scale);
+    }
+};
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+
+#if defined(OPENGL_DEMO_PROFILE)
+
+/**
+ * Record the rest of the enclosing C++ scope as name.
+ */
+#define PROFILE_SCOPE(name) Profiler::Zone PROFILE_JOIN(profileZone, __LINE__)(name)
+#define PROFILE_FRAME(number) Profiler::get().setFrame(number)
+#define PROFILE_THREAD(name) Profiler::get().setThreadName(name)
+
+#else
+
+#define PROFILE_SCOPE(name) (void)0
+#define PROFILE_FRAME(number) (void)0
+#define PROFILE_THREAD(name) (void)0
+
+#endif
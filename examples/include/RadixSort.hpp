@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.hpp"
+
+/**
+ * Stable LSD radix sort of 64 bit keys with a 32 bit value each, one byte
+ * per pass. Passes where every key has the same byte are skipped, so keys
+ * that only use a few bits cost only a few passes.
+ *
+ * With a JobSystem the keys are split into one chunk per thread. Every pass
+ * counts the bytes of each chunk in parallel and every chunk scatters into
+ * its own offsets, which keeps the sort stable.
+ */
+class RadixSort {
+public:
+    /**
+     * Below this many keys a parallel sort is not worth the jobs.
+     */
+    static constexpr std::size_t MinParallel = 1 << 16;
+
+private:
+    std::vector<std::uint64_t> keyScratch;
+    std::vector<std::uint32_t> valueScratch;
+    std::vector<std::size_t> counts;
+    std::vector<std::size_t> allCounts;
+
+public:
+    /**
+     * Sort keys and reorder values with them.
+     *
+     * @param jobs the job system to sort on, nullptr to sort on this thread
+     */
+    void sort(std::vector<std::uint64_t> & keys,
+              std::vector<std::uint32_t> & values,
+              JobSystem * jobs = nullptr) {
+        const std::size_t n = keys.size();
+        keyScratch.resize(n);
+        valueScratch.resize(n);
+
+        std::size_t chunks = 1;
+        if (jobs && n >= MinParallel)
+            chunks = jobs->getThreadCount();
+        const std::size_t chunkSize = (n + chunks - 1) / chunks;
+
+        std::uint64_t * srcKeys = keys.data();
+        std::uint32_t * srcValues = values.data();
+        std::uint64_t * dstKeys = keyScratch.data();
+        std::uint32_t * dstValues = valueScratch.data();
+
+        auto forChunks = [&](auto && function) {
+            if (chunks == 1)
+                function(0);
+            else
+                jobs->parallelFor(0, chunks, 1, [&](std::size_t first, std::size_t last) {
+                    for (std::size_t c = first; c < last; c++) {
+                        function(c);
+                    }
+                });
+        };
+
+        // on one thread the counts of every byte are taken in one read,
+        // they do not depend on the order
+        if (chunks == 1) {
+            allCounts.assign(8 * 256, 0);
+            std::size_t * count = allCounts.data();
+            for (std::size_t i = 0; i < n; i++) {
+                // a local copy, the counts could alias the keys
+                std::uint64_t key = srcKeys[i];
+                for (unsigned byte = 0; byte < 8; byte++) {
+                    count[byte * 256 + ((key >> (byte * 8)) & 0xFF)]++;
+                }
+            }
+        }
+
+        counts.assign(chunks * 256, 0);
+        for (unsigned shift = 0; shift < 64; shift += 8) {
+            if (chunks == 1) {
+                std::copy(allCounts.begin() + shift * 32,
+                          allCounts.begin() + shift * 32 + 256,
+                          counts.begin());
+            }
+            else {
+                std::fill(counts.begin(), counts.end(), 0);
+                forChunks([&](std::size_t c) {
+                    std::size_t * count = &counts[c * 256];
+                    std::size_t end = std::min(n, (c + 1) * chunkSize);
+                    for (std::size_t i = c * chunkSize; i < end; i++) {
+                        std::uint64_t key = srcKeys[i];
+                        count[(key >> shift) & 0xFF]++;
+                    }
+                });
+            }
+
+            // the byte is the same everywhere, nothing to reorder
+            bool skip = false;
+            for (unsigned b = 0; b < 256 && !skip; b++) {
+                std::size_t total = 0;
+                for (std::size_t c = 0; c < chunks; c++) {
+                    total += counts[c * 256 + b];
+                }
+                skip = total == n;
+            }
+            if (skip)
+                continue;
+
+            // turn counts into the first output index of each chunk and byte
+            std::size_t offset = 0;
+            for (unsigned b = 0; b < 256; b++) {
+                for (std::size_t c = 0; c < chunks; c++) {
+                    std::size_t count = counts[c * 256 + b];
+                    counts[c * 256 + b] = offset;
+                    offset += count;
+                }
+            }
+
+            forChunks([&](std::size_t c) {
+                std::size_t * next = &counts[c * 256];
+                std::size_t end = std::min(n, (c + 1) * chunkSize);
+                for (std::size_t i = c * chunkSize; i < end; i++) {
+                    std::uint64_t key = srcKeys[i];
+                    std::size_t j = next[(key >> shift) & 0xFF]++;
+                    dstKeys[j] = key;
+                    dstValues[j] = srcValues[i];
+                }
+            });
+            std::swap(srcKeys, dstKeys);
+            std::swap(srcValues, dstValues);
+        }
+
+        // an odd number of passes leaves the result in the scratch arrays
+        if (srcKeys != keys.data()) {
+            keys.swap(keyScratch);
+            values.swap(valueScratch);
+        }
+    }
+};
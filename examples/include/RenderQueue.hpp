@@ -0,0 +1,259 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "JobSystem.hpp"
+#include "RadixSort.hpp"
+#include "RenderStats.hpp"
+#include "Shader.hpp"
+#include "Texture.hpp"
+
+/**
+ * One indexed draw, what to draw and with which state.
+ */
+struct DrawPacket {
+    const BufferArray * array = nullptr;
+    GLenum mode = GL_TRIANGLES;
+    GLsizei count = 0;
+    GLenum type = GL_UNSIGNED_INT;
+    const void * indices = nullptr;
+    GLsizei instances = 1;
+    glm::mat4 model = glm::mat4(1);
+
+    // ids from RenderQueue::addShader() and addTexture(), texture 0 is none
+    std::uint16_t shader = 0;
+    std::uint16_t texture = 0;
+    // layers are drawn in ascending order
+    std::uint8_t layer = 0;
+    bool translucent = false;
+};
+
+/**
+ * Collects draw packets, sorts them by a 64 bit key and submits them with
+ * as few state changes as possible.
+ *
+ * The key, most significant bits first:
+ *
+ *     opaque:      layer 4 | 0 | shader 12 | texture 12 | depth 24 | array 11
+ *     translucent: layer 4 | 1 | far depth 24 | shader 12 | texture 12 | array 11
+ *
+ * Opaque draws are grouped by shader and texture and go front to back
+ * within a group for early depth rejection, so the number of shader and
+ * texture switches follows the number of materials rather than the number
+ * of draws. Translucent draws come after the opaque ones of their layer and
+ * go back to front for correct blending.
+ *
+ * Keys are sorted with RadixSort, on the threads of a JobSystem if one is
+ * given.
+ */
+class RenderQueue {
+public:
+    static constexpr std::size_t MaxShaders = 1 << 12;
+    static constexpr std::size_t MaxTextures = 1 << 12;
+    static constexpr unsigned MaxLayers = 1 << 4;
+
+    class RenderQueueException : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * What the last submit() did.
+     */
+    struct Stats {
+        std::size_t draws = 0;
+        std::size_t shaderChanges = 0;
+        std::size_t textureChanges = 0;
+        std::size_t arrayChanges = 0;
+    };
+
+private:
+    struct ShaderEntry {
+        const Shader * shader;
+        Shader::Uniform model;
+    };
+
+    std::vector<ShaderEntry> shaders;
+    std::vector<const Texture *> textures;
+
+    std::vector<DrawPacket> packets;
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint32_t> order;
+    RadixSort sorter;
+
+    glm::mat4 view;
+    float nearPlane, farPlane;
+
+public:
+    RenderQueue() : textures {nullptr}, view(1), nearPlane(0.1f), farPlane(100.0f) {}
+
+    /**
+     * Register a shader, the model matrix of each packet is set to its
+     * modelUniform.
+     *
+     * @return the id to use in DrawPacket::shader
+     *
+     * @throws RenderQueueException when MaxShaders are registered
+     */
+    std::uint16_t addShader(const Shader & shader, const char * modelUniform = "model") {
+        if (shaders.size() == MaxShaders)
+            throw RenderQueueException("Too many shaders");
+        shaders.push_back({&shader, shader.uniform(modelUniform)});
+        return shaders.size() - 1;
+    }
+
+    /**
+     * @return the id to use in DrawPacket::texture, never 0
+     *
+     * @throws RenderQueueException when MaxTextures are registered
+     */
+    std::uint16_t addTexture(const Texture & texture) {
+        if (textures.size() == MaxTextures)
+            throw RenderQueueException("Too many textures");
+        textures.push_back(&texture);
+        return textures.size() - 1;
+    }
+
+    /**
+     * The view used to turn packet positions into depth for the keys.
+     *
+     * @param nearPlane the distance that maps to depth 0
+     * @param farPlane the distance that maps to the largest depth
+     */
+    void setView(const glm::mat4 & view, float nearPlane, float farPlane) {
+        this->view = view;
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+    }
+
+    std::size_t size() const {
+        return packets.size();
+    }
+
+    void clear() {
+        packets.clear();
+        keys.clear();
+        order.clear();
+    }
+
+    void push(const DrawPacket & packet) {
+        keys.push_back(makeKey(packet));
+        order.push_back(packets.size());
+        packets.push_back(packet);
+    }
+
+    /**
+     * Sort the packets by key, stable for equal keys.
+     */
+    void sort(JobSystem * jobs = nullptr) {
+        sorter.sort(keys, order, jobs);
+    }
+
+    /**
+     * Draw the packets in sorted order, only binding the shader, texture
+     * and vertex array when they change. Translucent packets are drawn with
+     * alpha blending and without depth writes. Without sort() the packets
+     * are drawn in the order they were pushed.
+     */
+    Stats submit() const {
+        Stats stats;
+        std::uint16_t shader = ~0, texture = ~0;
+        GLuint array = ~0u;
+        bool blending = false;
+        for (auto i : order) {
+            const DrawPacket & p = packets[i];
+            if (p.translucent != blending) {
+                blending = p.translucent;
+                setBlending(blending);
+            }
+            if (p.shader != shader) {
+                shader = p.shader;
+                shaders[shader].shader->bind();
+                stats.shaderChanges++;
+            }
+            if (p.texture != texture) {
+                texture = p.texture;
+                if (textures[texture]) {
+                    textures[texture]->bind();
+                }
+                else {
+                    CAPTURE(Capture::BindTexture {GL_TEXTURE_2D, 0, -1});
+                    glBindTexture(GL_TEXTURE_2D, 0);
+                }
+                stats.textureChanges++;
+            }
+            if (p.array->getArrayId() != array) {
+                array = p.array->getArrayId();
+                p.array->bind();
+                stats.arrayChanges++;
+            }
+            shaders[shader].model.setMat4(p.model);
+            RenderStats::countDraw(p.mode, p.count, p.instances);
+            // the draw wrappers of BufferArray would bind the array again
+            CAPTURE(Capture::DrawElements {p.mode, p.count, p.type,
+                                           p.instances == 1 ? 0 : p.instances,
+                                           reinterpret_cast<std::uintptr_t>(p.indices)});
+            if (p.instances == 1)
+                glDrawElements(p.mode, p.count, p.type, p.indices);
+            else
+                glDrawElementsInstanced(p.mode, p.count, p.type, p.indices, p.instances);
+            stats.draws++;
+        }
+        CAPTURE(Capture::BindVertexArray {0});
+        glBindVertexArray(0);
+        if (blending)
+            setBlending(false);
+        return stats;
+    }
+
+private:
+    /**
+     * Translucent draws blend over the opaque ones and do not write depth.
+     */
+    static void setBlending(bool enabled) {
+        if (enabled) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+        }
+        else {
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+        }
+    }
+
+    /**
+     * The distance of the packet's origin along the view direction mapped
+     * to 24 bits.
+     */
+    std::uint64_t depthBits(const DrawPacket & packet) const {
+        float z = -(view * packet.model[3]).z;
+        float d = (z - nearPlane) / (farPlane - nearPlane);
+        d = std::min(std::max(d, 0.0f), 1.0f);
+        return std::uint64_t(d * float((1 << 24) - 1));
+    }
+
+    std::uint64_t makeKey(const DrawPacket & packet) const {
+        std::uint64_t layer = packet.layer & (MaxLayers - 1);
+        std::uint64_t shader = packet.shader & (MaxShaders - 1);
+        std::uint64_t texture = packet.texture & (MaxTextures - 1);
+        std::uint64_t array = packet.array->getArrayId() & 0x7FF;
+        std::uint64_t depth = depthBits(packet);
+
+        std::uint64_t key = layer << 60;
+        if (!packet.translucent)
+            return key | shader << 47 | texture << 35 | depth << 11 | array;
+        std::uint64_t farFirst = (std::uint64_t(1) << 24) - 1 - depth;
+        return key | std::uint64_t(1) << 59 | farFirst << 35 | shader << 23
+               | texture << 11 | array;
+    }
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * The work submitted in one frame, as counted by the wrappers.
+ */
+struct FrameStats {
+    std::uint64_t drawCalls = 0;
+    std::uint64_t instances = 0;
+    std::uint64_t primitives = 0;
+    std::uint64_t dispatches = 0;
+    std::uint64_t bufferUploads = 0;
+    std::uint64_t bufferBytes = 0;
+    std::uint64_t textureUploads = 0;
+    std::uint64_t textureBytes = 0;
+    std::uint64_t bufferBinds = 0;
+    std::uint64_t arrayBinds = 0;
+    std::uint64_t textureBinds = 0;
+    std::uint64_t programBinds = 0;
+    std::uint64_t framebufferBinds = 0;
+    std::uint64_t blits = 0;
+};
+
+/**
+ * Per frame counters of draws, uploads and binds.
+ *
+ * Buffer, BufferArray, Texture, Shader, FrameBuffer, RenderQueue and
+ * MeshletCuller add to current() as they issue GL calls, which is a plain
+ * increment since GL is only called from one thread. endFrame() closes the
+ * frame and checks it against the budget.
+ *
+ * A budget is a FrameStats of limits, where 0 means no limit.
+ */
+class RenderStats {
+public:
+    struct Field {
+        const char * name;
+        std::uint64_t FrameStats::*value;
+    };
+
+private:
+    FrameStats frame;
+    FrameStats last;
+    FrameStats peak;
+    FrameStats budget;
+    std::uint64_t frames;
+    std::uint64_t overBudgetFrames;
+    std::vector<const char *> exceeded;
+
+    RenderStats() : frames(0), overBudgetFrames(0) {}
+
+public:
+    RenderStats(const RenderStats &) = delete;
+    RenderStats & operator=(const RenderStats &) = delete;
+
+    static RenderStats & get() {
+        static RenderStats stats;
+        return stats;
+    }
+
+    /**
+     * The counters of the frame being recorded.
+     */
+    static FrameStats & current() {
+        return get().frame;
+    }
+
+    /**
+     * Count a draw of count vertices or indices in mode.
+     */
+    static void countDraw(GLenum mode, std::uint64_t count, std::uint64_t instances = 1) {
+        FrameStats & f = current();
+        f.drawCalls++;
+        f.instances += instances;
+        f.primitives += primitives(mode, count) * instances;
+    }
+
+    static std::uint64_t primitives(GLenum mode, std::uint64_t count) {
+        switch (mode) {
+            case GL_POINTS:
+                return count;
+            case GL_LINES:
+                return count / 2;
+            case GL_LINE_STRIP:
+                return count > 0 ? count - 1 : 0;
+            case GL_LINE_LOOP:
+                return count;
+            case GL_TRIANGLES:
+                return count / 3;
+            case GL_TRIANGLE_STRIP:
+            case GL_TRIANGLE_FAN:
+                return count > 2 ? count - 2 : 0;
+            default:
+                return 0;
+        }
+    }
+
+    /**
+     * Close the frame: keep its counters as getLast(), update the peaks and
+     * reset the counters.
+     *
+     * @return false if the frame went over the budget
+     */
+    bool endFrame() {
+        last = frame;
+        frame = FrameStats();
+        frames++;
+        exceeded.clear();
+        for (auto & field : fields()) {
+            std::uint64_t value = last.*field.value;
+            peak.*field.value = std::max(peak.*field.value, value);
+            std::uint64_t limit = budget.*field.value;
+            if (limit > 0 && value > limit)
+                exceeded.push_back(field.name);
+        }
+        if (!exceeded.empty())
+            overBudgetFrames++;
+        return exceeded.empty();
+    }
+
+    /**
+     * The counters of the last finished frame.
+     */
+    const FrameStats & getLast() const {
+        return last;
+    }
+
+    /**
+     * The highest value of every counter over all finished frames.
+     */
+    const FrameStats & getPeak() const {
+        return peak;
+    }
+
+    std::uint64_t getFrameCount() const {
+        return frames;
+    }
+
+    void setBudget(const FrameStats & limits) {
+        budget = limits;
+    }
+
+    const FrameStats & getBudget() const {
+        return budget;
+    }
+
+    /**
+     * The counters of the last frame that were over the budget.
+     */
+    const std::vector<const char *> & getExceeded() const {
+        return exceeded;
+    }
+
+    std::uint64_t getOverBudgetFrames() const {
+        return overBudgetFrames;
+    }
+
+    void reset() {
+        frame = last = peak = FrameStats();
+        frames = overBudgetFrames = 0;
+        exceeded.clear();
+    }
+
+    /**
+     * Every counter with its name, in declaration order.
+     */
+    static const std::vector<Field> & fields() {
+        static const std::vector<Field> list {
+            {"drawCalls", &FrameStats::drawCalls},
+            {"instances", &FrameStats::instances},
+            {"primitives", &FrameStats::primitives},
+            {"dispatches", &FrameStats::dispatches},
+            {"bufferUploads", &FrameStats::bufferUploads},
+            {"bufferBytes", &FrameStats::bufferBytes},
+            {"textureUploads", &FrameStats::textureUploads},
+            {"textureBytes", &FrameStats::textureBytes},
+            {"bufferBinds", &FrameStats::bufferBinds},
+            {"arrayBinds", &FrameStats::arrayBinds},
+            {"textureBinds", &FrameStats::textureBinds},
+            {"programBinds", &FrameStats::programBinds},
+            {"framebufferBinds", &FrameStats::framebufferBinds},
+            {"blits", &FrameStats::blits},
+        };
+        return list;
+    }
+
+    /**
+     * Write stats as a JSON object of counters.
+     */
+    static void writeJson(std::ostream & out, const FrameStats & stats) {
+        out << '{';
+        bool first = true;
+        for (auto & field : fields()) {
+            if (!first)
+                out << ',';
+            first = false;
+            out << '"' << field.name << "\":" << stats.*field.value;
+        }
+        out << '}';
+    }
+
+    /**
+     * Write the last frame, the peaks, the budget and the frames over it as
+     * one JSON object.
+     */
+    void writeJson(std::ostream & out) const {
+        out << "{\"frames\":" << frames << ",\"overBudgetFrames\":" << overBudgetFrames
+            << ",\"last\":";
+        writeJson(out, last);
+        out << ",\"peak\":";
+        writeJson(out, peak);
+        out << ",\"budget\":";
+        writeJson(out, budget);
+        out << "}\n";
+    }
+
+    /**
+     * A one line summary of stats, short enough for a window title.
+     */
+    static std::string summary(const FrameStats & stats) {
+        return std::to_string(stats.drawCalls) + " draws, "
+               + std::to_string(stats.primitives) + " prims, "
+               + std::to_string(stats.programBinds) + " programs, "
+               + std::to_string(stats.textureBinds) + " textures, "
+               + std::to_string((stats.bufferBytes + stats.textureBytes) / 1024) + " KiB up";
+    }
+};
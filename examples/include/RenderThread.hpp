@@ -0,0 +1,680 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "FrameBuffer.hpp"
+#include "Profiler.hpp"
+#include "Shader.hpp"
+#include "Texture.hpp"
+
+/**
+ * Refers to a resource that lives on the render thread. Handles are handed
+ * out by the thread that records commands, so they can be used in the
+ * commands right after the one that creates the resource.
+ */
+template<typename T>
+struct Handle {
+    std::uint32_t id = 0;
+
+    explicit operator bool() const {
+        return id != 0;
+    }
+};
+
+/**
+ * The resources of the render thread, only touched by commands.
+ */
+class RenderResources {
+    template<typename T>
+    using Table = std::vector<std::unique_ptr<T>>;
+
+    std::tuple<Table<Buffer>, Table<BufferArray>, Table<Texture>, Table<Shader>, Table<FrameBuffer>>
+        tables;
+
+    struct Location {
+        const char * name;
+        GLuint location;
+    };
+
+    // uniform locations by shader, looked up once per name
+    std::vector<std::vector<Location>> locations;
+
+    template<typename T>
+    Table<T> & table() {
+        return std::get<Table<T>>(tables);
+    }
+
+public:
+    template<typename T>
+    T & get(Handle<T> handle) {
+        return *table<T>()[handle.id];
+    }
+
+    /**
+     * Construct the resource of handle from args.
+     */
+    template<typename T, typename... Args>
+    T & emplace(Handle<T> handle, Args &&... args) {
+        auto & list = table<T>();
+        if (handle.id >= list.size())
+            list.resize(handle.id + 1);
+        list[handle.id] = std::make_unique<T>(std::forward<Args>(args)...);
+        return *list[handle.id];
+    }
+
+    template<typename T>
+    void erase(Handle<T> handle) {
+        auto & list = table<T>();
+        if (handle.id < list.size())
+            list[handle.id].reset();
+        if (std::is_same<T, Shader>::value && handle.id < locations.size())
+            locations[handle.id].clear();
+    }
+
+    /**
+     * Delete every resource, while the context is still current.
+     */
+    void clear() {
+        tables = {};
+        locations.clear();
+    }
+
+    /**
+     * The uniform called name of shader. Locations are cached by the name
+     * pointer, use string literals.
+     */
+    Shader::Uniform uniform(Handle<Shader> shader, const char * name) {
+        if (shader.id >= locations.size())
+            locations.resize(shader.id + 1);
+        for (auto & location : locations[shader.id]) {
+            if (location.name == name)
+                return Shader::Uniform(location.location);
+        }
+        Shader::Uniform uniform = get(shader).uniform(name);
+        locations[shader.id].push_back({name, uniform.getLocation()});
+        return uniform;
+    }
+};
+
+/**
+ * A single producer, single consumer ring of commands.
+ *
+ * A command is a trivially copyable callable, usually a lambda that
+ * captures handles and values, copied into the ring as a packet with an
+ * optional block of data. Packets never wrap, a padding packet fills the
+ * end of the ring when the next one does not fit. The producer only writes
+ * head and the consumer only writes tail, so neither side takes a lock.
+ */
+template<typename Context>
+class CommandRing {
+public:
+    static constexpr std::size_t Align = 16;
+
+    class CommandRingException : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+private:
+    using Execute = void (*)(Context &, const void * command, const void * data, std::size_t size);
+
+    struct alignas(Align) Packet {
+        // nullptr for padding
+        Execute execute;
+        std::uint32_t size;
+        std::uint32_t dataSize;
+    };
+
+    static_assert(sizeof(Packet) == Align, "packets are one alignment unit");
+
+    std::vector<unsigned char> storage;
+    unsigned char * ring;
+    std::size_t mask;
+
+    alignas(64) std::atomic<std::size_t> head;
+    alignas(64) std::atomic<std::size_t> tail;
+
+    static constexpr std::size_t align(std::size_t size) {
+        return (size + Align - 1) & ~(Align - 1);
+    }
+
+    template<typename F>
+    static void call(Context & context, const void * command, const void *, std::size_t) {
+        (*static_cast<const F *>(command))(context);
+    }
+
+    template<typename F>
+    static void callWithData(Context & context,
+                             const void * command,
+                             const void * data,
+                             std::size_t size) {
+        (*static_cast<const F *>(command))(context, data, size);
+    }
+
+    /**
+     * Write a packet of command and size bytes of data.
+     *
+     * @return false if there is no room
+     * @throws CommandRingException if the packet can never fit
+     */
+    template<typename F>
+    bool tryPush(Execute execute, const F & command, const void * data, std::size_t size) {
+        static_assert(std::is_trivially_copyable<F>::value,
+                      "commands are copied as bytes, capture only plain values and handles");
+        static_assert(alignof(F) <= Align, "command alignment");
+
+        const std::size_t commandSize = align(sizeof(F));
+        const std::size_t packetSize = sizeof(Packet) + commandSize + align(size);
+        if (packetSize > capacity() / 2)
+            throw CommandRingException("A command of " + std::to_string(packetSize)
+                                       + " bytes does not fit a ring of "
+                                       + std::to_string(capacity()));
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        const std::size_t offset = h & mask;
+        const std::size_t padding = offset + packetSize > capacity() ? capacity() - offset : 0;
+        if (h + padding + packetSize - tail.load(std::memory_order_acquire) > capacity())
+            return false;
+
+        std::size_t at = offset;
+        if (padding > 0) {
+            Packet pad {nullptr, std::uint32_t(padding), 0};
+            std::memcpy(ring + at, &pad, sizeof(pad));
+            at = 0;
+        }
+        Packet packet {execute, std::uint32_t(packetSize), std::uint32_t(size)};
+        std::memcpy(ring + at, &packet, sizeof(packet));
+        std::memcpy(ring + at + sizeof(Packet), &command, sizeof(F));
+        if (size > 0)
+            std::memcpy(ring + at + sizeof(Packet) + commandSize, data, size);
+        head.store(h + padding + packetSize, std::memory_order_release);
+        return true;
+    }
+
+public:
+    /**
+     * @param capacity the size of the ring in bytes, rounded up to a power
+     *                 of two
+     */
+    explicit CommandRing(std::size_t capacity) : head(0), tail(0) {
+        std::size_t size = 1024;
+        while (size < capacity)
+            size *= 2;
+        // commands run in place, so the ring starts aligned
+        storage.resize(size + Align);
+        void * base = storage.data();
+        std::size_t space = storage.size();
+        ring = static_cast<unsigned char *>(std::align(Align, size, base, space));
+        mask = size - 1;
+    }
+
+    CommandRing(const CommandRing &) = delete;
+    CommandRing & operator=(const CommandRing &) = delete;
+
+    std::size_t capacity() const {
+        return mask + 1;
+    }
+
+    /**
+     * The largest block of data a command can carry in the ring.
+     */
+    std::size_t maxDataSize() const {
+        return capacity() / 4;
+    }
+
+    /**
+     * Push a command called with the consumer's context.
+     */
+    template<typename F>
+    bool tryPush(const F & command) {
+        return tryPush(&call<F>, command, nullptr, 0);
+    }
+
+    /**
+     * Push a command called with the consumer's context and a copy of
+     * size bytes of data, size must be at most maxDataSize().
+     */
+    template<typename F>
+    bool tryPush(const F & command, const void * data, std::size_t size) {
+        return tryPush(&callWithData<F>, command, data, size);
+    }
+
+    bool empty() const {
+        return tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Run every published command, only called by the consumer.
+     *
+     * @return the number of commands run
+     */
+    std::size_t consume(Context & context) {
+        const std::size_t end = head.load(std::memory_order_acquire);
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        std::size_t count = 0;
+        while (t != end) {
+            Packet packet;
+            const unsigned char * at = ring + (t & mask);
+            std::memcpy(&packet, at, sizeof(packet));
+            t += packet.size;
+            if (packet.execute) {
+                // release the packet even when the command throws
+                struct Release {
+                    std::atomic<std::size_t> & tail;
+                    std::size_t value;
+                    ~Release() {
+                        tail.store(value, std::memory_order_release);
+                    }
+                } release {tail, t};
+                std::size_t commandSize = packet.size - sizeof(Packet)
+                                          - align(packet.dataSize);
+                packet.execute(context, at + sizeof(Packet), at + sizeof(Packet) + commandSize,
+                               packet.dataSize);
+                count++;
+            }
+            else {
+                tail.store(t, std::memory_order_release);
+            }
+        }
+        return count;
+    }
+};
+
+/**
+ * A thread that owns the GL context and runs the commands recorded by the
+ * thread that creates it, which keeps polling events and running the game
+ * logic. The recording thread works up to framesAhead frames ahead, so
+ * logic and driver submission overlap.
+ *
+ * acquire() makes the context current on the render thread, present()
+ * swaps and release() lets go of the context before the thread ends. With
+ * SFML deactivate the window on the main thread first, then acquire with
+ * window.setActive(true) and present with window.display().
+ *
+ * Commands are trivially copyable callables taking RenderResources &, they
+ * capture handles and values. Pointers in a command must stay valid until
+ * it has run, string literals are fine, everything else goes in the data of
+ * submit(). An exception in a command stops the render thread, it is thrown
+ * again from the next endFrame() or finish().
+ *
+ * Without threaded the commands run on the calling thread in endFrame(),
+ * the same commands without the overlap, to compare.
+ */
+class RenderThread {
+public:
+    static constexpr std::size_t DefaultCapacity = 8 << 20;
+    // spins of an idle render thread before it sleeps
+    static constexpr unsigned Spins = 256;
+    // commands recorded before a sleeping render thread is woken
+    static constexpr unsigned Batch = 64;
+
+    using Callback = std::function<void()>;
+
+    class RenderThreadException : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+private:
+    CommandRing<RenderResources> ring;
+    RenderResources resources;
+    Callback acquire;
+    Callback present;
+    Callback release;
+    bool threaded;
+    unsigned framesAhead;
+
+    // the last handle handed out by type, id 0 is never used
+    std::tuple<Handle<Buffer>, Handle<BufferArray>, Handle<Texture>, Handle<Shader>, Handle<FrameBuffer>>
+        last;
+
+    std::uint64_t submitted;
+    unsigned unannounced;
+    std::atomic<std::uint64_t> rendered;
+    std::atomic<bool> sleeping;
+    std::atomic<bool> stopping;
+    std::atomic<bool> failed;
+    bool stopped;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable frameDone;
+    std::thread thread;
+    double waited;
+
+    // heap copies of data too big for the ring, freed when their command has
+    // run or with the RenderThread when it never will
+    std::mutex copiesMutex;
+    std::vector<std::unique_ptr<unsigned char[]>> copies;
+
+public:
+    /**
+     * @param acquire makes the context current on the render thread
+     * @param present presents a frame
+     * @param release called on the render thread before it ends
+     * @param threaded run the commands on a thread of their own
+     * @param capacity the size of the command ring in bytes
+     */
+    RenderThread(const Callback & acquire,
+                 const Callback & present,
+                 const Callback & release = Callback(),
+                 bool threaded = true,
+                 std::size_t capacity = DefaultCapacity)
+        : ring(capacity),
+          acquire(acquire),
+          present(present),
+          release(release),
+          threaded(threaded),
+          framesAhead(1),
+          submitted(0),
+          unannounced(0),
+          rendered(0),
+          sleeping(false),
+          stopping(false),
+          failed(false),
+          stopped(false),
+          waited(0) {
+        if (threaded) {
+            thread = std::thread(&RenderThread::loop, this);
+        }
+        else if (acquire) {
+            acquire();
+        }
+    }
+
+    RenderThread(const RenderThread &) = delete;
+    RenderThread & operator=(const RenderThread &) = delete;
+
+    /**
+     * Run what is left and stop the render thread.
+     */
+    ~RenderThread() {
+        stop();
+        // the data of commands left in the ring after a command failed
+        copies.clear();
+    }
+
+    bool isThreaded() const {
+        return threaded;
+    }
+
+    /**
+     * How many frames the recording thread may be ahead of the render
+     * thread, at least 1.
+     */
+    void setFramesAhead(unsigned frames) {
+        framesAhead = std::max(frames, 1u);
+    }
+
+    /**
+     * A new handle for a resource, create it with a command.
+     */
+    template<typename T>
+    Handle<T> allocate() {
+        return Handle<T> {++std::get<Handle<T>>(last).id};
+    }
+
+    /**
+     * Create a resource from args on the render thread, args are copied
+     * into the command.
+     */
+    template<typename T, typename... Args>
+    Handle<T> create(const Args &... args) {
+        Handle<T> handle = allocate<T>();
+        submit([handle, args...](RenderResources & r) { r.emplace(handle, args...); });
+        return handle;
+    }
+
+    template<typename T>
+    void destroy(Handle<T> handle) {
+        submit([handle](RenderResources & r) { r.erase(handle); });
+    }
+
+    /**
+     * Record command, called with RenderResources & on the render thread.
+     */
+    template<typename F>
+    void submit(const F & command) {
+        while (!ring.tryPush(command))
+            full();
+        if (++unannounced >= Batch)
+            published();
+    }
+
+    /**
+     * Record command with a copy of size bytes of data, called with
+     * RenderResources &, the copy and size on the render thread.
+     */
+    template<typename F>
+    void submit(const F & command, const void * data, std::size_t size) {
+        if (size > ring.maxDataSize()) {
+            // too big for the ring, the command gets a heap copy instead
+            unsigned char * copy = new unsigned char[size];
+            std::memcpy(copy, data, size);
+            {
+                std::lock_guard<std::mutex> lock(copiesMutex);
+                copies.emplace_back(copy);
+            }
+            submit([this, command, copy, size](RenderResources & r) {
+                try {
+                    command(r, copy, size);
+                } catch (...) {
+                    freeCopy(copy);
+                    throw;
+                }
+                freeCopy(copy);
+            });
+            return;
+        }
+        while (!ring.tryPush(command, data, size))
+            full();
+        if (++unannounced >= Batch)
+            published();
+    }
+
+    /**
+     * Record the present of the frame, then wait while the render thread is
+     * more than framesAhead frames behind.
+     *
+     * @throws RenderThreadException or the exception of a failed command
+     */
+    void endFrame() {
+        PROFILE_SCOPE("RenderThread::endFrame");
+        submit([this](RenderResources &) { presentFrame(); });
+        submitted++;
+        published();
+        if (!threaded) {
+            ring.consume(resources);
+            return;
+        }
+        // the first framesAhead frames do not wait, submitted - framesAhead
+        // would wrap around
+        wait(submitted > framesAhead ? submitted - framesAhead : 0);
+    }
+
+    /**
+     * Wait until every recorded frame was presented.
+     *
+     * @throws RenderThreadException or the exception of a failed command
+     */
+    void finish() {
+        if (threaded)
+            wait(submitted);
+        else
+            ring.consume(resources);
+    }
+
+    /**
+     * The number of frames recorded with endFrame().
+     */
+    std::uint64_t getFrameCount() const {
+        return submitted;
+    }
+
+    std::uint64_t getRenderedFrames() const {
+        return rendered.load(std::memory_order_acquire);
+    }
+
+    /**
+     * The milliseconds the recording thread waited for the render thread
+     * in the last endFrame().
+     */
+    double getWaitTime() const {
+        return waited;
+    }
+
+    /**
+     * Run what is left and end the render thread, after this the context
+     * is released and no more commands can run.
+     */
+    void stop() {
+        if (stopped)
+            return;
+        stopped = true;
+        if (threaded) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping.store(true);
+            }
+            wake.notify_one();
+            thread.join();
+        }
+        else {
+            ring.consume(resources);
+            resources.clear();
+            if (release)
+                release();
+        }
+    }
+
+private:
+    void freeCopy(const unsigned char * copy) {
+        std::lock_guard<std::mutex> lock(copiesMutex);
+        auto it = std::find_if(copies.begin(), copies.end(),
+                               [&](const std::unique_ptr<unsigned char[]> & c) {
+                                   return c.get() == copy;
+                               });
+        if (it != copies.end())
+            copies.erase(it);
+    }
+
+    void presentFrame() {
+        if (present)
+            present();
+        rendered.fetch_add(1, std::memory_order_release);
+        if (threaded) {
+            std::lock_guard<std::mutex> lock(mutex);
+            frameDone.notify_one();
+        }
+    }
+
+    /**
+     * Make room in a full ring.
+     */
+    void full() {
+        if (!threaded) {
+            ring.consume(resources);
+            return;
+        }
+        rethrow();
+        published();
+        std::this_thread::yield();
+    }
+
+    /**
+     * Wake the render thread if it sleeps. Only every Batch commands, a
+     * wake per command costs more than the command. The fence pairs with the
+     * one in loop() so either this sees sleeping or the render thread sees
+     * the commands.
+     */
+    void published() {
+        unannounced = 0;
+        if (!threaded)
+            return;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_one();
+        }
+    }
+
+    void wait(std::uint64_t frame) {
+        auto start = std::chrono::steady_clock::now();
+        if (rendered.load(std::memory_order_acquire) < frame) {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameDone.wait(lock, [&] {
+                return rendered.load(std::memory_order_acquire) >= frame || failed.load();
+            });
+        }
+        waited = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                           - start)
+                     .count();
+        rethrow();
+    }
+
+    void rethrow() {
+        if (!failed.load(std::memory_order_acquire))
+            return;
+        if (error)
+            std::rethrow_exception(error);
+        throw RenderThreadException("The render thread failed");
+    }
+
+    void loop() {
+        PROFILE_THREAD("render");
+        try {
+            if (acquire)
+                acquire();
+            // with a single core spinning only takes time from the recording thread
+            const unsigned spins = std::thread::hardware_concurrency() > 1 ? Spins : 0;
+            unsigned idle = 0;
+            while (true) {
+                if (ring.consume(resources) > 0) {
+                    idle = 0;
+                    continue;
+                }
+                if (stopping.load(std::memory_order_acquire) && ring.empty())
+                    break;
+                if (++idle < spins) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(mutex);
+                sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                wake.wait(lock, [&] { return !ring.empty() || stopping.load(); });
+                sleeping.store(false, std::memory_order_relaxed);
+                idle = 0;
+            }
+        } catch (...) {
+            error = std::current_exception();
+            failed.store(true, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(mutex);
+            frameDone.notify_one();
+        }
+        resources.clear();
+        if (release)
+            release();
+    }
+};
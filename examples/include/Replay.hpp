@@ -0,0 +1,822 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Capture.hpp"
+#include "FrameBuffer.hpp"
+
+/**
+ * Executes a stream recorded by Capture on the current context.
+ *
+ * Objects get new names as they are created, uniform locations are looked
+ * up again by name and frame buffer 0 is FrameBuffer::getDefault(). The
+ * default frame buffer is cleared before the first draw of every frame with
+ * the recorded clear values, since the application's glClear is not
+ * recorded. Every frame ends with glFinish() so its time includes the GPU
+ * work, every call is timed on the CPU and with setSynchronous() also
+ * waits for the GPU.
+ *
+ * A stream can only be run once per context since it creates its objects.
+ * run() always executes the frames before the range too, they build the
+ * state the range needs, but only the range is timed.
+ */
+class Replay {
+public:
+    class ReplayException : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * The stream ends inside a command, like the capture of a process that
+     * crashed.
+     */
+    class TruncatedException : public ReplayException {
+    public:
+        TruncatedException() : ReplayException("Capture is truncated") {}
+    };
+
+    struct CallStats {
+        Capture::Op op;
+        std::uint64_t count = 0;
+        double total = 0;
+        double max = 0;
+    };
+
+    struct Call {
+        std::uint64_t frame;
+        // the position of the call in its frame
+        std::uint64_t index;
+        Capture::Op op;
+        double ms;
+    };
+
+    // the number of slowest calls kept
+    static constexpr std::size_t SlowestCalls = 16;
+    // object names and uniform locations above are taken as a corrupt stream
+    static constexpr std::uint32_t MaxName = 1 << 20;
+
+private:
+    std::vector<char> stream;
+    const char * cursor;
+    const char * end;
+
+    std::vector<GLuint> names[Capture::ObjectCount];
+    // the replayed location of every recorded location, by recorded program
+    std::vector<std::vector<GLint>> locations;
+    GLuint program;
+    // the default frame buffer is cleared before the next draw
+    bool clearPending;
+
+    bool synchronous;
+    bool truncated;
+    std::uint64_t frames;
+    std::uint64_t firstTimed;
+    std::vector<double> frameTimes;
+    std::vector<CallStats> calls;
+    std::vector<Call> slowest;
+
+public:
+    /**
+     * Load a capture file.
+     *
+     * @throws ReplayException if the file can not be read or is not a
+     * capture of this version
+     */
+    explicit Replay(const std::string & path)
+        : cursor(nullptr), end(nullptr), program(0), clearPending(true),
+          synchronous(false),
+          truncated(false),
+          frames(0),
+          firstTimed(0) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw ReplayException("Could not open " + path);
+        stream.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        Capture::Header expected;
+        Capture::Header header;
+        if (stream.size() < sizeof(header))
+            throw ReplayException(path + " is not a capture");
+        std::memcpy(&header, stream.data(), sizeof(header));
+        if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0)
+            throw ReplayException(path + " is not a capture");
+        if (header.version != Capture::Version)
+            throw ReplayException(path + " is capture version "
+                                  + std::to_string(header.version) + ", expected "
+                                  + std::to_string(Capture::Version));
+        cursor = stream.data() + sizeof(header);
+        end = stream.data() + stream.size();
+
+        for (std::size_t op = 0; op < std::size_t(Capture::Op::Count); op++) {
+            CallStats s;
+            s.op = Capture::Op(op);
+            calls.push_back(s);
+        }
+    }
+
+    Replay(const Replay &) = delete;
+    Replay & operator=(const Replay &) = delete;
+
+    ~Replay() {
+        for (GLuint name : names[Capture::BufferObject])
+            if (name)
+                glDeleteBuffers(1, &name);
+        for (GLuint name : names[Capture::VertexArrayObject])
+            if (name)
+                glDeleteVertexArrays(1, &name);
+        for (GLuint name : names[Capture::TextureObject])
+            if (name)
+                glDeleteTextures(1, &name);
+        for (GLuint name : names[Capture::ProgramObject])
+            if (name)
+                glDeleteProgram(name);
+        for (GLuint name : names[Capture::FramebufferObject])
+            if (name)
+                glDeleteFramebuffers(1, &name);
+        for (GLuint name : names[Capture::RenderbufferObject])
+            if (name)
+                glDeleteRenderbuffers(1, &name);
+    }
+
+    /**
+     * Wait for the GPU after every call, so call times include the GPU
+     * work instead of only the submission.
+     */
+    void setSynchronous(bool synchronous) {
+        this->synchronous = synchronous;
+    }
+
+    /**
+     * Execute the stream up to the end of frame last, or to the end of the
+     * stream, and time the frames from first on. A truncated stream is
+     * executed up to the last whole command, see isTruncated().
+     *
+     * @throws ReplayException if the stream is corrupt or a program fails
+     * to build
+     */
+    void run(std::uint64_t first = 0,
+             std::uint64_t last = std::numeric_limits<std::uint64_t>::max()) {
+        using clock = std::chrono::steady_clock;
+        firstTimed = std::max(first, frames);
+        auto frameStart = clock::now();
+        std::uint64_t index = 0;
+        while (cursor < end && frames <= last) {
+            Capture::Op op = read<Capture::Op>();
+            if (op >= Capture::Op::Count)
+                throw ReplayException("Unknown op " + std::to_string(int(op)));
+            // not timed as a call, the application's glClear is not either
+            if (clearPending && Capture::usesState(op))
+                clearFrame();
+
+            auto start = clock::now();
+            try {
+                execute(op);
+            } catch (TruncatedException &) {
+                truncated = true;
+                break;
+            }
+            if (synchronous)
+                glFinish();
+            double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+            if (frames >= first) {
+                CallStats & s = calls[std::size_t(op)];
+                s.count++;
+                s.total += ms;
+                s.max = std::max(s.max, ms);
+                keepIfSlow({frames, index, op, ms});
+            }
+            index++;
+
+            if (op == Capture::Op::EndFrame) {
+                if (frames >= first) {
+                    frameTimes.push_back(
+                        std::chrono::duration<double, std::milli>(clock::now() - frameStart)
+                            .count());
+                }
+                frames++;
+                index = 0;
+                frameStart = clock::now();
+            }
+        }
+        glFinish();
+    }
+
+    /**
+     * The number of frames executed so far.
+     */
+    std::uint64_t getFrameCount() const {
+        return frames;
+    }
+
+    /**
+     * The time of every timed frame in milliseconds, starting at frame
+     * getFirstTimedFrame().
+     */
+    const std::vector<double> & getFrameTimes() const {
+        return frameTimes;
+    }
+
+    std::uint64_t getFirstTimedFrame() const {
+        return firstTimed;
+    }
+
+    /**
+     * Whether the stream ended inside a command.
+     */
+    bool isTruncated() const {
+        return truncated;
+    }
+
+    /**
+     * The call times by op over the timed frames, in milliseconds.
+     */
+    const std::vector<CallStats> & getCallStats() const {
+        return calls;
+    }
+
+    /**
+     * The slowest calls of the timed frames, slowest first.
+     */
+    const std::vector<Call> & getSlowestCalls() const {
+        return slowest;
+    }
+
+    void report(std::ostream & out) const {
+        out << std::fixed << std::setprecision(3);
+        out << "frame        ms" << std::endl;
+        for (std::size_t i = 0; i < frameTimes.size(); i++)
+            out << std::setw(5) << firstTimed + i << std::setw(10)
+                << frameTimes[i] << std::endl;
+
+        out << std::endl
+            << std::left << std::setw(24) << "call" << std::right << std::setw(10) << "count"
+            << std::setw(12) << "total" << std::setw(10) << "avg" << std::setw(10) << "max"
+            << "  (ms)" << std::endl;
+        for (auto & s : calls) {
+            if (s.count == 0)
+                continue;
+            out << std::left << std::setw(24) << Capture::name(s.op) << std::right
+                << std::setw(10) << s.count << std::setw(12) << s.total << std::setw(10)
+                << s.total / s.count << std::setw(10) << s.max << std::endl;
+        }
+
+        out << std::endl << "slowest calls" << std::endl;
+        for (auto & call : slowest)
+            out << "  frame " << call.frame << " call " << call.index << " "
+                << Capture::name(call.op) << " " << call.ms << " ms" << std::endl;
+    }
+
+    void writeJson(std::ostream & out) const {
+        out << std::fixed << std::setprecision(4);
+        out << "{\"firstFrame\":" << firstTimed << ",\"frames\":[";
+        for (std::size_t i = 0; i < frameTimes.size(); i++)
+            out << (i ? "," : "") << frameTimes[i];
+        out << "],\"calls\":{";
+        bool first = true;
+        for (auto & s : calls) {
+            if (s.count == 0)
+                continue;
+            out << (first ? "" : ",") << '"' << Capture::name(s.op) << "\":{\"count\":" << s.count
+                << ",\"total\":" << s.total << ",\"max\":" << s.max << '}';
+            first = false;
+        }
+        out << "},\"slowest\":[";
+        for (std::size_t i = 0; i < slowest.size(); i++) {
+            auto & call = slowest[i];
+            out << (i ? "," : "") << "{\"frame\":" << call.frame << ",\"call\":" << call.index
+                << ",\"op\":\"" << Capture::name(call.op) << "\",\"ms\":" << call.ms << '}';
+        }
+        out << "]}\n";
+    }
+
+private:
+    template <typename T>
+    T read() {
+        T value;
+        if (std::size_t(end - cursor) < sizeof(T))
+            throw TruncatedException();
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+
+    /**
+     * Read the data of a command, nullptr if it has none.
+     */
+    const void * data(std::uint64_t & size) {
+        size = read<std::uint64_t>();
+        if (std::uint64_t(end - cursor) < size)
+            throw TruncatedException();
+        const char * bytes = cursor;
+        cursor += size;
+        return size ? bytes : nullptr;
+    }
+
+    const void * data() {
+        std::uint64_t size;
+        return data(size);
+    }
+
+    static void checkName(std::uint32_t id) {
+        if (id > MaxName)
+            throw ReplayException("Name " + std::to_string(id) + " is out of range");
+    }
+
+    GLuint & slot(std::uint32_t object, GLuint id) {
+        if (object >= Capture::ObjectCount)
+            throw ReplayException("Unknown object kind " + std::to_string(object));
+        checkName(id);
+        auto & list = names[object];
+        if (id >= list.size())
+            list.resize(id + 1, 0);
+        return list[id];
+    }
+
+    /**
+     * The replayed name of a recorded one, 0 stays 0 and objects created
+     * before the capture started are 0 too.
+     */
+    GLuint name(std::uint32_t object, GLuint id) const {
+        if (object == Capture::FramebufferObject && id == 0)
+            return FrameBuffer::getDefault().getBufferId();
+        auto & list = names[object];
+        return id < list.size() ? list[id] : 0;
+    }
+
+    GLint location(GLint recorded) const {
+        if (recorded < 0 || program >= locations.size())
+            return recorded;
+        auto & list = locations[program];
+        return std::size_t(recorded) < list.size() ? list[recorded] : recorded;
+    }
+
+    void keepIfSlow(const Call & call) {
+        if (slowest.size() == SlowestCalls && call.ms <= slowest.back().ms)
+            return;
+        auto it = std::upper_bound(slowest.begin(), slowest.end(), call,
+                                   [](const Call & a, const Call & b) { return a.ms > b.ms; });
+        slowest.insert(it, call);
+        if (slowest.size() > SlowestCalls)
+            slowest.pop_back();
+    }
+
+    void execute(Capture::Op op) {
+        switch (op) {
+            case Capture::Op::EndFrame:
+                read<Capture::EndFrame>();
+                glFinish();
+                clearPending = true;
+                break;
+            case Capture::Op::Create:
+                create(read<Capture::Create>());
+                break;
+            case Capture::Op::Delete:
+                destroy(read<Capture::Delete>());
+                break;
+            case Capture::Op::BindBuffer: {
+                auto c = read<Capture::BindBuffer>();
+                glBindBuffer(c.target, name(Capture::BufferObject, c.buffer));
+                break;
+            }
+            case Capture::Op::BindBufferBase: {
+                auto c = read<Capture::BindBufferBase>();
+                glBindBufferBase(c.target, c.index, name(Capture::BufferObject, c.buffer));
+                break;
+            }
+            case Capture::Op::BufferData: {
+                auto c = read<Capture::BufferData>();
+                std::uint64_t size;
+                const void * bytes = data(size);
+                // without data the store is left uninitialized
+                if (c.size < 0 || (size && size != std::uint64_t(c.size)))
+                    throw ReplayException("BufferData data does not match its size");
+                glBufferData(c.target, c.size, bytes, c.usage);
+                break;
+            }
+            case Capture::Op::BufferSubData: {
+                auto c = read<Capture::BufferSubData>();
+                std::uint64_t size;
+                const void * bytes = data(size);
+                glBufferSubData(c.target, c.offset, size, bytes);
+                break;
+            }
+            case Capture::Op::BindVertexArray: {
+                auto c = read<Capture::BindVertexArray>();
+                glBindVertexArray(name(Capture::VertexArrayObject, c.array));
+                break;
+            }
+            case Capture::Op::VertexAttrib: {
+                auto c = read<Capture::VertexAttrib>();
+                glVertexAttribPointer(c.index, c.size, c.type, GLboolean(c.normalized), c.stride,
+                                      reinterpret_cast<const void *>(std::uintptr_t(c.offset)));
+                glVertexAttribDivisor(c.index, c.divisor);
+                glEnableVertexAttribArray(c.index);
+                break;
+            }
+            case Capture::Op::DisableVertexAttrib:
+                glDisableVertexAttribArray(read<Capture::DisableVertexAttrib>().index);
+                break;
+            case Capture::Op::DrawArrays: {
+                auto c = read<Capture::DrawArrays>();
+                if (c.instances)
+                    glDrawArraysInstanced(c.mode, c.first, c.count, c.instances);
+                else
+                    glDrawArrays(c.mode, c.first, c.count);
+                break;
+            }
+            case Capture::Op::DrawElements: {
+                auto c = read<Capture::DrawElements>();
+                auto indices = reinterpret_cast<const void *>(std::uintptr_t(c.offset));
+                if (c.instances)
+                    glDrawElementsInstanced(c.mode, c.count, c.type, indices, c.instances);
+                else
+                    glDrawElements(c.mode, c.count, c.type, indices);
+                break;
+            }
+            case Capture::Op::DrawElementsIndirect: {
+                auto c = read<Capture::DrawElementsIndirect>();
+                glDrawElementsIndirect(c.mode, c.type,
+                                       reinterpret_cast<const void *>(std::uintptr_t(c.offset)));
+                break;
+            }
+            case Capture::Op::BindTexture: {
+                auto c = read<Capture::BindTexture>();
+                GLuint texture = name(Capture::TextureObject, c.texture);
+                if (c.unit < 0) {
+                    glBindTexture(c.target, texture);
+                }
+                else {
+                    glActiveTexture(GL_TEXTURE0 + c.unit);
+                    glBindTexture(c.target, texture);
+                    glActiveTexture(GL_TEXTURE0);
+                }
+                break;
+            }
+            case Capture::Op::BindImage: {
+                auto c = read<Capture::BindImage>();
+                glBindImageTexture(c.unit, name(Capture::TextureObject, c.texture), c.level,
+                                   GL_FALSE, 0, c.access, c.format);
+                break;
+            }
+            case Capture::Op::TexImage: {
+                auto c = read<Capture::TexImage>();
+                std::uint64_t size;
+                const void * pixels = data(size);
+                if (c.alignment != 1 && c.alignment != 2 && c.alignment != 4 && c.alignment != 8)
+                    throw ReplayException("TexImage alignment " + std::to_string(c.alignment)
+                                          + " is invalid");
+                if (c.width < 0 || c.height < 0
+                    || (size
+                        && size != Capture::imageSize(c.width, c.height, c.format, c.type,
+                                                      c.alignment)))
+                    throw ReplayException("TexImage data does not match its size and format");
+                glPixelStorei(GL_UNPACK_ALIGNMENT, c.alignment);
+                glTexImage2D(c.target, 0, c.internal, c.width, c.height, 0, c.format, c.type,
+                             pixels);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                break;
+            }
+            case Capture::Op::TexImageMultisample: {
+                auto c = read<Capture::TexImageMultisample>();
+                glTexImage2DMultisample(c.target, c.samples, c.internal, c.width, c.height,
+                                        GL_TRUE);
+                break;
+            }
+            case Capture::Op::TexParameter: {
+                auto c = read<Capture::TexParameter>();
+                glTexParameteri(c.target, c.name, c.value);
+                break;
+            }
+            case Capture::Op::GenerateMipmap:
+                glGenerateMipmap(read<Capture::GenerateMipmap>().target);
+                break;
+            case Capture::Op::CreateProgram:
+                createProgram(read<Capture::CreateProgram>());
+                break;
+            case Capture::Op::UseProgram: {
+                program = read<Capture::UseProgram>().program;
+                glUseProgram(name(Capture::ProgramObject, program));
+                break;
+            }
+            case Capture::Op::UniformLocation: {
+                auto c = read<Capture::UniformLocation>();
+                std::uint64_t size;
+                const char * text = static_cast<const char *>(data(size));
+                if (c.location < 0)
+                    break;
+                checkName(c.program);
+                checkName(c.location);
+                if (c.program >= locations.size())
+                    locations.resize(c.program + 1);
+                auto & list = locations[c.program];
+                if (std::size_t(c.location) >= list.size())
+                    list.resize(c.location + 1, -1);
+                list[c.location] = glGetUniformLocation(name(Capture::ProgramObject, c.program),
+                                                        std::string(text, size).c_str());
+                break;
+            }
+            case Capture::Op::Uniform:
+                uniform(read<Capture::Uniform>());
+                break;
+            case Capture::Op::Dispatch: {
+                auto c = read<Capture::Dispatch>();
+                glDispatchCompute(c.x, c.y, c.z);
+                break;
+            }
+            case Capture::Op::BindFramebuffer: {
+                auto c = read<Capture::BindFramebuffer>();
+                glBindFramebuffer(c.target, name(Capture::FramebufferObject, c.framebuffer));
+                break;
+            }
+            case Capture::Op::FramebufferTexture: {
+                auto c = read<Capture::FramebufferTexture>();
+                glFramebufferTexture2D(GL_FRAMEBUFFER, c.attachment, c.target,
+                                       name(Capture::TextureObject, c.texture), 0);
+                break;
+            }
+            case Capture::Op::FramebufferRenderbuffer: {
+                auto c = read<Capture::FramebufferRenderbuffer>();
+                glFramebufferRenderbuffer(GL_FRAMEBUFFER, c.attachment, GL_RENDERBUFFER,
+                                          name(Capture::RenderbufferObject, c.renderbuffer));
+                break;
+            }
+            case Capture::Op::BlitFramebuffer: {
+                auto c = read<Capture::BlitFramebuffer>();
+                glBlitFramebuffer(0, 0, c.sourceWidth, c.sourceHeight, 0, 0, c.width, c.height,
+                                  c.mask, c.filter);
+                break;
+            }
+            case Capture::Op::BindRenderbuffer: {
+                auto c = read<Capture::BindRenderbuffer>();
+                glBindRenderbuffer(GL_RENDERBUFFER,
+                                   name(Capture::RenderbufferObject, c.renderbuffer));
+                break;
+            }
+            case Capture::Op::RenderbufferStorage: {
+                auto c = read<Capture::RenderbufferStorage>();
+                glRenderbufferStorage(GL_RENDERBUFFER, c.internal, c.width, c.height);
+                break;
+            }
+            case Capture::Op::State:
+                apply(read<Capture::State>());
+                break;
+            case Capture::Op::MultiDrawElements:
+                multiDraw(read<Capture::MultiDrawElements>());
+                break;
+            case Capture::Op::MemoryBarrier:
+                glMemoryBarrier(read<Capture::MemoryBarrier>().barriers);
+                break;
+            case Capture::Op::Count:
+                break;
+        }
+    }
+
+    void multiDraw(const Capture::MultiDrawElements & c) {
+        std::uint64_t size;
+        const char * bytes = static_cast<const char *>(data(size));
+        if (c.drawCount < 0
+            || size != std::uint64_t(c.drawCount) * (sizeof(std::int32_t) + sizeof(std::uint64_t)))
+            throw ReplayException("MultiDrawElements data does not match its draw count");
+        std::vector<GLsizei> counts(c.drawCount);
+        std::vector<const void *> offsets(c.drawCount);
+        for (std::int32_t i = 0; i < c.drawCount; i++) {
+            std::int32_t count;
+            std::uint64_t offset;
+            std::memcpy(&count, bytes + i * sizeof(count), sizeof(count));
+            std::memcpy(&offset,
+                        bytes + c.drawCount * sizeof(count) + i * sizeof(offset),
+                        sizeof(offset));
+            counts[i] = count;
+            offsets[i] = reinterpret_cast<const void *>(std::uintptr_t(offset));
+        }
+        glMultiDrawElements(c.mode, counts.data(), c.type, offsets.data(), c.drawCount);
+    }
+
+    static void enable(GLenum capability, bool enabled) {
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    void apply(const Capture::State & s) {
+        glViewport(s.viewport[0], s.viewport[1], s.viewport[2], s.viewport[3]);
+        glScissor(s.scissor[0], s.scissor[1], s.scissor[2], s.scissor[3]);
+        glClearColor(s.clearColor[0], s.clearColor[1], s.clearColor[2], s.clearColor[3]);
+        glClearDepth(s.clearDepth);
+        enable(GL_DEPTH_TEST, s.enabled & Capture::State::DepthTest);
+        enable(GL_BLEND, s.enabled & Capture::State::Blend);
+        enable(GL_CULL_FACE, s.enabled & Capture::State::CullFace);
+        enable(GL_SCISSOR_TEST, s.enabled & Capture::State::ScissorTest);
+        glDepthFunc(s.depthFunc);
+        glDepthMask(GLboolean(s.depthMask));
+        glBlendFuncSeparate(s.blendFunc[0], s.blendFunc[1], s.blendFunc[2], s.blendFunc[3]);
+        glCullFace(s.cullFace);
+    }
+
+    /**
+     * Clear all of the default frame buffer, like the glClear a frame
+     * usually starts with.
+     */
+    void clearFrame() {
+        clearPending = false;
+        GLint bound = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+        GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+        GLboolean depthMask = GL_TRUE;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, name(Capture::FramebufferObject, 0));
+        glDisable(GL_SCISSOR_TEST);
+        glDepthMask(GL_TRUE);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        enable(GL_SCISSOR_TEST, scissor);
+        glDepthMask(depthMask);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, bound);
+    }
+
+    void create(const Capture::Create & c) {
+        GLuint & id = slot(c.object, c.id);
+        switch (c.object) {
+            case Capture::BufferObject:
+                glGenBuffers(1, &id);
+                break;
+            case Capture::VertexArrayObject:
+                glGenVertexArrays(1, &id);
+                break;
+            case Capture::TextureObject:
+                glGenTextures(1, &id);
+                break;
+            case Capture::FramebufferObject:
+                glGenFramebuffers(1, &id);
+                break;
+            case Capture::RenderbufferObject:
+                glGenRenderbuffers(1, &id);
+                break;
+            default:
+                throw ReplayException("Programs are created with CreateProgram");
+        }
+    }
+
+    void destroy(const Capture::Delete & c) {
+        GLuint & id = slot(c.object, c.id);
+        switch (c.object) {
+            case Capture::BufferObject:
+                glDeleteBuffers(1, &id);
+                break;
+            case Capture::VertexArrayObject:
+                glDeleteVertexArrays(1, &id);
+                break;
+            case Capture::TextureObject:
+                glDeleteTextures(1, &id);
+                break;
+            case Capture::ProgramObject:
+                glDeleteProgram(id);
+                if (c.id < locations.size())
+                    locations[c.id].clear();
+                break;
+            case Capture::FramebufferObject:
+                glDeleteFramebuffers(1, &id);
+                break;
+            case Capture::RenderbufferObject:
+                glDeleteRenderbuffers(1, &id);
+                break;
+        }
+        id = 0;
+    }
+
+    void createProgram(const Capture::CreateProgram & c) {
+        std::uint64_t size;
+        const char * text = static_cast<const char *>(data(size));
+        std::vector<std::string> sources;
+        for (std::uint64_t begin = 0, i = 0; i < size; i++) {
+            if (text[i] == '\0') {
+                sources.emplace_back(text + begin, i - begin);
+                begin = i + 1;
+            }
+        }
+        if (sources.size() != c.stages)
+            throw ReplayException("Program " + std::to_string(c.program) + " has "
+                                  + std::to_string(sources.size()) + " sources, expected "
+                                  + std::to_string(c.stages));
+
+        static const GLenum graphics[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+        GLuint id = glCreateProgram();
+        std::vector<GLuint> shaders;
+        for (std::size_t i = 0; i < sources.size(); i++) {
+            GLenum type = c.stages == 1 ? GL_COMPUTE_SHADER : graphics[i];
+            GLuint shader = glCreateShader(type);
+            const char * source = sources[i].c_str();
+            glShaderSource(shader, 1, &source, nullptr);
+            glCompileShader(shader);
+            glAttachShader(id, shader);
+            shaders.push_back(shader);
+        }
+        glLinkProgram(id);
+        for (GLuint shader : shaders) {
+            glDetachShader(id, shader);
+            glDeleteShader(shader);
+        }
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(id, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            GLint logSize = 0;
+            glGetProgramiv(id, GL_INFO_LOG_LENGTH, &logSize);
+            std::string log(std::max(logSize, 1), '\0');
+            glGetProgramInfoLog(id, logSize, nullptr, &log[0]);
+            glDeleteProgram(id);
+            throw ReplayException("Program " + std::to_string(c.program)
+                                  + " failed to link: " + log);
+        }
+        slot(Capture::ProgramObject, c.program) = id;
+    }
+
+    /**
+     * The bytes of a uniform of type, 0 if it is unknown.
+     */
+    static std::uint64_t uniformSize(GLenum type) {
+        switch (type) {
+            case GL_INT:
+            case GL_UNSIGNED_INT:
+            case GL_FLOAT:
+                return 4;
+            case GL_DOUBLE:
+            case GL_FLOAT_VEC2:
+                return 8;
+            case GL_FLOAT_VEC3:
+                return 12;
+            case GL_FLOAT_VEC4:
+            case GL_FLOAT_MAT2:
+                return 16;
+            case GL_FLOAT_MAT3:
+                return 36;
+            case GL_FLOAT_MAT4:
+                return 64;
+            default:
+                return 0;
+        }
+    }
+
+    void uniform(const Capture::Uniform & c) {
+        std::uint64_t size;
+        const void * values = data(size);
+        std::uint64_t element = uniformSize(c.type);
+        if (!element)
+            throw ReplayException("Unknown uniform type " + std::to_string(c.type));
+        if (c.count < 0 || size != element * std::uint64_t(c.count))
+            throw ReplayException("Uniform data does not match its type and count");
+        GLint at = location(c.location);
+        auto f = static_cast<const GLfloat *>(values);
+        switch (c.type) {
+            case GL_INT:
+                glUniform1iv(at, c.count, static_cast<const GLint *>(values));
+                break;
+            case GL_UNSIGNED_INT:
+                glUniform1uiv(at, c.count, static_cast<const GLuint *>(values));
+                break;
+            case GL_FLOAT:
+                glUniform1fv(at, c.count, f);
+                break;
+            case GL_DOUBLE:
+                glUniform1dv(at, c.count, static_cast<const GLdouble *>(values));
+                break;
+            case GL_FLOAT_VEC2:
+                glUniform2fv(at, c.count, f);
+                break;
+            case GL_FLOAT_VEC3:
+                glUniform3fv(at, c.count, f);
+                break;
+            case GL_FLOAT_VEC4:
+                glUniform4fv(at, c.count, f);
+                break;
+            case GL_FLOAT_MAT2:
+                glUniformMatrix2fv(at, c.count, GL_FALSE, f);
+                break;
+            case GL_FLOAT_MAT3:
+                glUniformMatrix3fv(at, c.count, GL_FALSE, f);
+                break;
+            case GL_FLOAT_MAT4:
+                glUniformMatrix4fv(at, c.count, GL_FALSE, f);
+                break;
+            default:
+                throw ReplayException("Unknown uniform type " + std::to_string(c.type));
+        }
+    }
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "Transform.hpp"
+
+/**
+ * A transform hierarchy stored in contiguous arrays in depth first order.
+ *
+ * Every parent is stored before its children and every subtree occupies a
+ * contiguous range, so the world matrices are updated in one linear pass
+ * where a node's parent has always been visited already. Nodes are referred
+ * to by stable handles, their index in the arrays changes when nodes are
+ * inserted, removed or reparented.
+ *
+ * Changing a local transform marks the node dirty and flags its ancestors
+ * so update() can skip clean subtrees with a single jump.
+ */
+class SceneGraph {
+public:
+    using Node = std::uint32_t;
+
+    static constexpr Node None = ~Node(0);
+
+    class SceneException : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+private:
+    enum : std::uint8_t {
+        Dirty = 1, // local transform changed
+        DirtyBelow = 2, // a descendant is dirty
+    };
+
+    std::vector<std::uint32_t> parent;
+    std::vector<std::uint32_t> subtreeSize;
+    std::vector<std::uint8_t> flags;
+    std::vector<Transform> local;
+    std::vector<glm::mat4> world;
+    std::vector<Node> nodeAt;
+
+    std::vector<std::uint32_t> indexOf;
+    std::vector<Node> freeNodes;
+
+public:
+    std::size_t size() const {
+        return parent.size();
+    }
+
+    /**
+     * Create a node as the last child of parent, or as a new root.
+     *
+     * @throws SceneException if parent is not a valid node
+     */
+    Node create(Node parentNode = None, const Transform & transform = Transform()) {
+        std::uint32_t p = None;
+        std::uint32_t i = size();
+        if (parentNode != None) {
+            p = index(parentNode);
+            i = p + subtreeSize[p];
+        }
+
+        Node node;
+        if (freeNodes.empty()) {
+            node = indexOf.size();
+            indexOf.push_back(i);
+        }
+        else {
+            node = freeNodes.back();
+            freeNodes.pop_back();
+        }
+
+        parent.insert(parent.begin() + i, p);
+        subtreeSize.insert(subtreeSize.begin() + i, 1);
+        flags.insert(flags.begin() + i, 0);
+        local.insert(local.begin() + i, transform);
+        world.insert(world.begin() + i, glm::mat4(1));
+        nodeAt.insert(nodeAt.begin() + i, node);
+
+        if (i + 1 < size()) {
+            remap(i + 1, [&](std::uint32_t j) { return j >= i ? j + 1 : j; });
+        }
+        indexOf[node] = i;
+
+        for (auto a = p; a != None; a = parent[a]) {
+            subtreeSize[a]++;
+        }
+        markDirty(i);
+        return node;
+    }
+
+    /**
+     * Remove a node and all of its descendants.
+     */
+    void remove(Node node) {
+        std::uint32_t i = index(node);
+        std::uint32_t n = subtreeSize[i];
+        for (auto a = parent[i]; a != None; a = parent[a]) {
+            subtreeSize[a] -= n;
+        }
+        for (std::uint32_t j = i; j < i + n; j++) {
+            indexOf[nodeAt[j]] = None;
+            freeNodes.push_back(nodeAt[j]);
+        }
+
+        parent.erase(parent.begin() + i, parent.begin() + i + n);
+        subtreeSize.erase(subtreeSize.begin() + i, subtreeSize.begin() + i + n);
+        flags.erase(flags.begin() + i, flags.begin() + i + n);
+        local.erase(local.begin() + i, local.begin() + i + n);
+        world.erase(world.begin() + i, world.begin() + i + n);
+        nodeAt.erase(nodeAt.begin() + i, nodeAt.begin() + i + n);
+
+        remap(i, [&](std::uint32_t j) { return j >= i + n ? j - n : j; });
+    }
+
+    /**
+     * Move a node and its subtree to the end of newParent's children, or
+     * make it a root. Only the range of the arrays between the old and new
+     * position is rotated. The local transform is kept, so the world
+     * transform changes with the new parent.
+     *
+     * @throws SceneException if newParent is inside the subtree of node
+     */
+    void setParent(Node node, Node newParent) {
+        std::uint32_t i = index(node);
+        std::uint32_t n = subtreeSize[i];
+        std::uint32_t p = newParent == None ? None : index(newParent);
+        if (p != None && p >= i && p < i + n)
+            throw SceneException("Node can not be parented to its own subtree");
+        if (p == parent[i])
+            return;
+
+        // the end of the new parent's subtree, in the current order
+        std::uint32_t dest = p == None ? size() : p + subtreeSize[p];
+
+        for (auto a = parent[i]; a != None; a = parent[a]) {
+            subtreeSize[a] -= n;
+        }
+        for (auto a = p; a != None; a = parent[a]) {
+            subtreeSize[a] += n;
+        }
+        parent[i] = p;
+
+        // the subtree [i, i + n) swaps places with [i + n, dest) or [dest, i)
+        std::uint32_t first = std::min(i, dest);
+        std::uint32_t middle = dest > i ? i + n : i;
+        std::uint32_t last = std::max(i + n, dest);
+        rotate(first, middle, last);
+        remap(first, [&](std::uint32_t j) {
+            if (j < first || j >= last)
+                return j;
+            return j < middle ? j + (last - middle) : j - (middle - first);
+        });
+        markDirty(indexOf[node]);
+    }
+
+    Node getParent(Node node) const {
+        auto p = parent[index(node)];
+        return p == None ? None : nodeAt[p];
+    }
+
+    /**
+     * The number of nodes in the subtree of node, including itself.
+     */
+    std::size_t getSubtreeSize(Node node) const {
+        return subtreeSize[index(node)];
+    }
+
+    const Transform & getLocal(Node node) const {
+        return local[index(node)];
+    }
+
+    void setLocal(Node node, const Transform & transform) {
+        auto i = index(node);
+        local[i] = transform;
+        markDirty(i);
+    }
+
+    /**
+     * Get the local transform for modification, the node is marked dirty.
+     * The reference is invalidated when nodes are added, removed or moved.
+     */
+    Transform & editLocal(Node node) {
+        auto i = index(node);
+        markDirty(i);
+        return local[i];
+    }
+
+    /**
+     * The local to world matrix as of the last update().
+     */
+    const glm::mat4 & getWorld(Node node) const {
+        return world[index(node)];
+    }
+
+    /**
+     * World matrices of all nodes in storage order, see getIndex().
+     */
+    const std::vector<glm::mat4> & getWorldMatrices() const {
+        return world;
+    }
+
+    /**
+     * The position of node in getWorldMatrices().
+     */
+    std::size_t getIndex(Node node) const {
+        return index(node);
+    }
+
+    /**
+     * Recompute the world matrices of all dirty nodes and their
+     * descendants in one pass over the arrays.
+     *
+     * @return the number of world matrices that were recomputed
+     */
+    std::size_t update() {
+        std::size_t updated = 0;
+        std::uint32_t i = 0;
+        while (i < size()) {
+            if (flags[i] & Dirty) {
+                std::uint32_t end = i + subtreeSize[i];
+                for (std::uint32_t j = i; j < end; j++) {
+                    auto p = parent[j];
+                    world[j] = p == None ? local[j].toMatrix()
+                                         : world[p] * local[j].toMatrix();
+                    flags[j] = 0;
+                }
+                updated += end - i;
+                i = end;
+            }
+            else if (flags[i] & DirtyBelow) {
+                flags[i] = 0;
+                i++;
+            }
+            else {
+                i += subtreeSize[i];
+            }
+        }
+        return updated;
+    }
+
+private:
+    std::uint32_t index(Node node) const {
+        if (node >= indexOf.size() || indexOf[node] == None)
+            throw SceneException("Invalid scene node");
+        return indexOf[node];
+    }
+
+    void markDirty(std::uint32_t i) {
+        flags[i] |= Dirty;
+        for (auto a = parent[i]; a != None && !(flags[a] & DirtyBelow);
+             a = parent[a]) {
+            flags[a] |= DirtyBelow;
+        }
+    }
+
+    /**
+     * Apply an index mapping to the parent links from first on and refresh
+     * the handle table for nodes that moved.
+     */
+    template<typename F>
+    void remap(std::uint32_t first, F && f) {
+        for (std::uint32_t j = first; j < size(); j++) {
+            if (parent[j] != None)
+                parent[j] = f(parent[j]);
+            indexOf[nodeAt[j]] = j;
+        }
+    }
+
+    void rotate(std::uint32_t first, std::uint32_t middle, std::uint32_t last) {
+        auto r = [&](auto & v) {
+            std::rotate(v.begin() + first, v.begin() + middle, v.begin() + last);
+        };
+        r(parent);
+        r(subtreeSize);
+        r(flags);
+        r(local);
+        r(world);
+        r(nodeAt);
+    }
+};
@@ -8,6 +8,10 @@
 #include <stdexcept>
 #include <string>
 
+#include "Capture.hpp"
+#include "Profiler.hpp"
+#include "RenderStats.hpp"
+
 class Shader {
 public:
     class Uniform {
@@ -21,48 +25,72 @@ public:
         }
 
         void setValue(bool value) const {
-            glUniform1i(location, static_cast<int>(value));
+            int v = value;
+            CAPTURE(Capture::Uniform {GLint(location), GL_INT, 1}, &v, sizeof(v));
+            glUniform1i(location, v);
         }
 
         void setValue(int value) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_INT, 1}, &value, sizeof(value));
             glUniform1i(location, value);
         }
 
         void setValue(unsigned int value) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_UNSIGNED_INT, 1}, &value, sizeof(value));
             glUniform1ui(location, value);
         }
 
         void setValue(float value) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_FLOAT, 1}, &value, sizeof(value));
             glUniform1f(location, value);
         }
 
         void setValue(double value) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_DOUBLE, 1}, &value, sizeof(value));
             glUniform1d(location, value);
         }
 
         void setVec2(const glm::vec2 & value) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_FLOAT_VEC2, 1}, &value, sizeof(value));
             glUniform2fv(location, 1, &value.x);
         }
 
         void setVec3(const glm::vec3 & value) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_FLOAT_VEC3, 1}, &value, sizeof(value));
             glUniform3fv(location, 1, &value.x);
         }
 
         void setVec4(const glm::vec4 & value) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_FLOAT_VEC4, 1}, &value, sizeof(value));
             glUniform4fv(location, 1, &value.x);
         }
 
         void setMat2(const glm::mat2 & value) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_FLOAT_MAT2, 1}, &value, sizeof(value));
             glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]);
         }
 
         void setMat3(const glm::mat3 & value) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_FLOAT_MAT3, 1}, &value, sizeof(value));
             glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]);
         }
 
         void setMat4(const glm::mat4 & value) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_FLOAT_MAT4, 1}, &value, sizeof(value));
             glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
         }
+
+        void setArray(const float * values, GLsizei count) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_FLOAT, count}, values,
+                    count * sizeof(float));
+            glUniform1fv(location, count, values);
+        }
+
+        void setArray(const glm::vec4 * values, GLsizei count) const {
+            CAPTURE(Capture::Uniform {GLint(location), GL_FLOAT_VEC4, count}, values,
+                    count * sizeof(glm::vec4));
+            glUniform4fv(location, count, &values[0].x);
+        }
     };
 
 private:
@@ -70,6 +98,7 @@ private:
 
 public:
     Shader(const char * vertexSource, const char * fragmentSource) {
+        PROFILE_SCOPE("Shader::Shader");
         GLuint vShader = compileShader(GL_VERTEX_SHADER, vertexSource);
         GLuint fShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
 
@@ -88,6 +117,32 @@ public:
         if (!linkSuccess(program)) {
             throw LinkException(program);
         }
+        CAPTURE(Capture::CreateProgram {program, 2},
+                std::string(vertexSource) + '\0' + fragmentSource + '\0');
+    }
+
+    /**
+     * Create a compute shader program, requires OpenGL 4.3.
+     *
+     * @param computeSource the compute shader source
+     */
+    explicit Shader(const char * computeSource) {
+        PROFILE_SCOPE("Shader::Shader");
+        GLuint cShader = compileShader(GL_COMPUTE_SHADER, computeSource);
+
+        program = glCreateProgram();
+
+        glAttachShader(program, cShader);
+
+        glLinkProgram(program);
+
+        glDetachShader(program, cShader);
+        glDeleteShader(cShader);
+
+        if (!linkSuccess(program)) {
+            throw LinkException(program);
+        }
+        CAPTURE(Capture::CreateProgram {program, 1}, std::string(computeSource) + '\0');
     }
 
     Shader(Shader && other) : program(other.program) {
@@ -104,8 +159,10 @@ public:
     Shader & operator=(const Shader &) = delete;
 
     ~Shader() {
-        if (program)
+        if (program) {
+            CAPTURE(Capture::Delete {Capture::ProgramObject, program});
             glDeleteProgram(program);
+        }
     }
 
     GLuint getProgram() const {
@@ -113,15 +170,43 @@ public:
     }
 
     void bind() const {
+        RenderStats::current().programBinds++;
+        CAPTURE(Capture::UseProgram {program});
         glUseProgram(program);
     }
 
     void unbind() const {
+        CAPTURE(Capture::UseProgram {0});
         glUseProgram(0);
     }
 
+    /**
+     * Bind the program and run a compute shader.
+     *
+     * @param x the number of work groups in x
+     * @param y the number of work groups in y
+     * @param z the number of work groups in z
+     */
+    void dispatch(GLuint x, GLuint y = 1, GLuint z = 1) const {
+        bind();
+        RenderStats::current().dispatches++;
+        CAPTURE(Capture::Dispatch {x, y, z});
+        glDispatchCompute(x, y, z);
+    }
+
+    /**
+     * Make the writes of earlier dispatches visible, see glMemoryBarrier.
+     *
+     * @param barriers the GL_*_BARRIER_BIT flags of the later reads
+     */
+    static void memoryBarrier(GLbitfield barriers) {
+        CAPTURE(Capture::MemoryBarrier {barriers});
+        glMemoryBarrier(barriers);
+    }
+
     Uniform uniform(const char * name) const {
         GLuint location = glGetUniformLocation(program, name);
+        CAPTURE(Capture::UniformLocation {program, GLint(location)}, std::string(name));
         return Uniform(location);
     }
 
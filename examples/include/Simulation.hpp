@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <thread>
+#include <vector>
+
+#include "Transform.hpp"
+#include "TripleBuffer.hpp"
+
+/**
+ * Steps a set of transforms at a fixed rate on its own thread and lets the
+ * render thread sample them at any time.
+ *
+ * Every tick publishes the previous and the new state through a
+ * TripleBuffer together with the time the new state belongs to. The next
+ * state is computed while the current pair is on screen and published when
+ * the pair runs out, so interpolate() always finds a pair that spans the
+ * current time and never waits for the simulation. When a step takes
+ * longer than a tick, the renderer holds the last state until the
+ * simulation catches up. When it falls more than MaxCatchUp ticks behind,
+ * the lost time is dropped instead of being stepped through.
+ */
+class Simulation {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Advance transforms by dt seconds. Runs on the simulation thread.
+     */
+    using Step = std::function<void(std::vector<Transform> & transforms, float dt)>;
+
+    static constexpr unsigned MaxCatchUp = 5;
+
+private:
+    struct Snapshot {
+        std::vector<Transform> previous;
+        std::vector<Transform> current;
+        Clock::time_point time;
+        std::uint64_t tick = 0;
+    };
+
+    Step step;
+    Clock::duration interval;
+    std::vector<Transform> state;
+
+    TripleBuffer<Snapshot> snapshots;
+    std::atomic<bool> running;
+    std::thread thread;
+
+public:
+    /**
+     * @param initial the transforms at tick 0
+     * @param rate the number of steps per second
+     * @param step advances the transforms by one tick
+     */
+    Simulation(std::vector<Transform> initial, double rate, Step step)
+        : step(std::move(step)),
+          interval(std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<double>(1.0 / rate))),
+          state(std::move(initial)),
+          snapshots(Snapshot {state, state, Clock::now(), 0}),
+          running(false) {}
+
+    Simulation(const Simulation &) = delete;
+    Simulation & operator=(const Simulation &) = delete;
+
+    ~Simulation() {
+        stop();
+    }
+
+    void start() {
+        if (running)
+            return;
+        running = true;
+        thread = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    /**
+     * The seconds simulated per step.
+     */
+    float getTimeStep() const {
+        return std::chrono::duration<float>(interval).count();
+    }
+
+    /**
+     * The tick of the newest snapshot seen by interpolate().
+     */
+    std::uint64_t getTick() const {
+        return snapshots.read().tick;
+    }
+
+    /**
+     * Write the transforms as of now, blended between the last two
+     * simulated states. Only call from one thread.
+     *
+     * @param out resized to the number of transforms
+     *
+     * @return the blend factor, 1 when the simulation is behind
+     */
+    float interpolate(std::vector<Transform> & out, Clock::time_point now = Clock::now()) {
+        snapshots.update();
+        const Snapshot & s = snapshots.read();
+        out.resize(s.current.size());
+        if (s.previous.size() != s.current.size()) {
+            std::copy(s.current.begin(), s.current.end(), out.begin());
+            return 1.0f;
+        }
+
+        float t = std::chrono::duration<float>(now - (s.time - interval)).count()
+                  / getTimeStep();
+        t = std::min(std::max(t, 0.0f), 1.0f);
+        for (std::size_t i = 0; i < out.size(); i++) {
+            out[i] = blend(s.previous[i], s.current[i], t);
+        }
+        return t;
+    }
+
+    static Transform blend(const Transform & a, const Transform & b, float t) {
+        return Transform(glm::mix(a.getPosition(), b.getPosition(), t),
+                         glm::slerp(a.getRotation(), b.getRotation(), t),
+                         glm::mix(a.getScale(), b.getScale(), t));
+    }
+
+private:
+    void run() {
+        const float dt = getTimeStep();
+        std::uint64_t tick = 0;
+        Clock::time_point due = Clock::now();
+
+        while (running) {
+            // compute the next tick while the current pair is on screen and
+            // publish it when the current pair runs out
+            Snapshot & s = snapshots.write();
+            s.previous.assign(state.begin(), state.end());
+            step(state, dt);
+            s.current.assign(state.begin(), state.end());
+            tick++;
+            due += interval;
+
+            auto now = Clock::now();
+            if (now - due > interval * MaxCatchUp)
+                due = now + interval;
+            std::this_thread::sleep_until(due - interval);
+
+            s.time = due;
+            s.tick = tick;
+            snapshots.publish();
+        }
+    }
+};
@@ -7,7 +7,13 @@
 #include <stb_image.h>
 
 #include <glm/glm.hpp>
+#include <memory>
 #include <stdexcept>
+#include <string>
+
+#include "Capture.hpp"
+#include "Profiler.hpp"
+#include "RenderStats.hpp"
 
 class Texture {
 public:
@@ -15,6 +21,18 @@ public:
         Gray = GL_RED,
         RGB = GL_RGB,
         RGBA = GL_RGBA,
+
+        // Sized internal formats, required for image load / store
+        RGBA8 = GL_RGBA8,
+        R16F = GL_R16F,
+        RGB16F = GL_RGB16F,
+        RGBA16F = GL_RGBA16F,
+        R11G11B10F = GL_R11F_G11F_B10F,
+        R32F = GL_R32F,
+
+        // Depth formats, use Depth as the format of pixel data
+        Depth = GL_DEPTH_COMPONENT,
+        Depth32F = GL_DEPTH_COMPONENT32F,
     };
 
     /// Mag filter only accepts Nearest or Linear.
@@ -88,6 +106,7 @@ public:
           mipmaps(mipmaps) {
 
         glGenTextures(1, &textureId);
+        CAPTURE(Capture::Create {Capture::TextureObject, textureId});
         loadFrom(data, size, nrComponents);
     }
 
@@ -131,6 +150,7 @@ public:
           mipmaps(mipmaps) {
 
         glGenTextures(1, &textureId);
+        CAPTURE(Capture::Create {Capture::TextureObject, textureId});
         resize(size);
     }
 
@@ -169,8 +189,10 @@ public:
     Texture & operator=(const Texture &) = delete;
 
     ~Texture() {
-        if (textureId)
+        if (textureId) {
+            CAPTURE(Capture::Delete {Capture::TextureObject, textureId});
             glDeleteTextures(1, &textureId);
+        }
     }
 
     GLuint getTextureId() const {
@@ -190,13 +212,55 @@ public:
     }
 
     void bind() const {
+        RenderStats::current().textureBinds++;
+        CAPTURE(Capture::BindTexture {target, textureId, -1});
         glBindTexture(target, textureId);
     }
 
     void unbind() const {
+        CAPTURE(Capture::BindTexture {target, 0, -1});
         glBindTexture(target, 0);
     }
 
+    /**
+     * Bind the texture to a texture unit other than 0. The active texture
+     * unit is reset to 0 afterwards so bind() keeps working as expected.
+     *
+     * @param unit the texture unit index
+     */
+    void bind(GLuint unit) const {
+        RenderStats::current().textureBinds++;
+        CAPTURE(Capture::BindTexture {target, textureId, GLint(unit)});
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, textureId);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    /**
+     * Bind a level of the texture to an image unit for use in a compute
+     * shader. The internal format must be one of the sized formats.
+     *
+     * @param unit the image unit index
+     * @param access GL_READ_ONLY, GL_WRITE_ONLY or GL_READ_WRITE
+     * @param level the mipmap level
+     */
+    void bindImage(GLuint unit,
+                   GLenum access = GL_WRITE_ONLY,
+                   GLint level = 0) const {
+        CAPTURE(Capture::BindImage {unit, textureId, level, access, GLenum(internal)});
+        glBindImageTexture(unit, textureId, level, GL_FALSE, 0, access, internal);
+    }
+
+    /**
+     * Build the mipmap levels from level 0, which also allocates them.
+     */
+    void generateMipmap() const {
+        bind();
+        CAPTURE(Capture::GenerateMipmap {target});
+        glGenerateMipmap(target);
+        unbind();
+    }
+
     /**
      * Load the texture from an image, setting the size to match
      * image.getSize().
@@ -213,6 +277,7 @@ public:
     void loadFrom(const unsigned char * data,
                   const glm::uvec2 & size,
                   size_t nrComponents) {
+        PROFILE_SCOPE("Texture::loadFrom");
         bind();
 
         this->size = size;
@@ -229,16 +294,23 @@ public:
         samples = 0;
         target = GL_TEXTURE_2D;
 
+        CAPTURE(Capture::TexImage {target, internal, GLsizei(size.x), GLsizei(size.y), GLenum(format),
+                                   type, unpackAlignment()},
+                data, Capture::imageSize(size.x, size.y, format, type));
         glTexImage2D(target, 0, internal, size.x, size.y, 0, format, type, data);
+        RenderStats::current().textureUploads++;
+        RenderStats::current().textureBytes += std::uint64_t(size.x) * size.y * nrComponents;
 
-        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, magFilter);
-        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, minFilter);
+        texParameter(GL_TEXTURE_MAG_FILTER, magFilter);
+        texParameter(GL_TEXTURE_MIN_FILTER, minFilter);
 
-        glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
-        glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+        texParameter(GL_TEXTURE_WRAP_S, wrap);
+        texParameter(GL_TEXTURE_WRAP_T, wrap);
 
-        if (mipmaps)
+        if (mipmaps) {
+            CAPTURE(Capture::GenerateMipmap {target});
             glGenerateMipmap(target);
+        }
         unbind();
     }
 
@@ -247,18 +319,23 @@ public:
         if (size.x > 0 && size.y > 0) {
             bind();
             if (samples > 0) {
+                CAPTURE(Capture::TexImageMultisample {target, samples, GLenum(internal),
+                                                      GLsizei(size.x), GLsizei(size.y)});
                 glTexImage2DMultisample(target, samples, internal, size.x,
                                         size.y, GL_TRUE);
             }
             else {
+                CAPTURE(Capture::TexImage {target, internal, GLsizei(size.x), GLsizei(size.y),
+                                           GLenum(format), type, unpackAlignment()},
+                        nullptr, 0);
                 glTexImage2D(target, 0, internal, size.x, size.y, 0, format,
                              type, NULL);
 
-                glTexParameteri(target, GL_TEXTURE_MAG_FILTER, magFilter);
-                glTexParameteri(target, GL_TEXTURE_MIN_FILTER, minFilter);
+                texParameter(GL_TEXTURE_MAG_FILTER, magFilter);
+                texParameter(GL_TEXTURE_MIN_FILTER, minFilter);
 
-                glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
-                glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+                texParameter(GL_TEXTURE_WRAP_S, wrap);
+                texParameter(GL_TEXTURE_WRAP_T, wrap);
             }
             unbind();
         }
@@ -276,13 +353,60 @@ public:
      * of components
      */
     static Texture fromPath(const std::string & path) {
+        return fromImage(decode(path));
+    }
+
+    /**
+     * Pixels decoded from an image file.
+     */
+    struct Image {
+        std::unique_ptr<unsigned char, void (*)(void *)> data {nullptr,
+                                                              stbi_image_free};
+        glm::uvec2 size;
+        int components = 0;
+    };
+
+    /**
+     * Decode an image file without touching GL, so it can run on a worker
+     * thread. Create the texture with fromImage() on the GL thread.
+     *
+     * @param path the path to the image file
+     *
+     * @throws TextureLoadException if the file can not be decoded
+     */
+    static Image decode(const std::string & path) {
+        PROFILE_SCOPE("Texture::decode");
+        Image image;
         int x, y, n;
-        auto * data = stbi_load(path.c_str(), &x, &y, &n, 0);
-        if (!data)
+        image.data.reset(stbi_load(path.c_str(), &x, &y, &n, 0));
+        if (!image.data)
             throw TextureLoadException("Failed to load image from file");
-        return Texture(data, glm::uvec2(x, y), n);
+        image.size = glm::uvec2(x, y);
+        image.components = n;
+        return image;
     }
 
+    /**
+     * @throws TextureLoadException if the image has an unsupported number
+     * of components
+     */
+    static Texture fromImage(const Image & image) {
+        return Texture(image.data.get(), image.size, image.components);
+    }
+
+private:
+    void texParameter(GLenum name, GLint value) const {
+        CAPTURE(Capture::TexParameter {target, name, value});
+        glTexParameteri(target, name, value);
+    }
+
+    static GLint unpackAlignment() {
+        GLint alignment = 4;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        return alignment;
+    }
+
+public:
     class TextureLoadException : public std::runtime_error {
     public:
         using std::runtime_error::runtime_error;
@@ -0,0 +1,626 @@
+#pragma once
+
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "InstancePacking.hpp"
+#include "JobSystem.hpp"
+#include "Transform.hpp"
+#include "simd.hpp"
+
+/**
+ * Many transforms stored as separate position, rotation and scale arrays.
+ *
+ * Every setter marks the transform in a dirty bitset. compose() and
+ * upload() rebuild the model matrix of each dirty block of BlockSize
+ * transforms in closed form, T * R * S written directly from the quaternion
+ * terms, with AVX2 (8 lanes) or SSE (4 lanes) when available. The arrays are
+ * padded to a multiple of BlockSize with identity transforms so the kernels
+ * never need a scalar tail.
+ *
+ * The output can be full matrices or one of the compact instance layouts,
+ * see InstanceLayout.
+ */
+class TransformStore {
+public:
+    static constexpr std::size_t BlockSize = 8;
+
+private:
+    std::vector<float> px, py, pz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> sx, sy, sz;
+    std::vector<std::uint64_t> dirty;
+    std::size_t count;
+
+public:
+    TransformStore() : count(0) {}
+
+    std::size_t size() const {
+        return count;
+    }
+
+    void reserve(std::size_t n) {
+        n = padded(n);
+        for (auto * a : {&px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz}) {
+            a->reserve(n);
+        }
+        dirty.reserve((n + 63) / 64);
+    }
+
+    void clear() {
+        count = 0;
+        resize(0);
+    }
+
+    /**
+     * Add a transform, it starts out dirty.
+     *
+     * @return the index of the new transform
+     */
+    std::size_t add(const glm::vec3 & position = glm::vec3(0),
+                    const glm::quat & rotation = glm::quat(1, 0, 0, 0),
+                    const glm::vec3 & scale = glm::vec3(1)) {
+        std::size_t i = count++;
+        if (i == px.size())
+            resize(padded(count));
+        setPosition(i, position);
+        setRotation(i, rotation);
+        setScale(i, scale);
+        return i;
+    }
+
+    std::size_t add(const Transform & transform) {
+        return add(transform.getPosition(),
+                   transform.getRotation(),
+                   transform.getScale());
+    }
+
+    Transform get(std::size_t i) const {
+        return Transform(getPosition(i), getRotation(i), getScale(i));
+    }
+
+    void set(std::size_t i, const Transform & transform) {
+        setPosition(i, transform.getPosition());
+        setRotation(i, transform.getRotation());
+        setScale(i, transform.getScale());
+    }
+
+    glm::vec3 getPosition(std::size_t i) const {
+        return {px[i], py[i], pz[i]};
+    }
+
+    void setPosition(std::size_t i, const glm::vec3 & position) {
+        px[i] = position.x;
+        py[i] = position.y;
+        pz[i] = position.z;
+        markDirty(i);
+    }
+
+    void move(std::size_t i, const glm::vec3 & delta) {
+        setPosition(i, getPosition(i) + delta);
+    }
+
+    glm::quat getRotation(std::size_t i) const {
+        return glm::quat(qw[i], qx[i], qy[i], qz[i]);
+    }
+
+    void setRotation(std::size_t i, const glm::quat & rotation) {
+        qx[i] = rotation.x;
+        qy[i] = rotation.y;
+        qz[i] = rotation.z;
+        qw[i] = rotation.w;
+        markDirty(i);
+    }
+
+    void rotate(std::size_t i, const glm::quat & delta) {
+        setRotation(i, delta * getRotation(i));
+    }
+
+    void rotateEuler(std::size_t i, const glm::vec3 & delta) {
+        rotate(i, glm::quat(delta));
+    }
+
+    glm::vec3 getScale(std::size_t i) const {
+        return {sx[i], sy[i], sz[i]};
+    }
+
+    void setScale(std::size_t i, const glm::vec3 & scale) {
+        sx[i] = scale.x;
+        sy[i] = scale.y;
+        sz[i] = scale.z;
+        markDirty(i);
+    }
+
+    void scale(std::size_t i, const glm::vec3 & scale) {
+        setScale(i, getScale(i) * scale);
+    }
+
+    bool isDirty(std::size_t i) const {
+        return (dirty[i / 64] >> (i % 64)) & 1;
+    }
+
+    void markDirty(std::size_t i) {
+        dirty[i / 64] |= std::uint64_t(1) << (i % 64);
+    }
+
+    void markAllDirty() {
+        std::fill(dirty.begin(), dirty.end(), ~std::uint64_t(0));
+    }
+
+    /**
+     * Write the instance data of every dirty block to out and clear the
+     * dirty bits. Entries of clean transforms are left untouched.
+     *
+     * @param out an array of at least size() entries
+     *
+     * @return the number of blocks that were composed
+     */
+    std::size_t compose(glm::mat4 * out) {
+        return composeDirty<InstanceLayout::Matrix>(&out[0][0][0]);
+    }
+
+    std::size_t compose(PackedAffine * out) {
+        return composeDirty<InstanceLayout::Affine>(&out[0].rows[0][0]);
+    }
+
+    /**
+     * Only the x scale is used as the uniform scale.
+     */
+    std::size_t compose(PackedRigid * out) {
+        return composeDirty<InstanceLayout::Rigid>(&out[0].rotation[0]);
+    }
+
+    /**
+     * Like compose() but the dirty blocks are spread over the threads of
+     * jobs in chunks of JobGrain blocks.
+     */
+    std::size_t compose(glm::mat4 * out, JobSystem & jobs) {
+        return composeDirty<InstanceLayout::Matrix>(&out[0][0][0], jobs);
+    }
+
+    std::size_t compose(PackedAffine * out, JobSystem & jobs) {
+        return composeDirty<InstanceLayout::Affine>(&out[0].rows[0][0], jobs);
+    }
+
+    std::size_t compose(PackedRigid * out, JobSystem & jobs) {
+        return composeDirty<InstanceLayout::Rigid>(&out[0].rotation[0], jobs);
+    }
+
+    /**
+     * Write the instance data of the span between the first and last dirty
+     * block straight into a mapped buffer and clear the dirty bits. The range
+     * is mapped with GL_MAP_INVALIDATE_RANGE_BIT so clean blocks inside the
+     * span are written too.
+     *
+     * @param buffer a buffer allocated with at least
+     *               size() * instanceStride(layout) bytes
+     * @param layout the instance format to write
+     *
+     * @return the number of blocks that were composed
+     */
+    std::size_t upload(const Buffer & buffer,
+                       InstanceLayout layout = InstanceLayout::Matrix) {
+        switch (layout) {
+            case InstanceLayout::Affine:
+                return uploadDirty<InstanceLayout::Affine>(buffer);
+            case InstanceLayout::Rigid:
+                return uploadDirty<InstanceLayout::Rigid>(buffer);
+            default:
+                return uploadDirty<InstanceLayout::Matrix>(buffer);
+        }
+    }
+
+    /**
+     * Like upload() but the blocks are composed into the mapped range on
+     * the threads of jobs.
+     */
+    std::size_t upload(const Buffer & buffer, InstanceLayout layout, JobSystem & jobs) {
+        switch (layout) {
+            case InstanceLayout::Affine:
+                return uploadDirty<InstanceLayout::Affine>(buffer, &jobs);
+            case InstanceLayout::Rigid:
+                return uploadDirty<InstanceLayout::Rigid>(buffer, &jobs);
+            default:
+                return uploadDirty<InstanceLayout::Matrix>(buffer, &jobs);
+        }
+    }
+
+private:
+    /**
+     * Blocks per job, 2048 transforms.
+     */
+    static constexpr std::size_t JobGrain = 256;
+
+    static std::size_t padded(std::size_t n) {
+        return (n + BlockSize - 1) / BlockSize * BlockSize;
+    }
+
+    /**
+     * The number of floats per instance of layout L.
+     */
+    template<InstanceLayout L>
+    static constexpr std::size_t floats() {
+        return L == InstanceLayout::Matrix ? 16
+               : L == InstanceLayout::Affine ? 12
+                                             : 8;
+    }
+
+    std::size_t blockCount() const {
+        return padded(count) / BlockSize;
+    }
+
+    bool blockDirty(std::size_t b) const {
+        return (dirty[b / 8] >> (b % 8 * 8)) & 0xFF;
+    }
+
+    void resize(std::size_t n) {
+        for (auto * a : {&px, &py, &pz, &qx, &qy, &qz}) {
+            a->resize(n, 0.0f);
+        }
+        for (auto * a : {&qw, &sx, &sy, &sz}) {
+            a->resize(n, 1.0f);
+        }
+        dirty.resize((n + 63) / 64, 0);
+    }
+
+    template<InstanceLayout L>
+    std::size_t composeDirty(float * out) {
+        std::size_t composed = 0;
+        for (std::size_t b = 0; b < blockCount(); b++) {
+            if (blockDirty(b)) {
+                composeBlock<L>(b, out + b * BlockSize * floats<L>());
+                composed++;
+            }
+        }
+        std::fill(dirty.begin(), dirty.end(), 0);
+        return composed;
+    }
+
+    template<InstanceLayout L>
+    std::size_t composeDirty(float * out, JobSystem & jobs) {
+        std::atomic<std::size_t> composed(0);
+        jobs.parallelFor(0, blockCount(), JobGrain, [&](std::size_t first, std::size_t last) {
+            std::size_t n = 0;
+            for (std::size_t b = first; b < last; b++) {
+                if (blockDirty(b)) {
+                    composeBlock<L>(b, out + b * BlockSize * floats<L>());
+                    n++;
+                }
+            }
+            composed += n;
+        });
+        std::fill(dirty.begin(), dirty.end(), 0);
+        return composed;
+    }
+
+    template<InstanceLayout L>
+    std::size_t uploadDirty(const Buffer & buffer, JobSystem * jobs = nullptr) {
+        std::size_t first = 0;
+        while (first < blockCount() && !blockDirty(first))
+            first++;
+        if (first == blockCount())
+            return 0;
+        std::size_t last = blockCount();
+        while (!blockDirty(last - 1))
+            last--;
+
+        std::size_t begin = first * BlockSize;
+        std::size_t end = std::min(last * BlockSize, count);
+        const GLsizeiptr stride = floats<L>() * sizeof(float);
+
+        buffer.bind();
+        // mapped writes can not be recorded, a capture composes on the CPU
+        // and uploads with a recorded glBufferSubData instead
+        bool recording = Capture::isRecording();
+        std::vector<float> staging;
+        float * data;
+        if (recording) {
+            staging.resize((end - begin) * floats<L>());
+            data = staging.data();
+        }
+        else {
+            data = static_cast<float *>(glMapBufferRange(
+                buffer.getTarget(),
+                begin * stride,
+                (end - begin) * stride,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+            if (!data)
+                return 0;
+        }
+
+        auto composeRange = [&](std::size_t from, std::size_t to) {
+            for (std::size_t b = from; b < to; b++) {
+                composeBlock<L>(b, data + (b - first) * BlockSize * floats<L>());
+            }
+        };
+        if (jobs)
+            jobs->parallelFor(first, last, JobGrain, composeRange);
+        else
+            composeRange(first, last);
+        if (recording) {
+            CAPTURE(Capture::BufferSubData {buffer.getTarget(), 0, std::int64_t(begin * stride)},
+                    data, (end - begin) * stride);
+            glBufferSubData(buffer.getTarget(), begin * stride, (end - begin) * stride, data);
+        }
+        else {
+            glUnmapBuffer(buffer.getTarget());
+        }
+
+        std::fill(dirty.begin(), dirty.end(), 0);
+        return last - first;
+    }
+
+    /**
+     * Compose the instances of block b into out. The last block may be
+     * partial, only the valid instances are written.
+     */
+    template<InstanceLayout L>
+    void composeBlock(std::size_t b, float * out) const {
+        std::size_t first = b * BlockSize;
+        std::size_t n = std::min(BlockSize, count - first);
+        if (n == BlockSize) {
+            composeLanes<L>(first, out);
+        }
+        else {
+            float tmp[BlockSize * 16];
+            composeLanes<L>(first, tmp);
+            std::copy(tmp, tmp + n * floats<L>(), out);
+        }
+    }
+
+#if SIMD_WIDTH == 8
+
+    template<InstanceLayout L>
+    void composeLanes(std::size_t i, float * out) const {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 zero = _mm256_setzero_ps();
+
+        if (L == InstanceLayout::Rigid) {
+            // one register per float of PackedRigid
+            __m256 r[8] = {
+                _mm256_loadu_ps(&qx[i]),
+                _mm256_loadu_ps(&qy[i]),
+                _mm256_loadu_ps(&qz[i]),
+                _mm256_loadu_ps(&qw[i]),
+                _mm256_loadu_ps(&px[i]),
+                _mm256_loadu_ps(&py[i]),
+                _mm256_loadu_ps(&pz[i]),
+                _mm256_loadu_ps(&sx[i]),
+            };
+            transpose8(r);
+            for (int k = 0; k < 8; k++) {
+                _mm256_storeu_ps(out + k * 8, r[k]);
+            }
+            return;
+        }
+
+        __m256 x = _mm256_loadu_ps(&qx[i]);
+        __m256 y = _mm256_loadu_ps(&qy[i]);
+        __m256 z = _mm256_loadu_ps(&qz[i]);
+        __m256 w = _mm256_loadu_ps(&qw[i]);
+
+        __m256 x2 = _mm256_add_ps(x, x);
+        __m256 y2 = _mm256_add_ps(y, y);
+        __m256 z2 = _mm256_add_ps(z, z);
+        __m256 xx = _mm256_mul_ps(x, x2);
+        __m256 yy = _mm256_mul_ps(y, y2);
+        __m256 zz = _mm256_mul_ps(z, z2);
+        __m256 xy = _mm256_mul_ps(x, y2);
+        __m256 xz = _mm256_mul_ps(x, z2);
+        __m256 yz = _mm256_mul_ps(y, z2);
+        __m256 wx = _mm256_mul_ps(w, x2);
+        __m256 wy = _mm256_mul_ps(w, y2);
+        __m256 wz = _mm256_mul_ps(w, z2);
+
+        __m256 s0 = _mm256_loadu_ps(&sx[i]);
+        __m256 s1 = _mm256_loadu_ps(&sy[i]);
+        __m256 s2 = _mm256_loadu_ps(&sz[i]);
+
+        // m[column][row] of the upper 3x4 part
+        __m256 m[4][3] = {
+            {
+                _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), s0),
+                _mm256_mul_ps(_mm256_add_ps(xy, wz), s0),
+                _mm256_mul_ps(_mm256_sub_ps(xz, wy), s0),
+            },
+            {
+                _mm256_mul_ps(_mm256_sub_ps(xy, wz), s1),
+                _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), s1),
+                _mm256_mul_ps(_mm256_add_ps(yz, wx), s1),
+            },
+            {
+                _mm256_mul_ps(_mm256_add_ps(xz, wy), s2),
+                _mm256_mul_ps(_mm256_sub_ps(yz, wx), s2),
+                _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), s2),
+            },
+            {
+                _mm256_loadu_ps(&px[i]),
+                _mm256_loadu_ps(&py[i]),
+                _mm256_loadu_ps(&pz[i]),
+            },
+        };
+
+        if (L == InstanceLayout::Matrix) {
+            // columns 0 and 1 in lo, columns 2 and 3 in hi
+            __m256 lo[8] = {
+                m[0][0], m[0][1], m[0][2], zero, //
+                m[1][0], m[1][1], m[1][2], zero, //
+            };
+            __m256 hi[8] = {
+                m[2][0], m[2][1], m[2][2], zero, //
+                m[3][0], m[3][1], m[3][2], one, //
+            };
+            transpose8(lo);
+            transpose8(hi);
+            for (int k = 0; k < 8; k++) {
+                _mm256_storeu_ps(out + k * 16, lo[k]);
+                _mm256_storeu_ps(out + k * 16 + 8, hi[k]);
+            }
+        }
+        else {
+            // rows 0 and 1 in lo, row 2 in the lower half of hi
+            __m256 lo[8] = {
+                m[0][0], m[1][0], m[2][0], m[3][0], //
+                m[0][1], m[1][1], m[2][1], m[3][1], //
+            };
+            __m256 hi[8] = {
+                m[0][2], m[1][2], m[2][2], m[3][2], //
+                zero,    zero,    zero,    zero, //
+            };
+            transpose8(lo);
+            transpose8(hi);
+            for (int k = 0; k < 8; k++) {
+                _mm256_storeu_ps(out + k * 12, lo[k]);
+                _mm_storeu_ps(out + k * 12 + 8, _mm256_castps256_ps128(hi[k]));
+            }
+        }
+    }
+
+#elif SIMD_WIDTH == 4
+
+    template<InstanceLayout L>
+    void composeLanes(std::size_t i, float * out) const {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 zero = _mm_setzero_ps();
+        const std::size_t stride = floats<L>();
+
+        for (std::size_t h = 0; h < BlockSize; h += 4, i += 4, out += 4 * stride) {
+            if (L == InstanceLayout::Rigid) {
+                __m128 q0 = _mm_loadu_ps(&qx[i]), q1 = _mm_loadu_ps(&qy[i]);
+                __m128 q2 = _mm_loadu_ps(&qz[i]), q3 = _mm_loadu_ps(&qw[i]);
+                __m128 t0 = _mm_loadu_ps(&px[i]), t1 = _mm_loadu_ps(&py[i]);
+                __m128 t2 = _mm_loadu_ps(&pz[i]), t3 = _mm_loadu_ps(&sx[i]);
+                _MM_TRANSPOSE4_PS(q0, q1, q2, q3);
+                _MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+                __m128 q[4] = {q0, q1, q2, q3};
+                __m128 t[4] = {t0, t1, t2, t3};
+                for (int lane = 0; lane < 4; lane++) {
+                    _mm_storeu_ps(out + lane * 8, q[lane]);
+                    _mm_storeu_ps(out + lane * 8 + 4, t[lane]);
+                }
+                continue;
+            }
+
+            __m128 x = _mm_loadu_ps(&qx[i]);
+            __m128 y = _mm_loadu_ps(&qy[i]);
+            __m128 z = _mm_loadu_ps(&qz[i]);
+            __m128 w = _mm_loadu_ps(&qw[i]);
+
+            __m128 x2 = _mm_add_ps(x, x);
+            __m128 y2 = _mm_add_ps(y, y);
+            __m128 z2 = _mm_add_ps(z, z);
+            __m128 xx = _mm_mul_ps(x, x2);
+            __m128 yy = _mm_mul_ps(y, y2);
+            __m128 zz = _mm_mul_ps(z, z2);
+            __m128 xy = _mm_mul_ps(x, y2);
+            __m128 xz = _mm_mul_ps(x, z2);
+            __m128 yz = _mm_mul_ps(y, z2);
+            __m128 wx = _mm_mul_ps(w, x2);
+            __m128 wy = _mm_mul_ps(w, y2);
+            __m128 wz = _mm_mul_ps(w, z2);
+
+            __m128 s0 = _mm_loadu_ps(&sx[i]);
+            __m128 s1 = _mm_loadu_ps(&sy[i]);
+            __m128 s2 = _mm_loadu_ps(&sz[i]);
+
+            // m[column][row]
+            __m128 m[4][4] = {
+                {
+                    _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), s0),
+                    _mm_mul_ps(_mm_add_ps(xy, wz), s0),
+                    _mm_mul_ps(_mm_sub_ps(xz, wy), s0),
+                    zero,
+                },
+                {
+                    _mm_mul_ps(_mm_sub_ps(xy, wz), s1),
+                    _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), s1),
+                    _mm_mul_ps(_mm_add_ps(yz, wx), s1),
+                    zero,
+                },
+                {
+                    _mm_mul_ps(_mm_add_ps(xz, wy), s2),
+                    _mm_mul_ps(_mm_sub_ps(yz, wx), s2),
+                    _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), s2),
+                    zero,
+                },
+                {
+                    _mm_loadu_ps(&px[i]),
+                    _mm_loadu_ps(&py[i]),
+                    _mm_loadu_ps(&pz[i]),
+                    one,
+                },
+            };
+
+            if (L == InstanceLayout::Matrix) {
+                for (int col = 0; col < 4; col++) {
+                    _MM_TRANSPOSE4_PS(m[col][0], m[col][1], m[col][2], m[col][3]);
+                    for (int lane = 0; lane < 4; lane++) {
+                        _mm_storeu_ps(out + lane * 16 + col * 4, m[col][lane]);
+                    }
+                }
+            }
+            else {
+                for (int row = 0; row < 3; row++) {
+                    __m128 r0 = m[0][row], r1 = m[1][row];
+                    __m128 r2 = m[2][row], r3 = m[3][row];
+                    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                    __m128 r[4] = {r0, r1, r2, r3};
+                    for (int lane = 0; lane < 4; lane++) {
+                        _mm_storeu_ps(out + lane * 12 + row * 4, r[lane]);
+                    }
+                }
+            }
+        }
+    }
+
+#else
+
+    template<InstanceLayout L>
+    void composeLanes(std::size_t i, float * out) const {
+        const std::size_t stride = floats<L>();
+        for (std::size_t lane = 0; lane < BlockSize; lane++, i++, out += stride) {
+            if (L == InstanceLayout::Rigid) {
+                const float r[8] = {
+                    qx[i], qy[i], qz[i], qw[i], px[i], py[i], pz[i], sx[i],
+                };
+                std::copy(r, r + 8, out);
+                continue;
+            }
+
+            float x2 = qx[i] + qx[i], y2 = qy[i] + qy[i], z2 = qz[i] + qz[i];
+            float xx = qx[i] * x2, yy = qy[i] * y2, zz = qz[i] * z2;
+            float xy = qx[i] * y2, xz = qx[i] * z2, yz = qy[i] * z2;
+            float wx = qw[i] * x2, wy = qw[i] * y2, wz = qw[i] * z2;
+
+            // m[column][row]
+            const float m[4][4] = {
+                {(1 - (yy + zz)) * sx[i], (xy + wz) * sx[i], (xz - wy) * sx[i], 0},
+                {(xy - wz) * sy[i], (1 - (xx + zz)) * sy[i], (yz + wx) * sy[i], 0},
+                {(xz + wy) * sz[i], (yz - wx) * sz[i], (1 - (xx + yy)) * sz[i], 0},
+                {px[i], py[i], pz[i], 1},
+            };
+
+            if (L == InstanceLayout::Matrix) {
+                std::copy(&m[0][0], &m[0][0] + 16, out);
+            }
+            else {
+                for (int row = 0; row < 3; row++) {
+                    for (int col = 0; col < 4; col++) {
+                        out[row * 4 + col] = m[col][row];
+                    }
+                }
+            }
+        }
+    }
+
+#endif
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Hands values from one writer thread to one reader thread without locks
+ * and without either side ever waiting.
+ *
+ * The writer fills the back slot and publishes it, the reader picks up the
+ * newest published slot. Of the three slots, one belongs to the writer, one
+ * to the reader and the third sits in the middle, swapping the middle slot
+ * is a single atomic exchange. The reader skips values that were published
+ * while it was busy, it always sees the latest one.
+ */
+template<typename T>
+class TripleBuffer {
+    // an index into slots, with Fresh set when the writer swapped it in
+    // since the reader last took it
+    enum : std::uint8_t {
+        IndexMask = 3,
+        Fresh = 4,
+    };
+
+    struct alignas(64) Slot {
+        T value;
+    };
+
+    Slot slots[3];
+    alignas(64) std::atomic<std::uint8_t> middle;
+    alignas(64) std::uint8_t back;
+    alignas(64) std::uint8_t front;
+
+public:
+    TripleBuffer() : middle(1), back(0), front(2) {}
+
+    /**
+     * Construct every slot as a copy of value.
+     */
+    explicit TripleBuffer(const T & value)
+        : slots {{value}, {value}, {value}}, middle(1), back(0), front(2) {}
+
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer & operator=(const TripleBuffer &) = delete;
+
+    /**
+     * The slot the writer fills, it holds whatever value was there when
+     * the slot came back from the reader.
+     */
+    T & write() {
+        return slots[back].value;
+    }
+
+    /**
+     * Make the back slot the newest value and take over an old one.
+     */
+    void publish() {
+        back = middle.exchange(back | Fresh, std::memory_order_acq_rel) & IndexMask;
+    }
+
+    /**
+     * Take the newest published value if there is one.
+     *
+     * @return true if read() changed
+     */
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & Fresh))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & IndexMask;
+        return true;
+    }
+
+    /**
+     * The value taken by the last update().
+     */
+    const T & read() const {
+        return slots[front].value;
+    }
+};
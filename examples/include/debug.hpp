@@ -1,99 +1,441 @@
 #pragma once
 
+#include <GL/glew.h>
+// gl.h after glew.h, clang-format don't sort
 #include <GL/gl.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
-static void GLAPIENTRY MessageCallback(GLenum source,
-                                       GLenum type,
-                                       GLuint id,
-                                       GLenum severity,
-                                       GLsizei length,
-                                       const GLchar * message,
-                                       const void * userParam) {
+/**
+ * Prints GL debug messages without slowing down the thread that caused them.
+ *
+ * The callback only copies the message into a bounded lock free queue, the
+ * formatting and the writes happen on a logger thread that drains it every
+ * Period. When the queue is full messages are dropped and counted.
+ *
+ * The first message of every (source, type, id) is printed in full, repeats
+ * are only counted. At most Rate messages a second are printed, the rest are
+ * suppressed. Every summary interval a single line reports the repeats, the
+ * suppressed and the dropped messages, so debug output can stay on in
+ * release builds.
+ *
+ * Known noise is filtered by the driver with glDebugMessageControl(), see
+ * initDebug().
+ */
+class DebugLog {
+public:
+    static constexpr std::size_t Capacity = 256;
+    static constexpr std::size_t MaxLength = 512;
+    // printed messages per second, also the burst size
+    static constexpr unsigned Rate = 20;
+    static constexpr std::chrono::milliseconds Period {10};
 
-    // ignore non-significant error/warning codes
-    if (id == 131169 || id == 131185 || id == 131218 || id == 131204)
-        return;
+    struct Message {
+        GLenum source;
+        GLenum type;
+        GLuint id;
+        GLenum severity;
+        char text[MaxLength];
+    };
 
-    std::cerr << "---------------" << std::endl;
-    std::cerr << "Debug message (" << id << "): " << message << std::endl;
-
-    switch (source) {
-        case GL_DEBUG_SOURCE_API:
-            std::cerr << "Source: API";
-            break;
-        case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
-            std::cerr << "Source: Window System";
-            break;
-        case GL_DEBUG_SOURCE_SHADER_COMPILER:
-            std::cerr << "Source: Shader Compiler";
-            break;
-        case GL_DEBUG_SOURCE_THIRD_PARTY:
-            std::cerr << "Source: Third Party";
-            break;
-        case GL_DEBUG_SOURCE_APPLICATION:
-            std::cerr << "Source: Application";
-            break;
-        case GL_DEBUG_SOURCE_OTHER:
-            std::cerr << "Source: Other";
-            break;
-    }
-    std::cerr << std::endl;
-
-    switch (type) {
-        case GL_DEBUG_TYPE_ERROR:
-            std::cerr << "Type: Error";
-            break;
-        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
-            std::cerr << "Type: Deprecated Behaviour";
-            break;
-        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
-            std::cerr << "Type: Undefined Behaviour";
-            break;
-        case GL_DEBUG_TYPE_PORTABILITY:
-            std::cerr << "Type: Portability";
-            break;
-        case GL_DEBUG_TYPE_PERFORMANCE:
-            std::cerr << "Type: Performance";
-            break;
-        case GL_DEBUG_TYPE_MARKER:
-            std::cerr << "Type: Marker";
-            break;
-        case GL_DEBUG_TYPE_PUSH_GROUP:
-            std::cerr << "Type: Push Group";
-            break;
-        case GL_DEBUG_TYPE_POP_GROUP:
-            std::cerr << "Type: Pop Group";
-            break;
-        case GL_DEBUG_TYPE_OTHER:
-            std::cerr << "Type: Other";
-            break;
-    }
-    std::cerr << std::endl;
-
-    switch (severity) {
-        case GL_DEBUG_SEVERITY_HIGH:
-            std::cerr << "Severity: high";
-            break;
-        case GL_DEBUG_SEVERITY_MEDIUM:
-            std::cerr << "Severity: medium";
-            break;
-        case GL_DEBUG_SEVERITY_LOW:
-            std::cerr << "Severity: low";
-            break;
-        case GL_DEBUG_SEVERITY_NOTIFICATION:
-            std::cerr << "Severity: notification";
-            break;
-    }
-    std::cerr << std::endl;
-    std::cerr << std::endl;
-}
+private:
+    struct Slot {
+        std::atomic<std::size_t> sequence;
+        Message message;
+    };
+
+    struct Entry {
+        std::uint64_t count = 0;
+        // repeats since the last summary
+        std::uint64_t repeats = 0;
+    };
+
+    // the queue, multiple producers because drivers may call back from
+    // their own threads
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<std::size_t> enqueuePos;
+    std::size_t dequeuePos;
+
+    std::atomic<std::uint64_t> received;
+    std::atomic<std::uint64_t> dropped;
+
+    // everything below is only touched with logMutex held
+    std::mutex logMutex;
+    std::ostream * out;
+    std::unordered_map<std::uint64_t, Entry> entries;
+    std::chrono::milliseconds summaryInterval;
+    std::chrono::steady_clock::time_point lastSummary;
+    std::chrono::steady_clock::time_point lastRefill;
+    double tokens;
+    std::uint64_t printed;
+    std::uint64_t suppressed;
+    std::uint64_t intervalSuppressed;
+    std::uint64_t reportedDropped;
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopping;
+    std::thread logger;
+
+    DebugLog()
+        : slots(new Slot[Capacity]),
+          enqueuePos(0),
+          dequeuePos(0),
+          received(0),
+          dropped(0),
+          out(&std::cerr),
+          summaryInterval(1000),
+          lastSummary(std::chrono::steady_clock::now()),
+          lastRefill(lastSummary),
+          tokens(Rate),
+          printed(0),
+          suppressed(0),
+          intervalSuppressed(0),
+          reportedDropped(0),
+          stopping(false) {
+        for (std::size_t i = 0; i < Capacity; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    DebugLog(const DebugLog &) = delete;
+    DebugLog & operator=(const DebugLog &) = delete;
+
+    ~DebugLog() {
+        stop();
+    }
+
+    static DebugLog & get() {
+        static DebugLog log;
+        return log;
+    }
+
+    /**
+     * The GLDEBUGPROC to register, userParam must be the DebugLog.
+     */
+    static void GLAPIENTRY callback(GLenum source,
+                                    GLenum type,
+                                    GLuint id,
+                                    GLenum severity,
+                                    GLsizei length,
+                                    const GLchar * message,
+                                    const void * userParam) {
+        auto log = static_cast<DebugLog *>(const_cast<void *>(userParam));
+        log->push(source, type, id, severity, length, message);
+    }
+
+    /**
+     * Queue a message, never blocks.
+     *
+     * @param length the length of text, negative if it is null terminated
+     * @return false if the queue was full and the message was dropped
+     */
+    bool push(GLenum source,
+              GLenum type,
+              GLuint id,
+              GLenum severity,
+              GLsizei length,
+              const char * text) {
+        received.fetch_add(1, std::memory_order_relaxed);
+        std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Slot * slot;
+        for (;;) {
+            slot = &slots[pos % Capacity];
+            std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            auto diff = std::intptr_t(sequence) - std::intptr_t(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        Message & m = slot->message;
+        m.source = source;
+        m.type = type;
+        m.id = id;
+        m.severity = severity;
+        std::size_t n = length < 0 ? std::strlen(text) : std::size_t(length);
+        n = std::min(n, MaxLength - 1);
+        std::memcpy(m.text, text, n);
+        m.text[n] = '\0';
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Start the logger thread, initDebug() does this.
+     */
+    void start() {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        if (logger.joinable())
+            return;
+        stopping = false;
+        logger = std::thread([this] { run(); });
+    }
+
+    /**
+     * Stop the logger thread after printing what is left in the queue.
+     */
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            if (!logger.joinable())
+                return;
+            stopping = true;
+        }
+        wake.notify_one();
+        logger.join();
+        logger = std::thread();
+    }
+
+    /**
+     * Print everything queued so far and a summary now, on the calling
+     * thread. Call it every frame for per frame summaries.
+     */
+    void flush() {
+        std::lock_guard<std::mutex> lock(logMutex);
+        drain();
+        summarize();
+    }
+
+    /**
+     * @param interval how often the logger prints a summary, zero for only
+     *                 on flush()
+     */
+    void setSummaryInterval(std::chrono::milliseconds interval) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        summaryInterval = interval;
+    }
+
+    void setStream(std::ostream & stream) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        out = &stream;
+    }
+
+    /**
+     * Ignore ids of a source and type in the driver, they are never sent.
+     */
+    static void ignore(GLenum source, GLenum type, const std::vector<GLuint> & ids) {
+        glDebugMessageControl(source, type, GL_DONT_CARE, ids.size(), ids.data(), GL_FALSE);
+    }
+
+    std::uint64_t getReceivedCount() const {
+        return received.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t getDroppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t getSuppressedCount() {
+        std::lock_guard<std::mutex> lock(logMutex);
+        return suppressed;
+    }
+
+    std::uint64_t getPrintedCount() {
+        std::lock_guard<std::mutex> lock(logMutex);
+        return printed;
+    }
+
+    static const char * sourceName(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API:
+                return "API";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+                return "Window System";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER:
+                return "Shader Compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY:
+                return "Third Party";
+            case GL_DEBUG_SOURCE_APPLICATION:
+                return "Application";
+            default:
+                return "Other";
+        }
+    }
+
+    static const char * typeName(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR:
+                return "Error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+                return "Deprecated Behaviour";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+                return "Undefined Behaviour";
+            case GL_DEBUG_TYPE_PORTABILITY:
+                return "Portability";
+            case GL_DEBUG_TYPE_PERFORMANCE:
+                return "Performance";
+            case GL_DEBUG_TYPE_MARKER:
+                return "Marker";
+            case GL_DEBUG_TYPE_PUSH_GROUP:
+                return "Push Group";
+            case GL_DEBUG_TYPE_POP_GROUP:
+                return "Pop Group";
+            default:
+                return "Other";
+        }
+    }
+
+    static const char * severityName(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH:
+                return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM:
+                return "medium";
+            case GL_DEBUG_SEVERITY_LOW:
+                return "low";
+            default:
+                return "notification";
+        }
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> wakeLock(wakeMutex);
+        while (!stopping) {
+            wake.wait_for(wakeLock, Period);
+            wakeLock.unlock();
+            {
+                std::lock_guard<std::mutex> lock(logMutex);
+                drain();
+                auto now = std::chrono::steady_clock::now();
+                if (summaryInterval.count() > 0 && now - lastSummary >= summaryInterval)
+                    summarize();
+            }
+            wakeLock.lock();
+        }
+        wakeLock.unlock();
+        flush();
+    }
+
+    /**
+     * Pop and print every queued message, logMutex must be held.
+     */
+    void drain() {
+        for (;;) {
+            Slot & slot = slots[dequeuePos % Capacity];
+            std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence != dequeuePos + 1)
+                break;
+            print(slot.message);
+            slot.sequence.store(dequeuePos + Capacity, std::memory_order_release);
+            dequeuePos++;
+        }
+        out->flush();
+    }
+
+    void print(const Message & m) {
+        std::uint64_t key = std::uint64_t(m.source & 0xFFFF) << 48
+                            | std::uint64_t(m.type & 0xFFFF) << 32 | m.id;
+        Entry & entry = entries[key];
+        if (entry.count++ > 0) {
+            entry.repeats++;
+            return;
+        }
+
+        // token bucket
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - lastRefill;
+        lastRefill = now;
+        tokens = std::min<double>(Rate, tokens + elapsed.count() * Rate);
+        if (tokens < 1) {
+            suppressed++;
+            intervalSuppressed++;
+            return;
+        }
+        tokens -= 1;
+        printed++;
+
+        *out << "GL debug (" << m.id << ") [" << sourceName(m.source) << ", "
+             << typeName(m.type) << ", " << severityName(m.severity)
+             << "]: " << m.text << '\n';
+    }
+
+    /**
+     * Print one line about what was not printed since the last summary,
+     * nothing if everything was. logMutex must be held.
+     */
+    void summarize() {
+        lastSummary = std::chrono::steady_clock::now();
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> repeated;
+        for (auto & e : entries) {
+            if (e.second.repeats > 0) {
+                repeated.push_back({e.second.repeats, e.first});
+                e.second.repeats = 0;
+            }
+        }
+        std::uint64_t newlyDropped = dropped.load(std::memory_order_relaxed) - reportedDropped;
+        reportedDropped += newlyDropped;
+        if (repeated.empty() && intervalSuppressed == 0 && newlyDropped == 0)
+            return;
+
+        std::sort(repeated.rbegin(), repeated.rend());
+        *out << "GL debug summary:";
+        for (std::size_t i = 0; i < repeated.size() && i < 5; i++) {
+            *out << " id " << (repeated[i].second & 0xFFFFFFFF) << " x"
+                 << repeated[i].first << ',';
+        }
+        if (repeated.size() > 5)
+            *out << " " << repeated.size() - 5 << " more ids repeated,";
+        *out << " " << intervalSuppressed << " suppressed, " << newlyDropped
+             << " dropped" << std::endl;
+        intervalSuppressed = 0;
+    }
+};
+
+/**
+ * Turn on debug output handled by DebugLog.
+ *
+ * Notifications and the known noise of the NVIDIA driver (buffer and
+ * framebuffer allocation info, shader recompiles, textures without a base
+ * level) are filtered in the driver, so they never cost a callback.
+ *
+ * @param synchronous call back on the thread and during the GL call that
+ *                    caused the message, to break in the debugger there
+ */
+inline void initDebug(bool synchronous = false) {
+    if (!GLEW_KHR_debug && !GLEW_VERSION_4_3) {
+        std::cerr << "Debug messages not supported" << std::endl;
+        return;
+    }
 
-void initDebug() {
     // During init, enable debug output
     glEnable(GL_DEBUG_OUTPUT);
-    glDebugMessageCallback(MessageCallback, 0);
+    if (synchronous)
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    else
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION,
+                          0, nullptr, GL_FALSE);
+    const std::vector<GLuint> noise {131169, 131185, 131204, 131218};
+    DebugLog::ignore(GL_DEBUG_SOURCE_API, GL_DEBUG_TYPE_OTHER, noise);
+    DebugLog::ignore(GL_DEBUG_SOURCE_API, GL_DEBUG_TYPE_PERFORMANCE, noise);
+
+    DebugLog & log = DebugLog::get();
+    log.start();
+    glDebugMessageCallback(DebugLog::callback, &log);
 
     std::cerr << "Debug messages enabled" << std::endl;
 }
@@ -0,0 +1,105 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include <GL/glew.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <Context.hpp>
+#include <Replay.hpp>
+
+static void usage(const char * name) {
+    std::cerr << "usage: " << name << " capture [options]\n"
+              << "  --from N     time frames from N on (default 0)\n"
+              << "  --to N       stop after frame N\n"
+              << "  --sync       wait for the GPU after every call\n"
+              << "  --size WxH   the size of the default frame buffer (default 800x600)\n"
+              << "  --json PATH  also write the results as JSON" << std::endl;
+}
+
+/**
+ * Replay a stream recorded with OPENGL_DEMO_CAPTURE on a headless context
+ * as fast as possible and print the frame and call times.
+ *
+ * All frames before --from are executed too, they create the objects the
+ * timed frames use.
+ */
+int main(int argc, char ** argv) {
+    if (argc < 2 || argv[1][0] == '-') {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string path = argv[1];
+    std::uint64_t first = 0;
+    std::uint64_t last = std::numeric_limits<std::uint64_t>::max();
+    bool synchronous = false;
+    std::string json;
+    Context::Settings settings;
+    settings.majorVersion = 4;
+    settings.minorVersion = 3;
+    settings.vsync = false;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sync") {
+            synchronous = true;
+        }
+        else if (arg == "--from" && hasValue) {
+            first = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--to" && hasValue) {
+            last = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--size" && hasValue) {
+            std::string size = argv[++i];
+            settings.size.x = std::strtoul(size.c_str(), nullptr, 10);
+            settings.size.y = std::strtoul(size.c_str() + size.find('x') + 1, nullptr, 10);
+        }
+        else if (arg == "--json" && hasValue) {
+            json = argv[++i];
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::unique_ptr<HeadlessContext> context;
+    try {
+        context = std::make_unique<HeadlessContext>(settings);
+    } catch (Context::ContextException & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    FrameBuffer::getDefault().bind();
+
+    try {
+        Replay replay(path);
+        replay.setSynchronous(synchronous);
+        replay.run(first, last);
+
+        std::cout << "replayed " << replay.getFrameCount() << " frames on "
+                  << reinterpret_cast<const char *>(glGetString(GL_RENDERER)) << std::endl;
+        if (replay.isTruncated())
+            std::cerr << path << " is truncated, replayed up to the last whole call" << std::endl;
+        replay.report(std::cout);
+
+        if (!json.empty()) {
+            std::ofstream file(json);
+            if (!file) {
+                std::cerr << "Could not open " << json << std::endl;
+                return 1;
+            }
+            replay.writeJson(file);
+        }
+    } catch (Replay::ReplayException & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}